@@ -0,0 +1,52 @@
+# Locate LZ4.
+# This module defines
+# LZ4_LIBRARY
+# LZ4_FOUND, if false, do not try to link to lz4
+# LZ4_INCLUDE_DIR, where to find the headers
+
+FIND_PATH(LZ4_INCLUDE_DIR lz4.h
+  PATHS
+  $ENV{LZ4_DIR}
+  NO_DEFAULT_PATH
+    PATH_SUFFIXES include
+)
+
+FIND_PATH(LZ4_INCLUDE_DIR lz4.h
+  PATHS
+  ~/Library/Frameworks
+  /Library/Frameworks
+  /usr/local/include
+  /usr/include
+  /sw/include # Fink
+  /opt/local/include # DarwinPorts
+  /opt/csw/include # Blastwave
+  /opt/include
+)
+
+FIND_LIBRARY(LZ4_LIBRARY
+  NAMES liblz4 lz4 lz4_static
+  PATHS
+    $ENV{LZ4_DIR}
+    NO_DEFAULT_PATH
+    PATH_SUFFIXES lib64 lib
+)
+
+FIND_LIBRARY(LZ4_LIBRARY
+  NAMES liblz4 lz4 lz4_static
+  PATHS
+    ~/Library/Frameworks
+    /Library/Frameworks
+    /usr/local
+    /usr
+    /sw
+    /opt/local
+    /opt/csw
+    /opt
+    /usr/freeware
+  PATH_SUFFIXES lib64 lib
+)
+
+SET(LZ4_FOUND "NO")
+IF(LZ4_LIBRARY AND LZ4_INCLUDE_DIR)
+  SET(LZ4_FOUND "YES")
+ENDIF(LZ4_LIBRARY AND LZ4_INCLUDE_DIR)
@@ -0,0 +1,52 @@
+# Locate Zstandard (zstd).
+# This module defines
+# ZSTD_LIBRARY
+# ZSTD_FOUND, if false, do not try to link to zstd
+# ZSTD_INCLUDE_DIR, where to find the headers
+
+FIND_PATH(ZSTD_INCLUDE_DIR zstd.h
+  PATHS
+  $ENV{ZSTD_DIR}
+  NO_DEFAULT_PATH
+    PATH_SUFFIXES include
+)
+
+FIND_PATH(ZSTD_INCLUDE_DIR zstd.h
+  PATHS
+  ~/Library/Frameworks
+  /Library/Frameworks
+  /usr/local/include
+  /usr/include
+  /sw/include # Fink
+  /opt/local/include # DarwinPorts
+  /opt/csw/include # Blastwave
+  /opt/include
+)
+
+FIND_LIBRARY(ZSTD_LIBRARY
+  NAMES libzstd zstd zstd_static
+  PATHS
+    $ENV{ZSTD_DIR}
+    NO_DEFAULT_PATH
+    PATH_SUFFIXES lib64 lib
+)
+
+FIND_LIBRARY(ZSTD_LIBRARY
+  NAMES libzstd zstd zstd_static
+  PATHS
+    ~/Library/Frameworks
+    /Library/Frameworks
+    /usr/local
+    /usr
+    /sw
+    /opt/local
+    /opt/csw
+    /opt
+    /usr/freeware
+  PATH_SUFFIXES lib64 lib
+)
+
+SET(ZSTD_FOUND "NO")
+IF(ZSTD_LIBRARY AND ZSTD_INCLUDE_DIR)
+  SET(ZSTD_FOUND "YES")
+ENDIF(ZSTD_LIBRARY AND ZSTD_INCLUDE_DIR)
@@ -0,0 +1,238 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/RawRecordCodec>
+#include <osgEarth/Registry>
+#include <osgEarth/Random>
+#include <osgEarth/StringUtils>
+#include <osg/ArgumentParser>
+#include <osg/Image>
+#include <osg/Shape>
+#include <osg/Timer>
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+#include <osgDB/ObjectWrapper>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+
+#define LC "[cachebench] "
+
+using namespace osgEarth;
+
+/**
+ * Compares the size and decode throughput of cache records written by the
+ * osgb serializer (plain and with the zlib compressor the filesystem cache
+ * uses) against the raw record format with each available compressor.
+ * Everything happens in memory, so the numbers are pure CPU cost: what a
+ * cache hit costs on top of the disk read.
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_cachebench" << std::endl
+        << "    [--image file]    : image to encode (default = synthetic 256x256 RGBA tile)" << std::endl
+        << "    [--heightfield]   : encode a synthetic 257x257 heightfield instead" << std::endl
+        << "    [--iterations n]  : number of decodes per format (default = 2000)" << std::endl;
+    return -1;
+}
+
+osg::Image* createImage()
+{
+    // smooth gradients with some noise, roughly as compressible as imagery.
+    osgEarth::Random prng(0, osgEarth::Random::METHOD_FAST);
+    osg::Image* image = new osg::Image();
+    image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    unsigned char* p = image->data();
+    for(int t=0; t<256; ++t)
+    {
+        for(int s=0; s<256; ++s)
+        {
+            *p++ = (unsigned char)(s ^ (prng.next(16)));
+            *p++ = (unsigned char)(t ^ (prng.next(16)));
+            *p++ = (unsigned char)((s+t)/2);
+            *p++ = 255;
+        }
+    }
+    return image;
+}
+
+osg::HeightField* createHeightField()
+{
+    osg::HeightField* hf = new osg::HeightField();
+    hf->allocate(257, 257);
+    hf->setOrigin( osg::Vec3(-180.0f, -90.0f, 0.0f) );
+    hf->setXInterval( 360.0f/256.0f );
+    hf->setYInterval( 180.0f/256.0f );
+    for(unsigned r=0; r<257; ++r)
+        for(unsigned c=0; c<257; ++c)
+            hf->setHeight(c, r, 1000.0f * sinf(0.05f*c) * cosf(0.03f*r));
+    return hf;
+}
+
+struct Result
+{
+    std::string name;
+    size_t      bytes;
+    double      seconds;
+    unsigned    numOK;
+};
+
+void report(const Result& r, unsigned iterations, size_t rawBytes)
+{
+    double perSecond = r.seconds > 0.0 ? (double)r.numOK / r.seconds : 0.0;
+    OE_NOTICE << LC
+        << std::setw(10) << std::left << r.name
+        << ": bytes=" << r.bytes
+        << " (" << std::setprecision(3) << (100.0*(double)r.bytes/(double)rawBytes) << "% of raw)"
+        << "; ok=" << r.numOK << "/" << iterations
+        << "; decodes/s=" << std::setprecision(6) << perSecond
+        << "; MB/s=" << (perSecond * (double)rawBytes / 1048576.0)
+        << std::endl;
+}
+
+Result benchOSGB(const std::string& name, const osg::Object* object, const osgDB::Options* dbo, unsigned iterations)
+{
+    Result result;
+    result.name  = name;
+    result.bytes = 0u;
+    result.seconds = 0.0;
+    result.numOK = 0u;
+
+    osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+    if ( !rw )
+        return result;
+
+    std::stringstream out;
+    if ( !rw->writeObject(*object, out, dbo).success() )
+        return result;
+
+    std::string data = out.str();
+    result.bytes = data.size();
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<iterations; ++i)
+    {
+        // same as a database cache bin: stream straight from the record bytes.
+        std::istringstream in(data);
+        osgDB::ReaderWriter::ReadResult r = rw->readObject(in, dbo);
+        if ( r.success() ) ++result.numOK;
+    }
+    result.seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    return result;
+}
+
+Result benchRaw(const std::string& name, const osg::Object* object, CacheOptions::RecordCompression c, unsigned iterations)
+{
+    Result result;
+    result.name  = name;
+    result.bytes = 0u;
+    result.seconds = 0.0;
+    result.numOK = 0u;
+
+    osg::ref_ptr<RawRecordCodec> codec = new RawRecordCodec(c);
+    std::string data;
+    if ( !codec->encode(object, data) )
+        return result;
+
+    result.bytes = data.size();
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned i=0; i<iterations; ++i)
+    {
+        osg::ref_ptr<osg::Object> decoded = RawRecordCodec::decode(data.data(), data.size());
+        if ( decoded.valid() ) ++result.numOK;
+    }
+    result.seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    return result;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( arguments.read("--help") )
+        return usage("");
+
+    unsigned iterations = 2000u;
+    arguments.read("--iterations", iterations);
+
+    std::string imageFile;
+    arguments.read("--image", imageFile);
+
+    bool heightField = arguments.read("--heightfield");
+
+    Registry::instance();
+
+    osg::ref_ptr<osg::Object> object;
+    size_t rawBytes = 0u;
+
+    if ( heightField )
+    {
+        osg::HeightField* hf = createHeightField();
+        rawBytes = hf->getNumColumns() * hf->getNumRows() * sizeof(float);
+        object = hf;
+    }
+    else
+    {
+        osg::Image* image = imageFile.empty() ? createImage() : osgDB::readImageFile(imageFile);
+        if ( !image )
+            return usage(Stringify() << "Failed to load image \"" << imageFile << "\"");
+        rawBytes = image->getTotalSizeInBytes();
+        object = image;
+    }
+
+    // force OSG to initialize the serializer wrappers before timing anything.
+    osgDB::ObjectWrapperManager* owm = osgDB::Registry::instance()->getObjectWrapperManager();
+    owm->findWrapper("osg::Image");
+    owm->findWrapper("osg::HeightField");
+
+    OE_NOTICE << LC << "raw payload = " << rawBytes << " bytes; " << iterations << " decodes per format" << std::endl;
+
+    osg::ref_ptr<osgDB::Options> zlibOptions = Registry::instance()->cloneOrCreateOptions();
+    zlibOptions->setPluginStringData("Compressor", "zlib");
+
+    report( benchOSGB("osgb", object.get(), 0L, iterations), iterations, rawBytes );
+    report( benchOSGB("osgb+zlib", object.get(), zlibOptions.get(), iterations), iterations, rawBytes );
+
+    const CacheOptions::RecordCompression methods[4] = {
+        CacheOptions::RECORD_COMPRESSION_NONE,
+        CacheOptions::RECORD_COMPRESSION_LZ4,
+        CacheOptions::RECORD_COMPRESSION_ZSTD,
+        CacheOptions::RECORD_COMPRESSION_ZLIB };
+    const char* names[4] = { "raw", "raw+lz4", "raw+zstd", "raw+zlib" };
+
+    for(unsigned i=0; i<4; ++i)
+    {
+        if ( RawRecordCodec::isSupported(methods[i]) )
+            report( benchRaw(names[i], object.get(), methods[i], iterations), iterations, rawBytes );
+        else
+            OE_NOTICE << LC << std::setw(10) << std::left << names[i] << ": not available in this build" << std::endl;
+    }
+
+    return 0;
+}
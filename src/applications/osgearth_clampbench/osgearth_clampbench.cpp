@@ -0,0 +1,147 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Random>
+#include <osgDB/ReadFile>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <vector>
+
+#define LC "[clampbench] "
+
+using namespace osgEarth;
+
+/**
+ * Measures point clamping throughput: samples the elevation of random
+ * points one at a time and then in a single batch, and reports both.
+ * Run an untimed pass first so both timings measure sampling rather than
+ * tile creation; use a small --extent to keep the tiles within the pool's
+ * cache.
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_clampbench <file.earth>" << std::endl
+        << "    [--points n]           : number of points to clamp (default = 1000000)" << std::endl
+        << "    [--level n]            : LOD of the elevation data to sample (default = 12)" << std::endl
+        << "    [--extent xmin ymin xmax ymax] : area to sample, in lat/long (default = whole map)" << std::endl;
+    return -1;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    unsigned numPoints = 1000000u;
+    arguments.read("--points", numPoints);
+
+    unsigned level = 12u;
+    arguments.read("--level", level);
+
+    double xmin = -180.0, ymin = -90.0, xmax = 180.0, ymax = 90.0;
+    bool hasExtent = arguments.read("--extent", xmin, ymin, xmax, ymax);
+
+    osg::ref_ptr<osg::Node> node = osgDB::readNodeFiles( arguments );
+    MapNode* mapNode = MapNode::get( node.get() );
+    if ( !mapNode )
+        return usage("Failed to load an earth file");
+
+    Map* map = mapNode->getMap();
+    const SpatialReference* srs = map->getSRS()->getGeographicSRS();
+
+    GeoExtent extent = map->getProfile()->getExtent().transform( srs );
+    if ( hasExtent )
+        extent = GeoExtent( srs, xmin, ymin, xmax, ymax );
+
+    // Use the same random points for both runs.
+    Random prng( 0u );
+    std::vector<double> x( numPoints ), y( numPoints );
+    for(unsigned i=0; i<numPoints; ++i)
+    {
+        x[i] = extent.xMin() + prng.next() * extent.width();
+        y[i] = extent.yMin() + prng.next() * extent.height();
+    }
+
+    OE_NOTICE << LC << "Clamping " << numPoints << " points at level " << level
+        << " in " << extent.toString() << std::endl;
+
+    // Warm up the elevation pool:
+    {
+        osg::ref_ptr<ElevationEnvelope> envelope = map->getElevationPool()->createEnvelope( srs, level );
+        std::vector<float> elevations( numPoints );
+        if ( numPoints > 0u )
+            envelope->getElevations( &x[0], &y[0], numPoints, &elevations[0] );
+    }
+
+    // Point-by-point:
+    {
+        osg::ref_ptr<ElevationEnvelope> envelope = map->getElevationPool()->createEnvelope( srs, level );
+        unsigned numClamped = 0u;
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned i=0; i<numPoints; ++i)
+        {
+            if ( envelope->getElevation(x[i], y[i]) != NO_DATA_VALUE )
+                ++numClamped;
+        }
+
+        double seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+        OE_NOTICE << LC
+            << "mode=point"
+            << "; clamped=" << numClamped
+            << "; time=" << seconds << "s"
+            << "; points/s=" << (seconds > 0.0 ? (double)numPoints/seconds : 0.0)
+            << std::endl;
+    }
+
+    // Batched:
+    {
+        osg::ref_ptr<ElevationEnvelope> envelope = map->getElevationPool()->createEnvelope( srs, level );
+        std::vector<float> elevations( numPoints );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        unsigned numClamped = numPoints > 0u ?
+            envelope->getElevations( &x[0], &y[0], numPoints, &elevations[0] ) : 0u;
+
+        double seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+        OE_NOTICE << LC
+            << "mode=batch"
+            << "; clamped=" << numClamped
+            << "; time=" << seconds << "s"
+            << "; points/s=" << (seconds > 0.0 ? (double)numPoints/seconds : 0.0)
+            << std::endl;
+    }
+
+    return 0;
+}
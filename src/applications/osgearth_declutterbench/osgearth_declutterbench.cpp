@@ -0,0 +1,191 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/ScreenSpaceLayout>
+#include <osgEarth/Random>
+#include <osg/ArgumentParser>
+#include <osg/Camera>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Math>
+#include <osg/Timer>
+#include <osgUtil/RenderStage>
+#include <osgUtil/StateGraph>
+#include <vector>
+
+#define LC "[declutterbench] "
+
+using namespace osgEarth;
+
+/**
+ * Feeds synthetic label boxes through the screen-space layout (declutter)
+ * sorter, without a window or graphics context, and reports the time per
+ * sort. Each label is a quad drawable under its own Geode, placed at a
+ * random window position through its modelview matrix, the way the cull
+ * traversal would hand it to the layout render bin.
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_declutterbench" << std::endl
+        << "    [--labels n]      : number of labels (default = 20000)" << std::endl
+        << "    [--frames n]      : number of sorts to time (default = 50)" << std::endl
+        << "    [--width n]       : viewport width (default = 1920)" << std::endl
+        << "    [--height n]      : viewport height (default = 1080)" << std::endl
+        << "    [--priority]      : sort by random label priority instead of depth" << std::endl;
+    return -1;
+}
+
+// A label-sized quad centered on the origin.
+osg::Geometry*
+createLabel(Random& prng)
+{
+    float w = 20.0f + (float)prng.next(100);
+    float h = 10.0f + (float)prng.next(20);
+
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    verts->push_back( osg::Vec3(-0.5f*w, -0.5f*h, 0.0f) );
+    verts->push_back( osg::Vec3( 0.5f*w, -0.5f*h, 0.0f) );
+    verts->push_back( osg::Vec3( 0.5f*w,  0.5f*h, 0.0f) );
+    verts->push_back( osg::Vec3(-0.5f*w,  0.5f*h, 0.0f) );
+
+    osg::Geometry* geom = new osg::Geometry();
+    geom->setVertexArray( verts );
+    geom->addPrimitiveSet( new osg::DrawArrays(GL_QUADS, 0, 4) );
+    return geom;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( arguments.read("--help") )
+        return usage("");
+
+    unsigned numLabels = 20000u;
+    arguments.read("--labels", numLabels);
+    numLabels = osg::maximum(numLabels, 1u);
+
+    unsigned numFrames = 50u;
+    arguments.read("--frames", numFrames);
+    numFrames = osg::maximum(numFrames, 1u);
+
+    int width = 1920, height = 1080;
+    arguments.read("--width", width);
+    arguments.read("--height", height);
+    width  = osg::maximum(width, 1);
+    height = osg::maximum(height, 1);
+
+    bool byPriority = arguments.read("--priority");
+
+    ScreenSpaceLayoutOptions options = ScreenSpaceLayout::getOptions();
+    options.sortByPriority() = byPriority;
+    ScreenSpaceLayout::setOptions( options );
+    ScreenSpaceLayout::setDeclutteringEnabled( true );
+
+    osgUtil::RenderBin* prototype = osgUtil::RenderBin::getRenderBinPrototype( OSGEARTH_SCREEN_SPACE_LAYOUT_BIN );
+    osgUtil::RenderBin::SortCallback* sorter = prototype ? prototype->getSortCallback() : 0L;
+    if ( !sorter )
+        return usage("The screen-space layout render bin is not registered");
+
+    // an ortho camera that maps modelview translations straight to window coordinates.
+    osg::ref_ptr<osg::Camera> camera = new osg::Camera();
+    camera->setViewport( 0, 0, width, height );
+    camera->setProjectionMatrixAsOrtho2D( 0.0, (double)width, 0.0, (double)height );
+    camera->setViewMatrix( osg::Matrix::identity() );
+
+    osg::ref_ptr<osg::RefMatrix> projection = new osg::RefMatrix( camera->getProjectionMatrix() );
+
+    osg::ref_ptr<osgUtil::RenderStage> stage = new osgUtil::RenderStage();
+    stage->setCamera( camera.get() );
+
+    osg::ref_ptr<osgUtil::StateGraph> stateGraph = new osgUtil::StateGraph();
+
+    Random prng( 0u );
+    std::vector< osg::ref_ptr<osg::Geode> >         geodes;
+    std::vector< osg::ref_ptr<osgUtil::RenderLeaf> > leaves;
+    std::vector< osg::ref_ptr<osg::RefMatrix> >      modelviews;
+    std::vector< float >                             depths;
+
+    for(unsigned i=0; i<numLabels; ++i)
+    {
+        osg::Geometry* label = createLabel( prng );
+
+        if ( byPriority )
+            ScreenSpaceLayoutData::getOrCreate( label )->setPriority( (float)prng.next(100) );
+
+        // the sorter groups drawables by their parent.
+        osg::Geode* geode = new osg::Geode();
+        geode->addDrawable( label );
+        geodes.push_back( geode );
+
+        osg::RefMatrix* modelview = new osg::RefMatrix( osg::Matrix::translate(
+            (double)(prng.next() * width),
+            (double)(prng.next() * height),
+            0.0) );
+        modelviews.push_back( modelview );
+
+        depths.push_back( (float)prng.next() );
+
+        osgUtil::RenderLeaf* leaf = new osgUtil::RenderLeaf( label, projection.get(), modelview, depths.back(), i );
+        leaves.push_back( leaf );
+        stateGraph->addLeaf( leaf );
+    }
+
+    OE_NOTICE << LC << numLabels << " labels in a " << width << "x" << height << " viewport; "
+        << (byPriority ? "priority" : "depth") << " order" << std::endl;
+
+    double total = 0.0;
+    unsigned numDrawn = 0u;
+
+    for(unsigned frame=0; frame<numFrames; ++frame)
+    {
+        // the sorter replaces each leaf's modelview with a window-space one and
+        // reuses its depth for the fade; restore them. The bin also drops its
+        // state graphs once it has collected their leaves.
+        for(unsigned i=0; i<leaves.size(); ++i)
+        {
+            leaves[i]->_modelview = modelviews[i].get();
+            leaves[i]->_depth     = depths[i];
+        }
+        stage->addStateGraph( stateGraph.get() );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        sorter->sortImplementation( stage.get() );
+        total += osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+        numDrawn = stage->getRenderLeafList().size();
+    }
+
+    OE_NOTICE << LC
+        << "ms/sort=" << (1000.0 * total / (double)numFrames)
+        << "; labels/s=" << (total > 0.0 ? (double)numLabels * (double)numFrames / total : 0.0)
+        << "; leaves left to draw=" << numDrawn << "/" << numLabels
+        << std::endl;
+
+    return 0;
+}
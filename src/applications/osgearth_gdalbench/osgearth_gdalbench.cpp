@@ -0,0 +1,169 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/TileSource>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Random>
+#include <osgEarthDrivers/gdal/GDALOptions>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <vector>
+
+#define LC "[gdalbench] "
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+/**
+ * Measures GDAL tile read throughput: reads random tiles from a local
+ * dataset with 1, 2, 4 ... N threads and reports tiles per second.
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_gdalbench <file>" << std::endl
+        << "    [--tiles n]       : number of tiles to read per run (default = 1000)" << std::endl
+        << "    [--threads n]     : maximum number of threads (default = 32)" << std::endl
+        << "    [--level n]       : LOD of the tiles to read (default = 10)" << std::endl
+        << "    [--elevation]     : read heightfields instead of images" << std::endl;
+    return -1;
+}
+
+struct ReadThread : public OpenThreads::Thread
+{
+    ReadThread(TileSource* source, const std::vector<TileKey>& keys, unsigned first, unsigned count, bool elevation) :
+        _source(source), _keys(keys), _first(first), _count(count), _elevation(elevation), _numRead(0u) { }
+
+    void run()
+    {
+        for(unsigned i=_first; i<_first+_count; ++i)
+        {
+            if ( _elevation )
+            {
+                osg::ref_ptr<osg::HeightField> hf = _source->createHeightField( _keys[i] );
+                if ( hf.valid() ) ++_numRead;
+            }
+            else
+            {
+                osg::ref_ptr<osg::Image> image = _source->createImage( _keys[i] );
+                if ( image.valid() ) ++_numRead;
+            }
+        }
+    }
+
+    TileSource*                 _source;
+    const std::vector<TileKey>& _keys;
+    unsigned                    _first, _count;
+    bool                        _elevation;
+    unsigned                    _numRead;
+};
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( argc < 2 )
+        return usage("Missing input file");
+
+    unsigned numTiles = 1000u;
+    arguments.read("--tiles", numTiles);
+
+    unsigned maxThreads = 32u;
+    arguments.read("--threads", maxThreads);
+
+    unsigned level = 10u;
+    arguments.read("--level", level);
+
+    bool elevation = arguments.read("--elevation");
+
+    GDALOptions gdal;
+    gdal.url() = arguments[1];
+    gdal.L2CacheSize() = 0; // measure the driver, not the memory cache
+
+    osg::ref_ptr<TileSource> source = TileSourceFactory::create( gdal );
+    if ( !source.valid() )
+        return usage("Failed to load the GDAL driver");
+
+    const Status& status = source->open();
+    if ( status.isError() )
+        return usage( Stringify() << "Failed to open " << arguments[1] << ": " << status.message() );
+
+    const Profile* profile = source->getProfile();
+    GeoExtent extent = source->getDataExtentsUnion();
+    if ( !extent.isValid() )
+        extent = profile->getExtent();
+
+    // Use the same random keys for every run so the results are comparable.
+    Random prng( 0u );
+    std::vector<TileKey> keys;
+    keys.reserve( numTiles );
+    for(unsigned i=0; i<numTiles; ++i)
+    {
+        double x = extent.xMin() + prng.next() * extent.width();
+        double y = extent.yMin() + prng.next() * extent.height();
+        keys.push_back( profile->createTileKey(x, y, level) );
+    }
+
+    OE_NOTICE << LC << "Reading " << numTiles << (elevation ? " heightfields" : " images")
+        << " at level " << level << " from " << arguments[1] << std::endl;
+
+    for(unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        std::vector< ReadThread* > threads;
+        unsigned perThread = numTiles / numThreads;
+        for(unsigned t=0; t<numThreads; ++t)
+        {
+            unsigned count = t+1 < numThreads ? perThread : numTiles - perThread*t;
+            threads.push_back( new ReadThread(source.get(), keys, perThread*t, count, elevation) );
+        }
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned t=0; t<threads.size(); ++t)
+            threads[t]->start();
+
+        unsigned numRead = 0u;
+        for(unsigned t=0; t<threads.size(); ++t)
+        {
+            threads[t]->join();
+            numRead += threads[t]->_numRead;
+            delete threads[t];
+        }
+
+        double seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+        OE_NOTICE << LC
+            << "threads=" << numThreads
+            << "; tiles=" << numRead
+            << "; time=" << seconds << "s"
+            << "; tiles/s=" << (seconds > 0.0 ? (double)numRead/seconds : 0.0)
+            << std::endl;
+    }
+
+    return 0;
+}
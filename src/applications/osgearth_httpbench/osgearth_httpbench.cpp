@@ -0,0 +1,277 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/HTTPClient>
+#include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <osgEarth/URI>
+#include <osg/ArgumentParser>
+#include <osg/Math>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <vector>
+#include <new>
+#include <cstdlib>
+
+#define LC "[httpbench] "
+
+using namespace osgEarth;
+
+/**
+ * Compares blocking HTTP reads on a pool of threads against asynchronous
+ * reads on the HTTPClient's I/O thread. Point it at a local server that
+ * adds latency to each response to see the effect of keeping many
+ * requests in flight.
+ *
+ * With --alloc it instead fetches the URL repeatedly on the main thread and
+ * counts the heap bytes allocated per response. Anything beyond the size of
+ * the body is growth slack or a copy of it.
+ */
+
+// Heap accounting for --alloc. Only the main thread allocates while the
+// counter is enabled. Replacing the global operators only catches
+// allocations that go through the executable's runtime: that covers the
+// osgEarth libraries on Linux and macOS, but not DLLs on Windows.
+static std::size_t s_bytesAllocated = 0u;
+static bool        s_countAllocations = false;
+
+#if __cplusplus >= 201103L
+#  define OE_THROWS_BAD_ALLOC
+#  define OE_NO_THROW noexcept
+#else
+#  define OE_THROWS_BAD_ALLOC throw(std::bad_alloc)
+#  define OE_NO_THROW throw()
+#endif
+
+void* operator new(std::size_t size) OE_THROWS_BAD_ALLOC
+{
+    if ( s_countAllocations )
+        s_bytesAllocated += size;
+    void* p = std::malloc( size > 0u ? size : 1u );
+    if ( !p )
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) OE_NO_THROW
+{
+    std::free( p );
+}
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_httpbench <url>" << std::endl
+        << "    [--requests n]    : number of requests per run (default = 500)" << std::endl
+        << "    [--threads n]     : number of threads for the blocking run (default = 8)" << std::endl
+        << "    [--max n]         : maximum async requests in flight (default = 256)" << std::endl
+        << "    [--http2]         : allow HTTP/2 multiplexing for the async run" << std::endl
+        << "    [--alloc]         : report heap bytes allocated per response instead" << std::endl
+        << std::endl
+        << "Each request appends \"?n=<index>\" (or \"&n=<index>\") to the URL." << std::endl;
+    return -1;
+}
+
+std::string makeURL(const std::string& base, unsigned i)
+{
+    return Stringify() << base << (base.find('?') == std::string::npos ? "?" : "&") << "n=" << i;
+}
+
+struct GetThread : public OpenThreads::Thread
+{
+    GetThread(const std::string& base, unsigned first, unsigned count) :
+        _base(base), _first(first), _count(count), _numOK(0u) { }
+
+    void run()
+    {
+        for(unsigned i=_first; i<_first+_count; ++i)
+        {
+            HTTPResponse response = HTTPClient::get( makeURL(_base, i) );
+            if ( response.isOK() ) ++_numOK;
+        }
+    }
+
+    std::string _base;
+    unsigned    _first, _count;
+    unsigned    _numOK;
+};
+
+int allocBench(const std::string& base, unsigned numRequests)
+{
+    // warm up the connection and any lazily created state first.
+    HTTPClient::get( makeURL(base, 0u) );
+
+    std::size_t bodyBytes = 0u, allocBytes = 0u;
+    unsigned numOK = 0u;
+
+    for(unsigned i=0; i<numRequests; ++i)
+    {
+        std::string url = makeURL(base, i);
+
+        s_bytesAllocated = 0u;
+        s_countAllocations = true;
+        HTTPResponse response = HTTPClient::get( url );
+        s_countAllocations = false;
+
+        if ( response.isOK() && response.getNumParts() > 0 )
+        {
+            ++numOK;
+            bodyBytes  += response.getPartSize(0);
+            allocBytes += s_bytesAllocated;
+        }
+    }
+
+    if ( numOK == 0u )
+        return usage("No successful responses");
+
+    double body  = (double)bodyBytes / (double)numOK;
+    double alloc = (double)allocBytes / (double)numOK;
+
+    OE_NOTICE << LC
+        << "responses=" << numOK
+        << "; body bytes/tile=" << body
+        << "; allocated bytes/tile=" << alloc
+        << "; extra bytes/tile=" << (alloc - body)
+        << "; allocated/body=" << (body > 0.0 ? alloc/body : 0.0)
+        << std::endl;
+
+    return 0;
+}
+
+void report(const std::string& name, unsigned numOK, unsigned numRequests, osg::Timer_t start)
+{
+    double seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+    OE_NOTICE << LC
+        << name
+        << ": ok=" << numOK << "/" << numRequests
+        << "; time=" << seconds << "s"
+        << "; requests/s=" << (seconds > 0.0 ? (double)numOK/seconds : 0.0)
+        << std::endl;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( argc < 2 )
+        return usage("Missing URL");
+
+    unsigned numRequests = 500u;
+    arguments.read("--requests", numRequests);
+
+    unsigned numThreads = 8u;
+    arguments.read("--threads", numThreads);
+    numThreads = osg::maximum(numThreads, 1u);
+
+    unsigned maxInFlight = 256u;
+    arguments.read("--max", maxInFlight);
+
+    bool http2 = arguments.read("--http2");
+
+    bool alloc = arguments.read("--alloc");
+
+    std::string base = arguments[1];
+
+    // make sure curl is initialized.
+    Registry::instance();
+
+    HTTPClient::setMaxConcurrentRequests( maxInFlight );
+    HTTPClient::setHTTP2Enabled( http2 );
+
+    if ( alloc )
+    {
+        HTTPClient::setAsyncEnabled( false );
+        return allocBench( base, numRequests );
+    }
+
+    // blocking reads, spread across a pool of threads:
+    {
+        std::vector< GetThread* > threads;
+        unsigned perThread = numRequests / numThreads;
+        for(unsigned t=0; t<numThreads; ++t)
+        {
+            unsigned count = t+1 < numThreads ? perThread : numRequests - perThread*t;
+            threads.push_back( new GetThread(base, perThread*t, count) );
+        }
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned t=0; t<threads.size(); ++t)
+            threads[t]->start();
+
+        unsigned numOK = 0u;
+        for(unsigned t=0; t<threads.size(); ++t)
+        {
+            threads[t]->join();
+            numOK += threads[t]->_numOK;
+            delete threads[t];
+        }
+
+        report( Stringify() << "blocking (" << numThreads << " threads)", numOK, numRequests, start );
+    }
+
+    // asynchronous reads, all issued from this thread:
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        std::vector< osg::ref_ptr<HTTPFuture> > futures;
+        futures.reserve( numRequests );
+        for(unsigned i=0; i<numRequests; ++i)
+        {
+            futures.push_back( HTTPClient::getAsync(HTTPRequest(makeURL(base, i))) );
+        }
+
+        unsigned numOK = 0u;
+        for(unsigned i=0; i<futures.size(); ++i)
+        {
+            if ( futures[i]->getResponse().isOK() ) ++numOK;
+        }
+
+        report( Stringify() << "async (" << maxInFlight << " in flight" << (http2 ? ", http2" : "") << ")", numOK, numRequests, start );
+    }
+
+    // the same through URI, which adds caching and decodes in get():
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        std::vector< osg::ref_ptr<URIFuture> > futures;
+        futures.reserve( numRequests );
+        for(unsigned i=0; i<numRequests; ++i)
+        {
+            futures.push_back( URI(makeURL(base, i)).readStringAsync() );
+        }
+
+        unsigned numOK = 0u;
+        for(unsigned i=0; i<futures.size(); ++i)
+        {
+            if ( futures[i]->get().succeeded() ) ++numOK;
+        }
+
+        report( "URI async", numOK, numRequests, start );
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/Registry>
+#include <osgEarth/TileSource>
+#include <osgEarth/TileKey>
+#include <osg/ArgumentParser>
+#include <osg/Image>
+#include <osg/Math>
+#include <osg/Timer>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#define LC "[memcachebench] "
+
+using namespace osgEarth;
+
+/**
+ * Measures what an ImageLayer memory (L2) cache hit costs, with the cache
+ * sharing its images (l2_cache_share_objects = true) and with it handing
+ * out deep copies (the default). The layer reads synthetic tiles from an
+ * in-process TileSource; after one pass warms the cache, every
+ * createImage() call is a hit. Reports the time and the bytes allocated
+ * per hit.
+ */
+
+// Counts bytes passing through the global allocator while enabled.
+static bool   s_counting = false;
+static size_t s_bytes    = 0;
+
+void* operator new(std::size_t size)
+{
+    if ( s_counting ) s_bytes += size;
+    void* p = ::malloc( size > 0 ? size : 1 );
+    if ( !p ) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    if ( s_counting ) s_bytes += size;
+    void* p = ::malloc( size > 0 ? size : 1 );
+    if ( !p ) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) throw()   { ::free(p); }
+void operator delete[](void* p) throw() { ::free(p); }
+
+#if __cplusplus >= 201402L
+void operator delete(void* p, std::size_t) throw()   { ::free(p); }
+void operator delete[](void* p, std::size_t) throw() { ::free(p); }
+#endif
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_memcachebench" << std::endl
+        << "    [--tiles n]       : number of distinct tiles (default = 16, at most 32)" << std::endl
+        << "    [--passes n]      : timed passes over the tiles (default = 2000)" << std::endl
+        << "    [--tile-size n]   : tile width and height in pixels (default = 256)" << std::endl;
+    return -1;
+}
+
+/**
+ * Generates a noise tile for every key; never caches.
+ */
+class SyntheticTileSource : public TileSource
+{
+public:
+    SyntheticTileSource(int tileSize) : TileSource(TileSourceOptions()), _tileSize(tileSize) { }
+
+    Status initialize(const osgDB::Options* dbOptions)
+    {
+        setProfile( Registry::instance()->getGlobalGeodeticProfile() );
+        return STATUS_OK;
+    }
+
+    CachePolicy getCachePolicyHint(const Profile* profile) const
+    {
+        return CachePolicy::NO_CACHE;
+    }
+
+    osg::Image* createImage(const TileKey& key, ProgressCallback* progress)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(_tileSize, _tileSize, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        unsigned char* p = image->data();
+        unsigned seed = key.getTileX() * 7919u + key.getTileY();
+        for(int i=0; i<_tileSize*_tileSize*4; ++i)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            *p++ = (unsigned char)(seed >> 24);
+        }
+        return image;
+    }
+
+    int _tileSize;
+};
+
+struct Result
+{
+    double   seconds;
+    size_t   bytes;
+    unsigned numHits;
+    bool     sameObject;
+};
+
+Result
+run(bool share, unsigned numTiles, unsigned passes, int tileSize)
+{
+    TileSourceOptions driver;
+    // room to spare, so uneven hashing across the LRU shards can't evict.
+    driver.L2CacheSize() = (int)(numTiles * 4u);
+    driver.L2CacheShareObjects() = share;
+
+    ImageLayerOptions options( "memcachebench", driver );
+    options.cachePolicy() = CachePolicy::NO_CACHE;
+
+    SyntheticTileSource* source = new SyntheticTileSource( tileSize );
+    source->open();
+
+    osg::ref_ptr<ImageLayer> layer = new ImageLayer( options, source );
+    layer->open();
+
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    std::vector<TileKey> keys;
+    for(unsigned i=0; i<numTiles; ++i)
+        keys.push_back( TileKey(2, i % 8u, (i / 8u) % 4u, profile) );
+
+    Result result;
+    result.numHits = 0u;
+
+    // warm up; every later read is a memory cache hit.
+    osg::ref_ptr<osg::Image> first;
+    for(unsigned i=0; i<keys.size(); ++i)
+    {
+        GeoImage image = layer->createImage( keys[i] );
+        if ( i == 0 ) first = image.getImage();
+    }
+
+    s_bytes = 0;
+    s_counting = true;
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    for(unsigned p=0; p<passes; ++p)
+    {
+        for(unsigned i=0; i<keys.size(); ++i)
+        {
+            GeoImage image = layer->createImage( keys[i] );
+            if ( image.valid() )
+                ++result.numHits;
+        }
+    }
+
+    result.seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+    s_counting = false;
+    result.bytes = s_bytes;
+
+    result.sameObject = layer->createImage( keys[0] ).getImage() == first.get();
+
+    return result;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( arguments.read("--help") )
+        return usage("");
+
+    unsigned numTiles = 16u;
+    arguments.read("--tiles", numTiles);
+    numTiles = osg::clampBetween(numTiles, 1u, 32u);
+
+    unsigned passes = 2000u;
+    arguments.read("--passes", passes);
+    passes = osg::maximum(passes, 1u);
+
+    int tileSize = 256;
+    arguments.read("--tile-size", tileSize);
+    tileSize = osg::maximum(tileSize, 1);
+
+    OE_NOTICE << LC << numTiles << " tiles of " << tileSize << "x" << tileSize
+        << " RGBA; " << passes << " passes" << std::endl;
+
+    for(unsigned share = 0; share < 2; ++share)
+    {
+        Result r = run( share == 1u, numTiles, passes, tileSize );
+        unsigned reads = numTiles * passes;
+
+        OE_NOTICE << LC
+            << (share ? "shared: " : "cloned: ")
+            << "hits=" << r.numHits << "/" << reads
+            << "; us/hit=" << (1.0e6 * r.seconds / (double)reads)
+            << "; bytes/hit=" << ((double)r.bytes / (double)reads)
+            << "; same object on hit=" << (r.sameObject ? "yes" : "no")
+            << std::endl;
+    }
+
+    return 0;
+}
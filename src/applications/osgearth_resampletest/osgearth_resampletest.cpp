@@ -0,0 +1,270 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Random>
+#include <osg/ArgumentParser>
+#include <osg/Image>
+#include <osg/Math>
+#include <string.h>
+#include <vector>
+
+#define LC "[resampletest] "
+
+using namespace osgEarth;
+
+/**
+ * Checks that each specialized BilinearResampler kernel (scalar, SSE2 and
+ * AVX2, whichever this CPU supports) produces the same output as the
+ * generic PixelReader/PixelWriter path: bit-for-bit for RGBA8 and RGB8,
+ * and within 1 ULP for R32F. Source widths are deliberately not multiples
+ * of the vector widths, and the sample points include every edge and
+ * corner texel. Returns nonzero on any mismatch.
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_resampletest" << std::endl
+        << "    [--runs n]        : random sample runs per image size (default = 20)" << std::endl;
+    return -1;
+}
+
+struct Format
+{
+    const char* name;
+    GLenum      pixelFormat;
+    GLenum      dataType;
+};
+
+osg::Image*
+createSource(const Format& format, int s, int t, Random& prng)
+{
+    osg::Image* image = new osg::Image();
+    image->allocateImage(s, t, 1, format.pixelFormat, format.dataType);
+
+    if ( format.dataType == GL_FLOAT )
+    {
+        float* p = (float*)image->data();
+        for(int i=0; i<s*t; ++i)
+            p[i] = (float)((prng.next() - 0.5) * 2000.0);
+    }
+    else
+    {
+        unsigned char* p = image->data();
+        for(unsigned i=0; i<image->getTotalSizeInBytes(); ++i)
+            p[i] = (unsigned char)prng.next(256);
+    }
+    return image;
+}
+
+osg::Image*
+createDest(const Format& format, int s, int t)
+{
+    osg::Image* image = new osg::Image();
+    image->allocateImage(s, t, 1, format.pixelFormat, format.dataType);
+    ::memset(image->data(), 0, image->getTotalSizeInBytes());
+    return image;
+}
+
+// Sample points covering the corners, the edges, exact texels, single-axis
+// taps and arbitrary bilinear taps, in an order that mixes them up.
+void
+createSamples(int maxS, int maxT, unsigned count, Random& prng, std::vector<float>& s, std::vector<float>& t)
+{
+    const float edgeS[] = { 0.0f, (float)maxS, 0.5f*(float)maxS, (float)maxS - 0.25f, 0.25f };
+    const float edgeT[] = { 0.0f, (float)maxT, 0.5f*(float)maxT, (float)maxT - 0.25f, 0.25f };
+
+    s.clear();
+    t.clear();
+    for(unsigned i=0; i<count; ++i)
+    {
+        float ss, tt;
+        switch( i % 4u )
+        {
+        case 0:
+            // edges and corners
+            ss = edgeS[prng.next(5)];
+            tt = edgeT[prng.next(5)];
+            break;
+        case 1:
+            // exact texel
+            ss = (float)prng.next(maxS+1);
+            tt = (float)prng.next(maxT+1);
+            break;
+        case 2:
+            // one axis on a texel
+            ss = (float)(prng.next() * maxS);
+            tt = (float)(prng.next() * maxT);
+            if ( prng.next(2) )
+                ss = (float)prng.next(maxS+1);
+            else
+                tt = (float)prng.next(maxT+1);
+            break;
+        default:
+            ss = (float)(prng.next() * maxS);
+            tt = (float)(prng.next() * maxT);
+        }
+        s.push_back( osg::clampBetween(ss, 0.0f, (float)maxS) );
+        t.push_back( osg::clampBetween(tt, 0.0f, (float)maxT) );
+    }
+}
+
+// Distance between two floats in units in the last place.
+unsigned
+ulps(float a, float b)
+{
+    int ia, ib;
+    ::memcpy(&ia, &a, sizeof(int));
+    ::memcpy(&ib, &b, sizeof(int));
+    if ( ia < 0 ) ia = (int)(0x80000000u - (unsigned)ia);
+    if ( ib < 0 ) ib = (int)(0x80000000u - (unsigned)ib);
+    return ia > ib ? (unsigned)(ia - ib) : (unsigned)(ib - ia);
+}
+
+// Number of texels in "test" that don't match "ref".
+unsigned
+compare(const osg::Image* ref, const osg::Image* test)
+{
+    unsigned numBad = 0u;
+    if ( ref->getDataType() == GL_FLOAT )
+    {
+        const float* a = (const float*)ref->data();
+        const float* b = (const float*)test->data();
+        for(int i=0; i<ref->s()*ref->t(); ++i)
+            if ( ulps(a[i], b[i]) > 1u )
+                ++numBad;
+    }
+    else
+    {
+        unsigned size = osg::Image::computeNumComponents(ref->getPixelFormat());
+        for(int t=0; t<ref->t(); ++t)
+            for(int s=0; s<ref->s(); ++s)
+                if ( ::memcmp(ref->data(s, t), test->data(s, t), size) != 0 )
+                    ++numBad;
+    }
+    return numBad;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( arguments.read("--help") )
+        return usage("");
+
+    unsigned runs = 20u;
+    arguments.read("--runs", runs);
+
+    const Format formats[] = {
+        { "RGBA8", GL_RGBA,      GL_UNSIGNED_BYTE },
+        { "RGB8",  GL_RGB,       GL_UNSIGNED_BYTE },
+        { "R32F",  GL_LUMINANCE, GL_FLOAT }
+    };
+
+    // source sizes; none of the widths are a multiple of 4 or 8.
+    const int sizes[][2] = { {1,1}, {2,3}, {3,2}, {5,7}, {13,11}, {31,17}, {67,3}, {257,5} };
+
+    const ImageUtils::BilinearResampler::Kernel kernels[] = {
+        ImageUtils::BilinearResampler::KERNEL_SCALAR,
+        ImageUtils::BilinearResampler::KERNEL_SSE2,
+        ImageUtils::BilinearResampler::KERNEL_AVX2
+    };
+
+    Random prng( 0u );
+    unsigned numFailed = 0u;
+
+    for(unsigned f=0; f<3; ++f)
+    {
+        const Format& format = formats[f];
+        std::vector<std::string> tested;
+
+        for(unsigned z=0; z<sizeof(sizes)/sizeof(sizes[0]); ++z)
+        {
+            osg::ref_ptr<osg::Image> src = createSource( format, sizes[z][0], sizes[z][1], prng );
+
+            for(unsigned run=0; run<runs; ++run)
+            {
+                // run lengths around the vector widths, plus longer ones.
+                unsigned count = run < 18u ? run + 1u : 33u + prng.next(200);
+
+                std::vector<float> s, t;
+                createSamples( src->s()-1, src->t()-1, count, prng, s, t );
+
+                // write each run once along a row and once down a column.
+                osg::ref_ptr<osg::Image> refRow = createDest( format, count, 1 );
+                osg::ref_ptr<osg::Image> refCol = createDest( format, 1, count );
+                {
+                    ImageUtils::BilinearResampler ref( src.get(), refRow.get(), ImageUtils::BilinearResampler::KERNEL_GENERIC );
+                    ref( &s[0], &t[0], count, 0, 0, 1, 0 );
+                }
+                {
+                    ImageUtils::BilinearResampler ref( src.get(), refCol.get(), ImageUtils::BilinearResampler::KERNEL_GENERIC );
+                    ref( &s[0], &t[0], count, 0, 0, 0, 1 );
+                }
+
+                std::string prevName;
+                for(unsigned k=0; k<3; ++k)
+                {
+                    osg::ref_ptr<osg::Image> row = createDest( format, count, 1 );
+                    osg::ref_ptr<osg::Image> col = createDest( format, 1, count );
+
+                    ImageUtils::BilinearResampler rowSampler( src.get(), row.get(), kernels[k] );
+                    rowSampler( &s[0], &t[0], count, 0, 0, 1, 0 );
+
+                    ImageUtils::BilinearResampler colSampler( src.get(), col.get(), kernels[k] );
+                    colSampler( &s[0], &t[0], count, 0, 0, 0, 1 );
+
+                    // a kernel this CPU doesn't have falls back to the one tested before it.
+                    std::string name = rowSampler.getKernelName();
+                    if ( name == prevName )
+                        continue;
+                    prevName = name;
+
+                    if ( z == 0u && run == 0u )
+                        tested.push_back( name );
+
+                    unsigned numBad = compare( refRow.get(), row.get() ) + compare( refCol.get(), col.get() );
+                    if ( numBad > 0u )
+                    {
+                        ++numFailed;
+                        OE_NOTICE << LC << "FAILED: " << format.name << " kernel " << name
+                            << " source " << src->s() << "x" << src->t()
+                            << " run of " << count << ": " << numBad << " texel(s) differ" << std::endl;
+                    }
+                }
+            }
+        }
+
+        std::string names;
+        for(unsigned i=0; i<tested.size(); ++i)
+            names += " " + tested[i];
+        OE_NOTICE << LC << format.name << ": tested kernels" << names << std::endl;
+    }
+
+    OE_NOTICE << LC << (numFailed == 0u ? "All kernels match the generic path" : "Some kernels DO NOT match") << std::endl;
+    return numFailed == 0u ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <osg/ArgumentParser>
+#include <osg/Math>
+#include <osg/Timer>
+#include <iomanip>
+
+#define LC "[taskbench] "
+
+using namespace osgEarth;
+
+/**
+ * Measures TaskService throughput as the number of worker threads grows.
+ * Each run queues a batch of small CPU-bound ParallelTasks and waits on a
+ * MultiEvent for all of them, the same pattern the terrain engine uses.
+ * With --lanes 1 (the TaskService default) the queue behaves like a single
+ * locked priority map, for comparison against the bench's default of one
+ * lane per processor.
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_taskbench" << std::endl
+        << "    [--max-threads n] : largest thread count to test (default = 2 x processors)" << std::endl
+        << "    [--tasks n]       : number of tasks per run (default = 200000)" << std::endl
+        << "    [--work n]        : loop iterations per task (default = 1000)" << std::endl
+        << "    [--lanes n]       : number of queue lanes (default = 0, one per processor)" << std::endl
+        << "    [--max-size n]    : bound the queue to n requests (default = 0, unbounded)" << std::endl;
+    return -1;
+}
+
+struct SpinWork
+{
+    unsigned _work;
+    volatile unsigned _result;
+
+    void execute()
+    {
+        unsigned x = 0u;
+        for(unsigned i=0; i<_work; ++i)
+            x = x * 1664525u + 1013904223u;
+        _result = x;
+    }
+};
+
+typedef ParallelTask<SpinWork> SpinTask;
+
+double
+run(unsigned numThreads, unsigned numTasks, unsigned work, unsigned lanes, unsigned maxSize)
+{
+    osg::ref_ptr<TaskService> service = new TaskService("taskbench", numThreads, maxSize, lanes);
+
+    Threading::MultiEvent done( numTasks );
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    for(unsigned i=0; i<numTasks; ++i)
+    {
+        SpinTask* task = new SpinTask( &done );
+        task->_work = work;
+        task->setPriority( (float)(i % 16u) );
+        service->add( task );
+    }
+
+    done.wait();
+
+    return osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( arguments.read("--help") )
+        return usage("");
+
+    unsigned maxThreads = 2u * (unsigned)OpenThreads::GetNumberOfProcessors();
+    arguments.read("--max-threads", maxThreads);
+    maxThreads = osg::maximum(maxThreads, 1u);
+
+    unsigned numTasks = 200000u;
+    arguments.read("--tasks", numTasks);
+    numTasks = osg::maximum(numTasks, 1u);
+
+    unsigned work = 1000u;
+    arguments.read("--work", work);
+
+    unsigned lanes = 0u;
+    arguments.read("--lanes", lanes);
+
+    unsigned maxSize = 0u;
+    arguments.read("--max-size", maxSize);
+
+    OE_NOTICE << LC << numTasks << " tasks of " << work << " iterations; lanes = "
+        << (lanes > 0u ? lanes : (unsigned)OpenThreads::GetNumberOfProcessors())
+        << "; max size = " << maxSize << std::endl;
+
+    double baseline = 0.0;
+
+    for(unsigned numThreads = 1u; numThreads <= maxThreads; numThreads *= 2u)
+    {
+        double seconds = run( numThreads, numTasks, work, lanes, maxSize );
+        double perSecond = seconds > 0.0 ? (double)numTasks / seconds : 0.0;
+        if ( numThreads == 1u )
+            baseline = perSecond;
+
+        OE_NOTICE << LC
+            << "threads=" << std::setw(3) << numThreads
+            << "; time=" << seconds << "s"
+            << "; tasks/s=" << perSecond
+            << "; speedup=" << (baseline > 0.0 ? perSecond / baseline : 0.0)
+            << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,343 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/Notify>
+#include <osgEarth/Tessellator>
+#include <osgEarth/Random>
+#include <osgUtil/Tessellator>
+#include <osg/ArgumentParser>
+#include <osg/Geometry>
+#include <osg/Timer>
+#include <vector>
+
+#define LC "[tessbench] "
+
+using namespace osgEarth;
+
+/**
+ * Tessellates a corpus of generated coastline-like polygons, with and
+ * without holes, checks that the osgEarth tessellator's output is valid,
+ * and reports triangles per second for it and for the osgUtil (GLU)
+ * tessellator. A hole is either bridged into the outer ring or passed as a
+ * second loop, the way ExtrudeGeometryFilter builds roofs.
+ */
+
+int
+usage(const std::string& msg)
+{
+    OE_NOTICE
+        << msg << std::endl
+        << "USAGE: osgearth_tessbench" << std::endl
+        << "    [--max-level n]   : largest ring has 8*2^n vertices (default = 14)" << std::endl
+        << "    [--no-glu]        : skip the osgUtil tessellator" << std::endl;
+    return -1;
+}
+
+// Generates a closed, counter-clockwise, fractal ring by midpoint displacement of an octagon.
+void
+makeRing(Random& prng, unsigned levels, double cx, double cy, double radius, std::vector<osg::Vec3d>& out)
+{
+    out.clear();
+    for(unsigned i=0; i<8; ++i)
+    {
+        double a = osg::PI * 2.0 * (double)i / 8.0;
+        out.push_back( osg::Vec3d(cx + radius*cos(a), cy + radius*sin(a), 0.0) );
+    }
+
+    double amp = 0.3;
+    for(unsigned level=0; level<levels; ++level)
+    {
+        std::vector<osg::Vec3d> next;
+        next.reserve( out.size()*2 );
+        for(unsigned i=0; i<out.size(); ++i)
+        {
+            const osg::Vec3d& a = out[i];
+            const osg::Vec3d& b = out[(i+1) % out.size()];
+            osg::Vec3d d = b - a;
+            double offset = (prng.next() - 0.5) * amp;
+            next.push_back( a );
+            next.push_back( (a+b)*0.5 + osg::Vec3d(-d.y(), d.x(), 0.0)*offset );
+        }
+        out.swap( next );
+        amp *= 0.9;
+    }
+}
+
+enum HoleMode
+{
+    HOLE_NONE,
+    HOLE_BRIDGED,   // reversed and bridged into the outer ring, like BuildGeometryFilter
+    HOLE_LOOP       // a separate loop after the outer one, like ExtrudeGeometryFilter's roofs
+};
+
+const char* holeModeName(HoleMode mode)
+{
+    return mode == HOLE_NONE ? "none" : mode == HOLE_BRIDGED ? "bridged" : "loop";
+}
+
+osg::Geometry*
+makeGeometry(const std::vector<osg::Vec3d>& outer, const std::vector<osg::Vec3d>& hole, HoleMode mode)
+{
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    verts->reserve( outer.size() + (mode != HOLE_NONE ? hole.size()+2 : 0) );
+
+    for(unsigned i=0; i<outer.size(); ++i)
+    {
+        verts->push_back( outer[i] );
+
+        if ( mode == HOLE_BRIDGED && i == 0 )
+        {
+            // bridge from the outer ring's first vertex to the hole's first
+            // vertex, walk the hole clockwise and come back.
+            for(unsigned h=0; h<hole.size(); ++h)
+                verts->push_back( hole[(hole.size()-h) % hole.size()] );
+            verts->push_back( hole[0] );
+            verts->push_back( outer[0] );
+        }
+    }
+
+    osg::Geometry* geom = new osg::Geometry();
+    geom->setVertexArray( verts );
+
+    if ( mode == HOLE_LOOP )
+    {
+        // the hole keeps its counter-clockwise winding; the tessellator
+        // shouldn't care which way it goes.
+        for(unsigned h=0; h<hole.size(); ++h)
+            verts->push_back( hole[h] );
+
+        geom->addPrimitiveSet( new osg::DrawArrays(GL_LINE_LOOP, 0, outer.size()) );
+        geom->addPrimitiveSet( new osg::DrawArrays(GL_LINE_LOOP, outer.size(), hole.size()) );
+    }
+    else
+    {
+        geom->addPrimitiveSet( new osg::DrawArrays(GL_POLYGON, 0, verts->size()) );
+    }
+    return geom;
+}
+
+double
+ringArea(const osg::Vec3Array& v, unsigned first, unsigned last)
+{
+    double area = 0.0;
+    for(unsigned i=first, j=last-1; i<last; j=i++)
+        area += (double)v[j].x()*(double)v[i].y() - (double)v[i].x()*(double)v[j].y();
+    return 0.5*area;
+}
+
+// Area the triangles must cover: the outer ring's, less the hole's when it's a separate loop.
+double
+polygonArea(osg::Geometry* geom)
+{
+    const osg::Vec3Array& v = *static_cast<osg::Vec3Array*>(geom->getVertexArray());
+    osg::DrawArrays* outer = static_cast<osg::DrawArrays*>(geom->getPrimitiveSet(0));
+    double area = ringArea( v, outer->getFirst(), outer->getFirst()+outer->getCount() );
+
+    for(unsigned p=1; p<geom->getNumPrimitiveSets(); ++p)
+    {
+        osg::DrawArrays* hole = static_cast<osg::DrawArrays*>(geom->getPrimitiveSet(p));
+        double holeArea = osg::absolute( ringArea(v, hole->getFirst(), hole->getFirst()+hole->getCount()) );
+        area += area < 0.0 ? holeArea : -holeArea;
+    }
+    return area;
+}
+
+// Checks that the triangles are in range, wound like the ring, and cover its area.
+bool
+validate(osg::Geometry* geom, double area, unsigned& out_numTris)
+{
+    const osg::Vec3Array& v = *static_cast<osg::Vec3Array*>(geom->getVertexArray());
+    out_numTris = 0u;
+    double sum = 0.0;
+
+    for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+    {
+        osg::DrawElementsUInt* de = dynamic_cast<osg::DrawElementsUInt*>(geom->getPrimitiveSet(p));
+        if ( !de || de->getMode() != GL_TRIANGLES )
+            return false;
+
+        for(unsigned i=0; i+2<de->size(); i += 3)
+        {
+            unsigned a = (*de)[i], b = (*de)[i+1], c = (*de)[i+2];
+            if ( a >= v.size() || b >= v.size() || c >= v.size() )
+                return false;
+
+            double t = 0.5 * (
+                ((double)v[b].x()-(double)v[a].x()) * ((double)v[c].y()-(double)v[a].y()) -
+                ((double)v[c].x()-(double)v[a].x()) * ((double)v[b].y()-(double)v[a].y()) );
+
+            if ( t != 0.0 && (t < 0.0) != (area < 0.0) )
+                return false;
+
+            sum += t;
+            ++out_numTris;
+        }
+    }
+
+    return osg::absolute(sum - area) <= 1e-4 * osg::absolute(area);
+}
+
+// Whether any triangle contains the point.
+bool
+covers(osg::Geometry* geom, double x, double y)
+{
+    const osg::Vec3Array& v = *static_cast<osg::Vec3Array*>(geom->getVertexArray());
+
+    for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+    {
+        osg::DrawElementsUInt* de = dynamic_cast<osg::DrawElementsUInt*>(geom->getPrimitiveSet(p));
+        if ( !de )
+            continue;
+
+        for(unsigned i=0; i+2<de->size(); i += 3)
+        {
+            const osg::Vec3& a = v[(*de)[i]];
+            const osg::Vec3& b = v[(*de)[i+1]];
+            const osg::Vec3& c = v[(*de)[i+2]];
+            double d1 = (b.x()-a.x())*(y-a.y()) - (b.y()-a.y())*(x-a.x());
+            double d2 = (c.x()-b.x())*(y-b.y()) - (c.y()-b.y())*(x-b.x());
+            double d3 = (a.x()-c.x())*(y-c.y()) - (a.y()-c.y())*(x-c.x());
+            if ( (d1 > 0.0 && d2 > 0.0 && d3 > 0.0) || (d1 < 0.0 && d2 < 0.0 && d3 < 0.0) )
+                return true;
+        }
+    }
+    return false;
+}
+
+// A square roof with a square hole, given as two loops: the hole must stay
+// open. A "hole" outside the outer ring must fail so the caller can fall back.
+bool
+testSquareWithHole()
+{
+    std::vector<osg::Vec3d> outer, hole, outside;
+    outer.push_back( osg::Vec3d( 0, 0, 0) );
+    outer.push_back( osg::Vec3d(10, 0, 0) );
+    outer.push_back( osg::Vec3d(10,10, 0) );
+    outer.push_back( osg::Vec3d( 0,10, 0) );
+    hole.push_back( osg::Vec3d(3, 3, 0) );
+    hole.push_back( osg::Vec3d(3, 7, 0) );
+    hole.push_back( osg::Vec3d(7, 7, 0) );
+    hole.push_back( osg::Vec3d(7, 3, 0) );
+    outside.push_back( osg::Vec3d(20, 3, 0) );
+    outside.push_back( osg::Vec3d(20, 7, 0) );
+    outside.push_back( osg::Vec3d(24, 7, 0) );
+    outside.push_back( osg::Vec3d(24, 3, 0) );
+
+    osg::ref_ptr<osg::Geometry> geom = makeGeometry( outer, hole, HOLE_LOOP );
+    double area = polygonArea( geom.get() );
+
+    Tessellator tess;
+    unsigned numTris = 0u;
+    bool ok =
+        tess.tessellateGeometry( *geom.get() ) &&
+        validate( geom.get(), area, numTris ) &&
+        !covers( geom.get(), 5.0, 5.0 );
+
+    osg::ref_ptr<osg::Geometry> bad = makeGeometry( outer, outside, HOLE_LOOP );
+    bool failed =
+        !tess.tessellateGeometry( *bad.get() ) &&
+        bad->getNumPrimitiveSets() == 2u;
+
+    OE_NOTICE << LC
+        << "square with hole: valid=" << (ok ? "yes" : "NO")
+        << "; hole outside rejected=" << (failed ? "yes" : "NO")
+        << std::endl;
+
+    return ok && failed;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if ( arguments.read("--help") )
+        return usage("");
+
+    unsigned maxLevel = 14u;
+    arguments.read("--max-level", maxLevel);
+
+    bool glu = !arguments.read("--no-glu");
+
+    Random prng( 0u );
+    unsigned numFailed = 0u;
+
+    if ( !testSquareWithHole() )
+        ++numFailed;
+
+    for(unsigned level = 4u; level <= maxLevel; ++level)
+    {
+        std::vector<osg::Vec3d> outer, hole;
+        makeRing( prng, level, 0.0, 0.0, 1.0, outer );
+        makeRing( prng, level > 2u ? level-2u : 0u, 0.0, 0.0, 0.25, hole );
+
+        for(unsigned m = HOLE_NONE; m <= HOLE_LOOP; ++m)
+        {
+            HoleMode mode = (HoleMode)m;
+            osg::ref_ptr<osg::Geometry> geom = makeGeometry( outer, hole, mode );
+            unsigned numVerts = geom->getVertexArray()->getNumElements();
+            double area = polygonArea( geom.get() );
+
+            osg::ref_ptr<osg::Geometry> gluGeom = new osg::Geometry( *geom.get(), osg::CopyOp::DEEP_COPY_ALL );
+
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            Tessellator tess;
+            bool ok = tess.tessellateGeometry( *geom.get() );
+            double seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+            unsigned numTris = 0u;
+            ok = ok && validate( geom.get(), area, numTris );
+            if ( mode != HOLE_NONE )
+                ok = ok && !covers( geom.get(), 0.0, 0.0 );
+            if ( !ok )
+                ++numFailed;
+
+            OE_NOTICE << LC
+                << "verts=" << numVerts
+                << "; hole=" << holeModeName(mode)
+                << "; valid=" << (ok ? "yes" : "NO")
+                << "; time=" << seconds << "s"
+                << "; tris/s=" << (seconds > 0.0 ? (double)numTris/seconds : 0.0)
+                << std::endl;
+
+            if ( glu )
+            {
+                start = osg::Timer::instance()->tick();
+                osgUtil::Tessellator gluTess;
+                gluTess.setTessellationType( osgUtil::Tessellator::TESS_TYPE_GEOMETRY );
+                gluTess.setWindingType( mode == HOLE_LOOP ? osgUtil::Tessellator::TESS_WINDING_ODD : osgUtil::Tessellator::TESS_WINDING_POSITIVE );
+                gluTess.retessellatePolygons( *gluGeom.get() );
+                seconds = osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+                OE_NOTICE << LC
+                    << "verts=" << numVerts
+                    << "; hole=" << holeModeName(mode)
+                    << "; glu time=" << seconds << "s"
+                    << "; tris/s=" << (seconds > 0.0 ? (double)(numVerts-2)/seconds : 0.0)
+                    << std::endl;
+            }
+        }
+    }
+
+    OE_NOTICE << LC << (numFailed == 0u ? "All tessellations valid" : "Some tessellations were INVALID") << std::endl;
+    return numFailed == 0u ? 0 : 1;
+}
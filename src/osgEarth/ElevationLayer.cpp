@@ -382,143 +382,178 @@ ElevationLayer::createHeightField(const TileKey&    key,
     }
 
     GeoHeightField result;
-    osg::ref_ptr<osg::HeightField> hf;
-
-    // Check the memory cache first
-    bool fromMemCache = false;
 
     // cache key combines the key with the full signature (incl vdatum)
     std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
-    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
 
+    // Check the memory cache first. Anything in there is already post-processed.
     if ( _memCache.valid() )
     {
         CacheBin* bin = _memCache->getOrCreateDefaultBin();
         ReadResult cacheResult = bin->readObject(cacheKey, 0L);
         if ( cacheResult.succeeded() )
         {
-            result = GeoHeightField(
+            return GeoHeightField(
                 static_cast<osg::HeightField*>(cacheResult.releaseObject()),
                 key.getExtent());
-
-            fromMemCache = true;
         }
     }
 
-    if ( !result.valid() )
-    {
-        // See if there's a persistent cache.
-        CacheBin* cacheBin = getCacheBin( key.getProfile() );
+    // Coalesce concurrent requests for the same tile, so that only one thread
+    // reads the cache/source and fills the caches; the others share its result.
+    // Unless the L2 cache shares objects, every caller gets a heightfield of its own.
+    bool shareObjects = _memCache.valid() && _memCache->getShareObjects();
 
-        // validate that we have either a valid tile source, or we're cache-only.
-        if ( ! (getTileSource() || (policy.isCacheOnly() && cacheBin) ) )
+    osg::ref_ptr<HeightFieldFlights::Call> call;
+    if ( !_heightFieldFlights.begin(cacheKey, call, result, progress) )
+    {
+        if ( result.valid() && !shareObjects )
         {
-            disable("Error: layer does not have a valid TileSource, cannot create heightfield");
-            return GeoHeightField::INVALID;
+            return GeoHeightField(
+                osg::clone(result.getHeightField(), osg::CopyOp::DEEP_COPY_ALL),
+                result.getExtent());
         }
+        return result;
+    }
 
-        // validate the existance of a valid layer profile.
-        if ( !policy.isCacheOnly() && !getProfile() )
-        {
-            disable("Could not establish a valid profile");
-            return GeoHeightField::INVALID;
-        }
+    result = createHeightFieldFromCacheOrTileSource( key, cacheKey, progress );
 
-        // Now attempt to read from the cache. Since the cached data is stored in the
-        // map profile, we can try this first.
-        bool fromCache = false;
+    // A canceled or retryable failure is specific to this caller.
+    bool shareable =
+        result.valid() ||
+        progress == 0L ||
+        (!progress->isCanceled() && !progress->needsRetry());
 
-        osg::ref_ptr< osg::HeightField > cachedHF;
+    // The caller may modify its result, so waiters clone a private copy instead.
+    GeoHeightField published = result;
+    if ( result.valid() && !shareObjects && _heightFieldFlights.close(call.get()) > 0u )
+    {
+        published = GeoHeightField(
+            osg::clone(result.getHeightField(), osg::CopyOp::DEEP_COPY_ALL),
+            result.getExtent());
+    }
 
-        if ( cacheBin && policy.isCacheReadable() )
-        {
-            ReadResult r = cacheBin->readObject(cacheKey, 0L);
-            if ( r.succeeded() )
-            {            
-                bool expired = policy.isExpired(r.lastModifiedTime());
-                cachedHF = r.get<osg::HeightField>();
-                if ( cachedHF && validateHeightField(cachedHF) )
-                {
-                    if (!expired)
-                    {
-                        hf = cachedHF;
-                        fromCache = true;
-                    }
-                }
-            }
-        }
+    _heightFieldFlights.end( call.get(), published, shareable );
 
-        // if we're cache-only, but didn't get data from the cache, fail silently.
-        if ( !hf.valid() && policy.isCacheOnly() )
-        {
-            return GeoHeightField::INVALID;
-        }
+    return result;
+}
 
-        if ( !hf.valid() )
-        {
-            // bad tilesource? fail
-            if ( !getTileSource() || !getTileSource()->isOK() )
-                return GeoHeightField::INVALID;
 
-            if ( !isKeyInRange(key) )
-                return GeoHeightField::INVALID;
+GeoHeightField
+ElevationLayer::createHeightFieldFromCacheOrTileSource(const TileKey&     key,
+                                                       const std::string& cacheKey,
+                                                       ProgressCallback*  progress)
+{
+    GeoHeightField result;
+    osg::ref_ptr<osg::HeightField> hf;
 
-            // build a HF from the TileSource.
-            hf = createHeightFieldFromTileSource( key, progress );
+    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
 
-            // validate it to make sure it's legal.
-            if ( hf.valid() && !validateHeightField(hf.get()) )
-            {
-                OE_WARN << LC << "Driver " << getTileSource()->getName() << " returned an illegal heightfield" << std::endl;
-                hf = 0L; // to fall back on cached data if possible.
-            }
+    // See if there's a persistent cache.
+    CacheBin* cacheBin = getCacheBin( key.getProfile() );
 
-            // cache if necessary
-            if ( hf            && 
-                 cacheBin      && 
-                 !fromCache    &&
-                 policy.isCacheWriteable() )
-            {
-                cacheBin->write(cacheKey, hf, 0L);
-            }
+    // validate that we have either a valid tile source, or we're cache-only.
+    if ( ! (getTileSource() || (policy.isCacheOnly() && cacheBin) ) )
+    {
+        disable("Error: layer does not have a valid TileSource, cannot create heightfield");
+        return GeoHeightField::INVALID;
+    }
 
-            // We have an expired heightfield from the cache and no new data from the TileSource.  So just return the cached data.
-            if (!hf.valid() && cachedHF.valid())
-            {
-                OE_DEBUG << LC << "Using cached but expired heightfield for " << key.str() << std::endl;
-                hf = cachedHF;
-            }
+    // validate the existance of a valid layer profile.
+    if ( !policy.isCacheOnly() && !getProfile() )
+    {
+        disable("Could not establish a valid profile");
+        return GeoHeightField::INVALID;
+    }
+
+    // Now attempt to read from the cache. Since the cached data is stored in the
+    // map profile, we can try this first.
+    bool fromCache = false;
 
-            if ( !hf.valid() )
+    osg::ref_ptr< osg::HeightField > cachedHF;
+
+    if ( cacheBin && policy.isCacheReadable() )
+    {
+        ReadResult r = cacheBin->readObject(cacheKey, 0L);
+        if ( r.succeeded() )
+        {            
+            bool expired = policy.isExpired(r.lastModifiedTime());
+            cachedHF = r.get<osg::HeightField>();
+            if ( cachedHF && validateHeightField(cachedHF) )
             {
-                return GeoHeightField::INVALID;
+                if (!expired)
+                {
+                    hf = cachedHF;
+                    fromCache = true;
+                }
             }
+        }
+    }
+
+    // if we're cache-only, but didn't get data from the cache, fail silently.
+    if ( !hf.valid() && policy.isCacheOnly() )
+    {
+        return GeoHeightField::INVALID;
+    }
+
+    if ( !hf.valid() )
+    {
+        // bad tilesource? fail
+        if ( !getTileSource() || !getTileSource()->isOK() )
+            return GeoHeightField::INVALID;
+
+        if ( !isKeyInRange(key) )
+            return GeoHeightField::INVALID;
+
+        // build a HF from the TileSource.
+        hf = createHeightFieldFromTileSource( key, progress );
 
-            // Set up the heightfield params.
-            double minx, miny, maxx, maxy;
-            key.getExtent().getBounds(minx, miny, maxx, maxy);
-            hf->setOrigin( osg::Vec3d( minx, miny, 0.0 ) );
-            double dx = (maxx - minx)/(double)(hf->getNumColumns()-1);
-            double dy = (maxy - miny)/(double)(hf->getNumRows()-1);
-            hf->setXInterval( dx );
-            hf->setYInterval( dy );
-            hf->setBorderWidth( 0 );
+        // validate it to make sure it's legal.
+        if ( hf.valid() && !validateHeightField(hf.get()) )
+        {
+            OE_WARN << LC << "Driver " << getTileSource()->getName() << " returned an illegal heightfield" << std::endl;
+            hf = 0L; // to fall back on cached data if possible.
+        }
+
+        // cache if necessary
+        if ( hf            && 
+             cacheBin      && 
+             !fromCache    &&
+             policy.isCacheWriteable() )
+        {
+            cacheBin->write(cacheKey, hf, 0L);
         }
 
-        if ( hf.valid() )
+        // We have an expired heightfield from the cache and no new data from the TileSource.  So just return the cached data.
+        if (!hf.valid() && cachedHF.valid())
         {
-            result = GeoHeightField( hf.get(), key.getExtent() );
+            OE_DEBUG << LC << "Using cached but expired heightfield for " << key.str() << std::endl;
+            hf = cachedHF;
         }
+
+        if ( !hf.valid() )
+        {
+            return GeoHeightField::INVALID;
+        }
+
+        // Set up the heightfield params.
+        double minx, miny, maxx, maxy;
+        key.getExtent().getBounds(minx, miny, maxx, maxy);
+        hf->setOrigin( osg::Vec3d( minx, miny, 0.0 ) );
+        double dx = (maxx - minx)/(double)(hf->getNumColumns()-1);
+        double dy = (maxy - miny)/(double)(hf->getNumRows()-1);
+        hf->setXInterval( dx );
+        hf->setYInterval( dy );
+        hf->setBorderWidth( 0 );
     }
 
-    // write to mem cache if needed:
-    if ( result.valid() && !fromMemCache && _memCache.valid() )
+    if ( hf.valid() )
     {
-        CacheBin* bin = _memCache->getOrCreateDefaultBin();
-        bin->write(cacheKey, result.getHeightField(), 0L);
+        result = GeoHeightField( hf.get(), key.getExtent() );
     }
 
-    // post-processing:
+    // post-processing (before the mem cache write, since the mem cache may be
+    // sharing its heightfields and they must not be modified after insertion):
     if ( result.valid() )
     {
         if ( _runtimeOptions.noDataPolicy() == NODATA_MSL )
@@ -545,6 +580,13 @@ ElevationLayer::createHeightField(const TileKey&    key,
         }
     }
 
+    // write to mem cache if needed:
+    if ( result.valid() && _memCache.valid() )
+    {
+        CacheBin* bin = _memCache->getOrCreateDefaultBin();
+        bin->write(cacheKey, result.getHeightField(), 0L);
+    }
+
     return result;
 }
 
@@ -573,6 +615,250 @@ namespace
     typedef osg::ref_ptr<ElevationLayer>          RefElevationLayer;
     typedef std::pair<RefElevationLayer, TileKey> LayerAndKey;
     typedef std::vector<LayerAndKey>              LayerAndKeyVector;
+
+    /**
+     * Samples one layer's heightfield at every point of an output grid.
+     * Equivalent to calling GeoHeightField::getElevation for each grid
+     * point, but the SRS transform, extent test and pixel mapping are
+     * done once per layer instead of once per sample. Results come out a
+     * grid row at a time.
+     */
+    class GridSampler
+    {
+    public:
+        GridSampler(const GeoHeightField&      layerHF,
+                    const SpatialReference*    gridSRS,
+                    const std::vector<double>& xs,
+                    const std::vector<double>& ys,
+                    ElevationInterpolation     interpolation) :
+            _layerHF      ( layerHF ),
+            _hf           ( layerHF.getHeightField() ),
+            _extent       ( layerHF.getExtent() ),
+            _gridSRS      ( gridSRS ),
+            _xs           ( xs ),
+            _ys           ( ys ),
+            _interpolation( interpolation ),
+            _mode         ( MODE_POINT )
+        {
+            const SpatialReference* extentSRS = _extent.getSRS();
+
+            // A vertical datum conversion needs a geographic location per sample,
+            // so leave that (uncommon) case to GeoHeightField.
+            if ( !extentSRS->isVertEquivalentTo(gridSRS) )
+                return;
+
+            double xInterval = _extent.width()  / (double)(_hf->getNumColumns()-1);
+            double yInterval = _extent.height() / (double)(_hf->getNumRows()-1);
+            double maxCol    = (double)(_hf->getNumColumns()-1);
+            double maxRow    = (double)(_hf->getNumRows()-1);
+
+            if ( gridSRS->isEquivalentTo(extentSRS) )
+            {
+                // Same SRS: the grid is axis-aligned in the layer, and the extent
+                // test is separable, so map each column and each row just once.
+                // Each axis is probed with a coordinate that is inside the extent
+                // on the other axis.
+                double yProbe = 0.5*(_extent.yMin() + _extent.yMax());
+                _colIn.resize( xs.size() );
+                _px.resize( xs.size() );
+                int inside = -1;
+                for(unsigned c=0; c<xs.size(); ++c)
+                {
+                    _colIn[c] = _extent.contains(xs[c], yProbe);
+                    _px[c] = osg::clampBetween( (xs[c] - _extent.xMin()) / xInterval, 0.0, maxCol );
+                    if ( _colIn[c] && inside < 0 )
+                        inside = c;
+                }
+
+                _rowIn.resize( ys.size() );
+                _py.resize( ys.size() );
+                for(unsigned r=0; r<ys.size(); ++r)
+                {
+                    _rowIn[r] = inside >= 0 && _extent.contains(xs[inside], ys[r]);
+                    _py[r] = osg::clampBetween( (ys[r] - _extent.yMin()) / yInterval, 0.0, maxRow );
+                }
+
+                // For bilinear sampling, also work out each column's and each
+                // row's source texels and weights up front.
+                if ( _interpolation == INTERP_BILINEAR )
+                {
+                    computeTaps( _px, _hf->getNumColumns(), _colTaps );
+                    computeTaps( _py, _hf->getNumRows(), _rowTaps );
+                }
+
+                _mode = MODE_GRID;
+            }
+            else
+            {
+                // Different SRS: project the whole grid in one call.
+                _local.reserve( xs.size() * ys.size() );
+                for(unsigned r=0; r<ys.size(); ++r)
+                    for(unsigned c=0; c<xs.size(); ++c)
+                        _local.push_back( osg::Vec3d(xs[c], ys[r], 0.0) );
+
+                if ( gridSRS->transform(_local, extentSRS) )
+                {
+                    _xInterval = xInterval;
+                    _yInterval = yInterval;
+                    _mode = MODE_BULK;
+                }
+                else
+                {
+                    // at least one point failed; fall back on per-sample transforms.
+                    _local.clear();
+                }
+            }
+        }
+
+        /**
+         * Elevations along grid row r, written to out[0..numColumns-1].
+         * Points outside the layer, or with no data, get NO_DATA_VALUE.
+         * Points whose "skip" flag is set (if skip is not NULL) are left alone.
+         */
+        void getRow(unsigned r, const unsigned char* skip, float* out) const
+        {
+            unsigned numColumns = _xs.size();
+
+            if ( _mode == MODE_GRID && !_colTaps.empty() )
+            {
+                if ( !_rowIn[r] )
+                {
+                    for(unsigned c=0; c<numColumns; ++c)
+                        if ( !skip || !skip[c] )
+                            out[c] = NO_DATA_VALUE;
+                    return;
+                }
+
+                // Same arithmetic as HeightFieldUtils::getHeightAtPixel, with
+                // the taps looked up instead of recomputed for every sample.
+                const Tap&   rt      = _rowTaps[r];
+                const float* heights = &_hf->getFloatArray()->front();
+                const float* lower   = heights + rt.min * _hf->getNumColumns();
+                const float* upper   = heights + rt.max * _hf->getNumColumns();
+                bool         rowExact = rt.min == rt.max;
+
+                for(unsigned c=0; c<numColumns; ++c)
+                {
+                    if ( skip && skip[c] )
+                        continue;
+
+                    if ( !_colIn[c] )
+                    {
+                        out[c] = NO_DATA_VALUE;
+                        continue;
+                    }
+
+                    const Tap& ct = _colTaps[c];
+                    float ur = upper[ct.max], ll = lower[ct.min], ul = upper[ct.min], lr = lower[ct.max];
+
+                    if ( !HeightFieldUtils::validateSamples(ur, ll, ul, lr) )
+                        out[c] = NO_DATA_VALUE;
+                    else if ( ct.min == ct.max && rowExact )
+                        out[c] = ll;
+                    else if ( ct.min == ct.max )
+                        out[c] = rt.w0 * ll + rt.w1 * ul;
+                    else if ( rowExact )
+                        out[c] = ct.w0 * ll + ct.w1 * lr;
+                    else
+                    {
+                        double r1 = ct.w0 * (double)ll + ct.w1 * (double)lr;
+                        double r2 = ct.w0 * (double)ul + ct.w1 * (double)ur;
+                        out[c] = rt.w0 * r1 + rt.w1 * r2;
+                    }
+                }
+                return;
+            }
+
+            for(unsigned c=0; c<numColumns; ++c)
+            {
+                if ( skip && skip[c] )
+                    continue;
+
+                float elevation;
+                out[c] = getElevation(c, r, elevation) ? elevation : NO_DATA_VALUE;
+            }
+        }
+
+    private:
+        // Source texels on either side of a pixel coordinate, and their weights.
+        struct Tap
+        {
+            int    min, max;
+            double w0, w1; // max-p, p-min
+        };
+
+        // Same texel selection as HeightFieldUtils::getHeightAtPixel.
+        static void computeTaps(const std::vector<double>& p, unsigned size, std::vector<Tap>& taps)
+        {
+            taps.resize( p.size() );
+            for(unsigned i=0; i<p.size(); ++i)
+            {
+                Tap& tap = taps[i];
+                tap.min = osg::maximum((int)floor(p[i]), 0);
+                tap.max = osg::maximum(osg::minimum((int)ceil(p[i]), (int)size-1), 0);
+                if ( tap.min > tap.max ) tap.min = tap.max;
+                tap.w0 = (double)tap.max - p[i];
+                tap.w1 = p[i] - (double)tap.min;
+            }
+        }
+
+        /** Elevation at grid point (c, r); false if the point is outside the layer. */
+        bool getElevation(unsigned c, unsigned r, float& out_elevation) const
+        {
+            if ( _mode == MODE_GRID )
+            {
+                if ( !_colIn[c] || !_rowIn[r] )
+                {
+                    out_elevation = 0.0f;
+                    return false;
+                }
+                out_elevation = HeightFieldUtils::getHeightAtPixel(_hf, _px[c], _py[r], _interpolation);
+                return true;
+            }
+
+            else if ( _mode == MODE_BULK )
+            {
+                const osg::Vec3d& local = _local[r*_xs.size() + c];
+                if ( !_extent.contains(local.x(), local.y()) )
+                {
+                    out_elevation = 0.0f;
+                    return false;
+                }
+                out_elevation = HeightFieldUtils::getHeightAtLocation(
+                    _hf, local.x(), local.y(),
+                    _extent.xMin(), _extent.yMin(),
+                    _xInterval, _yInterval,
+                    _interpolation);
+                return true;
+            }
+
+            else
+            {
+                return _layerHF.getElevation(_gridSRS, _xs[c], _ys[r], _interpolation, _gridSRS, out_elevation);
+            }
+        }
+
+        enum Mode { MODE_GRID, MODE_BULK, MODE_POINT };
+
+        const GeoHeightField&      _layerHF;
+        const osg::HeightField*    _hf;
+        const GeoExtent&           _extent;
+        const SpatialReference*    _gridSRS;
+        const std::vector<double>& _xs;
+        const std::vector<double>& _ys;
+        ElevationInterpolation     _interpolation;
+        Mode                       _mode;
+
+        // MODE_GRID: per-column and per-row pixel coordinates and extent tests,
+        // plus texels and weights when interpolating bilinearly
+        std::vector<double>        _px, _py;
+        std::vector<bool>          _colIn, _rowIn;
+        std::vector<Tap>           _colTaps, _rowTaps;
+
+        // MODE_BULK: grid points projected into the layer's SRS
+        std::vector<osg::Vec3d>    _local;
+        double                     _xInterval, _yInterval;
+    };
 }
 
 bool
@@ -680,137 +966,91 @@ ElevationLayerVector::populateHeightField(osg::HeightField*      hf,
     double   ymin       = key.getExtent().yMin();
     double   dx         = key.getExtent().width() / (double)(numColumns-1);
     double   dy         = key.getExtent().height() / (double)(numRows-1);
-    
-    // We will load the actual heightfields on demand. We might not need them all.
-    GeoHeightFieldVector heightFields(contenders.size());
-    GeoHeightFieldVector offsetFields(offsets.size());
-    std::vector<bool>    heightFallback(contenders.size(), false);
-    std::vector<bool>    heightFailed(contenders.size(), false);
-    std::vector<bool>    offsetFailed(offsets.size(), false);
 
-    // The maximum number of heightfields to keep in this local cache
-    unsigned int maxHeightFields = 50;
-    unsigned numHeightFieldsInCache = 0;
+    std::vector<double> xs(numColumns), ys(numRows);
+    for (unsigned c = 0; c < numColumns; ++c)
+        xs[c] = xmin + (dx * (double)c);
+    for (unsigned r = 0; r < numRows; ++r)
+        ys[r] = ymin + (dy * (double)r);
 
     const SpatialReference* keySRS = keyToUse.getProfile()->getSRS();
 
     bool realData = false;
 
-    unsigned int total = numColumns * numRows;
-    unsigned int completed = 0;
-    int nodataCount = 0;
+    // Composite one layer at a time, in priority order. A sample is resolved by
+    // the first contender that has a valid elevation for it; lower-priority
+    // layers only fill the samples that are still unresolved, and are not even
+    // loaded once every sample is resolved.
+    unsigned total = numColumns * numRows;
+    unsigned numResolved = 0;
+    std::vector<unsigned char> resolved(total, 0);
+    std::vector<float> row(numColumns);
 
-    for (unsigned c = 0; c < numColumns; ++c)
+    for(unsigned i=0; i<contenders.size() && numResolved < total; ++i)
     {
-        double x = xmin + (dx * (double)c);
-        for (unsigned r = 0; r < numRows; ++r)
-        {
-            double y = ymin + (dy * (double)r);
-
-            // Collect elevations from each layer as necessary.
-            bool resolved = false;
+        ElevationLayer* layer = contenders[i].first.get();
 
-            for(int i=0; i<contenders.size() && !resolved; ++i)
+        // Load the heightfield, falling back on parent keys to make sure that
+        // we have data at the location even if it's fallback.
+        GeoHeightField layerHF;
+        TileKey actualKey = contenders[i].second;
+        while (!layerHF.valid() && actualKey.valid())
+        {
+            layerHF = layer->createHeightField(actualKey, progress);
+            if (!layerHF.valid())
             {
-                if ( heightFailed[i] )
-                    continue;
-
-                ElevationLayer* layer = contenders[i].first.get();
-
-                GeoHeightField& layerHF = heightFields[i];
-                TileKey actualKey = contenders[i].second;
+                actualKey = actualKey.createParentKey();
+            }
+        }
 
-                if (!layerHF.valid())
-                {
-                    // We couldn't get the heightfield from the cache, so try to create it.
-                    // We also fallback on parent layers to make sure that we have data at the location even if it's fallback.
-                    while (!layerHF.valid() && actualKey.valid())
-                    {
-                        layerHF = layer->createHeightField(actualKey, progress);
-                        if (!layerHF.valid())
-                        {
-                            actualKey = actualKey.createParentKey();
-                        }
-                    }
+        if (!layerHF.valid())
+            continue;
 
-                    // Mark this layer as fallback if necessary.
-                    if (layerHF.valid())
-                    {
-                        heightFallback[i] = actualKey != contenders[i].second;
-                        numHeightFieldsInCache++;
-                    }
-                    else
-                    {
-                        heightFailed[i] = true;
-                        continue;
-                    }
-                }
-
-                if (layerHF.valid())
-                {
-                    bool isFallback = heightFallback[i];
+        // We only have real data if this is not a fallback heightfield.
+        if (actualKey == contenders[i].second)
+        {
+            realData = true;
+        }
 
-                    // We only have real data if this is not a fallback heightfield.
-                    if (!isFallback)
-                    {
-                        realData = true;
-                    }
-
-                    float elevation;
-                    if (layerHF.getElevation(keySRS, x, y, interpolation, keySRS, elevation))
-                    {
-                        if ( elevation != NO_DATA_VALUE )
-                        {
-                            resolved = true;                    
-                            hf->setHeight(c, r, elevation);
-                        }
-                        else
-                        {
-                            ++nodataCount;
-                        }
-                    }
-                }
+        GridSampler sampler(layerHF, keySRS, xs, ys, interpolation);
 
+        for (unsigned r = 0; r < numRows; ++r)
+        {
+            unsigned char* rowResolved = &resolved[r*numColumns];
+            sampler.getRow(r, rowResolved, &row[0]);
 
-                // Clear the heightfield cache if we have too many heightfields in the cache.
-                if (numHeightFieldsInCache >= maxHeightFields)
+            for (unsigned c = 0; c < numColumns; ++c)
+            {
+                if ( !rowResolved[c] && row[c] != NO_DATA_VALUE )
                 {
-                    //OE_NOTICE << "Clearing cache" << std::endl;
-                    for (unsigned int k = 0; k < heightFields.size(); k++)
-                    {
-                        heightFields[k] = GeoHeightField::INVALID;
-                        heightFallback[k] = false;
-                    }
-                    numHeightFieldsInCache = 0;
+                    hf->setHeight(c, r, row[c]);
+                    rowResolved[c] = 1;
+                    ++numResolved;
                 }
             }
+        }
+    }
 
-            for(int i=offsets.size()-1; i>=0; --i)
-            {
-                if ( offsetFailed[i] )
-                    continue;
+    for(int i=offsets.size()-1; i>=0; --i)
+    {
+        GeoHeightField layerHF = offsets[i].first->createHeightField(offsets[i].second, progress);
+        if ( !layerHF.valid() )
+            continue;
 
-                GeoHeightField& layerHF = offsetFields[i];
-                if ( !layerHF.valid() )
-                {
-                    ElevationLayer* offset = offsets[i].first.get();
+        // If we actually got a layer then we have real data
+        realData = true;
 
-                    layerHF = offset->createHeightField(offsets[i].second, progress);
-                    if ( !layerHF.valid() )
-                    {
-                        offsetFailed[i] = true;
-                        continue;
-                    }
-                }
+        GridSampler sampler(layerHF, keySRS, xs, ys, interpolation);
 
-                // If we actually got a layer then we have real data
-                realData = true;
+        for (unsigned r = 0; r < numRows; ++r)
+        {
+            sampler.getRow(r, 0L, &row[0]);
 
-                float elevation = 0.0f;
-                if (layerHF.getElevation(keySRS, x, y, interpolation, keySRS, elevation) &&
-                    elevation != NO_DATA_VALUE)
-                {                    
-                    hf->getHeight(c, r) += elevation;
+            for (unsigned c = 0; c < numColumns; ++c)
+            {
+                if (row[c] != NO_DATA_VALUE)
+                {
+                    hf->getHeight(c, r) += row[c];
                 }
             }
         }
@@ -25,20 +25,28 @@ using namespace osgEarth;
 #define LC "[ElevationPool] "
 
 ElevationPool::ElevationPool() :
-_entries(0u),
-_maxEntries( 128u )
+_mruHead   ( 0L ),
+_mruTail   ( 0L ),
+_entries   ( 0u ),
+_maxEntries( 128u ),
+_bytes     ( 0u ),
+_maxBytes  ( 0u )
 {
     //nop
 }
 
+ElevationPool::~ElevationPool()
+{
+    Threading::ScopedMutexLock lock(_tilesMutex);
+    clearCache();
+}
+
 void
 ElevationPool::setMap(const Map* map)
 {
     Threading::ScopedMutexLock lock(_tilesMutex);
     _frame.setMap( map );
-    _tiles.clear();
-    _mru.clear();
-    _entries = 0u;
+    clearCache();
 }
 
 bool
@@ -73,59 +81,104 @@ ElevationPool::fetchTileFromMap(const TileKey& key, Tile* tile)
 }
 
 void
-ElevationPool::popMRU()
+ElevationPool::unlink(Tile* tile)
 {
-    // first rememeber the key of the item we're about the pop:
-    TileKey key = _mru.back()->_key;
+    if ( tile->_prev ) tile->_prev->_next = tile->_next;
+    else               _mruHead = tile->_next;
 
-    // establish a temporary observer on the item:
-    osg::observer_ptr<Tile> temp = _mru.back().get();
+    if ( tile->_next ) tile->_next->_prev = tile->_prev;
+    else               _mruTail = tile->_prev;
 
-    // pop the Tile from the MRU:
-    _mru.pop_back();
+    tile->_prev = tile->_next = 0L;
+}
 
-    // if our observer went to NULL, we know there are no more pointers
-    // to that Tile in the MRU, and we can remove it from the main list:
-    if (!temp.valid())
+void
+ElevationPool::moveToFront(Tile* tile)
+{
+    if ( tile == _mruHead )
+        return;
+
+    if ( tile->_cached )
+        unlink( tile );
+
+    tile->_next = _mruHead;
+    tile->_prev = 0L;
+    if ( _mruHead ) _mruHead->_prev = tile;
+    _mruHead = tile;
+    if ( !_mruTail ) _mruTail = tile;
+    tile->_cached = true;
+}
+
+void
+ElevationPool::prune()
+{
+    // evict from the LRU end until we are within budget, but never evict the
+    // most recently used tile (the one the caller is about to use).
+    while (
+        _mruTail && _mruTail != _mruHead &&
+        (_entries > _maxEntries || (_maxBytes > 0u && _bytes > _maxBytes)) )
     {
-        _tiles.erase(key);
+        Tile* tile = _mruTail;
+        unlink( tile );
+        tile->_cached = false;
+        --_entries;
+        _bytes -= tile->_bytes;
+
+        // drops the pool's reference; the tile lives on if a query still uses it.
+        _tiles.erase( tile->_key );
     }
 }
 
-bool
-ElevationPool::tryTile(const TileKey& key, osg::ref_ptr<Tile>& out)
+void
+ElevationPool::clearCache()
 {
-    // first see whether the tile is available
-    _tilesMutex.lock();
+    for(Tiles::iterator i = _tiles.begin(); i != _tiles.end(); ++i)
+    {
+        Tile* tile = i->second.get();
+        tile->_prev = tile->_next = 0L;
+        tile->_cached = false;
+    }
+    _tiles.clear();
+    _mruHead = _mruTail = 0L;
+    _entries = 0u;
+    _bytes = 0u;
+}
 
-    // locate the tile in the local tile cache:
-    osg::observer_ptr<Tile>& tile_obs = _tiles[key];
+bool
+ElevationPool::getTile(const TileKey& key, osg::ref_ptr<ElevationPool::Tile>& output)
+{
+    // Synchronize the MapFrame to its Map; if there's an update,
+    // clear out the internal cache and MRU.
+    if ( _frame.needsSync() )
+    {
+        if (_frame.sync())
+        {
+            Threading::ScopedMutexLock lock(_tilesMutex);
+            clearCache();
+        }
+    }
 
     osg::ref_ptr<Tile> tile;
 
-    // Get a safe pointer to it. If this is NULL, we need to create and
-    // fetch a new tile from the Map.
-    if (!tile_obs.lock(tile))
+    _tilesMutex.lock();
+
+    // locate the tile in the local tile cache:
+    osg::ref_ptr<Tile>& cached = _tiles[key];
+    if ( !cached.valid() )
     {
         // a new tile; status -> EMPTY
-        tile = new Tile();
-        tile->_key = key;
+        cached = new Tile();
+        cached->_key = key;
+        ++_entries;
+    }
+    tile = cached.get();
 
-        // update the LRU:
-        _mru.push_front(tile.get());
+    // Mark this tile as recently used and prune the MRU if necessary:
+    moveToFront( tile.get() );
+    prune();
 
-        // prune the MRU if necessary:
-        if (++_entries > _maxEntries )
-        {
-            popMRU();
-            --_entries;
-        }
-
-        // add to the main cache (after putting it on the LRU).
-        tile_obs = tile;
-    }
-       
-    // This means the tile object exists but has yet to be populated:
+    // This means the tile object exists but has yet to be populated.
+    // Fetch it, then wake up any threads waiting on it.
     if ( tile->_status == STATUS_EMPTY )
     {
         OE_DEBUG << "  getTile(" << key.str() << ") -> fetch from map\n";
@@ -133,86 +186,45 @@ ElevationPool::tryTile(const TileKey& key, osg::ref_ptr<Tile>& out)
         _tilesMutex.unlock();
 
         bool ok = fetchTileFromMap(key, tile.get());
-        tile->_status.exchange( ok ? STATUS_AVAILABLE : STATUS_FAIL );
-        
-        out = ok ? tile.get() : 0L;
-        return ok;
-    }
-
-    // This means the tile object is populated and available for use:
-    else if ( tile->_status == STATUS_AVAILABLE )
-    {
-        OE_DEBUG << "  getTile(" << key.str() << ") -> available\n";
-        out = tile.get();
 
-        // Mark this tile as recently used:
-        _mru.push_front(tile.get());
+        _tilesMutex.lock();
+        tile->_status.exchange( ok ? STATUS_AVAILABLE : STATUS_FAIL );
 
-        // prune the MRU if necessary
-        if (++_entries > _maxEntries)
+        // charge the data to the budget, unless the tile was evicted meanwhile.
+        tile->_bytes = ok ? sizeof(Tile) + tile->_hf.getHeightField()->getFloatArray()->getTotalDataSize() : 0u;
+        if ( tile->_cached )
         {
-            popMRU();
-            --_entries;
+            _bytes += tile->_bytes;
+            prune();
         }
-
-        _tilesMutex.unlock();
-        return true;
-    }
-
-    // This means the attempt to populate the tile with data failed.
-    else if ( tile->_status == STATUS_FAIL )
-    {
-        OE_DEBUG << "  getTile(" << key.str() << ") -> fail\n";
-        _tilesMutex.unlock();
-        out = 0L;
-        return false;
+        tile->_loaded.broadcast();
     }
 
-    // This means tile data fetch is still in progress (in another thread)
-    // and the caller should check back later.
-    else //if ( tile->_status == STATUS_IN_PROGRESS )
+    // This means tile data fetch is in progress in another thread,
+    // so wait for it to finish.
+    else if ( tile->_status == STATUS_IN_PROGRESS )
     {
         OE_DEBUG << "  getTile(" << key.str() << ") -> in progress...waiting\n";
-        _tilesMutex.unlock();
-        return true;            // out:NULL => check back later please.
-    }
-}
 
-bool
-ElevationPool::getTile(const TileKey& key, osg::ref_ptr<ElevationPool::Tile>& output)
-{
-    // Synchronize the MapFrame to its Map; if there's an update,
-    // clear out the internal cache and MRU.
-    if ( _frame.needsSync() )
-    {
-        if (_frame.sync())
+        OE_START_TIMER(get);
+        const double timeout = 30.0;
+        while ( tile->_status == STATUS_IN_PROGRESS && OE_GET_TIMER(get) < timeout )
         {
-            _tilesMutex.lock();
-            _tiles.clear();
-            _mru.clear();
-            _entries = 0u;
-            _tilesMutex.unlock();
+            tile->_loaded.wait( &_tilesMutex, 1000 );
         }
-    }
-   
-    OE_START_TIMER(get);
 
-    const double timeout = 30.0;
-    osg::ref_ptr<Tile> tile;
-    while( tryTile(key, tile) && !tile.valid() && OE_GET_TIMER(get) < timeout)
-    {
-        // condition: another thread is working on fetching the tile from the map,
-        // so wait and try again later. Do this until we succeed or time out.
-        OpenThreads::Thread::YieldCurrentThread();
+        if ( tile->_status == STATUS_IN_PROGRESS )
+        {
+            // this means we timed out trying to fetch the map tile.
+            OE_WARN << LC << "Timout fetching tile " << key.str() << std::endl;
+        }
     }
 
-    if ( !tile.valid() && OE_GET_TIMER(get) >= timeout )
-    {
-        // this means we timed out trying to fetch the map tile.
-        OE_WARN << LC << "Timout fetching tile " << key.str() << std::endl;
-    }
+    bool ok = (tile->_status == STATUS_AVAILABLE);
+
+    _tilesMutex.unlock();
 
-    if ( tile.valid() )
+    if ( ok )
     {
         if ( tile->_hf.valid() )
         {
@@ -222,10 +234,11 @@ ElevationPool::getTile(const TileKey& key, osg::ref_ptr<ElevationPool::Tile>& ou
         else
         {
             OE_WARN << LC << "Got a tile with an invalid HF (" << key.str() << ")\n";
+            ok = false;
         }
     }
 
-    return tile.valid();
+    return ok;
 }
 
 ElevationEnvelope*
@@ -317,25 +330,152 @@ ElevationEnvelope::getElevationAndResolution(double x, double y)
     return std::make_pair(elevation, resolution);
 }
 
+unsigned
+ElevationEnvelope::sampleBatch(const double* x, const double* y, unsigned count, float* output)
+{
+    const SpatialReference* mapSRS = _mapProfile->getSRS();
+
+    // Points already in the map SRS are sampled straight from the arrays.
+    if ( _inputSRS->isHorizEquivalentTo(mapSRS) )
+        return sampleMapPoints(x, y, count, output);
+
+    // Transform all the points into the map SRS in one go. The SRS transforms
+    // point vectors, so this is the one place the arrays get copied.
+    std::vector<osg::Vec3d> points( count );
+    for(unsigned i=0; i<count; ++i)
+        points[i].set( x[i], y[i], 0.0 );
+
+    if ( !_inputSRS->transform(points, mapSRS) )
+    {
+        // at least one point failed to transform; fall back on the point-by-point
+        // path, which reports the failures individually.
+        unsigned numSampled = 0u;
+        for(unsigned i=0; i<count; ++i)
+        {
+            float resolution;
+            if ( sample(x[i], y[i], output[i], resolution) )
+                ++numSampled;
+        }
+        return numSampled;
+    }
+
+    std::vector<double> mapX( count ), mapY( count );
+    for(unsigned i=0; i<count; ++i)
+    {
+        mapX[i] = points[i].x();
+        mapY[i] = points[i].y();
+    }
+
+    return sampleMapPoints(&mapX[0], &mapY[0], count, output);
+}
+
+unsigned
+ElevationEnvelope::sampleMapPoints(const double* x, const double* y, unsigned count, float* output)
+{
+    // Bucket the points by the key of the tile they fall in, and track the
+    // bounds of each bucket.
+    typedef std::map<TileKey, std::vector<unsigned> > Buckets;
+    Buckets buckets;
+    for(unsigned i=0; i<count; ++i)
+    {
+        output[i] = NO_DATA_VALUE;
+        TileKey key = _mapProfile->createTileKey( x[i], y[i], _lod );
+        if ( key.valid() )
+            buckets[key].push_back( i );
+    }
+
+    std::vector<ElevationPool::Tile*> candidates;
+    std::vector<unsigned> misses;
+
+    for(Buckets::const_iterator b = buckets.begin(); b != buckets.end(); ++b)
+    {
+        const std::vector<unsigned>& indices = b->second;
+
+        Bounds bucketBounds;
+        for(unsigned j=0; j<indices.size(); ++j)
+            bucketBounds.expandBy( x[indices[j]], y[indices[j]] );
+
+        // Collect the tiles already in the query set that overlap the bucket,
+        // keeping the set's high-to-low resolution order.
+        candidates.clear();
+        for(ElevationPool::QuerySet::const_iterator tile_ref = _tiles.begin(); tile_ref != _tiles.end(); ++tile_ref)
+        {
+            ElevationPool::Tile* tile = tile_ref->get();
+            const Bounds& tb = tile->_bounds;
+            if (tb.xMin() <= bucketBounds.xMax() && tb.xMax() >= bucketBounds.xMin() &&
+                tb.yMin() <= bucketBounds.yMax() && tb.yMax() >= bucketBounds.yMin())
+            {
+                candidates.push_back( tile );
+            }
+        }
+
+        // Sample each point from the first candidate that contains it, exactly
+        // as sample() does; remember the points no candidate contains.
+        misses.clear();
+        for(unsigned j=0; j<indices.size(); ++j)
+        {
+            unsigned i = indices[j];
+            bool foundTile = false;
+
+            for(unsigned c=0; c<candidates.size(); ++c)
+            {
+                ElevationPool::Tile* tile = candidates[c];
+                if ( tile->_bounds.contains(x[i], y[i]) )
+                {
+                    foundTile = true;
+                    if ( tile->_hf.getElevation(0L, x[i], y[i], INTERP_BILINEAR, 0L, output[i]) )
+                        break;
+                }
+            }
+
+            if ( !foundTile )
+                misses.push_back( i );
+        }
+
+        // Fetch the bucket's tile once for all the points that need it.
+        if ( !misses.empty() )
+        {
+            osg::ref_ptr<ElevationPool::Tile> tile;
+            if ( _clamper->getTile(b->first, tile) )
+            {
+                _tiles.insert( tile.get() );
+
+                for(unsigned j=0; j<misses.size(); ++j)
+                {
+                    unsigned i = misses[j];
+                    tile->_hf.getElevation(0L, x[i], y[i], INTERP_BILINEAR, 0L, output[i]);
+                }
+            }
+        }
+    }
+
+    unsigned numSampled = 0u;
+    for(unsigned i=0; i<count; ++i)
+    {
+        if ( output[i] != NO_DATA_VALUE )
+            ++numSampled;
+    }
+
+    return numSampled;
+}
+
 unsigned
 ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
                                std::vector<float>& output)
 {
-    unsigned count = 0u;
+    output.resize(input.size());
+    if ( input.empty() )
+        return 0u;
 
-    output.reserve(input.size());
-    output.clear();
-
-    // for each input point:
-    for (std::vector<osg::Vec3d>::const_iterator v = input.begin(); v != input.end(); ++v)
+    std::vector<double> x( input.size() ), y( input.size() );
+    for(unsigned i=0; i<input.size(); ++i)
     {
-        float elevation, resolution;
-        sample(v->x(), v->y(), elevation, resolution);
-        output.push_back(elevation);
-        if (elevation != NO_DATA_VALUE)
-            ++count;
+        x[i] = input[i].x();
+        y[i] = input[i].y();
     }
 
+    unsigned count = sampleBatch(&x[0], &y[0], input.size(), &output[0]);
+
     if (count < input.size())
     {
         OE_WARN << LC << "Issue: Envelope had failed samples" << std::endl;
@@ -350,6 +490,15 @@ ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
     return count;
 }
 
+unsigned
+ElevationEnvelope::getElevations(const double* x,
+                                 const double* y,
+                                 unsigned      count,
+                                 float*        output)
+{
+    return count > 0u ? sampleBatch(x, y, count, output) : 0u;
+}
+
 bool
 ElevationEnvelope::getElevationExtrema(const std::vector<osg::Vec3d>& input,
                                      float& min, float& max)
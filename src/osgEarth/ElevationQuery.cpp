@@ -114,6 +114,12 @@ ElevationQuery::getElevation(const GeoPoint& point,
     return result;
 }
 
+bool
+ElevationQuery::canSampleBatch() const
+{
+    return _patchLayers.empty() && !_mapf.elevationLayers().empty();
+}
+
 bool
 ElevationQuery::getElevations(std::vector<osg::Vec3d>& points,
                               const SpatialReference*  pointsSRS,
@@ -121,6 +127,22 @@ ElevationQuery::getElevations(std::vector<osg::Vec3d>& points,
                               double                   desiredResolution )
 {
     sync();
+
+    if ( canSampleBatch() && pointsSRS && !points.empty() )
+    {
+        std::vector<float> elevations;
+        getEnvelope(pointsSRS, desiredResolution)->getElevations(points, elevations);
+
+        for(unsigned i=0; i<points.size(); ++i)
+        {
+            if ( elevations[i] != NO_DATA_VALUE )
+            {
+                points[i].z() = ignoreZ ? elevations[i] : elevations[i] + points[i].z();
+            }
+        }
+        return true;
+    }
+
     for( osg::Vec3dArray::iterator i = points.begin(); i != points.end(); ++i )
     {
         float elevation;
@@ -141,6 +163,20 @@ ElevationQuery::getElevations(const std::vector<osg::Vec3d>& points,
                               double                         desiredResolution )
 {
     sync();
+
+    if ( canSampleBatch() && pointsSRS && !points.empty() )
+    {
+        std::vector<float> elevations;
+        getEnvelope(pointsSRS, desiredResolution)->getElevations(points, elevations);
+
+        out_elevations.reserve( out_elevations.size() + elevations.size() );
+        for(unsigned i=0; i<elevations.size(); ++i)
+        {
+            out_elevations.push_back( elevations[i] != NO_DATA_VALUE ? elevations[i] : 0.0f );
+        }
+        return true;
+    }
+
     for( osg::Vec3dArray::const_iterator i = points.begin(); i != points.end(); ++i )
     {
         float elevation;
@@ -158,6 +194,35 @@ ElevationQuery::getElevations(const std::vector<osg::Vec3d>& points,
     return true;
 }
 
+ElevationEnvelope*
+ElevationQuery::getEnvelope(const SpatialReference* srs,
+                            double                  desiredResolution)
+{
+    // tile size (resolution of elevation tiles)
+    unsigned tileSize = 257; // yes?
+
+    // default LOD:
+    unsigned lod = 23u;
+
+    // attempt to map the requested resolution to an LOD:
+    if (desiredResolution > 0.0)
+    {
+        int level = _mapf.getProfile()->getLevelOfDetailForHorizResolution(desiredResolution, tileSize);
+        if ( level > 0 )
+            lod = level;
+    }
+
+    // do we need a new ElevationEnvelope?
+    if (!_envelope.valid() ||
+        !srs->isHorizEquivalentTo(_envelope->getSRS()) ||
+        lod != _envelope->getLOD())
+    {
+        _envelope = _mapf.getElevationPool()->createEnvelope(srs, lod);
+    }
+
+    return _envelope.get();
+}
+
 bool
 ElevationQuery::getElevationImpl(const GeoPoint& point,
                                  float&          out_elevation,
@@ -247,38 +312,18 @@ ElevationQuery::getElevationImpl(const GeoPoint& point,
         return true;
     }
 
-    // tile size (resolution of elevation tiles)
-    unsigned tileSize = 257; // yes?
-
-    // default LOD:
-    unsigned lod = 23u;
-
-    // attempt to map the requested resolution to an LOD:
-    if (desiredResolution > 0.0)
-    {
-        int level = _mapf.getProfile()->getLevelOfDetailForHorizResolution(desiredResolution, tileSize);
-        if ( level > 0 )
-            lod = level;
-    }
-
-    // do we need a new ElevationEnvelope?
-    if (!_envelope.valid() ||
-        !point.getSRS()->isHorizEquivalentTo(_envelope->getSRS()) ||
-        lod != _envelope->getLOD())
-    {
-        _envelope = _mapf.getElevationPool()->createEnvelope(point.getSRS(), lod);
-    }
+    ElevationEnvelope* envelope = getEnvelope(point.getSRS(), desiredResolution);
 
     // sample the elevation, and if requested, the resolution as well:
     if (out_actualResolution)
     {
-        std::pair<float, float> result = _envelope->getElevationAndResolution(point.x(), point.y());
+        std::pair<float, float> result = envelope->getElevationAndResolution(point.x(), point.y());
         out_elevation = result.first;
         *out_actualResolution = result.second;
     }
     else
     {
-        out_elevation = _envelope->getElevation(point.x(), point.y());
+        out_elevation = envelope->getElevation(point.x(), point.y());
     }
 
     return out_elevation != NO_DATA_VALUE;
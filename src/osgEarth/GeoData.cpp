@@ -1802,6 +1802,13 @@ namespace
         ImageUtils::PixelReader ia(image);
         double xfac = (image->s() - 1) / src_extent.width();
         double yfac = (image->t() - 1) / src_extent.height();
+
+        // When interpolating, collect each column's in-bounds sample points into
+        // runs and hand them to the resampler in one call.
+        ImageUtils::BilinearResampler resample(image, result);
+        std::vector<float> runX, runY;
+        unsigned int runStart = 0;
+
         for (unsigned int c = 0; c < width; ++c)
         {
             for (unsigned int r = 0; r < height; ++r)
@@ -1813,6 +1820,12 @@ namespace
                 {
                     //If the sample point is outside of the bound of the source extent, increment the pixel and keep looping through.
                     //OE_WARN << LC << "ERROR: sample point out of bounds: " << src_x << ", " << src_y << std::endl;
+                    if ( !runX.empty() )
+                    {
+                        resample(&runX[0], &runY[0], (unsigned)runX.size(), c, runStart, 0, 1);
+                        runX.clear();
+                        runY.clear();
+                    }
                     pixel++;
                     continue;
                 }
@@ -1820,105 +1833,31 @@ namespace
                 float px = (src_x - src_extent.xMin()) * xfac;
                 float py = (src_y - src_extent.yMin()) * yfac;
 
-                int px_i = osg::clampBetween( (int)osg::round(px), 0, image->s()-1 );
-                int py_i = osg::clampBetween( (int)osg::round(py), 0, image->t()-1 );
-
-                osg::Vec4 color(0,0,0,0);
-
                 // TODO: consider this again later. Causes blockiness.
                 if ( !interpolate ) //! isSrcContiguous ) // non-contiguous space- use nearest neighbot
                 {
-                    color = ia(px_i, py_i);
+                    int px_i = osg::clampBetween( (int)osg::round(px), 0, image->s()-1 );
+                    int py_i = osg::clampBetween( (int)osg::round(py), 0, image->t()-1 );
+                    writer(ia(px_i, py_i), c, r);
                 }
 
                 else // contiguous space - use bilinear sampling
                 {
-                    int rowMin = osg::maximum((int)floor(py), 0);
-                    int rowMax = osg::maximum(osg::minimum((int)ceil(py), (int)(image->t()-1)), 0);
-                    int colMin = osg::maximum((int)floor(px), 0);
-                    int colMax = osg::maximum(osg::minimum((int)ceil(px), (int)(image->s()-1)), 0);
-
-                    if (rowMin > rowMax) rowMin = rowMax;
-                    if (colMin > colMax) colMin = colMax;
-
-                    osg::Vec4 urColor = ia(colMax, rowMax);
-                    osg::Vec4 llColor = ia(colMin, rowMin);
-                    osg::Vec4 ulColor = ia(colMin, rowMax);
-                    osg::Vec4 lrColor = ia(colMax, rowMin);
-
-                    /*Average Interpolation*/
-                    /*double x_rem = px - (int)px;
-                    double y_rem = py - (int)py;
-
-                    double w00 = (1.0 - y_rem) * (1.0 - x_rem);
-                    double w01 = (1.0 - y_rem) * x_rem;
-                    double w10 = y_rem * (1.0 - x_rem);
-                    double w11 = y_rem * x_rem;
-                    double wsum = w00 + w01 + w10 + w11;
-                    wsum = 1.0/wsum;
-
-                    color.r() = (w00 * llColor.r() + w01 * lrColor.r() + w10 * ulColor.r() + w11 * urColor.r()) * wsum;
-                    color.g() = (w00 * llColor.g() + w01 * lrColor.g() + w10 * ulColor.g() + w11 * urColor.g()) * wsum;
-                    color.b() = (w00 * llColor.b() + w01 * lrColor.b() + w10 * ulColor.b() + w11 * urColor.b()) * wsum;
-                    color.a() = (w00 * llColor.a() + w01 * lrColor.a() + w10 * ulColor.a() + w11 * urColor.a()) * wsum;*/
-
-                    /*Nearest Neighbor Interpolation*/
-                    /*if (px_i >= 0 && px_i < image->s() &&
-                    py_i >= 0 && py_i < image->t())
-                    {
-                    //OE_NOTICE << "[osgEarth::GeoData] Sampling pixel " << px << "," << py << std::endl;
-                    color = ImageUtils::getColor(image, px_i, py_i);
-                    }
-                    else
-                    {
-                    OE_NOTICE << "[osgEarth::GeoData] Pixel out of range " << px_i << "," << py_i << "  image is " << image->s() << "x" << image->t() << std::endl;
-                    }*/
-
-                    /*Bilinear interpolation*/
-                    //Check for exact value
-                    if ((colMax == colMin) && (rowMax == rowMin))
-                    {
-                        //OE_NOTICE << "[osgEarth::GeoData] Exact value" << std::endl;
-                        color = ia(px_i, py_i);
-                    }
-                    else if (colMax == colMin)
-                    {
-                        //OE_NOTICE << "[osgEarth::GeoData] Vertically" << std::endl;
-                        //Linear interpolate vertically
-                        for (unsigned int i = 0; i < 4; ++i)
-                        {
-                            color[i] = ((float)rowMax - py) * llColor[i] + (py - (float)rowMin) * ulColor[i];
-                        }
-                    }
-                    else if (rowMax == rowMin)
-                    {
-                        //OE_NOTICE << "[osgEarth::GeoData] Horizontally" << std::endl;
-                        //Linear interpolate horizontally
-                        for (unsigned int i = 0; i < 4; ++i)
-                        {
-                            color[i] = ((float)colMax - px) * llColor[i] + (px - (float)colMin) * lrColor[i];
-                        }
-                    }
-                    else
-                    {
-                        //OE_NOTICE << "[osgEarth::GeoData] Bilinear" << std::endl;
-                        //Bilinear interpolate
-                        float col1 = colMax - px, col2 = px - colMin;
-                        float row1 = rowMax - py, row2 = py - rowMin;
-                        for (unsigned int i = 0; i < 4; ++i)
-                        {
-                            float r1 = col1 * llColor[i] + col2 * lrColor[i];
-                            float r2 = col1 * ulColor[i] + col2 * urColor[i];
-
-                            //OE_INFO << "r1, r2 = " << r1 << " , " << r2 << std::endl;
-                            color[i] = row1 * r1 + row2 * r2;
-                        }
-                    }
+                    if ( runX.empty() )
+                        runStart = r;
+                    runX.push_back(px);
+                    runY.push_back(py);
                 }
 
-                writer(color, c, r);
                 pixel++;
             }
+
+            if ( !runX.empty() )
+            {
+                resample(&runX[0], &runY[0], (unsigned)runX.size(), c, runStart, 0, 1);
+                runX.clear();
+                runY.clear();
+            }
         }
 
         delete[] srcPointsX;
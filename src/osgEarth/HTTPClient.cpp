@@ -26,12 +26,16 @@
 #include <osgDB/FileNameUtils>
 #include <osg/Notify>
 #include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Condition>
 #include <string.h>
 #include <sstream>
 #include <fstream>
 #include <iterator>
 #include <iostream>
 #include <algorithm>
+#include <deque>
+#include <set>
 #include <curl/curl.h>
 
 // Whether to use WinInet instead of cURL - CMAKE option
@@ -42,6 +46,11 @@
 
 #define LC "[HTTPClient] "
 
+// curl_multi_poll and curl_multi_wakeup arrived in 7.68
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define OE_CURL_HAS_WAKEUP 1
+#endif
+
 //#define OE_TEST OE_NOTICE
 #define OE_TEST OE_NULL
 
@@ -115,24 +124,38 @@ namespace osgEarth
 {
     struct StreamObject
     {
-        StreamObject(std::ostream* stream) : _stream(stream) { }
+        StreamObject(std::vector<char>* buffer) : _buffer(buffer) { }
 
         void write(const char* ptr, size_t realsize)
         {
-            if (_stream) _stream->write(ptr, realsize);
+            if (_buffer) _buffer->insert(_buffer->end(), ptr, ptr+realsize);
         }
 
         void writeHeader(const char* ptr, size_t realsize)
         {            
-            std::string header(ptr);            
+            std::string header(ptr, realsize);
             StringTokenizer tok(":");
             StringVector tized;
             tok.tokenize(header, tized);            
             if ( tized.size() >= 2 )
-                _headers[tized[0]] = tized[1];                
+            {
+                _headers[tized[0]] = tized[1];
+
+                // size the body buffer up front so it never reallocates. The
+                // length is only a hint (it's the compressed size when curl is
+                // decoding gzip) so cap it to guard against a bogus value.
+                if ( _buffer && ciEquals(tized[0], "Content-Length") )
+                {
+                    size_t length = as<size_t>(tized[1], 0u);
+                    if ( length > 0u && length <= s_maxReserve )
+                        _buffer->reserve( length );
+                }
+            }
         }
 
-        std::ostream* _stream;
+        static const size_t s_maxReserve = 64u * 1024u * 1024u;
+
+        std::vector<char>* _buffer;
         Headers _headers;
         std::string     _resultMimeType;
     };
@@ -311,7 +334,7 @@ HTTPResponse::getNumParts() const {
 
 unsigned int
 HTTPResponse::getPartSize( unsigned int n ) const {
-    return _parts[n]->_size;
+    return _parts[n]->_buffer.size();
 }
 
 const std::string&
@@ -321,14 +344,19 @@ HTTPResponse::getPartHeader( unsigned int n, const std::string& name ) const {
 
 std::istream&
 HTTPResponse::getPartStream( unsigned int n ) const {
-    return _parts[n]->_stream;
+    return _parts[n]->rewind();
 }
 
 std::string
 HTTPResponse::getPartAsString( unsigned int n ) const {
-    std::string streamStr;
-    streamStr = _parts[n]->_stream.str();    
-    return streamStr;
+    const std::vector<char>& buf = _parts[n]->_buffer;
+    return buf.empty() ? std::string() : std::string(&buf[0], buf.size());
+}
+
+const char*
+HTTPResponse::getPartData( unsigned int n ) const {
+    const std::vector<char>& buf = _parts[n]->_buffer;
+    return buf.empty() ? 0L : &buf[0];
 }
 
 const std::string&
@@ -380,6 +408,62 @@ namespace
     static osg::ref_ptr< URLRewriter > s_rewriter;
 
     static osg::ref_ptr< CurlConfigHandler > s_curlConfigHandler;
+
+    // asynchronous requests.
+    static unsigned                    s_maxConcurrentRequests = 256u;
+    static bool                        s_http2 = false;
+    static bool                        s_async = false;
+
+    /**
+     * Applies the options common to every request to a new curl handle.
+     */
+    void setDefaultOptions(CURL* handle)
+    {
+        //Get the user agent
+        std::string userAgent = s_userAgent;
+        const char* userAgentEnv = getenv("OSGEARTH_USERAGENT");
+        if (userAgentEnv)
+        {
+            userAgent = std::string(userAgentEnv);
+        }
+
+        OE_DEBUG << LC << "HTTPClient setting userAgent=" << userAgent << std::endl;
+
+        curl_easy_setopt( handle, CURLOPT_USERAGENT, userAgent.c_str() );
+        curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, osgEarth::StreamObjectReadCallback );
+        curl_easy_setopt( handle, CURLOPT_HEADERFUNCTION, osgEarth::StreamObjectHeaderCallback );
+        curl_easy_setopt( handle, CURLOPT_FOLLOWLOCATION, (void*)1 );
+        curl_easy_setopt( handle, CURLOPT_MAXREDIRS, (void*)5 );
+        curl_easy_setopt( handle, CURLOPT_PROGRESSFUNCTION, &CurlProgressCallback);
+        curl_easy_setopt( handle, CURLOPT_NOPROGRESS, (void*)0 ); //0=enable.
+        curl_easy_setopt( handle, CURLOPT_FILETIME, true );
+
+        // Enable automatic CURL decompression of known types. An empty string will automatically add all supported encoding types that are built into curl.
+        // Note that you must have curl built against zlib to support gzip or deflate encoding.
+        curl_easy_setopt( handle, CURLOPT_ENCODING, "");
+
+        osg::ref_ptr< CurlConfigHandler > curlConfigHandler = HTTPClient::getCurlConfigHandler();
+        if (curlConfigHandler.valid()) {
+            curlConfigHandler->onInitialize(handle);
+        }
+
+        long timeout = s_timeout;
+        const char* timeoutEnv = getenv("OSGEARTH_HTTP_TIMEOUT");
+        if (timeoutEnv)
+        {
+            timeout = osgEarth::as<long>(std::string(timeoutEnv), 0);
+        }
+        OE_DEBUG << LC << "Setting timeout to " << timeout << std::endl;
+        curl_easy_setopt( handle, CURLOPT_TIMEOUT, timeout );
+        long connectTimeout = s_connectTimeout;
+        const char* connectTimeoutEnv = getenv("OSGEARTH_HTTP_CONNECTTIMEOUT");
+        if (connectTimeoutEnv)
+        {
+            connectTimeout = osgEarth::as<long>(std::string(connectTimeoutEnv), 0);
+        }
+        OE_DEBUG << LC << "Setting connect timeout to " << connectTimeout << std::endl;
+        curl_easy_setopt( handle, CURLOPT_CONNECTTIMEOUT, connectTimeout );
+    }
 }
 
 HTTPClient&
@@ -413,14 +497,6 @@ HTTPClient::initializeImpl()
     _previousHttpAuthentication = 0;
     _curl_handle = curl_easy_init();
 
-    //Get the user agent
-    std::string userAgent = s_userAgent;
-    const char* userAgentEnv = getenv("OSGEARTH_USERAGENT");
-    if (userAgentEnv)
-    {
-        userAgent = std::string(userAgentEnv);
-    }
-
     //Check for a response-code simulation (for testing)
     const char* simCode = getenv("OSGEARTH_SIMULATE_HTTP_RESPONSE_CODE");
     if ( simCode )
@@ -443,42 +519,7 @@ HTTPClient::initializeImpl()
         OE_WARN << LC << "HTTP debugging enabled" << std::endl;
     }
 
-    OE_DEBUG << LC << "HTTPClient setting userAgent=" << userAgent << std::endl;
-
-    curl_easy_setopt( _curl_handle, CURLOPT_USERAGENT, userAgent.c_str() );
-    curl_easy_setopt( _curl_handle, CURLOPT_WRITEFUNCTION, osgEarth::StreamObjectReadCallback );
-    curl_easy_setopt( _curl_handle, CURLOPT_HEADERFUNCTION, osgEarth::StreamObjectHeaderCallback );
-    curl_easy_setopt( _curl_handle, CURLOPT_FOLLOWLOCATION, (void*)1 );
-    curl_easy_setopt( _curl_handle, CURLOPT_MAXREDIRS, (void*)5 );
-    curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSFUNCTION, &CurlProgressCallback);
-    curl_easy_setopt( _curl_handle, CURLOPT_NOPROGRESS, (void*)0 ); //0=enable.
-    curl_easy_setopt( _curl_handle, CURLOPT_FILETIME, true );
-
-    // Enable automatic CURL decompression of known types. An empty string will automatically add all supported encoding types that are built into curl.
-    // Note that you must have curl built against zlib to support gzip or deflate encoding.
-    curl_easy_setopt( _curl_handle, CURLOPT_ENCODING, "");
-
-    osg::ref_ptr< CurlConfigHandler > curlConfigHandler = getCurlConfigHandler();
-    if (curlConfigHandler.valid()) {
-        curlConfigHandler->onInitialize(_curl_handle);
-    }
-
-    long timeout = s_timeout;
-    const char* timeoutEnv = getenv("OSGEARTH_HTTP_TIMEOUT");
-    if (timeoutEnv)
-    {
-        timeout = osgEarth::as<long>(std::string(timeoutEnv), 0);
-    }
-    OE_DEBUG << LC << "Setting timeout to " << timeout << std::endl;
-    curl_easy_setopt( _curl_handle, CURLOPT_TIMEOUT, timeout );
-    long connectTimeout = s_connectTimeout;
-    const char* connectTimeoutEnv = getenv("OSGEARTH_HTTP_CONNECTTIMEOUT");
-    if (connectTimeoutEnv)
-    {
-        connectTimeout = osgEarth::as<long>(std::string(connectTimeoutEnv), 0);
-    }
-    OE_DEBUG << LC << "Setting connect timeout to " << connectTimeout << std::endl;
-    curl_easy_setopt( _curl_handle, CURLOPT_CONNECTTIMEOUT, connectTimeout );
+    setDefaultOptions( (CURL*)_curl_handle );
 
     _initialized = true;
 }
@@ -544,14 +585,50 @@ void HTTPClient::setCurlConfighandler(CurlConfigHandler* handler)
     s_curlConfigHandler = handler;
 }
 
+void HTTPClient::setMaxConcurrentRequests( unsigned value )
+{
+    s_maxConcurrentRequests = osg::maximum(value, 1u);
+}
+
+unsigned HTTPClient::getMaxConcurrentRequests()
+{
+    return s_maxConcurrentRequests;
+}
+
+void HTTPClient::setHTTP2Enabled( bool value )
+{
+    s_http2 = value;
+}
+
+bool HTTPClient::getHTTP2Enabled()
+{
+    return s_http2;
+}
+
+void HTTPClient::setAsyncEnabled( bool value )
+{
+    s_async = value;
+}
+
+bool HTTPClient::getAsyncEnabled()
+{
+    return s_async;
+}
+
 void
 HTTPClient::globalInit()
 {
     curl_global_init(CURL_GLOBAL_ALL);
+
+    if ( ::getenv("OSGEARTH_HTTP_ASYNC") )
+    {
+        s_async = true;
+        OE_INFO << LC << "Asynchronous HTTP enabled" << std::endl;
+    }
 }
 
 void
-HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host, std::string& proxy_port) const
+HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host, std::string& proxy_port)
 {
     // try to set proxy host/port by reading the CURL proxy options
     if ( options )
@@ -573,17 +650,80 @@ HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host,
     }
 }
 
+void
+HTTPClient::getProxySettings(const osgDB::Options* options, std::string& proxy_addr, std::string& proxy_auth)
+{
+    std::string proxy_host;
+    std::string proxy_port = "8080";
+
+    //Try to get the proxy settings from the global settings
+    if (s_proxySettings.isSet())
+    {
+        proxy_host = s_proxySettings.get().hostName();
+        std::stringstream buf;
+        buf << s_proxySettings.get().port();
+        proxy_port = buf.str();
+
+        std::string proxy_username = s_proxySettings.get().userName();
+        std::string proxy_password = s_proxySettings.get().password();
+        if (!proxy_username.empty() && !proxy_password.empty())
+        {
+            proxy_auth = proxy_username + std::string(":") + proxy_password;
+        }
+    }
+
+    //Try to get the proxy settings from the local options that are passed in.
+    readOptions( options, proxy_host, proxy_port );
+
+    optional< ProxySettings > proxySettings;
+    ProxySettings::fromOptions( options, proxySettings );
+    if (proxySettings.isSet())
+    {       
+        proxy_host = proxySettings.get().hostName();
+        proxy_port = toString<int>(proxySettings.get().port());
+        OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
+    }
+
+    //Try to get the proxy settings from the environment variable
+    const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
+    if (proxyEnvAddress) //Env Proxy Settings
+    {
+        proxy_host = std::string(proxyEnvAddress);
+
+        const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
+        if (proxyEnvPort)
+        {
+            proxy_port = std::string( proxyEnvPort );
+        }
+    }
+
+    const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
+    if (proxyEnvAuth)
+    {
+        proxy_auth = std::string(proxyEnvAuth);
+    }
+
+    if ( !proxy_host.empty() )
+    {
+        std::stringstream buf;
+        buf << proxy_host << ":" << proxy_port;
+        proxy_addr = buf.str();
+    }
+}
+
 bool
 HTTPClient::decodeMultipartStream(const std::string&   boundary,
                                   HTTPResponse::Part*  input,
-                                  HTTPResponse::Parts& output) const
+                                  HTTPResponse::Parts& output)
 {
     std::string bstr = std::string("--") + boundary;
     std::string line;
     char tempbuf[256];
 
+    std::istream& in = input->rewind();
+
     // first thing in the stream should be the boundary.
-    input->_stream.read( tempbuf, bstr.length() );
+    in.read( tempbuf, bstr.length() );
     tempbuf[bstr.length()] = 0;
     line = tempbuf;
     if ( line != bstr )
@@ -601,7 +741,7 @@ HTTPClient::decodeMultipartStream(const std::string&   boundary,
         osg::ref_ptr<HTTPResponse::Part> next_part = new HTTPResponse::Part();
 
         // first finish off the boundary.
-        std::getline( input->_stream, line );
+        std::getline( in, line );
         if ( line == "--" )
         {
             done = true;
@@ -612,7 +752,7 @@ HTTPClient::decodeMultipartStream(const std::string&   boundary,
             line = " ";
             while( line.length() > 0 && !done )
             {
-                std::getline( input->_stream, line );
+                std::getline( in, line );
 
                 // check for EOS:
                 if ( line == "--" )
@@ -639,19 +779,15 @@ HTTPClient::decodeMultipartStream(const std::string&   boundary,
             while( bstr_ptr < bstr.length() )
             {
                 char b;
-                input->_stream.read( &b, 1 );
+                in.read( &b, 1 );
                 if ( b == bstr[bstr_ptr] )
                 {
                     bstr_ptr++;
                 }
                 else
                 {
-                    for( unsigned int i=0; i<bstr_ptr; i++ )
-                    {
-                        next_part->_stream << bstr[i];
-                    }
-                    next_part->_stream << b;
-                    next_part->_size += bstr_ptr + 1;
+                    next_part->append( bstr.c_str(), bstr_ptr );
+                    next_part->append( &b, 1 );
                     bstr_ptr = 0;
                 }
             }
@@ -718,6 +854,64 @@ HTTPClient::download(const std::string& uri,
 }
 
 
+void
+HTTPClient::finishResponse(void*               curl_handle,
+                           int                 curl_result,
+                           long                response_code,
+                           HTTPResponse::Part* part,
+                           const Headers&      headers,
+                           HTTPResponse&       response)
+{
+    response._response_code = response_code;
+
+    // read the response content type:
+    char* content_type_cp = 0L;
+
+    curl_easy_getinfo( curl_handle, CURLINFO_CONTENT_TYPE, &content_type_cp );    
+
+    if ( content_type_cp != NULL )
+    {
+        response._mimeType = content_type_cp;    
+    } 
+
+    // read the file time:
+    response._lastModified = getCurlFileTime( curl_handle );
+
+    // upon success, parse the data:
+    if ( curl_result != CURLE_ABORTED_BY_CALLBACK && curl_result != CURLE_OPERATION_TIMEDOUT )
+    {        
+        // check for multipart content
+        if (response._mimeType.length() > 9 && 
+            ::strstr( response._mimeType.c_str(), "multipart" ) == response._mimeType.c_str() )
+        {
+            OE_DEBUG << LC << "detected multipart data; decoding..." << std::endl;
+
+            //TODO: parse out the "wcs" -- this is WCS-specific
+            if ( !decodeMultipartStream( "wcs", part, response._parts ) )
+            {
+                // error decoding an invalid multipart stream.
+                // should we do anything, or just leave the response empty?
+            }
+        }
+        else
+        {            
+            for (Headers::const_iterator itr = headers.begin(); itr != headers.end(); ++itr)
+            {                
+                part->_headers[itr->first] = itr->second;                
+            }
+
+            // Write the headers to the metadata
+            response._parts.push_back( part );
+        }
+    }
+    else  /*if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT) */
+    {        
+        //If we were aborted by a callback, then it was cancelled by a user
+        response._cancelled = true;
+    }
+}
+
+
 #ifdef OSGEARTH_USE_WININET_FOR_HTTP
 
 namespace
@@ -932,7 +1126,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
         DWORD numBytesRead = 0;
         while( InternetReadFile(hRequest, buffer, 4096, &numBytesRead) && numBytesRead )
         {
-            part->_stream << std::string(buffer, numBytesRead);
+            part->append( buffer, numBytesRead );
         }
 
         response._parts.push_back( part.get() );
@@ -964,6 +1158,13 @@ HTTPClient::doGet(const HTTPRequest&    request,
 {    
     initialize();
 
+    // in async mode, run the request on the shared I/O thread and wait for it.
+    if ( s_async && _simResponseCode < 0 )
+    {
+        osg::ref_ptr<HTTPFuture> future = getAsync( request, options, progress );
+        return future->getResponse();
+    }
+
     OE_START_TIMER(http_get);
     
     std::string url = request.getURL();
@@ -972,71 +1173,15 @@ HTTPClient::doGet(const HTTPRequest&    request,
             options->getAuthenticationMap() :
             osgDB::Registry::instance()->getAuthenticationMap();
 
-    std::string proxy_host;
-    std::string proxy_port = "8080";
-
-    std::string proxy_auth;
-
     //TODO: don't do all this proxy setup on every GET. Just do it once per client, or only when 
     // the proxy information changes.
-
-    //Try to get the proxy settings from the global settings
-    if (s_proxySettings.isSet())
-    {
-        proxy_host = s_proxySettings.get().hostName();
-        std::stringstream buf;
-        buf << s_proxySettings.get().port();
-        proxy_port = buf.str();
-
-        std::string proxy_username = s_proxySettings.get().userName();
-        std::string proxy_password = s_proxySettings.get().password();
-        if (!proxy_username.empty() && !proxy_password.empty())
-        {
-            proxy_auth = proxy_username + std::string(":") + proxy_password;
-        }
-    }
-
-    //Try to get the proxy settings from the local options that are passed in.
-    readOptions( options, proxy_host, proxy_port );
-
-    optional< ProxySettings > proxySettings;
-    ProxySettings::fromOptions( options, proxySettings );
-    if (proxySettings.isSet())
-    {       
-        proxy_host = proxySettings.get().hostName();
-        proxy_port = toString<int>(proxySettings.get().port());
-        OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
-    }
-
-    //Try to get the proxy settings from the environment variable
-    const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
-    if (proxyEnvAddress) //Env Proxy Settings
-    {
-        proxy_host = std::string(proxyEnvAddress);
-
-        const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
-        if (proxyEnvPort)
-        {
-            proxy_port = std::string( proxyEnvPort );
-        }
-    }
-
-    const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
-    if (proxyEnvAuth)
-    {
-        proxy_auth = std::string(proxyEnvAuth);
-    }
+    std::string proxy_addr;
+    std::string proxy_auth;
+    getProxySettings( options, proxy_addr, proxy_auth );
 
     // Set up proxy server:
-    std::string proxy_addr;
-    if ( !proxy_host.empty() )
+    if ( !proxy_addr.empty() )
     {
-        std::stringstream buf;
-        buf << proxy_host << ":" << proxy_port;
-        std::string bufStr;
-        bufStr = buf.str();
-        proxy_addr = bufStr;
-    
         if ( s_HTTP_DEBUG )
         {
             OE_NOTICE << LC << "Using proxy: " << proxy_addr << std::endl;
@@ -1129,7 +1274,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
     curl_easy_setopt(_curl_handle, CURLOPT_HTTPHEADER, headers); 
     
     osg::ref_ptr<HTTPResponse::Part> part = new HTTPResponse::Part();
-    StreamObject sp( &part->_stream );
+    StreamObject sp( &part->_buffer );
 
     //Take a temporary ref to the callback (why? dangerous.)
     //osg::ref_ptr<ProgressCallback> progressCallback = callback;
@@ -1184,53 +1329,8 @@ HTTPClient::doGet(const HTTPRequest&    request,
         res = response_code == 408 ? CURLE_OPERATION_TIMEDOUT : CURLE_COULDNT_CONNECT;
     }
 
-    HTTPResponse response( response_code );    
-    
-    // read the response content type:
-    char* content_type_cp;
-
-    curl_easy_getinfo( _curl_handle, CURLINFO_CONTENT_TYPE, &content_type_cp );    
-
-    if ( content_type_cp != NULL )
-    {
-        response._mimeType = content_type_cp;    
-    } 
-
-    // read the file time:
-    response._lastModified = getCurlFileTime( _curl_handle );
-
-    // upon success, parse the data:
-    if ( res != CURLE_ABORTED_BY_CALLBACK && res != CURLE_OPERATION_TIMEDOUT )
-    {        
-        // check for multipart content
-        if (response._mimeType.length() > 9 && 
-            ::strstr( response._mimeType.c_str(), "multipart" ) == response._mimeType.c_str() )
-        {
-            OE_DEBUG << LC << "detected multipart data; decoding..." << std::endl;
-
-            //TODO: parse out the "wcs" -- this is WCS-specific
-            if ( !decodeMultipartStream( "wcs", part.get(), response._parts ) )
-            {
-                // error decoding an invalid multipart stream.
-                // should we do anything, or just leave the response empty?
-            }
-        }
-        else
-        {            
-            for (Headers::iterator itr = sp._headers.begin(); itr != sp._headers.end(); ++itr)
-            {                
-                part->_headers[itr->first] = itr->second;                
-            }
-
-            // Write the headers to the metadata
-            response._parts.push_back( part.get() );
-        }
-    }
-    else  /*if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT) */
-    {        
-        //If we were aborted by a callback, then it was cancelled by a user
-        response._cancelled = true;
-    }
+    HTTPResponse response;
+    finishResponse( _curl_handle, res, response_code, part.get(), sp._headers, response );
 
     response._duration_s = OE_STOP_TIMER(get_duration);
 
@@ -1303,6 +1403,445 @@ HTTPClient::doGet(const HTTPRequest&    request,
 
 #endif // USE_WININET
 
+/****************************************************************************/
+
+HTTPFuture::HTTPFuture( const HTTPRequest& request, ProgressCallback* progress ) :
+_request  ( request ),
+_progress ( progress ),
+_cancelled( 0u )
+{
+    //nop
+}
+
+HTTPFuture::~HTTPFuture()
+{
+    //nop
+}
+
+const HTTPResponse&
+HTTPFuture::getResponse()
+{
+    while( !_ready.isSet() )
+        _ready.wait();
+    return _response;
+}
+
+void
+HTTPFuture::cancel()
+{
+    _cancelled.exchange( 1u );
+}
+
+ReadResult
+HTTPFuture::readImage( const osgDB::Options* dbOptions )
+{
+    ReadResult result = HTTPClient::decodeImage( _request, getResponse(), dbOptions, _progress.get() );
+    if ( result.getImage() )
+        result.getImage()->setName( _request.getURL() );
+    return result;
+}
+
+ReadResult
+HTTPFuture::readString()
+{
+    return HTTPClient::decodeString( _request, getResponse(), _progress.get() );
+}
+
+void
+HTTPClient::completeFuture(HTTPFuture*         future,
+                           void*               curl_handle,
+                           int                 curl_result,
+                           long                response_code,
+                           HTTPResponse::Part* part,
+                           const Headers&      headers)
+{
+    HTTPResponse& response = future->_response;
+    finishResponse( curl_handle, curl_result, response_code, part, headers, response );
+
+    double total_s = 0.0;
+    if ( curl_easy_getinfo(curl_handle, CURLINFO_TOTAL_TIME, &total_s) == CURLE_OK )
+        response._duration_s = total_s;
+
+    if ( s_HTTP_DEBUG )
+    {
+        OE_NOTICE << LC 
+            << "GET(" << response_code << ", " << response._mimeType << ") : \"" 
+            << future->_request.getURL() << "\" t="
+            << std::setprecision(4) << response.getDuration() << "s (async)" << std::endl;
+    }
+
+    future->_ready.set();
+}
+
+bool
+HTTPClient::isAborted( const HTTPFuture* future )
+{
+    return
+        future->_cancelled != 0u ||
+        (future->_progress.valid() && future->_progress->isCanceled());
+}
+
+#ifdef OSGEARTH_USE_WININET_FOR_HTTP
+
+osg::ref_ptr<HTTPFuture>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress,
+                     HTTPResponseCallback* callback)
+{
+    // WinInet has no multi interface; run the request right away.
+    osg::ref_ptr<HTTPFuture> future = new HTTPFuture( request, progress );
+    future->_response = get( request, options, progress );
+    future->_ready.set();
+
+    if ( callback )
+        callback->onResponse( future.get() );
+
+    return future;
+}
+
+void
+HTTPClient::shutdownAsync()
+{
+    //nop
+}
+
+#else // OSGEARTH_USE_WININET_FOR_HTTP
+
+/**
+ * Runs HTTP requests on a single I/O thread with a curl "multi" handle.
+ * Requests share the multi handle's connection cache, so connections
+ * to the same host are reused (and multiplexed with HTTP/2 if enabled).
+ * At most HTTPClient::getMaxConcurrentRequests() transfers run at once;
+ * the rest wait in a queue.
+ */
+class HTTPClient::AsyncEngine : public OpenThreads::Thread
+{
+public:
+    AsyncEngine() :
+        _multi    ( 0L ),
+        _numActive( 0u ),
+        _done     ( false )
+    {
+        _multi = curl_multi_init();
+
+        curl_multi_setopt( _multi, CURLMOPT_MAXCONNECTS, (long)s_maxConcurrentRequests );
+
+#ifdef CURLPIPE_MULTIPLEX
+        if ( s_http2 )
+        {
+            curl_multi_setopt( _multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+        }
+#endif
+
+        start();
+    }
+
+    ~AsyncEngine()
+    {
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            _done = true;
+            _cond.broadcast();
+        }
+#ifdef OE_CURL_HAS_WAKEUP
+        curl_multi_wakeup( _multi );
+#endif
+        join();
+
+        // abandon anything still queued or in flight.
+        for(std::deque<Transfer*>::iterator i = _pending.begin(); i != _pending.end(); ++i)
+            finish( *i, CURLE_ABORTED_BY_CALLBACK );
+        for(std::set<Transfer*>::iterator i = _active.begin(); i != _active.end(); ++i)
+        {
+            curl_multi_remove_handle( _multi, (*i)->_handle );
+            finish( *i, CURLE_ABORTED_BY_CALLBACK );
+        }
+
+        curl_multi_cleanup( _multi );
+    }
+
+    /** Sets up a curl handle for the request and queues it for the I/O thread. */
+    void submit( HTTPFuture* future, const osgDB::Options* options, HTTPResponseCallback* callback )
+    {
+        Transfer* t = new Transfer( future, callback );
+
+        CURL* handle = t->_handle;
+        setDefaultOptions( handle );
+
+        std::string url = future->getRequest().getURL();
+
+        // Rewrite the url if the url rewriter is available  
+        osg::ref_ptr< URLRewriter > rewriter = getURLRewriter();
+        if ( rewriter.valid() )
+        {
+            std::string oldURL = url;
+            url = rewriter->rewrite( oldURL );
+            OE_DEBUG << LC << "Rewrote URL " << oldURL << " to " << url << std::endl;
+        }
+
+        std::string proxy_addr;
+        std::string proxy_auth;
+        getProxySettings( options, proxy_addr, proxy_auth );
+        if ( !proxy_addr.empty() )
+        {
+            curl_easy_setopt( handle, CURLOPT_PROXY, proxy_addr.c_str() );
+            if ( !proxy_auth.empty() )
+                curl_easy_setopt( handle, CURLOPT_PROXYUSERPWD, proxy_auth.c_str() );
+        }
+
+        const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ? 
+                options->getAuthenticationMap() :
+                osgDB::Registry::instance()->getAuthenticationMap();
+
+        const osgDB::AuthenticationDetails* details = authenticationMap ?
+            authenticationMap->getAuthenticationDetails( url ) :
+            0;
+
+        if ( details )
+        {
+            std::string password( details->username + ":" + details->password );
+            curl_easy_setopt( handle, CURLOPT_USERPWD, password.c_str() );
+#if LIBCURL_VERSION_NUM >= 0x070a07
+            curl_easy_setopt( handle, CURLOPT_HTTPAUTH, details->httpAuthentication ); 
+#endif
+        }
+
+        // Set any headers
+        const Headers& requestHeaders = future->getRequest().getHeaders();
+        for (Headers::const_iterator itr = requestHeaders.begin(); itr != requestHeaders.end(); ++itr)
+        {
+            std::stringstream buf;
+            buf << itr->first << ": " << itr->second;
+            t->_headers = curl_slist_append( t->_headers, buf.str().c_str() );
+        }
+
+        // Disable the default Pragma: no-cache that curl adds by default.
+        t->_headers = curl_slist_append( t->_headers, "Pragma: " );
+        curl_easy_setopt( handle, CURLOPT_HTTPHEADER, t->_headers ); 
+
+        curl_easy_setopt( handle, CURLOPT_URL, url.c_str() );
+        curl_easy_setopt( handle, CURLOPT_WRITEDATA, (void*)&t->_stream );
+        curl_easy_setopt( handle, CURLOPT_HEADERDATA, (void*)&t->_stream );
+        curl_easy_setopt( handle, CURLOPT_PROGRESSFUNCTION, &AsyncEngine::progressCallback );
+        curl_easy_setopt( handle, CURLOPT_PROGRESSDATA, (void*)t );
+        curl_easy_setopt( handle, CURLOPT_PRIVATE, (void*)t );
+        curl_easy_setopt( handle, CURLOPT_NOSIGNAL, (void*)1 );
+
+        //Disable peer certificate verification to allow us to access in https servers where the peer certificate cannot be verified.
+        curl_easy_setopt( handle, CURLOPT_SSL_VERIFYPEER, (void*)0 );
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+        if ( s_http2 )
+        {
+            curl_easy_setopt( handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS );
+            // wait for a connection to multiplex on instead of opening another one.
+            curl_easy_setopt( handle, CURLOPT_PIPEWAIT, 1L );
+        }
+#endif
+
+        osg::ref_ptr< CurlConfigHandler > curlConfigHandler = getCurlConfigHandler();
+        if (curlConfigHandler.valid()) {
+            curlConfigHandler->onGet( handle );
+        }
+
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            _pending.push_back( t );
+            _cond.broadcast();
+        }
+#ifdef OE_CURL_HAS_WAKEUP
+        curl_multi_wakeup( _multi );
+#endif
+    }
+
+    void run()
+    {
+        for(;;)
+        {
+            std::vector<Transfer*> aborted;
+
+            // move queued requests into the multi handle, or sleep if there's nothing to do.
+            {
+                Threading::ScopedMutexLock lock( _mutex );
+                while( !_done && _pending.empty() && _numActive == 0u )
+                    _cond.wait( &_mutex );
+
+                if ( _done )
+                    break;
+
+                while( !_pending.empty() && _numActive < s_maxConcurrentRequests )
+                {
+                    Transfer* t = _pending.front();
+                    _pending.pop_front();
+
+                    if ( isAborted(t->_future.get()) )
+                    {
+                        aborted.push_back( t );
+                    }
+                    else
+                    {
+                        curl_multi_add_handle( _multi, t->_handle );
+                        _active.insert( t );
+                        ++_numActive;
+                    }
+                }
+            }
+
+            // finish these outside the lock, since a callback may submit another request.
+            for(unsigned i=0; i<aborted.size(); ++i)
+                finish( aborted[i], CURLE_ABORTED_BY_CALLBACK );
+
+            int running = 0;
+            curl_multi_perform( _multi, &running );
+
+            // hand off the finished transfers.
+            int left = 0;
+            while( CURLMsg* msg = curl_multi_info_read(_multi, &left) )
+            {
+                if ( msg->msg == CURLMSG_DONE )
+                {
+                    Transfer* t = 0L;
+                    curl_easy_getinfo( msg->easy_handle, CURLINFO_PRIVATE, (char**)&t );
+                    CURLcode result = msg->data.result;
+
+                    curl_multi_remove_handle( _multi, t->_handle );
+                    _active.erase( t );
+                    --_numActive;
+
+                    finish( t, result );
+                }
+            }
+
+            // wait for network activity. Without curl_multi_wakeup, wake up
+            // now and then to pick up new requests.
+#ifdef OE_CURL_HAS_WAKEUP
+            curl_multi_poll( _multi, 0L, 0, 1000, 0L );
+#else
+            curl_multi_wait( _multi, 0L, 0, 10, 0L );
+#endif
+        }
+    }
+
+private:
+    struct Transfer
+    {
+        Transfer( HTTPFuture* future, HTTPResponseCallback* callback ) :
+            _future  ( future ),
+            _callback( callback ),
+            _handle  ( curl_easy_init() ),
+            _headers ( 0L ),
+            _part    ( new HTTPResponse::Part() ),
+            _stream  ( &_part->_buffer ) { }
+
+        ~Transfer()
+        {
+            if ( _headers )
+                curl_slist_free_all( _headers );
+            curl_easy_cleanup( _handle );
+        }
+
+        osg::ref_ptr<HTTPFuture>           _future;
+        osg::ref_ptr<HTTPResponseCallback> _callback;
+        CURL*                              _handle;
+        curl_slist*                        _headers;
+        osg::ref_ptr<HTTPResponse::Part>   _part;
+        StreamObject                       _stream;
+    };
+
+    static int progressCallback( void* clientp, double dltotal, double dlnow, double ultotal, double ulnow )
+    {
+        Transfer* t = (Transfer*)clientp;
+        return isAborted( t->_future.get() ) ? 1 : 0;
+    }
+
+    static void finish( Transfer* t, CURLcode result )
+    {
+        long response_code = 0L;
+        curl_easy_getinfo( t->_handle, CURLINFO_RESPONSE_CODE, &response_code );
+
+        completeFuture( t->_future.get(), t->_handle, result, response_code, t->_part.get(), t->_stream._headers );
+
+        if ( t->_callback.valid() )
+            t->_callback->onResponse( t->_future.get() );
+
+        delete t;
+    }
+
+    CURLM*                  _multi;
+    unsigned                _numActive;
+    std::deque<Transfer*>   _pending;
+    std::set<Transfer*>     _active;
+    bool                    _done;
+    Threading::Mutex        _mutex;
+    OpenThreads::Condition  _cond;
+};
+
+namespace
+{
+    // Created on the first getAsync() and deleted by shutdownAsync().
+    Threading::Mutex      s_asyncEngineMutex;
+    OpenThreads::Thread*  s_asyncEngine = 0L;
+}
+
+void
+HTTPClient::shutdownAsync()
+{
+    OpenThreads::Thread* engine = 0L;
+    {
+        Threading::ScopedMutexLock lock( s_asyncEngineMutex );
+        engine = s_asyncEngine;
+        s_asyncEngine = 0L;
+    }
+
+    // Delete outside the lock: the destructor joins the I/O thread, and
+    // response callbacks running there may call getAsync().
+    delete engine;
+}
+
+osg::ref_ptr<HTTPFuture>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress,
+                     HTTPResponseCallback* callback)
+{
+    osg::ref_ptr<HTTPFuture> future = new HTTPFuture( request, progress );
+
+    // honor the testing hooks that the blocking client supports.
+    HTTPClient& client = getClient();
+    client.initialize();
+    long simResponseCode = client._simResponseCode;
+
+    if ( simResponseCode >= 0 )
+    {
+        osg::ref_ptr<HTTPResponse::Part> part = new HTTPResponse::Part();
+        CURL* handle = curl_easy_init();
+        completeFuture(
+            future.get(), handle,
+            simResponseCode == 408 ? CURLE_OPERATION_TIMEDOUT : CURLE_COULDNT_CONNECT,
+            simResponseCode, part.get(), Headers() );
+        curl_easy_cleanup( handle );
+
+        if ( callback )
+            callback->onResponse( future.get() );
+    }
+    else
+    {
+        // submit under the lock so shutdownAsync() can't delete the engine
+        // out from under us.
+        Threading::ScopedMutexLock lock( s_asyncEngineMutex );
+        if ( !s_asyncEngine )
+            s_asyncEngine = new AsyncEngine();
+        static_cast<AsyncEngine*>( s_asyncEngine )->submit( future.get(), options, callback );
+    }
+
+    // the engine may have finished and released its reference already,
+    // so ours has to reach the caller intact.
+    return future;
+}
+
+#endif // OSGEARTH_USE_WININET_FOR_HTTP
+
 bool
 HTTPClient::doDownload(const std::string& url, const std::string& filename)
 {
@@ -1314,19 +1853,10 @@ HTTPClient::doDownload(const std::string& url, const std::string& filename)
     if ( response.isOK() )
     {
         unsigned int part_num = response.getNumParts() > 1? 1 : 0;
-        std::istream& input_stream = response.getPartStream( part_num );
 
         std::ofstream fout;
         fout.open(filename.c_str(), std::ios::out | std::ios::binary);
-
-        input_stream.seekg (0, std::ios::end);
-        int length = input_stream.tellg();
-        input_stream.seekg (0, std::ios::beg);
-
-        char *buffer = new char[length];
-        input_stream.read(buffer, length);
-        fout.write(buffer, length);
-        delete[] buffer;
+        fout.write(response.getPartData(part_num), response.getPartSize(part_num));
         fout.close();
         return true;
     }
@@ -1385,10 +1915,19 @@ HTTPClient::doReadImage(const HTTPRequest&    request,
 {
     initialize();
 
-    ReadResult result;
-
     HTTPResponse response = this->doGet(request, options, callback);
 
+    return decodeImage( request, response, options, callback );
+}
+
+ReadResult
+HTTPClient::decodeImage(const HTTPRequest&    request,
+                        const HTTPResponse&   response,
+                        const osgDB::Options* options,
+                        ProgressCallback*     callback)
+{
+    ReadResult result;
+
     if (response.isOK())
     {
         osgDB::ReaderWriter* reader = getReader(request.getURL(), response);
@@ -1608,9 +2147,18 @@ HTTPClient::doReadString(const HTTPRequest&    request,
 {
     initialize();
 
+    HTTPResponse response = this->doGet( request, options, callback );
+
+    return decodeString( request, response, callback );
+}
+
+ReadResult
+HTTPClient::decodeString(const HTTPRequest&    request,
+                         const HTTPResponse&   response,
+                         ProgressCallback*     callback )
+{
     ReadResult result;
 
-    HTTPResponse response = this->doGet( request, options, callback );
     if ( response.isOK() )
     {
         result = ReadResult( new StringObject(response.getPartAsString(0)) );
@@ -53,6 +53,47 @@ void StringObject::setString( const std::string& value )
 
 //------------------------------------------------------------------------
 
+MemoryStreamBuf::MemoryStreamBuf()
+{
+    //nop
+}
+
+MemoryStreamBuf::MemoryStreamBuf( const char* data, size_t length )
+{
+    reset( data, length );
+}
+
+void
+MemoryStreamBuf::reset( const char* data, size_t length )
+{
+    // never written through; std::streambuf just doesn't have a const get area.
+    char* begin = const_cast<char*>(data);
+    setg( begin, begin, begin + length );
+}
+
+std::streambuf::pos_type
+MemoryStreamBuf::seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which )
+{
+    if ( (which & std::ios_base::in) == 0 )
+        return pos_type(off_type(-1));
+
+    char* base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::end ? egptr() : gptr();
+    char* next = base + off;
+    if ( next < eback() || next > egptr() )
+        return pos_type(off_type(-1));
+
+    setg( eback(), next, egptr() );
+    return pos_type(next - eback());
+}
+
+std::streambuf::pos_type
+MemoryStreamBuf::seekpos( pos_type pos, std::ios_base::openmode which )
+{
+    return seekoff( off_type(pos), std::ios_base::beg, which );
+}
+
+//------------------------------------------------------------------------
+
 URIReadCallback::URIReadCallback()
 {
     //nop
@@ -267,6 +267,11 @@ ImageLayerTileProcessor::process( osg::ref_ptr<osg::Image>& image ) const
             // a format that does before continuing.
             image = ImageUtils::convertToRGBA8( image.get() );
         }           
+        else if ( image->referenceCount() > 1 )
+        {
+            // the image may be shared (e.g. with a memory cache); copy before modifying.
+            image = ImageUtils::cloneImage( image.get() );
+        }
 
         ImageUtils::PixelVisitor<ApplyChromaKey> applyChroma;
         applyChroma._chromaKey = _chromaKey;
@@ -554,7 +559,6 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
 
     // the cache key combines the Key and the horizontal profile.
     std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getHorizSignature();
-    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
     
     // Check the layer L2 cache first
     if ( _memCache.valid() )
@@ -565,6 +569,47 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
             return GeoImage(static_cast<osg::Image*>(result.releaseObject()), key.getExtent());
     }
 
+    // Coalesce concurrent requests for the same tile, so that only one thread
+    // reads the cache/source and fills the caches; the others share its result.
+    // Unless the L2 cache shares objects, every caller gets an image of its own.
+    bool shareObjects = _memCache.valid() && _memCache->getShareObjects();
+
+    osg::ref_ptr<ImageFlights::Call> call;
+    if ( !_imageFlights.begin(cacheKey, call, result, progress) )
+    {
+        if ( result.valid() && !shareObjects )
+            return GeoImage(ImageUtils::cloneImage(result.getImage()), result.getExtent());
+        return result;
+    }
+
+    result = createImageFromCacheOrTileSource( key, cacheKey, progress );
+
+    // A canceled or retryable failure is specific to this caller.
+    bool shareable =
+        result.valid() ||
+        progress == 0L ||
+        (!progress->isCanceled() && !progress->needsRetry());
+
+    // The caller may modify its result, so waiters clone a private copy instead.
+    GeoImage published = result;
+    if ( result.valid() && !shareObjects && _imageFlights.close(call.get()) > 0u )
+        published = GeoImage(ImageUtils::cloneImage(result.getImage()), result.getExtent());
+
+    _imageFlights.end( call.get(), published, shareable );
+
+    return result;
+}
+
+
+GeoImage
+ImageLayer::createImageFromCacheOrTileSource(const TileKey&     key,
+                                             const std::string& cacheKey,
+                                             ProgressCallback*  progress)
+{
+    GeoImage result;
+
+    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
+
     // locate the cache bin for the target profile for this layer:
     CacheBin* cacheBin = getCacheBin( key.getProfile() );
 
@@ -711,6 +756,10 @@ ImageLayer::createImageFromTileSource(const TileKey&    key,
     // Process images with full alpha to properly support MP blending.    
     if ( result.valid() && *_runtimeOptions.featherPixels())
     {
+        // the image may be shared (e.g. with a memory cache); copy before modifying.
+        if ( result->referenceCount() > 1 )
+            result = ImageUtils::cloneImage( result.get() );
+
         ImageUtils::featherAlphaRegions( result.get() );
     }    
     
@@ -959,11 +1008,15 @@ ImageLayer::applyTextureCompressionMode(osg::Texture* tex) const
                 return;
             }
 
-            osg::Image *image = tex->getImage(0);
+            // compression happens in place, and the image may be shared with the
+            // layer's memory cache or with concurrent requests for the same tile;
+            // compress a copy.
+            osg::ref_ptr<osg::Image> image = ImageUtils::cloneImage( tex->getImage(0) );
+
             imageProcessor->compress(*image, mode, false, true, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::FASTEST);
             osg::Timer_t end = osg::Timer::instance()->tick();
             image->dirty();
-            tex->setImage(0, image);
+            tex->setImage(0, image.get());
             OE_INFO << "Compress took " << osg::Timer::instance()->delta_m(start, end) << std::endl;        
         }
         else
@@ -30,6 +30,7 @@
 #include <osg/ValueObject>
 #include <osgDB/Registry>
 #include <string.h>
+#include <stdlib.h>
 #include <memory.h>
 
 #define LC "[ImageUtils] "
@@ -253,16 +254,43 @@ ImageUtils::resizeImage(const osg::Image* input,
     {
         memcpy( output->data(), input->data(), input->getTotalSizeInBytes() );
     }
+    else if ( bilinear )
+    {
+        BilinearResampler resample( input, output.get() );
+
+        // the input column for each output column is the same on every row.
+        std::vector<float> cols( out_s ), rows( out_s );
+        for( unsigned int output_col = 0; output_col < out_s; output_col++ )
+        {
+            float output_col_ratio = (float)output_col/(float)out_s;
+            float input_col =  output_col_ratio * (float)in_s;
+            if ( input_col >= (int)in_s ) input_col = in_s-1;
+            else if ( input_col < 0 ) input_col = 0.0f;
+            cols[output_col] = input_col;
+        }
+
+        for( unsigned int output_row=0; output_row < out_t && out_s > 0; output_row++ )
+        {
+            // get an appropriate input row
+            float output_row_ratio = (float)output_row/(float)out_t;
+            float input_row = output_row_ratio * (float)in_t;
+            if ( input_row >= input->t() ) input_row = in_t-1;
+            else if ( input_row < 0 ) input_row = 0;
+
+            std::fill( rows.begin(), rows.end(), input_row );
+
+            for(int layer=0; layer<input->r(); ++layer)
+            {
+                // write the whole row to the target mip level
+                resample( &cols[0], &rows[0], out_s, 0, output_row, 1, 0, layer, layer, mipmapLevel );
+            }
+        }
+    }
     else
     {
         PixelReader read( input );
         PixelWriter write( output.get() );
 
-        unsigned int pixel_size_bytes = input->getRowSizeInBytes() / in_s;
-
-        unsigned char* dataOffset = output->getMipmapData(mipmapLevel);
-        unsigned int   dataRowSizeBytes = output->getRowSizeInBytes() >> mipmapLevel;
-
         for( unsigned int output_row=0; output_row < out_t; output_row++ )
         {
             // get an appropriate input row
@@ -282,61 +310,16 @@ ImageUtils::resizeImage(const osg::Image* input,
 
                 for(int layer=0; layer<input->r(); ++layer)
                 {
-                    if (bilinear)
-                    {
-                        // Do a billinear interpolation for the image
-                        int rowMin = osg::maximum((int)floor(input_row), 0);
-                        int rowMax = osg::maximum(osg::minimum((int)ceil(input_row), (int)(input->t()-1)), 0);
-                        int colMin = osg::maximum((int)floor(input_col), 0);
-                        int colMax = osg::maximum(osg::minimum((int)ceil(input_col), (int)(input->s()-1)), 0);                    
-
-                        if (rowMin > rowMax) rowMin = rowMax;
-                        if (colMin > colMax) colMin = colMax;  
-
-                        osg::Vec4 urColor = read(colMax, rowMax, layer);
-                        osg::Vec4 llColor = read(colMin, rowMin, layer);
-                        osg::Vec4 ulColor = read(colMin, rowMax, layer);
-                        osg::Vec4 lrColor = read(colMax, rowMin, layer);
-                    
-                        if ((colMax == colMin) && (rowMax == rowMin))
-                        {
-                            // Exact value
-                            color = urColor;
-                        }
-                        else if (colMax == colMin)
-                        {                     
-                            // Linear interpolate vertically            
-                            color = llColor * ((double)rowMax - input_row) + ulColor * (input_row - (double)rowMin);
-                        }
-                        else if (rowMax == rowMin)
-                        {                     
-                            // Linear interpolate horizontally
-                            color = llColor * ((double)colMax - input_col) + lrColor * (input_col - (double)colMin);
-                        }
-                        else
-                        {                        
-                            // Bilinear interpolate
-                            osg::Vec4 r1 = llColor * ((double)colMax - input_col) + lrColor * (input_col - (double)colMin);
-                            osg::Vec4 r2 = ulColor * ((double)colMax - input_col) + urColor * (input_col - (double)colMin);                      
-                            color = r1 * ((double)rowMax - input_row) + r2 * (input_row - (double)rowMin);
-                        }                         
-                    }
-                    else
-                    {
-                        // nearest neighbor:
-                        int col = (input_col-(int)input_col) <= (ceil(input_col)-input_col) ?
-                            (int)input_col :
-                            std::min( 1+(int)input_col, (int)in_s-1 );
+                    // nearest neighbor:
+                    int col = (input_col-(int)input_col) <= (ceil(input_col)-input_col) ?
+                        (int)input_col :
+                        std::min( 1+(int)input_col, (int)in_s-1 );
 
-                        int row = (input_row-(int)input_row) <= (ceil(input_row)-input_row) ?
-                            (int)input_row :
-                            std::min( 1+(int)input_row, (int)in_t-1 );
+                    int row = (input_row-(int)input_row) <= (ceil(input_row)-input_row) ?
+                        (int)input_row :
+                        std::min( 1+(int)input_row, (int)in_t-1 );
 
-                        color = read(col, row, layer); // read pixel from mip level 0.
-
-                        // old code
-                        //color = read( (int)input_col, (int)input_row, layer ); // read pixel from mip level 0
-                    }
+                    color = read(col, row, layer); // read pixel from mip level 0.
 
                     write( color, output_col, output_row, layer, mipmapLevel ); // write to target mip level
                 }
@@ -1849,6 +1832,567 @@ ImageUtils::PixelWriter::supports( GLenum pixelFormat, GLenum dataType )
     return getWriter(pixelFormat, dataType) != 0L;
 }
 
+//------------------------------------------------------------------------
+
+// Specialized kernels for BilinearResampler. Each one reproduces the
+// arithmetic of the generic PixelReader/PixelWriter path: texels decode to
+// float with the reader's scale, interpolation runs in float in the same
+// order of operations, and values encode with the writer's double-precision
+// divide and truncation. The output is therefore identical to the generic
+// path; the savings come from skipping the per-texel reader/writer dispatch.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define OE_RESAMPLE_SSE2
+#   include <emmintrin.h>
+#   if defined(_MSC_VER) && (_MSC_VER >= 1800)
+#       define OE_RESAMPLE_AVX2
+#       define OE_TARGET_AVX2
+#       include <immintrin.h>
+#       include <intrin.h>
+#   elif defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#       define OE_RESAMPLE_AVX2
+#       define OE_TARGET_AVX2 __attribute__((target("avx2")))
+#       include <immintrin.h>
+#   endif
+#endif
+
+namespace
+{
+    enum TapMode
+    {
+        TAP_EXACT,
+        TAP_VERTICAL,
+        TAP_HORIZONTAL,
+        TAP_BILINEAR
+    };
+
+    // Source texels and weights for one sample point.
+    struct Tap
+    {
+        int   colMin, colMax, rowMin, rowMax;
+        int   mode;
+        float w[4]; // colMax-s, s-colMin, rowMax-t, t-rowMin
+    };
+
+    inline void computeTap(float s, float t, int maxS, int maxT, Tap& tap)
+    {
+        tap.rowMin = osg::maximum((int)floor(t), 0);
+        tap.rowMax = osg::maximum(osg::minimum((int)ceil(t), maxT), 0);
+        tap.colMin = osg::maximum((int)floor(s), 0);
+        tap.colMax = osg::maximum(osg::minimum((int)ceil(s), maxS), 0);
+
+        if (tap.rowMin > tap.rowMax) tap.rowMin = tap.rowMax;
+        if (tap.colMin > tap.colMax) tap.colMin = tap.colMax;
+
+        tap.mode =
+            tap.colMax == tap.colMin && tap.rowMax == tap.rowMin ? TAP_EXACT :
+            tap.colMax == tap.colMin ? TAP_VERTICAL :
+            tap.rowMax == tap.rowMin ? TAP_HORIZONTAL :
+            TAP_BILINEAR;
+
+        tap.w[0] = (float)tap.colMax - s;
+        tap.w[1] = s - (float)tap.colMin;
+        tap.w[2] = (float)tap.rowMax - t;
+        tap.w[3] = t - (float)tap.rowMin;
+    }
+
+    inline float interpolate(const Tap& tap, float ll, float lr, float ul, float ur)
+    {
+        switch( tap.mode )
+        {
+        case TAP_EXACT:
+            return ur;
+        case TAP_VERTICAL:
+            return tap.w[2]*ll + tap.w[3]*ul;
+        case TAP_HORIZONTAL:
+            return tap.w[0]*ll + tap.w[1]*lr;
+        default:
+            {
+                float r1 = tap.w[0]*ll + tap.w[1]*lr;
+                float r2 = tap.w[0]*ul + tap.w[1]*ur;
+                return tap.w[2]*r1 + tap.w[3]*r2;
+            }
+        }
+    }
+
+    inline float texelFloat(const unsigned char* src, unsigned rowBytes, int col, int row)
+    {
+        return *(const float*)(src + col*sizeof(float) + row*rowBytes);
+    }
+
+    // N-channel unsigned byte images (RGB, RGBA, BGR, BGRA)
+    template<unsigned N>
+    void resampleUByte(const ImageUtils::BilinearResampler* rs,
+                       const float* s, const float* t, unsigned count,
+                       const unsigned char* src, unsigned char* dest, int destStep)
+    {
+        const unsigned rowBytes = rs->_read._rowMult;
+        const float*   lut      = rs->_decode;
+        Tap tap;
+
+        for(unsigned i=0; i<count; ++i, dest += destStep)
+        {
+            computeTap(s[i], t[i], rs->_maxS, rs->_maxT, tap);
+
+            const unsigned char* ll = src + tap.colMin*N + tap.rowMin*rowBytes;
+            const unsigned char* lr = src + tap.colMax*N + tap.rowMin*rowBytes;
+            const unsigned char* ul = src + tap.colMin*N + tap.rowMax*rowBytes;
+            const unsigned char* ur = src + tap.colMax*N + tap.rowMax*rowBytes;
+
+            for(unsigned c=0; c<N; ++c)
+            {
+                float v = interpolate(tap, lut[ll[c]], lut[lr[c]], lut[ul[c]], lut[ur[c]]);
+                dest[c] = (GLubyte)(v / rs->_encodeScale);
+            }
+        }
+    }
+
+    // Single channel float images (GL_LUMINANCE/GL_FLOAT)
+    void resampleFloat(const ImageUtils::BilinearResampler* rs,
+                       const float* s, const float* t, unsigned count,
+                       const unsigned char* src, unsigned char* dest, int destStep)
+    {
+        const unsigned rowBytes = rs->_read._rowMult;
+        Tap tap;
+
+        for(unsigned i=0; i<count; ++i, dest += destStep)
+        {
+            computeTap(s[i], t[i], rs->_maxS, rs->_maxT, tap);
+
+            float v = interpolate(tap,
+                texelFloat(src, rowBytes, tap.colMin, tap.rowMin),
+                texelFloat(src, rowBytes, tap.colMax, tap.rowMin),
+                texelFloat(src, rowBytes, tap.colMin, tap.rowMax),
+                texelFloat(src, rowBytes, tap.colMax, tap.rowMax));
+
+            *(GLfloat*)dest = (GLfloat)(v / rs->_encodeScale);
+        }
+    }
+
+#ifdef OE_RESAMPLE_SSE2
+
+    template<unsigned N>
+    inline __m128 decode_SSE2(const float* lut, const unsigned char* p)
+    {
+        return _mm_setr_ps(lut[p[0]], lut[p[1]], lut[p[2]], N > 3 ? lut[p[3]] : 0.0f);
+    }
+
+    // Same operations as interpolate(), one channel per lane.
+    inline __m128 interpolate_SSE2(const Tap& tap, __m128 ll, __m128 lr, __m128 ul, __m128 ur)
+    {
+        switch( tap.mode )
+        {
+        case TAP_EXACT:
+            return ur;
+        case TAP_VERTICAL:
+            return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tap.w[2]), ll), _mm_mul_ps(_mm_set1_ps(tap.w[3]), ul));
+        case TAP_HORIZONTAL:
+            return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tap.w[0]), ll), _mm_mul_ps(_mm_set1_ps(tap.w[1]), lr));
+        default:
+            {
+                __m128 c0 = _mm_set1_ps(tap.w[0]);
+                __m128 c1 = _mm_set1_ps(tap.w[1]);
+                __m128 r1 = _mm_add_ps(_mm_mul_ps(c0, ll), _mm_mul_ps(c1, lr));
+                __m128 r2 = _mm_add_ps(_mm_mul_ps(c0, ul), _mm_mul_ps(c1, ur));
+                return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tap.w[2]), r1), _mm_mul_ps(_mm_set1_ps(tap.w[3]), r2));
+            }
+        }
+    }
+
+    // (GLubyte)(v / scale) for each lane, packed into the low 4 bytes.
+    inline int encode_SSE2(__m128 v, __m128d scale)
+    {
+        __m128d lo = _mm_div_pd(_mm_cvtps_pd(v), scale);
+        __m128d hi = _mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), scale);
+        __m128i i = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+        i = _mm_packs_epi32(i, i);
+        i = _mm_packus_epi16(i, i);
+        return _mm_cvtsi128_si32(i);
+    }
+
+    template<unsigned N>
+    void resampleUByte_SSE2(const ImageUtils::BilinearResampler* rs,
+                            const float* s, const float* t, unsigned count,
+                            const unsigned char* src, unsigned char* dest, int destStep)
+    {
+        const unsigned rowBytes = rs->_read._rowMult;
+        const float*   lut      = rs->_decode;
+        const __m128d  scale    = _mm_set1_pd(rs->_encodeScale);
+        Tap tap;
+
+        for(unsigned i=0; i<count; ++i, dest += destStep)
+        {
+            computeTap(s[i], t[i], rs->_maxS, rs->_maxT, tap);
+
+            __m128 v = interpolate_SSE2(tap,
+                decode_SSE2<N>(lut, src + tap.colMin*N + tap.rowMin*rowBytes),
+                decode_SSE2<N>(lut, src + tap.colMax*N + tap.rowMin*rowBytes),
+                decode_SSE2<N>(lut, src + tap.colMin*N + tap.rowMax*rowBytes),
+                decode_SSE2<N>(lut, src + tap.colMax*N + tap.rowMax*rowBytes));
+
+            int packed = encode_SSE2(v, scale);
+            memcpy(dest, &packed, N);
+        }
+    }
+
+    inline __m128 select_SSE2(__m128i modes, int mode, __m128 ifTrue, __m128 ifFalse)
+    {
+        __m128 mask = _mm_castsi128_ps(_mm_cmpeq_epi32(modes, _mm_set1_epi32(mode)));
+        return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+    }
+
+    // Four samples at a time, one per lane.
+    void resampleFloat_SSE2(const ImageUtils::BilinearResampler* rs,
+                            const float* s, const float* t, unsigned count,
+                            const unsigned char* src, unsigned char* dest, int destStep)
+    {
+        const unsigned rowBytes = rs->_read._rowMult;
+        Tap tap[4];
+        float ll[4], lr[4], ul[4], ur[4], w[4][4], out[4];
+        int modes[4];
+
+        unsigned i = 0;
+        for( ; i+4 <= count; i += 4)
+        {
+            for(unsigned k=0; k<4; ++k)
+            {
+                computeTap(s[i+k], t[i+k], rs->_maxS, rs->_maxT, tap[k]);
+                ll[k] = texelFloat(src, rowBytes, tap[k].colMin, tap[k].rowMin);
+                lr[k] = texelFloat(src, rowBytes, tap[k].colMax, tap[k].rowMin);
+                ul[k] = texelFloat(src, rowBytes, tap[k].colMin, tap[k].rowMax);
+                ur[k] = texelFloat(src, rowBytes, tap[k].colMax, tap[k].rowMax);
+                for(unsigned j=0; j<4; ++j)
+                    w[j][k] = tap[k].w[j];
+                modes[k] = tap[k].mode;
+            }
+
+            __m128 LL = _mm_loadu_ps(ll), LR = _mm_loadu_ps(lr);
+            __m128 UL = _mm_loadu_ps(ul), UR = _mm_loadu_ps(ur);
+            __m128 c0 = _mm_loadu_ps(w[0]), c1 = _mm_loadu_ps(w[1]);
+            __m128 r0 = _mm_loadu_ps(w[2]), r1 = _mm_loadu_ps(w[3]);
+
+            __m128 horiz = _mm_add_ps(_mm_mul_ps(c0, LL), _mm_mul_ps(c1, LR));
+            __m128 vert  = _mm_add_ps(_mm_mul_ps(r0, LL), _mm_mul_ps(r1, UL));
+            __m128 upper = _mm_add_ps(_mm_mul_ps(c0, UL), _mm_mul_ps(c1, UR));
+            __m128 bilin = _mm_add_ps(_mm_mul_ps(r0, horiz), _mm_mul_ps(r1, upper));
+
+            __m128i m = _mm_loadu_si128((const __m128i*)modes);
+            __m128 v = select_SSE2(m, TAP_HORIZONTAL, horiz, bilin);
+            v = select_SSE2(m, TAP_VERTICAL, vert, v);
+            v = select_SSE2(m, TAP_EXACT, UR, v);
+            _mm_storeu_ps(out, v);
+
+            for(unsigned k=0; k<4; ++k, dest += destStep)
+                *(GLfloat*)dest = (GLfloat)(out[k] / rs->_encodeScale);
+        }
+
+        if ( i < count )
+        {
+            resampleFloat(rs, s+i, t+i, count-i, src, dest, destStep);
+        }
+    }
+
+#endif // OE_RESAMPLE_SSE2
+
+#ifdef OE_RESAMPLE_AVX2
+
+    template<unsigned N> OE_TARGET_AVX2
+    inline __m128 decode_AVX2(const float* lut, const unsigned char* p)
+    {
+        int bytes = 0;
+        memcpy(&bytes, p, N);
+        return _mm_i32gather_ps(lut, _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)), 4);
+    }
+
+    OE_TARGET_AVX2
+    inline int encode_AVX2(__m128 v, __m256d scale)
+    {
+        __m128i i = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtps_pd(v), scale));
+        i = _mm_packs_epi32(i, i);
+        i = _mm_packus_epi16(i, i);
+        return _mm_cvtsi128_si32(i);
+    }
+
+    template<unsigned N> OE_TARGET_AVX2
+    void resampleUByte_AVX2(const ImageUtils::BilinearResampler* rs,
+                            const float* s, const float* t, unsigned count,
+                            const unsigned char* src, unsigned char* dest, int destStep)
+    {
+        const unsigned rowBytes = rs->_read._rowMult;
+        const float*   lut      = rs->_decode;
+        const __m256d  scale    = _mm256_set1_pd(rs->_encodeScale);
+        Tap tap;
+
+        for(unsigned i=0; i<count; ++i, dest += destStep)
+        {
+            computeTap(s[i], t[i], rs->_maxS, rs->_maxT, tap);
+
+            __m128 v = interpolate_SSE2(tap,
+                decode_AVX2<N>(lut, src + tap.colMin*N + tap.rowMin*rowBytes),
+                decode_AVX2<N>(lut, src + tap.colMax*N + tap.rowMin*rowBytes),
+                decode_AVX2<N>(lut, src + tap.colMin*N + tap.rowMax*rowBytes),
+                decode_AVX2<N>(lut, src + tap.colMax*N + tap.rowMax*rowBytes));
+
+            int packed = encode_AVX2(v, scale);
+            memcpy(dest, &packed, N);
+        }
+    }
+
+    OE_TARGET_AVX2
+    inline __m256 select_AVX2(__m256i modes, int mode, __m256 ifTrue, __m256 ifFalse)
+    {
+        __m256 mask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(modes, _mm256_set1_epi32(mode)));
+        return _mm256_blendv_ps(ifFalse, ifTrue, mask);
+    }
+
+    // Eight samples at a time, gathering the texels by byte offset.
+    OE_TARGET_AVX2
+    void resampleFloat_AVX2(const ImageUtils::BilinearResampler* rs,
+                            const float* s, const float* t, unsigned count,
+                            const unsigned char* src, unsigned char* dest, int destStep)
+    {
+        const unsigned rowBytes = rs->_read._rowMult;
+        const float* base = (const float*)src;
+        Tap tap;
+        int ll[8], lr[8], ul[8], ur[8], modes[8];
+        float w[4][8], out[8];
+
+        unsigned i = 0;
+        for( ; i+8 <= count; i += 8)
+        {
+            for(unsigned k=0; k<8; ++k)
+            {
+                computeTap(s[i+k], t[i+k], rs->_maxS, rs->_maxT, tap);
+                ll[k] = tap.colMin*sizeof(float) + tap.rowMin*rowBytes;
+                lr[k] = tap.colMax*sizeof(float) + tap.rowMin*rowBytes;
+                ul[k] = tap.colMin*sizeof(float) + tap.rowMax*rowBytes;
+                ur[k] = tap.colMax*sizeof(float) + tap.rowMax*rowBytes;
+                for(unsigned j=0; j<4; ++j)
+                    w[j][k] = tap.w[j];
+                modes[k] = tap.mode;
+            }
+
+            __m256 LL = _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)ll), 1);
+            __m256 LR = _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)lr), 1);
+            __m256 UL = _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)ul), 1);
+            __m256 UR = _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)ur), 1);
+            __m256 c0 = _mm256_loadu_ps(w[0]), c1 = _mm256_loadu_ps(w[1]);
+            __m256 r0 = _mm256_loadu_ps(w[2]), r1 = _mm256_loadu_ps(w[3]);
+
+            __m256 horiz = _mm256_add_ps(_mm256_mul_ps(c0, LL), _mm256_mul_ps(c1, LR));
+            __m256 vert  = _mm256_add_ps(_mm256_mul_ps(r0, LL), _mm256_mul_ps(r1, UL));
+            __m256 upper = _mm256_add_ps(_mm256_mul_ps(c0, UL), _mm256_mul_ps(c1, UR));
+            __m256 bilin = _mm256_add_ps(_mm256_mul_ps(r0, horiz), _mm256_mul_ps(r1, upper));
+
+            __m256i m = _mm256_loadu_si256((const __m256i*)modes);
+            __m256 v = select_AVX2(m, TAP_HORIZONTAL, horiz, bilin);
+            v = select_AVX2(m, TAP_VERTICAL, vert, v);
+            v = select_AVX2(m, TAP_EXACT, UR, v);
+            _mm256_storeu_ps(out, v);
+
+            for(unsigned k=0; k<8; ++k, dest += destStep)
+                *(GLfloat*)dest = (GLfloat)(out[k] / rs->_encodeScale);
+        }
+
+        if ( i < count )
+        {
+            resampleFloat(rs, s+i, t+i, count-i, src, dest, destStep);
+        }
+    }
+
+#endif // OE_RESAMPLE_AVX2
+
+    enum SIMDLevel
+    {
+        SIMD_NONE,
+        SIMD_SSE2,
+        SIMD_AVX2
+    };
+
+    // Best instruction set available at runtime. Set OSGEARTH_NO_SIMD
+    // to force the scalar kernels.
+    SIMDLevel detectSIMD()
+    {
+        if ( ::getenv("OSGEARTH_NO_SIMD") )
+            return SIMD_NONE;
+
+#if defined(OE_RESAMPLE_AVX2)
+#   if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if ( info[0] >= 7 )
+        {
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1<<27)) != 0;
+            bool avx     = (info[2] & (1<<28)) != 0;
+            // the OS must also save the YMM registers:
+            if ( osxsave && avx && (_xgetbv(0) & 0x6) == 0x6 )
+            {
+                __cpuidex(info, 7, 0);
+                if ( (info[1] & (1<<5)) != 0 )
+                    return SIMD_AVX2;
+            }
+        }
+#   else
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports("avx2") )
+            return SIMD_AVX2;
+#   endif
+#endif
+
+#if defined(OE_RESAMPLE_SSE2)
+        return SIMD_SSE2;
+#else
+        return SIMD_NONE;
+#endif
+    }
+
+    SIMDLevel getSIMDLevel()
+    {
+        static SIMDLevel s_level = detectSIMD();
+        return s_level;
+    }
+
+    // Best instruction set to use, at most the one "maxKernel" asks for.
+    SIMDLevel getSIMDLevel(ImageUtils::BilinearResampler::Kernel maxKernel)
+    {
+        SIMDLevel level = getSIMDLevel();
+        if ( maxKernel <= ImageUtils::BilinearResampler::KERNEL_SCALAR )
+            return SIMD_NONE;
+        if ( maxKernel == ImageUtils::BilinearResampler::KERNEL_SSE2 && level > SIMD_SSE2 )
+            return SIMD_SSE2;
+        return level;
+    }
+
+    template<unsigned N>
+    void chooseUByteKernel(SIMDLevel level, ImageUtils::BilinearResampler::KernelFunc& kernel, const char*& name)
+    {
+        switch( level )
+        {
+#ifdef OE_RESAMPLE_AVX2
+        case SIMD_AVX2:
+            kernel = &resampleUByte_AVX2<N>;
+            name = N == 4 ? "ubyte4/avx2" : "ubyte3/avx2";
+            break;
+#endif
+#ifdef OE_RESAMPLE_SSE2
+        case SIMD_SSE2:
+            kernel = &resampleUByte_SSE2<N>;
+            name = N == 4 ? "ubyte4/sse2" : "ubyte3/sse2";
+            break;
+#endif
+        default:
+            kernel = &resampleUByte<N>;
+            name = N == 4 ? "ubyte4" : "ubyte3";
+        }
+    }
+
+    void chooseFloatKernel(SIMDLevel level, ImageUtils::BilinearResampler::KernelFunc& kernel, const char*& name)
+    {
+        switch( level )
+        {
+#ifdef OE_RESAMPLE_AVX2
+        case SIMD_AVX2:
+            kernel = &resampleFloat_AVX2;
+            name = "float1/avx2";
+            break;
+#endif
+#ifdef OE_RESAMPLE_SSE2
+        case SIMD_SSE2:
+            kernel = &resampleFloat_SSE2;
+            name = "float1/sse2";
+            break;
+#endif
+        default:
+            kernel = &resampleFloat;
+            name = "float1";
+        }
+    }
+}
+
+ImageUtils::BilinearResampler::BilinearResampler(const osg::Image* src, osg::Image* dest, Kernel maxKernel) :
+_read       ( src ),
+_write      ( dest ),
+_kernel     ( 0L ),
+_kernelName ( "generic" ),
+_encodeScale( 1.0 )
+{
+    _maxS = src->s()-1;
+    _maxT = src->t()-1;
+
+    // kernels copy channels straight across, so the formats must match.
+    GLenum format = src->getPixelFormat();
+    GLenum type   = src->getDataType();
+    if ( format != dest->getPixelFormat() || type != dest->getDataType() )
+        return;
+
+    if ( maxKernel == KERNEL_GENERIC )
+        return;
+
+    SIMDLevel level = getSIMDLevel( maxKernel );
+
+    if ( type == GL_UNSIGNED_BYTE &&
+         (format == GL_RGBA || format == GL_BGRA || format == GL_RGB || format == GL_BGR) )
+    {
+        // decode exactly as ColorReader does:
+        double scale = GLTypeTraits<GLubyte>::scale(_read._normalized);
+        for(unsigned i=0; i<256; ++i)
+            _decode[i] = float((GLubyte)i) * scale;
+
+        _encodeScale = GLTypeTraits<GLubyte>::scale(_write._normalized);
+
+        if ( format == GL_RGBA || format == GL_BGRA )
+            chooseUByteKernel<4>( level, _kernel, _kernelName );
+        else
+            chooseUByteKernel<3>( level, _kernel, _kernelName );
+    }
+
+    else if ( type == GL_FLOAT && format == GL_LUMINANCE )
+    {
+        _encodeScale = GLTypeTraits<GLfloat>::scale(_write._normalized);
+        chooseFloatKernel( level, _kernel, _kernelName );
+    }
+}
+
+void
+ImageUtils::BilinearResampler::operator()(const float* s, const float* t, unsigned count,
+                                          int destS, int destT, int stepS, int stepT,
+                                          int srcLayer, int destLayer, int destMipmap)
+{
+    if ( count == 0 )
+        return;
+
+    if ( _kernel )
+    {
+        const unsigned char* src  = _read.data(0, 0, srcLayer);
+        unsigned char*       dest = _write.data(destS, destT, destLayer, destMipmap);
+        int destStep = stepS*(int)_write._colMult + stepT*(int)(_write._rowMult >> destMipmap);
+        _kernel( this, s, t, count, src, dest, destStep );
+        return;
+    }
+
+    // generic path for all other formats:
+    Tap tap;
+    for(unsigned i=0; i<count; ++i)
+    {
+        computeTap(s[i], t[i], _maxS, _maxT, tap);
+
+        osg::Vec4 ur = _read(tap.colMax, tap.rowMax, srcLayer);
+        osg::Vec4 color = ur;
+
+        if ( tap.mode != TAP_EXACT )
+        {
+            osg::Vec4 ll = _read(tap.colMin, tap.rowMin, srcLayer);
+            osg::Vec4 lr = _read(tap.colMax, tap.rowMin, srcLayer);
+            osg::Vec4 ul = _read(tap.colMin, tap.rowMax, srcLayer);
+            for(unsigned c=0; c<4; ++c)
+                color[c] = interpolate(tap, ll[c], lr[c], ul[c], ur[c]);
+        }
+
+        _write( color, destS + (int)i*stepS, destT + (int)i*stepT, destLayer, destMipmap );
+    }
+}
+
 TextureAndImageVisitor::TextureAndImageVisitor() :
 osg::NodeVisitor()
 {
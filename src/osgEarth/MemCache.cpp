@@ -20,6 +20,7 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/Containers>
+#include <osg/Shape>
 
 using namespace osgEarth;
 
@@ -30,13 +31,43 @@ using namespace osgEarth;
 namespace
 {
     typedef std::pair<osg::ref_ptr<const osg::Object>, Config> MemCacheEntry;
-    typedef LRUCache<std::string, MemCacheEntry> MemCacheLRU;
+
+    struct HashKey {
+        unsigned operator()(const std::string& key) const { return osgEarth::hashString(key); }
+    };
+
+    typedef ShardedLRUCache<std::string, MemCacheEntry, HashKey> MemCacheLRU;
+
+    // Pick a stripe count that still leaves a few entries per stripe.
+    unsigned numShardsFor(unsigned maxSize)
+    {
+        return osg::clampBetween(maxSize/4u, 1u, 8u);
+    }
+
+    // Approximate memory footprint of a cached object, for the byte budget.
+    unsigned sizeOf(const osg::Object* object)
+    {
+        const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+        if ( image )
+            return image->getTotalSizeInBytes();
+
+        const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+        if ( hf )
+            return hf->getFloatArray() ? hf->getFloatArray()->getTotalDataSize() : 0u;
+
+        const StringObject* str = dynamic_cast<const StringObject*>(object);
+        if ( str )
+            return str->getString().size();
+
+        return 0u;
+    }
 
     struct MemCacheBin : public CacheBin
     {
-        MemCacheBin( const std::string& id, unsigned maxSize )
-            : CacheBin( id ),
-              _lru    ( true /* MT-safe */, maxSize )
+        MemCacheBin( const std::string& id, unsigned maxSize, unsigned maxBytes, bool shareObjects )
+            : CacheBin     ( id ),
+              _lru         ( numShardsFor(maxSize), maxSize, maxBytes ),
+              _shareObjects( shareObjects )
         {
             //nop
         }
@@ -46,12 +77,20 @@ namespace
             MemCacheLRU::Record rec;
             _lru.get(key, rec);
 
-            // clone required since the cache is in memory
-
             if ( rec.valid() )
             {
                 //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
 
+                // In sharing mode, hand out the cached object itself; the caller
+                // must treat it as read-only and copy it before making changes.
+                if ( _shareObjects )
+                {
+                    return ReadResult(
+                        const_cast<osg::Object*>(rec.value().first.get()),
+                        rec.value().second );
+                }
+
+                // otherwise clone, since the cache is in memory
                 return ReadResult( 
                    osg::clone(rec.value().first.get(), osg::CopyOp::DEEP_COPY_ALL),
                    rec.value().second );
@@ -77,7 +116,7 @@ namespace
         {
             if ( object ) 
             {
-                _lru.insert( key, std::make_pair(object, meta) );
+                _lru.insert( key, std::make_pair(object, meta), sizeOf(object) );
                 return true;
             }
             else
@@ -115,6 +154,7 @@ namespace
         }
 
         MemCacheLRU _lru;
+        bool        _shareObjects;
     };
     
 
@@ -123,8 +163,10 @@ namespace
 
 //------------------------------------------------------------------------
 
-MemCache::MemCache( unsigned maxBinSize ) :
+MemCache::MemCache( unsigned maxBinSize, unsigned maxBinBytes ) :
 _maxBinSize( std::max(maxBinSize, 1u) ),
+_maxBinBytes( maxBinBytes ),
+_shareObjects( false ),
 _reads(0),
 _writes(0),
 _hits(0)
@@ -135,7 +177,7 @@ _hits(0)
 CacheBin*
 MemCache::addBin( const std::string& binID )
 {
-    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize) );
+    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize, _maxBinBytes, _shareObjects) );
 }
 
 CacheBin*
@@ -156,7 +198,7 @@ MemCache::getOrCreateDefaultBin()
         // double check
         if ( !_defaultBin.valid() )
         {
-            _defaultBin = new MemCacheBin("__default", _maxBinSize);
+            _defaultBin = new MemCacheBin("__default", _maxBinSize, _maxBinBytes, _shareObjects);
         }
     }
 
@@ -164,10 +206,21 @@ MemCache::getOrCreateDefaultBin()
 }
 
 
+CacheStats
+MemCache::getBinStats(const std::string& binID)
+{
+    MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
+    return bin ? bin->_lru.getStats() : CacheStats(0, _maxBinSize, 0, 0.0f);
+}
+
 void
 MemCache::dumpStats(const std::string& binID)
 {
-    MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
-    CacheStats stats = bin->_lru.getStats();
-    OE_INFO << LC << "hit ratio = " << stats._hitRatio << std::endl;
+    CacheStats stats = getBinStats(binID);
+    OE_INFO << LC 
+        << "hit ratio = " << stats._hitRatio
+        << ", hits = " << stats._hits
+        << ", misses = " << stats._misses
+        << ", evictions = " << stats._evictions
+        << ", bytes = " << stats._bytes << std::endl;
 }
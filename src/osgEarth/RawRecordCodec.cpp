@@ -0,0 +1,441 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/RawRecordCodec>
+#include <osgEarth/Notify>
+#include <osg/Image>
+#include <osg/Math>
+#include <osg/Shape>
+#include <osg/Types>
+#include <string.h>
+
+#ifdef OSGEARTH_HAVE_LZ4
+#   include <lz4.h>
+#endif
+#ifdef OSGEARTH_HAVE_ZSTD
+#   include <zstd.h>
+#endif
+#ifdef OSGEARTH_HAVE_ZLIB
+#   include <zlib.h>
+#endif
+
+#define LC "[RawRecordCodec] "
+
+using namespace osgEarth;
+
+namespace
+{
+    typedef CacheOptions::RecordCompression Compression;
+
+    const char    RECORD_MAGIC[4] = { 'O', 'E', 'R', 'R' };
+    const uint8_t RECORD_VERSION  = 1;
+
+    enum RecordType
+    {
+        TYPE_IMAGE       = 1,
+        TYPE_HEIGHTFIELD = 2
+    };
+
+    // Fixed record header. The object name follows it, then the payload.
+    struct Header
+    {
+        char     magic[4];
+        uint8_t  version;
+        uint8_t  type;
+        uint8_t  compression;   // actual method used; may be NONE if compressing didn't pay off
+        uint8_t  reserved0;
+        uint32_t nameLength;
+        uint32_t rawLength;     // uncompressed payload size
+        uint32_t payloadLength; // stored payload size
+        int32_t  s, t, r;       // image dimensions, or heightfield columns/rows/1
+        int32_t  internalFormat;
+        uint32_t pixelFormat;
+        uint32_t dataType;
+        uint32_t packing;
+        int32_t  rowLength;
+        uint32_t origin;        // osg::Image::Origin
+        uint32_t borderWidth;   // heightfield only
+        uint32_t reserved1;
+        double   extents[6];    // heightfield origin x/y/z, x/y interval, skirt height
+    };
+
+    typedef char HeaderSizeCheck[sizeof(Header) == 112 ? 1 : -1];
+
+    size_t compressBound(Compression c, size_t len)
+    {
+        switch(c)
+        {
+#ifdef OSGEARTH_HAVE_LZ4
+        case CacheOptions::RECORD_COMPRESSION_LZ4:
+            return (size_t)LZ4_compressBound((int)len);
+#endif
+#ifdef OSGEARTH_HAVE_ZSTD
+        case CacheOptions::RECORD_COMPRESSION_ZSTD:
+            return ZSTD_compressBound(len);
+#endif
+#ifdef OSGEARTH_HAVE_ZLIB
+        case CacheOptions::RECORD_COMPRESSION_ZLIB:
+            return (size_t)::compressBound((uLong)len);
+#endif
+        default:
+            return len;
+        }
+    }
+
+    bool compress(Compression c, const char* src, size_t len, char* dst, size_t capacity, size_t& out_len)
+    {
+        switch(c)
+        {
+#ifdef OSGEARTH_HAVE_LZ4
+        case CacheOptions::RECORD_COMPRESSION_LZ4:
+            {
+                int n = LZ4_compress_default(src, dst, (int)len, (int)capacity);
+                out_len = (size_t)n;
+                return n > 0;
+            }
+#endif
+#ifdef OSGEARTH_HAVE_ZSTD
+        case CacheOptions::RECORD_COMPRESSION_ZSTD:
+            {
+                size_t n = ZSTD_compress(dst, capacity, src, len, 3);
+                out_len = n;
+                return !ZSTD_isError(n);
+            }
+#endif
+#ifdef OSGEARTH_HAVE_ZLIB
+        case CacheOptions::RECORD_COMPRESSION_ZLIB:
+            {
+                uLongf n = (uLongf)capacity;
+                int rc = ::compress2((Bytef*)dst, &n, (const Bytef*)src, (uLong)len, Z_DEFAULT_COMPRESSION);
+                out_len = (size_t)n;
+                return rc == Z_OK;
+            }
+#endif
+        default:
+            return false;
+        }
+    }
+
+    bool decompress(Compression c, const char* src, size_t len, char* dst, size_t rawLength)
+    {
+        switch(c)
+        {
+        case CacheOptions::RECORD_COMPRESSION_NONE:
+            if ( len != rawLength )
+                return false;
+            ::memcpy(dst, src, len);
+            return true;
+#ifdef OSGEARTH_HAVE_LZ4
+        case CacheOptions::RECORD_COMPRESSION_LZ4:
+            return LZ4_decompress_safe(src, dst, (int)len, (int)rawLength) == (int)rawLength;
+#endif
+#ifdef OSGEARTH_HAVE_ZSTD
+        case CacheOptions::RECORD_COMPRESSION_ZSTD:
+            return ZSTD_decompress(dst, rawLength, src, len) == rawLength;
+#endif
+#ifdef OSGEARTH_HAVE_ZLIB
+        case CacheOptions::RECORD_COMPRESSION_ZLIB:
+            {
+                uLongf n = (uLongf)rawLength;
+                return
+                    ::uncompress((Bytef*)dst, &n, (const Bytef*)src, (uLong)len) == Z_OK &&
+                    n == (uLongf)rawLength;
+            }
+#endif
+        default:
+            return false;
+        }
+    }
+
+    // Lower bound on the size of the image a header describes, in floating
+    // point so that a corrupt header can't overflow it. (osg::Image may round
+    // rows and compressed blocks up from this, never down.)
+    double minImageSizeInBytes(const Header& h)
+    {
+        double width     = (double)(h.rowLength > 0 ? h.rowLength : h.s);
+        double pixelBits = (double)osg::Image::computePixelSizeInBits( h.pixelFormat, h.dataType );
+        return width * (double)h.t * (double)h.r * pixelBits / 8.0;
+    }
+
+    const char* compressionName(Compression c)
+    {
+        return
+            c == CacheOptions::RECORD_COMPRESSION_LZ4  ? "lz4"  :
+            c == CacheOptions::RECORD_COMPRESSION_ZSTD ? "zstd" :
+            c == CacheOptions::RECORD_COMPRESSION_ZLIB ? "zlib" :
+            "none";
+    }
+}
+
+//------------------------------------------------------------------------
+
+RawRecordCodec*
+RawRecordCodec::create(const CacheOptions& options)
+{
+    if ( options.recordFormat() != CacheOptions::RECORD_FORMAT_RAW )
+        return 0L;
+
+    return new RawRecordCodec( options.recordCompression().get() );
+}
+
+RawRecordCodec::RawRecordCodec(CacheOptions::RecordCompression compression) :
+_compression( compression )
+{
+    if ( !isSupported(_compression) )
+    {
+        OE_WARN << LC << "Compression \"" << compressionName(_compression)
+            << "\" is not available in this build; raw records will be stored uncompressed" << std::endl;
+        _compression = CacheOptions::RECORD_COMPRESSION_NONE;
+    }
+}
+
+bool
+RawRecordCodec::isSupported(CacheOptions::RecordCompression compression)
+{
+    switch(compression)
+    {
+    case CacheOptions::RECORD_COMPRESSION_NONE:
+        return true;
+#ifdef OSGEARTH_HAVE_LZ4
+    case CacheOptions::RECORD_COMPRESSION_LZ4:
+        return true;
+#endif
+#ifdef OSGEARTH_HAVE_ZSTD
+    case CacheOptions::RECORD_COMPRESSION_ZSTD:
+        return true;
+#endif
+#ifdef OSGEARTH_HAVE_ZLIB
+    case CacheOptions::RECORD_COMPRESSION_ZLIB:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+bool
+RawRecordCodec::isRecord(const char* data, size_t length)
+{
+    return
+        data != 0L &&
+        length >= sizeof(Header) &&
+        ::memcmp(data, RECORD_MAGIC, sizeof(RECORD_MAGIC)) == 0;
+}
+
+bool
+RawRecordCodec::encode(const osg::Object* object, std::string& out) const
+{
+    Header h;
+    ::memset(&h, 0, sizeof(Header));
+    ::memcpy(h.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    h.version = RECORD_VERSION;
+
+    const char* payload   = 0L;
+    uint64_t    rawLength = 0u;
+
+    const osg::Image*       image = dynamic_cast<const osg::Image*>(object);
+    const osg::HeightField* hf    = image ? 0L : dynamic_cast<const osg::HeightField*>(object);
+
+    if ( image )
+    {
+        // mipmaps and user data only survive the osgb serializer.
+        if ( !image->data() || image->isMipmap() || image->getUserDataContainer() )
+            return false;
+
+        h.type           = TYPE_IMAGE;
+        h.s              = image->s();
+        h.t              = image->t();
+        h.r              = image->r();
+        h.internalFormat = image->getInternalTextureFormat();
+        h.pixelFormat    = image->getPixelFormat();
+        h.dataType       = image->getDataType();
+        h.packing        = image->getPacking();
+        h.rowLength      = image->getRowLength();
+        h.origin         = (uint32_t)image->getOrigin();
+
+        payload   = (const char*)image->data();
+        rawLength = image->getTotalSizeInBytes();
+    }
+    else if ( hf )
+    {
+        const osg::FloatArray* heights = hf->getFloatArray();
+        uint64_t numHeights = (uint64_t)hf->getNumColumns() * (uint64_t)hf->getNumRows();
+
+        if ( !heights || heights->empty() || heights->size() < numHeights ||
+             !hf->getRotation().zeroRotation() || hf->getUserDataContainer() )
+            return false;
+
+        h.type        = TYPE_HEIGHTFIELD;
+        h.s           = hf->getNumColumns();
+        h.t           = hf->getNumRows();
+        h.r           = 1;
+        h.borderWidth = hf->getBorderWidth();
+        h.extents[0]  = hf->getOrigin().x();
+        h.extents[1]  = hf->getOrigin().y();
+        h.extents[2]  = hf->getOrigin().z();
+        h.extents[3]  = hf->getXInterval();
+        h.extents[4]  = hf->getYInterval();
+        h.extents[5]  = hf->getSkirtHeight();
+
+        payload   = (const char*)&heights->front();
+        rawLength = numHeights * sizeof(float);
+    }
+    else
+    {
+        return false;
+    }
+
+    if ( rawLength == 0u || rawLength > 0xffffffffu )
+        return false;
+
+    const std::string& name = object->getName();
+    h.nameLength = name.size();
+    h.rawLength  = (uint32_t)rawLength;
+
+    size_t prefix   = sizeof(Header) + name.size();
+    size_t capacity = osg::maximum( compressBound(_compression, (size_t)rawLength), (size_t)rawLength );
+    out.resize( prefix + capacity );
+    char* dst = &out[prefix];
+
+    size_t payloadLength = 0u;
+    h.compression = CacheOptions::RECORD_COMPRESSION_NONE;
+
+    if ( _compression != CacheOptions::RECORD_COMPRESSION_NONE &&
+         compress(_compression, payload, (size_t)rawLength, dst, capacity, payloadLength) &&
+         payloadLength < rawLength )
+    {
+        h.compression = (uint8_t)_compression;
+    }
+    else
+    {
+        // incompressible data (or no compression); store it as-is.
+        ::memcpy(dst, payload, (size_t)rawLength);
+        payloadLength = (size_t)rawLength;
+    }
+
+    h.payloadLength = (uint32_t)payloadLength;
+    out.resize( prefix + payloadLength );
+    ::memcpy(&out[0], &h, sizeof(Header));
+    if ( !name.empty() )
+        ::memcpy(&out[sizeof(Header)], name.data(), name.size());
+
+    return true;
+}
+
+osg::Object*
+RawRecordCodec::decode(const char* data, size_t length)
+{
+    if ( !isRecord(data, length) )
+        return 0L;
+
+    Header h;
+    ::memcpy(&h, data, sizeof(Header));
+
+    if ( h.version != RECORD_VERSION )
+        return 0L;
+
+    if ( (uint64_t)sizeof(Header) + h.nameLength + h.payloadLength > (uint64_t)length )
+    {
+        OE_WARN << LC << "Truncated record" << std::endl;
+        return 0L;
+    }
+
+    if ( h.s <= 0 || h.t <= 0 || h.r <= 0 )
+        return 0L;
+
+    Compression c = (Compression)h.compression;
+    if ( !isSupported(c) )
+    {
+        OE_WARN << LC << "Record uses compression \"" << compressionName(c)
+            << "\" which is not available in this build" << std::endl;
+        return 0L;
+    }
+
+    const char* name    = data + sizeof(Header);
+    const char* payload = name + h.nameLength;
+
+    if ( h.type == TYPE_IMAGE )
+    {
+        // Check the payload size against the dimensions before allocating
+        // anything: the size osg::Image computes for them must match, and the
+        // lower bound rules out osg's 32-bit arithmetic wrapping around.
+        osg::ref_ptr<osg::Image> image = new osg::Image();
+        image->setImage(
+            h.s, h.t, h.r,
+            h.internalFormat, h.pixelFormat, h.dataType,
+            0L, osg::Image::NO_DELETE,
+            h.packing, h.rowLength );
+
+        if ( h.rowLength < 0 ||
+             minImageSizeInBytes(h) > (double)h.rawLength ||
+             image->getTotalSizeInBytes() != h.rawLength )
+        {
+            OE_WARN << LC << "Corrupt image record" << std::endl;
+            return 0L;
+        }
+
+        unsigned char* buf = new unsigned char[h.rawLength];
+        image->setImage(
+            h.s, h.t, h.r,
+            h.internalFormat, h.pixelFormat, h.dataType,
+            buf, osg::Image::USE_NEW_DELETE,
+            h.packing, h.rowLength );
+
+        if ( !decompress(c, payload, h.payloadLength, (char*)buf, h.rawLength) )
+        {
+            OE_WARN << LC << "Corrupt image record" << std::endl;
+            return 0L;
+        }
+
+        image->setOrigin( (osg::Image::Origin)h.origin );
+        if ( h.nameLength > 0u )
+            image->setName( std::string(name, h.nameLength) );
+
+        return image.release();
+    }
+
+    else if ( h.type == TYPE_HEIGHTFIELD )
+    {
+        if ( (uint64_t)h.s * (uint64_t)h.t * sizeof(float) != (uint64_t)h.rawLength )
+        {
+            OE_WARN << LC << "Corrupt heightfield record" << std::endl;
+            return 0L;
+        }
+
+        osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+        hf->allocate( h.s, h.t );
+
+        if ( !decompress(c, payload, h.payloadLength, (char*)&hf->getFloatArray()->front(), h.rawLength) )
+        {
+            OE_WARN << LC << "Corrupt heightfield record" << std::endl;
+            return 0L;
+        }
+
+        hf->setOrigin( osg::Vec3(h.extents[0], h.extents[1], h.extents[2]) );
+        hf->setXInterval( h.extents[3] );
+        hf->setYInterval( h.extents[4] );
+        hf->setSkirtHeight( h.extents[5] );
+        hf->setBorderWidth( h.borderWidth );
+        if ( h.nameLength > 0u )
+            hf->setName( std::string(name, h.nameLength) );
+
+        return hf.release();
+    }
+
+    return 0L;
+}
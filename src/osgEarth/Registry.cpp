@@ -150,7 +150,8 @@ _overrideCachePolicyInitialized( false )
 
 Registry::~Registry()
 {
-    //nop
+    // stop the HTTP I/O thread before static teardown.
+    HTTPClient::shutdownAsync();
 }
 
 Registry* 
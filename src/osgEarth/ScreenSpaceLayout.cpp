@@ -131,6 +131,124 @@ namespace
     
     typedef std::pair<const osg::Node*, osg::BoundingBox> RenderLeafBox;
 
+    // Screen-space boxes claimed so far in a declutter pass. Boxes are
+    // bucketed by the grid cells they cover (hashed into a fixed table) so
+    // that an occupancy test only visits boxes sharing a cell with the
+    // candidate, instead of every box placed so far.
+    class OccupancyGrid
+    {
+    public:
+        OccupancyGrid() : _buckets(NUM_BUCKETS) { }
+
+        void clear()
+        {
+            for(unsigned i=0; i<_dirty.size(); ++i)
+                _buckets[_dirty[i]].clear();
+            _dirty.clear();
+            _boxes.clear();
+            _unbucketed.clear();
+        }
+
+        // True if "box" does not overlap any claimed box with a different parent.
+        bool isClear(const osg::BoundingBox& box, const osg::Node* parent) const
+        {
+            int x0, y0, x1, y1;
+            if ( !getCells(box, x0, y0, x1, y1) )
+            {
+                for(unsigned i=0; i<_boxes.size(); ++i)
+                    if ( conflicts(i, box, parent) )
+                        return false;
+                return true;
+            }
+
+            for(unsigned i=0; i<_unbucketed.size(); ++i)
+                if ( conflicts(_unbucketed[i], box, parent) )
+                    return false;
+
+            for(int y=y0; y<=y1; ++y)
+            {
+                for(int x=x0; x<=x1; ++x)
+                {
+                    const std::vector<unsigned>& bucket = _buckets[hash(x, y)];
+                    for(unsigned i=0; i<bucket.size(); ++i)
+                        if ( conflicts(bucket[i], box, parent) )
+                            return false;
+                }
+            }
+            return true;
+        }
+
+        void insert(const osg::Node* parent, const osg::BoundingBox& box)
+        {
+            unsigned index = _boxes.size();
+            _boxes.push_back( std::make_pair(parent, box) );
+
+            int x0, y0, x1, y1;
+            if ( !getCells(box, x0, y0, x1, y1) )
+            {
+                _unbucketed.push_back( index );
+                return;
+            }
+
+            for(int y=y0; y<=y1; ++y)
+            {
+                for(int x=x0; x<=x1; ++x)
+                {
+                    unsigned b = hash(x, y);
+                    if ( _buckets[b].empty() )
+                        _dirty.push_back( b );
+                    _buckets[b].push_back( index );
+                }
+            }
+        }
+
+    private:
+        enum { CELL_SIZE = 64, NUM_BUCKETS = 4096, MAX_CELLS = 256 };
+
+        bool conflicts(unsigned index, const osg::BoundingBox& box, const osg::Node* parent) const
+        {
+            const RenderLeafBox& used = _boxes[index];
+
+            // only need a 2D test since we're in clip space
+            bool isClear =
+                box.xMin() > used.second.xMax() ||
+                box.xMax() < used.second.xMin() ||
+                box.yMin() > used.second.yMax() ||
+                box.yMax() < used.second.yMin();
+
+            // if there's an overlap (and the conflict isn't from the same drawable
+            // parent, which is acceptable), then the leaf is culled.
+            return !isClear && parent != used.first;
+        }
+
+        // Range of cells covered by a box. Returns false for boxes that don't
+        // belong in the grid (huge, inverted, or non-finite); those are
+        // compared against everything instead.
+        static bool getCells(const osg::BoundingBox& box, int& x0, int& y0, int& x1, int& y1)
+        {
+            const float limit = 1.0e6f;
+            if ( !(box.xMin() >= -limit && box.xMax() <= limit && box.yMin() >= -limit && box.yMax() <= limit) )
+                return false;
+
+            x0 = (int)floor(box.xMin() / (float)CELL_SIZE);
+            y0 = (int)floor(box.yMin() / (float)CELL_SIZE);
+            x1 = (int)floor(box.xMax() / (float)CELL_SIZE);
+            y1 = (int)floor(box.yMax() / (float)CELL_SIZE);
+
+            return x1 >= x0 && y1 >= y0 && (x1-x0+1)*(y1-y0+1) <= MAX_CELLS;
+        }
+
+        static unsigned hash(int x, int y)
+        {
+            return (((unsigned)x * 73856093u) ^ ((unsigned)y * 19349663u)) & (NUM_BUCKETS-1);
+        }
+
+        std::vector<RenderLeafBox>           _boxes;
+        std::vector<unsigned>                _unbucketed;
+        std::vector< std::vector<unsigned> > _buckets;
+        std::vector<unsigned>                _dirty;
+    };
+
     // Data structure stored one-per-View.
     struct PerCamInfo
     {
@@ -142,7 +260,7 @@ namespace
         // re-usable structures (to avoid unnecessary re-allocation)
         osgUtil::RenderBin::RenderLeafList _passed;
         osgUtil::RenderBin::RenderLeafList _failed;
-        std::vector<RenderLeafBox>         _used;
+        OccupancyGrid                      _used;
 
         // time stamp of the previous pass, for calculating animation speed
         osg::Timer_t _lastTimeStamp;
@@ -441,25 +559,7 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
                 else
                 {
                     // weed out any drawables that are obscured by closer drawables.
-                    // TODO: think about a more efficient algorithm - right now we are just using
-                    // brute force to compare all bbox's
-                    for( std::vector<RenderLeafBox>::const_iterator j = local._used.begin(); j != local._used.end(); ++j )
-                    {
-                        // only need a 2D test since we're in clip space
-                        bool isClear =
-                            box.xMin() > j->second.xMax() ||
-                            box.xMax() < j->second.xMin() ||
-                            box.yMin() > j->second.yMax() ||
-                            box.yMax() < j->second.yMin();
-
-                        // if there's an overlap (and the conflict isn't from the same drawable
-                        // parent, which is acceptable), then the leaf is culled.
-                        if ( !isClear && drawableParent != j->first )
-                        {
-                            visible = false;
-                            break;
-                        }
-                    }
+                    visible = local._used.isClear( box, drawableParent );
                 }
             }
 
@@ -467,7 +567,7 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
             {
                 // passed the test, so add the leaf's bbox to the "used" list, and add the leaf
                 // to the final draw list.
-                local._used.push_back( std::make_pair(drawableParent, box) );
+                local._used.insert( drawableParent, box );
                 local._passed.push_back( leaf );
             }
 
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/TaskService>
+#include <osgEarth/Registry>
 #include <osg/Notify>
 #include <osg/Math>
 
@@ -67,51 +68,121 @@ TaskRequest::wasCanceled() const
     return _progress->isCanceled();
 }
 
+void
+TaskRequest::finish()
+{
+    if ( _finished.exchange(1u) == 0u )
+    {
+        onFinished();
+    }
+}
+
 //------------------------------------------------------------------------
 
-TaskRequestQueue::TaskRequestQueue(unsigned int maxSize) :
+TaskRequestQueue::TaskRequestQueue(unsigned int maxSize, unsigned int numLanes) :
 osg::Referenced( true ),
+_numLanes( numLanes ),
+_numReserved( 0u ),
 _done( false ),
 _maxSize( maxSize ),
 _stamp(0)
 {
-    //nop
+    // Lanes are allocated once and never resized, so workers can index them
+    // without holding a queue-wide lock. Zero asks for one per processor.
+    if ( _numLanes == 0u )
+        _numLanes = (unsigned)osg::clampBetween( OpenThreads::GetNumberOfProcessors(), 1, 64 );
+
+    _lanes = new Lane[_numLanes];
+}
+
+TaskRequestQueue::~TaskRequestQueue()
+{
+    // Anything still queued will never run; let the owners know.
+    for(unsigned i=0; i<_numLanes; ++i)
+    {
+        for(TaskRequestPriorityMap::iterator r = _lanes[i]._requests.begin(); r != _lanes[i]._requests.end(); ++r)
+        {
+            r->second->cancel();
+            r->second->finish();
+        }
+    }
+
+    delete [] _lanes;
 }
 
 void
 TaskRequestQueue::clear()
 {
-    ScopedLock<Mutex> lock(_mutex);
-    _requests.clear();
+    TaskRequestVector removed;
+    for(unsigned i=0; i<_numLanes; ++i)
+    {
+        ScopedLock<Mutex> lock(_lanes[i]._mutex);
+        while( !_lanes[i]._requests.empty() )
+        {
+            _lanes[i]._requests.begin()->second->cancel();
+            removed.push_back( _lanes[i]._requests.begin()->second.get() );
+            _lanes[i]._requests.erase( _lanes[i]._requests.begin() );
+            --_count;
+        }
+    }
+
+    {
+        ScopedLock<Mutex> lock(_sleepMutex);
+        release( removed.size() );
+        _poison = 0L;
+        _notFull.broadcast();
+    }
+
+    // the removed requests will never run.
+    for(TaskRequestVector::iterator i = removed.begin(); i != removed.end(); ++i)
+        (*i)->finish();
 }
 
 void
 TaskRequestQueue::cancel()
 {
-    ScopedLock<Mutex> lock(_mutex);
-    for (TaskRequestPriorityMap::iterator it = _requests.begin(); it != _requests.end(); ++it)
-        (*it).second->cancel();
+    TaskRequestVector removed;
+    for(unsigned i=0; i<_numLanes; ++i)
+    {
+        ScopedLock<Mutex> lock(_lanes[i]._mutex);
+        while( !_lanes[i]._requests.empty() )
+        {
+            _lanes[i]._requests.begin()->second->cancel();
+            removed.push_back( _lanes[i]._requests.begin()->second.get() );
+            _lanes[i]._requests.erase( _lanes[i]._requests.begin() );
+            --_count;
+        }
+    }
+
+    {
+        ScopedLock<Mutex> lock(_sleepMutex);
+        release( removed.size() );
+        if ( _poison.valid() )
+            _poison->cancel();
+        _poison = 0L;
+        _notFull.broadcast();
+    }
 
-    _requests.clear();
+    for(TaskRequestVector::iterator i = removed.begin(); i != removed.end(); ++i)
+        (*i)->finish();
 }
 
 bool
 TaskRequestQueue::isFull() const
 {
-    return _maxSize > 0 && (_maxSize == _requests.size());
+    return _maxSize > 0 && (unsigned)_count >= _maxSize;
 }
 
 bool
 TaskRequestQueue::isEmpty() const
 {
-    return !_done && _requests.empty();
+    return !_done && (unsigned)_count == 0u && !_poison.valid();
 }
 
 unsigned int
 TaskRequestQueue::getNumRequests() const
 {
-    ScopedLock<Mutex> lock(const_cast<TaskRequestQueue*>(this)->_mutex);
-    return _requests.size();
+    return (unsigned)_count;
 }
 
 void 
@@ -123,66 +194,131 @@ TaskRequestQueue::add( TaskRequest* request )
     if ( !request->getProgressCallback() )
         request->setProgressCallback( new ProgressCallback() );
 
+    // A poison pill signals the end of the work; park it off to the side and
+    // only hand it out once all the lanes have drained.
+    if ( dynamic_cast<PoisonPill*>(request) )
     {
-        // Lock on the add mutex so no one else can add.
-        ScopedLock<Mutex> lock( _mutex );
+        ScopedLock<Mutex> lock( _sleepMutex );
+        _poison = request;
+        _notEmpty.broadcast();
+        return;
+    }
 
-        while(isFull())
+    // bounded queue: wait for room, and reserve it under the same lock so
+    // concurrent producers can't overfill the queue.
+    if ( _maxSize > 0 )
+    {
+        ScopedLock<Mutex> lock( _sleepMutex );
+        while( _numReserved >= _maxSize && !_done )
         {
-            _notFull.wait(&_mutex);
+            _notFull.wait(&_sleepMutex);
         }
 
+        ++_numReserved;
+
         // Check to make sure the bounded queue is working correctly.
-        if (_maxSize > 0 && _requests.size() > _maxSize)
+        if ( _numReserved > _maxSize && !_done )
         {
-            OE_NOTICE << "ERROR:  TaskRequestQueue requests " << getNumRequests() << " > max size of " << _maxSize << std::endl;
+            OE_NOTICE << "ERROR:  TaskRequestQueue requests " << _numReserved << " > max size of " << _maxSize << std::endl;
         }
-
-        // insert by priority.
-        _requests.insert( std::pair<float,TaskRequest*>(request->getPriority(), request) );
     }
 
-    //OE_NOTICE << "There are now " << _requests.size() << " tasks" << std::endl;
+    {
+        // Distribute requests round-robin across the lanes; insert by priority.
+        // The count changes under the lane lock, so it always matches the
+        // number of requests actually in the lanes.
+        Lane& lane = _lanes[ (unsigned)(++_nextLane) % _numLanes ];
+        ScopedLock<Mutex> lock( lane._mutex );
+        lane._requests.insert( std::pair<float,TaskRequest*>(request->getPriority(), request) );
+        ++_count;
+    }
 
     // since there is data in the queue, wake up one waiting task thread.
-    _notEmpty.signal(); 
+    if ( (unsigned)_numSleepers > 0u )
+    {
+        ScopedLock<Mutex> lock( _sleepMutex );
+        _notEmpty.signal();
+    }
+}
+
+TaskRequest*
+TaskRequestQueue::pop( unsigned int lane )
+{
+    // Try the home lane first, then steal from the others.
+    for(unsigned i=0; i<_numLanes; ++i)
+    {
+        Lane& l = _lanes[(lane + i) % _numLanes];
+        ScopedLock<Mutex> lock( l._mutex );
+        if ( !l._requests.empty() )
+        {
+            osg::ref_ptr<TaskRequest> next = l._requests.begin()->second.get();
+            l._requests.erase( l._requests.begin() );
+            --_count;
+            return next.release();
+        }
+    }
+    return 0L;
 }
 
 TaskRequest* 
-TaskRequestQueue::get()
+TaskRequestQueue::get( unsigned int lane )
 {
-    
-    osg::ref_ptr<TaskRequest> next;
+    while( !_done )
     {
-        ScopedLock<Mutex> lock(_mutex);
+        if ( (unsigned)_count > 0u )
+        {
+            TaskRequest* next = pop( lane );
+            if ( next )
+            {
+                // I'm done, someone else take a turn:
+                if ( _maxSize > 0 )
+                {
+                    ScopedLock<Mutex> lock( _sleepMutex );
+                    release( 1u );
+                    _notFull.signal();
+                }
+
+                return next;
+            }
+
+            // Another thread took the last request between the count check
+            // and the pop; fall through and sleep if the queue is now empty.
+        }
+
+        ScopedLock<Mutex> lock( _sleepMutex );
 
+        // Register as a sleeper before checking the count; add() increments the
+        // count before checking for sleepers, so a wake-up cannot be lost.
+        ++_numSleepers;
         while ( isEmpty() )
         {                
-            _notEmpty.wait( &_mutex );        
+            _notEmpty.wait( &_sleepMutex );
         }
+        --_numSleepers;
 
-        if ( _done )
+        if ( !_done && (unsigned)_count == 0u && _poison.valid() )
         {
-            return 0L;
+            osg::ref_ptr<TaskRequest> poison = _poison.get();
+            return poison.release();
         }
-
-        next = _requests.begin()->second.get(); //_requests.front();
-        _requests.erase( _requests.begin() ); //_requests.pop_front();
     }
 
-    // I'm done, someone else take a turn:
-    // (technically this shouldn't be necessary since add() bumps the semaphore once
-    // for each request in the queue)    
-    _notFull.signal();    
+    return 0L;
+}
 
-    return next.release();
+void
+TaskRequestQueue::release( unsigned int num )
+{
+    // caller holds _sleepMutex
+    if ( _maxSize > 0 )
+        _numReserved = num < _numReserved ? _numReserved - num : 0u;
 }
 
 void
 TaskRequestQueue::setDone()
 {
     // we need to obtain the mutex since we're using the Condition
-    ScopedLock<Mutex> lock(_mutex);
+    ScopedLock<Mutex> lock(_sleepMutex);
 
     _done = true;
 
@@ -198,8 +334,9 @@ TaskRequestQueue::setDone()
 
 //------------------------------------------------------------------------
 
-TaskThread::TaskThread( TaskRequestQueue* queue ) :
+TaskThread::TaskThread( TaskRequestQueue* queue, unsigned int lane ) :
 _queue( queue ),
+_lane( lane ),
 _done( false )
 {
     //nop
@@ -210,10 +347,10 @@ TaskThread::run()
 {
     while( !_done )
     {
-        _request = _queue->get();
-
-        if ( _done )
-            break;
+        // If this thread is retired while waiting, it still processes the
+        // request it was handed (the loop exits afterwards), so no request
+        // is ever dropped on the floor.
+        _request = _queue->get( _lane );
 
         if (_request.valid())
         { 
@@ -254,6 +391,8 @@ TaskThread::run()
             if ( _request->getProgressCallback() )
                 _request->getProgressCallback()->onCompleted();
 
+            _request->finish();
+
             // Release the request
             _request = 0;
         }
@@ -273,23 +412,23 @@ TaskThread::cancel()
             _request->cancel();
         }
 
-        while( isRunning() )
-        {        
-            OpenThreads::Thread::YieldCurrentThread();
-        }
+        // The queue is done by now (see ~TaskService), so the thread will
+        // wake up and exit; block until it does.
+        join();
     }
     return 0;
 }
 
 //------------------------------------------------------------------------
 
-TaskService::TaskService( const std::string& name, int numThreads, unsigned int maxSize ):
+TaskService::TaskService( const std::string& name, int numThreads, unsigned int maxSize, unsigned int numLanes ):
 osg::Referenced( true ),
 _lastRemoveFinishedThreadsStamp(0),
 _name(name),
-_numThreads( 0 )
+_numThreads( 0 ),
+_nextLane( 0u )
 {
-    _queue = new TaskRequestQueue( maxSize );
+    _queue = new TaskRequestQueue( maxSize, numLanes );
     setNumThreads( numThreads );
 }
 
@@ -395,7 +534,7 @@ TaskService::adjustThreadCount()
         //We need to add some threads
         for (int i = 0; i < diff; ++i)
         {
-            TaskThread* thread = new TaskThread( _queue.get() );
+            TaskThread* thread = new TaskThread( _queue.get(), (_nextLane++) % _queue->getNumLanes() );
             _threads.push_back( thread );
             thread->start();
         }       
@@ -510,6 +649,35 @@ TaskServiceManager::getOrAdd( UID uid, float weight )
     return service ? service : add( uid, weight );
 }
 
+TaskService*
+TaskServiceManager::getOrAdd( const std::string& name, float weight )
+{
+    ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+
+    UID uid;
+    NamedServiceMap::iterator n = _namedServices.find( name );
+    if ( n != _namedServices.end() )
+    {
+        uid = n->second;
+        TaskServiceMap::iterator i = _services.find( uid );
+        if ( i != _services.end() )
+            return i->second.first.get();
+    }
+    else
+    {
+        uid = Registry::instance()->createUID();
+        _namedServices[name] = uid;
+    }
+
+    if ( weight <= 0.0f )
+        weight = 0.001;
+
+    TaskService* newService = new TaskService( name, 1 );
+    _services[uid] = WeightedTaskService( newService, weight );
+    reallocate( _targetNumThreads );
+    return newService;
+}
+
 void
 TaskServiceManager::remove( TaskService* service )
 {
@@ -312,7 +312,11 @@ TerrainLayer::init()
     // Initialize the l2 cache if it's size is > 0
     if ( l2CacheSize > 0 )
     {
-        _memCache = new MemCache( l2CacheSize );
+        _memCache = new MemCache( l2CacheSize, _initOptions.driver()->L2CacheMaxBytes().get() );
+
+        // Sharing skips a deep copy on every hit, but is only safe for a
+        // layer whose results nothing modifies; it's off unless asked for.
+        _memCache->setShareObjects( _initOptions.driver()->L2CacheShareObjects().get() );
     }
 
     // create the unique cache ID for the cache bin.
@@ -20,6 +20,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/ImageToHeightFieldConverter>
+#include <osgEarth/TaskService>
 
 #include <osg/Texture2D>
 
@@ -64,6 +65,52 @@ TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
     return model.release();
 }
 
+namespace
+{
+    /**
+     * Progress callback handed to a single concurrent layer fetch. It reports
+     * the parent's cancelation state and collects stats privately, since the
+     * parent's stats table is not safe to update from several threads.
+     */
+    struct LayerFetchProgress : public ProgressCallback
+    {
+        LayerFetchProgress(ProgressCallback* parent) : _parent(parent) { }
+
+        bool isCanceled() {
+            return _canceled || (_parent.valid() && _parent->isCanceled());
+        }
+
+        /** Folds the collected stats and retry flag back into the parent. */
+        void mergeInto(ProgressCallback* parent) {
+            if ( !parent ) return;
+            for(Stats::const_iterator i = _stats.begin(); i != _stats.end(); ++i)
+                parent->stats(i->first) += i->second;
+            if ( needsRetry() )
+                parent->setNeedsRetry( true );
+        }
+
+        osg::ref_ptr<ProgressCallback> _parent;
+    };
+
+    /** Fetches the image for one layer; run through a ParallelTask. */
+    struct FetchImageLayer
+    {
+        void execute() {
+            OE_START_TIMER(fetch_image_layer);
+            _image = _layer->createImage( _key, _fetchProgress.get() );
+            _time = OE_STOP_TIMER(fetch_image_layer);
+        }
+
+        osg::ref_ptr<ImageLayer>           _layer;
+        TileKey                            _key;
+        osg::ref_ptr<LayerFetchProgress>   _fetchProgress;
+        GeoImage                           _image;
+        double                             _time;
+    };
+
+    typedef ParallelTask<FetchImageLayer> FetchImageLayerTask;
+}
+
 void
 TerrainTileModelFactory::addImageLayers(TerrainTileModel*            model,
                                         const MapFrame&              frame,
@@ -72,6 +119,10 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel*            model,
 {
     OE_START_TIMER(fetch_image_layers);
 
+    // First pass: decide which layers need fetching, preserving map order.
+    std::vector<ImageLayer*> layers;
+    std::vector<int>         orders;
+    
     int order = 0;
 
     for(ImageLayerVector::const_iterator i = frame.imageLayers().begin();
@@ -82,19 +133,7 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel*            model,
 
         if ( layer->getEnabled() && layer->isKeyInRange(key) )
         {
-            // This will only go true if we are requesting a ROOT TILE but we have to
-            // fall back on lower resolution data to create it.
-            bool isFallback = false;
-
-            GeoImage geoImage;
-
             const Profile* layerProfile = layer->getProfile();
-            
-            // If this is a ROOT tile, we will try to fall back on lower-resolution
-            // data if we can't find something at the optimal LOD.
-            bool isRootKey =
-                (key.getLOD() == 0) || // should never be
-                (key.getLOD()-1 == _options.firstLOD().get() );
 
             TileSource* tileSource = layer->getTileSource();
 
@@ -110,42 +149,97 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel*            model,
                 hasDataInExtent = tileSource->hasDataInExtent( ext );
             }
             
-            // fetch the image from the layer if it's available:
-            if ( hasDataInExtent && layer->isKeyInRange(key) )
+            if ( hasDataInExtent )
             {
-                geoImage = layer->createImage( key, progress );
+                layers.push_back( layer );
+                orders.push_back( order );
             }
-            
-            if ( geoImage.valid() )
-            {
-                TerrainTileImageLayerModel* layerModel = new TerrainTileImageLayerModel();
-                layerModel->setImageLayer( layer );
+        }
+    }
 
-                // preserve layer ordering. Without this, layer draw order can get out of whack
-                // if you have a layer that doesn't appear in the model until a higher LOD. Instead
-                // of just getting appended to the draw set, the Order will make sure it gets 
-                // inserted in the correct position according to the map model.
-                layerModel->setOrder( order );
+    // Second pass: fetch the images, concurrently if so configured.
+    std::vector<GeoImage> images( layers.size() );
 
-                // made an image. Store as a texture with an identity matrix.
-                osg::Texture* texture;
-                if ( layer->isCoverage() )
-                    texture = createCoverageTexture(geoImage.getImage(), layer);
-                else
-                    texture = createImageTexture(geoImage.getImage(), layer);
+    TaskService* service =
+        _options.parallelImageLayers() == true && layers.size() > 1 ?
+        Registry::instance()->getTaskServiceManager()->getOrAdd("TerrainTileModelFactory image fetch") : 0L;
 
-                layerModel->setTexture( texture );
+    if ( service )
+    {
+        // Run the first layer on this thread and farm the rest out to the pool.
+        Threading::MultiEvent done( layers.size()-1 );
+        std::vector< osg::ref_ptr<FetchImageLayerTask> > tasks( layers.size() );
 
+        for(unsigned i=0; i<layers.size(); ++i)
+        {
+            tasks[i] = new FetchImageLayerTask( &done );
+            tasks[i]->_layer    = layers[i];
+            tasks[i]->_key      = key;
+            tasks[i]->_fetchProgress = new LayerFetchProgress( progress );
+            tasks[i]->_time     = 0.0;
+            if ( i > 0 )
+                service->add( tasks[i].get() );
+        }
 
-                if ( layer->isShared() )
-                    model->sharedLayers().push_back( layerModel );
+        tasks[0]->execute();
+        done.wait();
 
-                if ( layer->getVisible() )
-                    model->colorLayers().push_back( layerModel );
+        double layerTime = 0.0;
+        for(unsigned i=0; i<tasks.size(); ++i)
+        {
+            images[i] = tasks[i]->_image;
+            layerTime += tasks[i]->_time;
+            tasks[i]->_fetchProgress->mergeInto( progress );
+        }
 
-                if ( layer->isDynamic() )
-                    model->setRequiresUpdateTraverse( true );
-            }
+        // Sum of the individual fetch times; compare with fetch_imagery_time
+        // to see what the concurrent fetch saved.
+        if (progress)
+            progress->stats()["fetch_imagery_layer_time"] += layerTime;
+    }
+    else
+    {
+        for(unsigned i=0; i<layers.size(); ++i)
+        {
+            images[i] = layers[i]->createImage( key, progress );
+        }
+    }
+
+    // Third pass: build the textures in map order.
+    for(unsigned i=0; i<layers.size(); ++i)
+    {
+        ImageLayer* layer = layers[i];
+        GeoImage& geoImage = images[i];
+            
+        if ( geoImage.valid() )
+        {
+            TerrainTileImageLayerModel* layerModel = new TerrainTileImageLayerModel();
+            layerModel->setImageLayer( layer );
+
+            // preserve layer ordering. Without this, layer draw order can get out of whack
+            // if you have a layer that doesn't appear in the model until a higher LOD. Instead
+            // of just getting appended to the draw set, the Order will make sure it gets 
+            // inserted in the correct position according to the map model.
+            layerModel->setOrder( orders[i] );
+
+            // made an image. Store as a texture with an identity matrix.
+            osg::Texture* texture;
+            if ( layer->isCoverage() )
+                texture = createCoverageTexture(geoImage.getImage(), layer);
+            else
+                texture = createImageTexture(geoImage.getImage(), layer);
+
+            layerModel->setTexture( texture );
+
+
+            if ( layer->isShared() )
+                model->sharedLayers().push_back( layerModel );
+
+            if ( layer->getVisible() )
+                model->colorLayers().push_back( layerModel );
+
+            if ( layer->isDynamic() )
+                model->setRequiresUpdateTraverse( true );
         }
     }
 
@@ -19,9 +19,31 @@
 * You should have received a copy of the GNU Lesser General Public License
 * along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
-#include <limits.h>
 
+/* The ear-clipping triangulator in this file is a port of earcut
+* (https://github.com/mapbox/earcut), which carries the following notice:
+*
+* ISC License
+*
+* Copyright (c) 2016, Mapbox
+*
+* Permission to use, copy, modify, and/or distribute this software for any purpose
+* with or without fee is hereby granted, provided that the above copyright notice
+* and this permission notice appear in all copies.
+*
+* THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH REGARD TO
+* THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+* IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+* CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+* OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+* ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
 #include <osgEarth/Tessellator>
+#include <osgEarth/Notify>
+#include <algorithm>
+#include <cfloat>
+#include <deque>
+#include <vector>
 
 using namespace osgEarth;
 
@@ -32,373 +54,835 @@ using namespace osgEarth;
 
 namespace
 {
-
-// Borrowed from osgUtil/DelaunayTriangulator.cpp
-// Compute the circumcircle of a triangle (only x and y coordinates are used),
-// return (Cx, Cy, r^2)
-inline osg::Vec3 compute_circumcircle(
-    const osg::Vec3 &a,
-    const osg::Vec3 &b,
-    const osg::Vec3 &c)
-{
-    float D =
-        (a.x() - c.x()) * (b.y() - c.y()) -
-        (b.x() - c.x()) * (a.y() - c.y());
-
-    float cx, cy, r2;
-
-    if(D==0.0)
+    // Ear clipping over a doubly-linked ring of vertices, after mapbox/earcut
+    // (ISC license; see the notice at the top of this file). Vertices are also
+    // linked in z-order (a Morton curve over the ring's bounding box) so the
+    // "is anything inside this ear" test only visits nearby vertices, which
+    // keeps large rings close to linear time. Holes are bridged into the
+    // outer ring with zero-width channels before clipping; rings that arrive
+    // with their holes already bridged in that way are handled as well.
+    struct Node
     {
-        // (Nearly) degenerate condition - either two of the points are equal (which we discount)
-        // or the three points are colinear. In this case we just determine the average of
-        // the three points as the centre for correctness, but squirt out a zero radius.
-        // This method will produce a triangulation with zero area, so we have to check later
-        cx = (a.x()+b.x()+c.x())/3.0;
-        cy = (a.y()+b.y()+c.y())/3.0;
-        r2 = 0.0;
-    }
-    else
+        unsigned i;          // index into the vertex array
+        double   x, y;
+        int      z;          // z-order value
+        Node*    prev;
+        Node*    next;
+        Node*    prevZ;
+        Node*    nextZ;
+    };
+
+    typedef std::vector<unsigned> IndexList;
+    typedef std::vector< std::pair<unsigned, unsigned> > Loops;
+
+    struct Earcut
     {
-        cx =
-        (((a.x() - c.x()) * (a.x() + c.x()) +
-        (a.y() - c.y()) * (a.y() + c.y())) / 2 * (b.y() - c.y()) -
-        ((b.x() - c.x()) * (b.x() + c.x()) +
-        (b.y() - c.y()) * (b.y() + c.y())) / 2 * (a.y() - c.y())) / D;
-
-        cy =
-        (((b.x() - c.x()) * (b.x() + c.x()) +
-        (b.y() - c.y()) * (b.y() + c.y())) / 2 * (a.x() - c.x()) -
-        ((a.x() - c.x()) * (a.x() + c.x()) +
-        (a.y() - c.y()) * (a.y() + c.y())) / 2 * (b.x() - c.x())) / D;
-
-      //  r2 = (c.x() - cx) * (c.x() - cx) + (c.y() - cy) * (c.y() - cy);
-        // the return r square is compared with r*r many times in an inner loop
-        // so for efficiency use the inefficient sqrt once rather than 30* multiplies later.
-        r2 = sqrt((c.x() - cx) * (c.x() - cx) + (c.y() - cy) * (c.y() - cy));
-    }
-    return osg::Vec3(cx, cy, r2);
-}
+        std::deque<Node> _nodes;  // deque, so node pointers stay valid as it grows
+        IndexList&       _out;
+        double           _minX, _minY, _invSize;
 
-// Test whether a point (only the x and y coordinates are used) lies inside
-// a circle; the circle is passed as a vector: (Cx, Cy, r).
+        Earcut(IndexList& out) : _out(out), _minX(0.0), _minY(0.0), _invSize(0.0) { }
 
-inline bool point_in_circle(const osg::Vec3 &point, const osg::Vec3 &circle)
-{
-    float r2 =
-        (point.x() - circle.x()) * (point.x() - circle.x()) +
-        (point.y() - circle.y()) * (point.y() - circle.y());
-    return r2 <= circle.z()*circle.z();
-//    return r2 <= circle.z();
-}
+        Node* createNode(unsigned i, double x, double y)
+        {
+            _nodes.push_back(Node());
+            Node* n = &_nodes.back();
+            n->i = i; n->x = x; n->y = y; n->z = 0;
+            n->prev = n->next = n->prevZ = n->nextZ = 0L;
+            return n;
+        }
 
-int checkCCW(double x1, double y1, double x2, double y2, double x3, double y3)
-{
-    double v = (x2 - x1) * (y3 - y1) - (y2 - y1) * (x3 - x1);
-    return (v == 0.0 ? 0 : (v > 0.0 ? 1 : -1));
-}
+        Node* insertNode(unsigned i, double x, double y, Node* last)
+        {
+            Node* p = createNode(i, x, y);
+            if (!last)
+            {
+                p->prev = p;
+                p->next = p;
+            }
+            else
+            {
+                p->next = last->next;
+                p->prev = last;
+                last->next->prev = p;
+                last->next = p;
+            }
+            return p;
+        }
 
-//bool point_in_tri(const osg::Vec3 &p, const osg::Vec3 &t1, const osg::Vec3 &t2, const osg::Vec3 &t3)
-bool point_in_tri(double xp, double yp, double x1, double y1, double x2, double y2, double x3, double y3)
-{
-  int t1 = checkCCW(xp, yp, x1, y1, x2, y2);
-  int t2 = checkCCW(xp, yp, x2, y2, x3, y3);
-  int t3 = checkCCW(xp, yp, x3, y3, x1, y1);
+        static void removeNode(Node* p)
+        {
+            p->next->prev = p->prev;
+            p->prev->next = p->next;
+            if (p->prevZ) p->prevZ->nextZ = p->nextZ;
+            if (p->nextZ) p->nextZ->prevZ = p->prevZ;
+        }
 
-  return t1 == t2 && t2 == t3;
-}
+        // twice the signed area of triangle pqr; negative when counter-clockwise
+        static double area(const Node* p, const Node* q, const Node* r)
+        {
+            return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+        }
 
-struct TriIndices
-{
-    unsigned int a;
-    unsigned int b;
-    unsigned int c;
+        static bool equals(const Node* a, const Node* b)
+        {
+            return a->x == b->x && a->y == b->y;
+        }
 
-    TriIndices(unsigned int p1, unsigned int p2, unsigned int p3)
-      : a(p1), b(p2), c(p3)
-    {
-      //nop
-    }
-};
+        static bool pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+        {
+            return
+                (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+                (ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+                (bx - px) * (cy - py) >= (cx - px) * (by - py);
+        }
 
-typedef std::vector<TriIndices> TriList;
+        static int sign(double v)
+        {
+            return v > 0.0 ? 1 : v < 0.0 ? -1 : 0;
+        }
 
-}
+        static bool onSegment(const Node* p, const Node* q, const Node* r)
+        {
+            return
+                q->x <= osg::maximum(p->x, r->x) && q->x >= osg::minimum(p->x, r->x) &&
+                q->y <= osg::maximum(p->y, r->y) && q->y >= osg::minimum(p->y, r->y);
+        }
 
-bool
-Tessellator::tessellateGeometry(osg::Geometry &geom)
-{
-    osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
+        static bool intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2)
+        {
+            int o1 = sign(area(p1, q1, p2));
+            int o2 = sign(area(p1, q1, q2));
+            int o3 = sign(area(p2, q2, p1));
+            int o4 = sign(area(p2, q2, q1));
+
+            if (o1 != o2 && o3 != o4) return true;
+            if (o1 == 0 && onSegment(p1, p2, q1)) return true;
+            if (o2 == 0 && onSegment(p1, q2, q1)) return true;
+            if (o3 == 0 && onSegment(p2, p1, q2)) return true;
+            if (o4 == 0 && onSegment(p2, q1, q2)) return true;
+            return false;
+        }
 
-    if (!vertices || vertices->empty() || geom.getPrimitiveSetList().empty()) return false;
+        static bool intersectsPolygon(const Node* a, const Node* b)
+        {
+            const Node* p = a;
+            do
+            {
+                if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i &&
+                    intersects(p, p->next, a, b))
+                    return true;
+                p = p->next;
+            }
+            while (p != a);
+            return false;
+        }
 
-    // copy the original primitive set list
-    osg::Geometry::PrimitiveSetList originalPrimitives = geom.getPrimitiveSetList();
+        static bool locallyInside(const Node* a, const Node* b)
+        {
+            return area(a->prev, a, a->next) < 0.0 ?
+                area(a, b, a->next) >= 0.0 && area(a, a->prev, b) >= 0.0 :
+                area(a, b, a->prev) < 0.0 || area(a, a->next, b) < 0.0;
+        }
 
-    // clear the primitive sets
-    unsigned int nprimsetoriginal= geom.getNumPrimitiveSets();
-    if (nprimsetoriginal) geom.removePrimitiveSet(0, nprimsetoriginal);
+        static bool middleInside(const Node* a, const Node* b)
+        {
+            const Node* p = a;
+            bool inside = false;
+            double px = (a->x + b->x) / 2.0;
+            double py = (a->y + b->y) / 2.0;
+            do
+            {
+                if (((p->y > py) != (p->next->y > py)) && p->next->y != p->y &&
+                    (px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x))
+                    inside = !inside;
+                p = p->next;
+            }
+            while (p != a);
+            return inside;
+        }
 
-    bool success = true;
-    for (unsigned int i=0; i < originalPrimitives.size(); i++)
-    {
-        osg::ref_ptr<osg::PrimitiveSet> primitive = originalPrimitives[i].get();
+        static bool isValidDiagonal(const Node* a, const Node* b)
+        {
+            return
+                a->next->i != b->i && a->prev->i != b->i && !intersectsPolygon(a, b) &&
+                ((locallyInside(a, b) && locallyInside(b, a) && middleInside(a, b) &&
+                  (area(a->prev, a, b->prev) != 0.0 || area(a, b->prev, b) != 0.0)) ||
+                 (equals(a, b) && area(a->prev, a, a->next) > 0.0 && area(b->prev, b, b->next) > 0.0));
+        }
 
-        if (primitive->getMode()==osg::PrimitiveSet::POLYGON || primitive->getMode()==osg::PrimitiveSet::LINE_LOOP)
+        // removes duplicate and collinear vertices
+        Node* filterPoints(Node* start, Node* end =0L)
         {
-            if (primitive->getType()==osg::PrimitiveSet::DrawArrayLengthsPrimitiveType)
+            if (!start) return start;
+            if (!end) end = start;
+
+            Node* p = start;
+            bool again;
+            do
             {
-                osg::DrawArrayLengths* drawArrayLengths = static_cast<osg::DrawArrayLengths*>(primitive.get());
-                unsigned int first = drawArrayLengths->getFirst();
-                for(osg::DrawArrayLengths::iterator itr=drawArrayLengths->begin();
-                    itr!=drawArrayLengths->end();
-                    ++itr)
+                again = false;
+                if (equals(p, p->next) || area(p->prev, p, p->next) == 0.0)
                 {
-                    unsigned int last = first + *itr;
-                    osg::PrimitiveSet* newPrimitive = tessellatePrimitive(first, last, vertices);
-                    if (newPrimitive)
-                    {
-                        geom.addPrimitiveSet(newPrimitive);
-                    }
-                    else
-                    {
-                        // tessellation failed, add old primitive set back
-                        geom.addPrimitiveSet(primitive);
-                        success = false;
-                    }
-
-                    first = last;
+                    removeNode(p);
+                    p = end = p->prev;
+                    if (p == p->next) break;
+                    again = true;
+                }
+                else
+                {
+                    p = p->next;
                 }
             }
-            else
+            while (again || p != end);
+
+            return end;
+        }
+
+        int zOrder(double x, double y) const
+        {
+            int ix = (int)((x - _minX) * _invSize);
+            int iy = (int)((y - _minY) * _invSize);
+
+            ix = (ix | (ix << 8)) & 0x00FF00FF;
+            ix = (ix | (ix << 4)) & 0x0F0F0F0F;
+            ix = (ix | (ix << 2)) & 0x33333333;
+            ix = (ix | (ix << 1)) & 0x55555555;
+
+            iy = (iy | (iy << 8)) & 0x00FF00FF;
+            iy = (iy | (iy << 4)) & 0x0F0F0F0F;
+            iy = (iy | (iy << 2)) & 0x33333333;
+            iy = (iy | (iy << 1)) & 0x55555555;
+
+            return ix | (iy << 1);
+        }
+
+        // merge sort of the z-order list (Simon Tatham's linked list sort)
+        static Node* sortLinked(Node* list)
+        {
+            int inSize = 1;
+            int numMerges;
+            do
             {
-                if (primitive->getNumIndices()>=3)
+                Node* p = list;
+                Node* tail = 0L;
+                list = 0L;
+                numMerges = 0;
+
+                while (p)
                 {
-                    osg::PrimitiveSet* newPrimitive = tessellatePrimitive(primitive.get(), vertices);
-                    if (newPrimitive)
+                    numMerges++;
+                    Node* q = p;
+                    int pSize = 0;
+                    for (int i = 0; i < inSize; i++)
                     {
-                        geom.addPrimitiveSet(newPrimitive);
+                        pSize++;
+                        q = q->nextZ;
+                        if (!q) break;
                     }
-                    else
+
+                    int qSize = inSize;
+                    while (pSize > 0 || (qSize > 0 && q))
                     {
-                        // tessellation failed, add old primitive set back
-                        geom.addPrimitiveSet(primitive);
-                        success = false;
+                        Node* e;
+                        if (pSize != 0 && (qSize == 0 || !q || p->z <= q->z))
+                        {
+                            e = p;
+                            p = p->nextZ;
+                            pSize--;
+                        }
+                        else
+                        {
+                            e = q;
+                            q = q->nextZ;
+                            qSize--;
+                        }
+
+                        if (tail) tail->nextZ = e;
+                        else list = e;
+
+                        e->prevZ = tail;
+                        tail = e;
                     }
+                    p = q;
                 }
+
+                tail->nextZ = 0L;
+                inSize *= 2;
             }
+            while (numMerges > 1);
+
+            return list;
         }
-        else
+
+        void indexCurve(Node* start)
         {
-            //
-            // TODO: handle more primitive modes
-            //
+            Node* p = start;
+            do
+            {
+                p->z = zOrder(p->x, p->y);
+                p->prevZ = p->prev;
+                p->nextZ = p->next;
+                p = p->next;
+            }
+            while (p != start);
+
+            p->prevZ->nextZ = 0L;
+            p->prevZ = 0L;
+
+            sortLinked(p);
         }
-    }
 
-    return success;
-}
+        static bool isEar(const Node* ear)
+        {
+            const Node* a = ear->prev;
+            const Node* b = ear;
+            const Node* c = ear->next;
 
+            if (area(a, b, c) >= 0.0) return false; // reflex
 
-osg::PrimitiveSet*
-Tessellator::tessellatePrimitive(osg::PrimitiveSet* primitive, osg::Vec3Array* vertices)
-{
-    //
-    //TODO: Hnadle more primitive types
-    //
+            const Node* p = ear->next->next;
+            while (p != ear->prev)
+            {
+                if (pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+                    area(p->prev, p, p->next) >= 0.0)
+                    return false;
+                p = p->next;
+            }
+            return true;
+        }
 
-    switch(primitive->getType())
-    {
-    case(osg::PrimitiveSet::DrawArraysPrimitiveType):
-        {
-            osg::DrawArrays* drawArray = static_cast<osg::DrawArrays*>(primitive);
-            unsigned int first = drawArray->getFirst();
-            unsigned int last = first+drawArray->getCount();
-            return tessellatePrimitive(first, last, vertices);
-         }
-    default:
-        OE_NOTICE << LC << "Primitive type " << primitive->getType()<< " not handled" << std::endl;
-        break;
-    }
+        bool isEarHashed(const Node* ear) const
+        {
+            const Node* a = ear->prev;
+            const Node* b = ear;
+            const Node* c = ear->next;
 
-    return 0L;
-}
+            if (area(a, b, c) >= 0.0) return false; // reflex
 
-osg::PrimitiveSet*
-Tessellator::tessellatePrimitive(unsigned int first, unsigned int last, osg::Vec3Array* vertices)
-{
-    std::vector<unsigned int> activeVerts;
-    activeVerts.reserve( last-first+1 );
-    for (unsigned int i=first; i < last; i++)
-    {
-        activeVerts.push_back(i);
-    }
+            // z-order range of the triangle's bounding box
+            int minZ = zOrder(
+                osg::minimum(a->x, osg::minimum(b->x, c->x)),
+                osg::minimum(a->y, osg::minimum(b->y, c->y)));
+            int maxZ = zOrder(
+                osg::maximum(a->x, osg::maximum(b->x, c->x)),
+                osg::maximum(a->y, osg::maximum(b->y, c->y)));
 
-    TriList tris;
-    tris.reserve( activeVerts.size() );
+            const Node* p = ear->prevZ;
+            const Node* n = ear->nextZ;
 
-    bool success = true;
-    unsigned int cursor = 0;
-    unsigned int cursor_start = 0;
-    unsigned int tradCursor = UINT_MAX;
-    while (activeVerts.size() > 3)
-    {
-        if (isConvex(*vertices, activeVerts, cursor))
-        {
-            bool tradEar = tradCursor != UINT_MAX;
-            if (isEar(*vertices, activeVerts, cursor, tradEar))
+            // look both ways along the curve
+            while (p && p->z >= minZ && n && n->z <= maxZ)
             {
-                unsigned int prev = cursor == 0 ? activeVerts.size() - 1 : cursor - 1;
-                unsigned int next = cursor == activeVerts.size() - 1 ? 0 : cursor + 1;
-
-                tris.push_back(TriIndices(activeVerts[prev], activeVerts[cursor], activeVerts[next]));
-              
-                activeVerts.erase(activeVerts.begin() + cursor);
-                if (cursor >= activeVerts.size())
-                    cursor = 0;
+                if (p != ear->prev && p != ear->next &&
+                    pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+                    area(p->prev, p, p->next) >= 0.0)
+                    return false;
+                p = p->prevZ;
+
+                if (n != ear->prev && n != ear->next &&
+                    pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, n->x, n->y) &&
+                    area(n->prev, n, n->next) >= 0.0)
+                    return false;
+                n = n->nextZ;
+            }
 
-                cursor_start = cursor;
-                tradCursor = UINT_MAX;
+            while (p && p->z >= minZ)
+            {
+                if (p != ear->prev && p != ear->next &&
+                    pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+                    area(p->prev, p, p->next) >= 0.0)
+                    return false;
+                p = p->prevZ;
+            }
 
-                continue;
+            while (n && n->z <= maxZ)
+            {
+                if (n != ear->prev && n != ear->next &&
+                    pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, n->x, n->y) &&
+                    area(n->prev, n, n->next) >= 0.0)
+                    return false;
+                n = n->nextZ;
             }
-            
-            if (tradEar && tradCursor == UINT_MAX)
+
+            return true;
+        }
+
+        void addTriangle(const Node* a, const Node* b, const Node* c)
+        {
+            _out.push_back(a->i);
+            _out.push_back(b->i);
+            _out.push_back(c->i);
+        }
+
+        // walks the ring and clips off small self-intersections
+        Node* cureLocalIntersections(Node* start)
+        {
+            Node* p = start;
+            do
             {
-                tradCursor = cursor;
+                Node* a = p->prev;
+                Node* b = p->next->next;
+
+                if (!equals(a, b) && intersects(a, p, p->next, b) && locallyInside(a, b) && locallyInside(b, a))
+                {
+                    addTriangle(a, p, b);
+                    removeNode(p);
+                    removeNode(p->next);
+                    p = start = b;
+                }
+                p = p->next;
             }
+            while (p != start);
+
+            return filterPoints(p);
         }
 
-        cursor++;
-        if (cursor >= activeVerts.size())
-            cursor = 0;
+        // links a and b with a new edge, splitting the ring in two; returns the new half
+        Node* splitPolygon(Node* a, Node* b)
+        {
+            Node* a2 = createNode(a->i, a->x, a->y);
+            Node* b2 = createNode(b->i, b->x, b->y);
+            Node* an = a->next;
+            Node* bp = b->prev;
+
+            a->next = b;
+            b->prev = a;
+
+            a2->next = an;
+            an->prev = a2;
+
+            b2->next = a2;
+            a2->prev = b2;
+
+            bp->next = b2;
+            b2->prev = bp;
 
-        if (cursor == cursor_start)
+            return b2;
+        }
+
+        // last resort: split the ring along a valid diagonal and clip each half
+        void splitEarcut(Node* start)
         {
-            if (tradCursor != UINT_MAX)
+            Node* a = start;
+            do
             {
-                // No ear was found with circumcircle test, use first traditional ear found
+                Node* b = a->next->next;
+                while (b != a->prev)
+                {
+                    if (a->i != b->i && isValidDiagonal(a, b))
+                    {
+                        Node* c = splitPolygon(a, b);
 
-                cursor = tradCursor;
+                        a = filterPoints(a, a->next);
+                        c = filterPoints(c, c->next);
 
-                unsigned int prev = cursor == 0 ? activeVerts.size() - 1 : cursor - 1;
-                unsigned int next = cursor == activeVerts.size() - 1 ? 0 : cursor + 1;
+                        earcutLinked(a, 0);
+                        earcutLinked(c, 0);
+                        return;
+                    }
+                    b = b->next;
+                }
+                a = a->next;
+            }
+            while (a != start);
+        }
 
-                tris.push_back(TriIndices(activeVerts[prev], activeVerts[cursor], activeVerts[next]));
-                  
-                activeVerts.erase(activeVerts.begin() + cursor);
-                if (cursor >= activeVerts.size())
-                    cursor = 0;
+        static bool compareX(const Node* a, const Node* b)
+        {
+            return a->x < b->x;
+        }
 
-                cursor_start = cursor;
-                tradCursor = UINT_MAX;
+        static Node* getLeftmost(Node* start)
+        {
+            Node* p = start;
+            Node* leftmost = start;
+            do
+            {
+                if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y))
+                    leftmost = p;
+                p = p->next;
+            }
+            while (p != start);
+            return leftmost;
+        }
 
-                continue;
+        // whether sector in vertex m contains sector in vertex p in the same coordinates
+        static bool sectorContainsSector(const Node* m, const Node* p)
+        {
+            return area(m->prev, m, p->prev) < 0.0 && area(p->next, m, m->prev) < 0.0;
+        }
+
+        // finds a vertex of the outer ring that the hole's leftmost vertex can
+        // see, by casting a ray to the left (David Eberly's algorithm)
+        static Node* findHoleBridge(Node* hole, Node* outer)
+        {
+            Node* p = outer;
+            double hx = hole->x;
+            double hy = hole->y;
+            double qx = -DBL_MAX;
+            Node* m = 0L;
+
+            // the segment of the outer ring nearest to the left of the hole
+            do
+            {
+                if (hy <= p->y && hy >= p->next->y && p->next->y != p->y)
+                {
+                    double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+                    if (x <= hx && x > qx)
+                    {
+                        qx = x;
+                        m = p->x < p->next->x ? p : p->next;
+                        if (x == hx)
+                            return m; // the hole touches the outer segment
+                    }
+                }
+                p = p->next;
             }
-            else
+            while (p != outer);
+
+            if (!m)
+                return 0L;
+
+            // look for vertices inside the triangle formed by the hole vertex,
+            // the ray's hit and the segment's endpoint; if there are any, bridge
+            // to the one with the smallest angle to the ray instead.
+            const Node* stop = m;
+            double mx = m->x;
+            double my = m->y;
+            double tanMin = DBL_MAX;
+
+            p = m;
+            do
             {
-                success = false;
-                break;
+                if (hx >= p->x && p->x >= mx && hx != p->x &&
+                    pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y))
+                {
+                    double tan = osg::absolute(hy - p->y) / (hx - p->x);
+
+                    if (locallyInside(p, hole) &&
+                        (tan < tanMin || (tan == tanMin && (p->x > m->x || (p->x == m->x && sectorContainsSector(m, p))))))
+                    {
+                        m = p;
+                        tanMin = tan;
+                    }
+                }
+                p = p->next;
             }
+            while (p != stop);
+
+            return m;
         }
-    }
 
-    if (success)
-    {
-        if (activeVerts.size() == 3)
+        // bridges a hole into the outer ring; returns the outer ring
+        Node* eliminateHole(Node* hole, Node* outer)
         {
-            // add last tri
-            tris.push_back(TriIndices(activeVerts[0], activeVerts[1], activeVerts[2]));
+            Node* bridge = findHoleBridge(hole, outer);
+            if (!bridge)
+                return outer;
+
+            Node* bridgeReverse = splitPolygon(bridge, hole);
+            filterPoints(bridgeReverse, bridgeReverse->next);
+            return filterPoints(bridge, bridge->next);
         }
 
-        osg::DrawElementsUInt* triElements = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, 0);
-        triElements->reserve( tris.size() * 3 );
-        for (TriList::const_iterator it = tris.begin(); it != tris.end(); ++it)
+        void earcutLinked(Node* ear, int pass)
         {
-            triElements->push_back(it->a);
-            triElements->push_back(it->b);
-            triElements->push_back(it->c);
+            if (!ear) return;
+
+            if (pass == 0 && _invSize != 0.0)
+                indexCurve(ear);
+
+            Node* stop = ear;
+
+            while (ear->prev != ear->next)
+            {
+                Node* prev = ear->prev;
+                Node* next = ear->next;
+
+                if (_invSize != 0.0 ? isEarHashed(ear) : isEar(ear))
+                {
+                    addTriangle(prev, ear, next);
+                    removeNode(ear);
+
+                    // skipping the next vertex leads to fewer sliver triangles
+                    ear = next->next;
+                    stop = next->next;
+                    continue;
+                }
+
+                ear = next;
+
+                // went all the way around without finding an ear:
+                if (ear == stop)
+                {
+                    if (pass == 0)
+                    {
+                        earcutLinked(filterPoints(ear), 1);
+                    }
+                    else if (pass == 1)
+                    {
+                        ear = cureLocalIntersections(filterPoints(ear));
+                        earcutLinked(ear, 2);
+                    }
+                    else
+                    {
+                        splitEarcut(ear);
+                    }
+                    break;
+                }
+            }
         }
 
-        return triElements;
-    }
-    else
-    {
-        //TODO: handle?
-        OE_DEBUG << LC << "Tessellation failed!" << std::endl;
-    }
+        // Links the loop of vertices [first, last) into a ring wound counter-
+        // clockwise (or clockwise if "ccw" is false), and returns it, or NULL if
+        // the loop is degenerate. Returns the loop's signed area (positive when
+        // counter-clockwise) in out_area.
+        Node* linkLoop(const osg::Vec3Array& vertices, unsigned first, unsigned last, bool ccw, double& out_area)
+        {
+            out_area = 0.0;
+            if (last - first < 3)
+                return 0L;
 
-    return 0L;
-}
+            for (unsigned i = first, j = last - 1; i < last; j = i++)
+            {
+                out_area += (double)vertices[j].x() * (double)vertices[i].y() - (double)vertices[i].x() * (double)vertices[j].y();
+            }
+            out_area *= 0.5;
+
+            Node* ring = 0L;
+            if ((out_area > 0.0) == ccw)
+            {
+                for (unsigned i = first; i < last; ++i)
+                    ring = insertNode(i, vertices[i].x(), vertices[i].y(), ring);
+            }
+            else
+            {
+                for (unsigned i = last; i-- > first; )
+                    ring = insertNode(i, vertices[i].x(), vertices[i].y(), ring);
+            }
 
+            // a closed ring repeats its first vertex
+            if (ring && equals(ring, ring->next))
+            {
+                Node* n = ring->next;
+                removeNode(ring);
+                ring = n;
+            }
 
-bool
-Tessellator::isConvex(const osg::Vec3Array &vertices, const std::vector<unsigned int> &activeVerts, unsigned int cursor)
-{
-    unsigned int prev = cursor == 0 ? activeVerts.size() - 1 : cursor - 1;
-    unsigned int next = cursor == activeVerts.size() - 1 ? 0 : cursor + 1;
+            if (!ring || ring->next == ring->prev)
+                return 0L;
+
+            return ring;
+        }
+
+        // Triangulates a polygon. The first loop is its outer boundary and the
+        // rest are holes. Returns the outer loop's signed area (positive when
+        // counter-clockwise) in out_area, and the total area of the holes in
+        // out_holesArea. Triangles are wound counter-clockwise.
+        void run(const osg::Vec3Array& vertices, const Loops& loops, double& out_area, double& out_holesArea)
+        {
+            out_area = 0.0;
+            out_holesArea = 0.0;
+            if (loops.empty())
+                return;
 
-    unsigned int a = activeVerts[prev];
-    unsigned int b = activeVerts[cursor];
-    unsigned int c = activeVerts[next];
+            Node* ring = linkLoop(vertices, loops[0].first, loops[0].second, true, out_area);
+            if (!ring)
+                return;
 
-    osg::Vec3d dataA;
-    dataA._v[0] = vertices[a][0];
-    dataA._v[1] = vertices[a][1];
-    dataA._v[2] = vertices[a][2];
+            unsigned count = loops[0].second - loops[0].first;
 
-    osg::Vec3d dataB;
-    dataB._v[0] = vertices[b][0];
-    dataB._v[1] = vertices[b][1];
-    dataB._v[2] = vertices[b][2];
+            if (loops.size() > 1)
+            {
+                // link the holes clockwise and bridge them into the outer ring
+                // from left to right.
+                std::vector<Node*> holes;
+                for (unsigned h = 1; h < loops.size(); ++h)
+                {
+                    double holeArea;
+                    Node* hole = linkLoop(vertices, loops[h].first, loops[h].second, false, holeArea);
+                    out_holesArea += osg::absolute(holeArea);
+                    count += loops[h].second - loops[h].first;
+                    if (hole)
+                        holes.push_back(getLeftmost(hole));
+                }
 
-    osg::Vec3d dataC;
-    dataC._v[0] = vertices[c][0];
-    dataC._v[1] = vertices[c][1];
-    dataC._v[2] = vertices[c][2];
+                std::sort(holes.begin(), holes.end(), compareX);
 
-    //http://www.gamedev.net/topic/542870-determine-which-side-of-a-line-a-point-is/#entry4500667
-    //(Bx - Ax) * (Cy - Ay) - (By - Ay) * (Cx - Ax)
+                for (unsigned h = 0; h < holes.size(); ++h)
+                    ring = eliminateHole(holes[h], ring);
+            }
 
-    return (dataB.x() - dataA.x()) * (dataC.y() - dataA.y()) - (dataB.y() - dataA.y()) * (dataC.x() - dataA.x()) > 0.0;
+            // only worth hashing for larger rings
+            if (count > 80)
+            {
+                double maxX, maxY;
+                _minX = maxX = ring->x;
+                _minY = maxY = ring->y;
+                const Node* p = ring->next;
+                while (p != ring)
+                {
+                    _minX = osg::minimum(_minX, p->x);
+                    _minY = osg::minimum(_minY, p->y);
+                    maxX  = osg::maximum(maxX, p->x);
+                    maxY  = osg::maximum(maxY, p->y);
+                    p = p->next;
+                }
+                double size = osg::maximum(maxX - _minX, maxY - _minY);
+                _invSize = size != 0.0 ? 32767.0 / size : 0.0;
+            }
+
+            earcutLinked(ring, 0);
+        }
+    };
+
+    double triangleArea(const osg::Vec3Array& v, unsigned a, unsigned b, unsigned c)
+    {
+        return 0.5 * (
+            ((double)v[b].x() - (double)v[a].x()) * ((double)v[c].y() - (double)v[a].y()) -
+            ((double)v[c].x() - (double)v[a].x()) * ((double)v[b].y() - (double)v[a].y()) );
+    }
 }
 
 bool
-Tessellator::isEar(const osg::Vec3Array &vertices, const std::vector<unsigned int> &activeVerts, unsigned int cursor, bool &tradEar)
+Tessellator::tessellateGeometry(osg::Geometry &geom)
 {
-    unsigned int prev = cursor == 0 ? activeVerts.size() - 1 : cursor - 1;
-    unsigned int next = cursor == activeVerts.size() - 1 ? 0 : cursor + 1;
+    osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
+
+    if (!vertices || vertices->empty() || geom.getPrimitiveSetList().empty()) return false;
 
-    osg::Vec3d cc(compute_circumcircle(vertices[activeVerts[prev]], vertices[activeVerts[cursor]], vertices[activeVerts[next]]));
+    // copy the original primitive set list
+    osg::Geometry::PrimitiveSetList originalPrimitives = geom.getPrimitiveSetList();
+
+    // clear the primitive sets
+    unsigned int nprimsetoriginal= geom.getNumPrimitiveSets();
+    if (nprimsetoriginal) geom.removePrimitiveSet(0, nprimsetoriginal);
+
+    // gather the loops; the first is the outer boundary and the rest are holes.
+    Loops loops;
+    osg::Geometry::PrimitiveSetList loopPrimitives;
 
-    unsigned int nextNext = next == activeVerts.size() - 1 ? 0 : next + 1;
+    bool success = true;
+    for (unsigned int i=0; i < originalPrimitives.size(); i++)
+    {
+        osg::ref_ptr<osg::PrimitiveSet> primitive = originalPrimitives[i].get();
 
-		// Check every point not part of the ear
-    bool circEar = true;
-		while( nextNext != prev )
-		{
-        unsigned int p = activeVerts[nextNext];
+        if (primitive->getMode()==osg::PrimitiveSet::POLYGON || primitive->getMode()==osg::PrimitiveSet::LINE_LOOP)
+        {
+            if (primitive->getType()==osg::PrimitiveSet::DrawArrayLengthsPrimitiveType)
+            {
+                osg::DrawArrayLengths* drawArrayLengths = static_cast<osg::DrawArrayLengths*>(primitive.get());
+                unsigned int first = drawArrayLengths->getFirst();
+                for(osg::DrawArrayLengths::iterator itr=drawArrayLengths->begin();
+                    itr!=drawArrayLengths->end();
+                    ++itr)
+                {
+                    unsigned int last = first + *itr;
+                    if (last - first >= 3)
+                    {
+                        loops.push_back(std::make_pair(first, last));
+                    }
+                    first = last;
+                }
+                loopPrimitives.push_back(primitive);
+            }
+            else if (primitive->getType()==osg::PrimitiveSet::DrawArraysPrimitiveType)
+            {
+                osg::DrawArrays* drawArray = static_cast<osg::DrawArrays*>(primitive.get());
+                if (drawArray->getCount() >= 3)
+                {
+                    unsigned int first = drawArray->getFirst();
+                    loops.push_back(std::make_pair(first, first + drawArray->getCount()));
+                    loopPrimitives.push_back(primitive);
+                }
+            }
+            else if (primitive->getNumIndices()>=3)
+            {
+                //
+                //TODO: Handle more primitive types
+                //
+                OE_NOTICE << LC << "Primitive type " << primitive->getType()<< " not handled" << std::endl;
 
-        if (circEar && point_in_circle(vertices[p], cc))
+                // add old primitive set back
+                geom.addPrimitiveSet(primitive);
+                success = false;
+            }
+        }
+        else
         {
-            circEar = false;
+            //
+            // TODO: handle more primitive modes
+            //
+        }
+    }
 
-            if (tradEar)
-              return false;
+    if (!loops.empty())
+    {
+        osg::PrimitiveSet* newPrimitive = tessellatePrimitive(loops, vertices);
+        if (newPrimitive)
+        {
+            geom.addPrimitiveSet(newPrimitive);
+        }
+        else
+        {
+            // tessellation failed, add old primitive sets back
+            for (unsigned int i=0; i < loopPrimitives.size(); i++)
+            {
+                geom.addPrimitiveSet(loopPrimitives[i].get());
+            }
+            success = false;
         }
+    }
 
-        if (!tradEar &&
-            point_in_tri(vertices[p].x(), vertices[p].y(),
-                         vertices[activeVerts[prev]].x(), vertices[activeVerts[prev]].y(),
-                         vertices[activeVerts[cursor]].x(), vertices[activeVerts[cursor]].y(),
-                         vertices[activeVerts[next]].x(), vertices[activeVerts[next]].y()))
-			  {
-            return false;
-			  }
+    return success;
+}
+
+osg::PrimitiveSet*
+Tessellator::tessellatePrimitive(const Loops& loops, osg::Vec3Array* vertices)
+{
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < loops.size(); ++i)
+    {
+        count += loops[i].second - loops[i].first;
+    }
+
+    IndexList indices;
+    indices.reserve( count > 2 ? (count-2+2*(loops.size()-1))*3 : 0 );
+
+    double outerArea, holesArea;
+    Earcut earcut( indices );
+    earcut.run( *vertices, loops, outerArea, holesArea );
+
+    // The clipped triangles must cover the polygon exactly. They won't when a
+    // ring crosses itself, a hole lies outside the outer ring, or clipping gave
+    // up, so report a failure and let the caller fall back on a general-purpose
+    // tessellator.
+    double ringArea = osg::absolute(outerArea) - holesArea;
 
-			  nextNext = nextNext == activeVerts.size() - 1 ? 0 : nextNext + 1;
-		}
+    double area = 0.0;
+    for (unsigned int i = 0; i < indices.size(); i += 3)
+    {
+        area += triangleArea(*vertices, indices[i], indices[i+1], indices[i+2]);
+    }
+
+    if ( osg::absolute(area - ringArea) > 1e-6 * osg::absolute(outerArea) )
+    {
+        OE_DEBUG << LC << "Tessellation failed!" << std::endl;
+        return 0L;
+    }
 
-    tradEar = true;
+    // keep the winding of the outer ring.
+    bool flip = outerArea < 0.0;
 
-		return circEar;
-}
\ No newline at end of file
+    osg::DrawElementsUInt* triElements = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, 0);
+    triElements->reserve( indices.size() );
+    for (unsigned int i = 0; i < indices.size(); i += 3)
+    {
+        triElements->push_back( indices[i] );
+        triElements->push_back( flip ? indices[i+2] : indices[i+1] );
+        triElements->push_back( flip ? indices[i+1] : indices[i+2] );
+    }
+
+    return triElements;
+}
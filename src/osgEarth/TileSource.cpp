@@ -148,6 +148,8 @@ _noDataValue          ( (float)SHRT_MIN ),
 _minValidValue        ( -32000.0f ),
 _maxValidValue        (  32000.0f ),
 _L2CacheSize          ( 16 ),
+_L2CacheMaxBytes      ( 0u ),
+_L2CacheShareObjects  ( false ),
 _bilinearReprojection ( true ),
 _coverage             ( false )
 { 
@@ -165,6 +167,8 @@ TileSourceOptions::getConfig() const
     conf.updateIfSet( "max_valid_value", _maxValidValue );
     conf.updateIfSet( "blacklist_filename", _blacklistFilename);
     conf.updateIfSet( "l2_cache_size", _L2CacheSize );
+    conf.updateIfSet( "l2_cache_max_bytes", _L2CacheMaxBytes );
+    conf.updateIfSet( "l2_cache_share_objects", _L2CacheShareObjects );
     conf.updateIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.updateIfSet( "max_data_level", _maxDataLevel );
     conf.updateIfSet( "coverage", _coverage );
@@ -193,6 +197,8 @@ TileSourceOptions::fromConfig( const Config& conf )
     conf.getIfSet( "nodata_max", _maxValidValue ); // backcompat
     conf.getIfSet( "blacklist_filename", _blacklistFilename);
     conf.getIfSet( "l2_cache_size", _L2CacheSize );
+    conf.getIfSet( "l2_cache_max_bytes", _L2CacheMaxBytes );
+    conf.getIfSet( "l2_cache_share_objects", _L2CacheShareObjects );
     conf.getIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.getIfSet( "max_data_level", _maxDataLevel );
     conf.getIfSet( "coverage", _coverage );
@@ -240,7 +246,7 @@ _openCalled( false )
     // Initialize the l2 cache if it's size is > 0
     if ( l2CacheSize > 0 )
     {
-        _memCache = new MemCache( l2CacheSize );
+        _memCache = new MemCache( l2CacheSize, options.L2CacheMaxBytes().get() );
     }
 
     if (_options.blacklistFilename().isSet())
@@ -245,7 +245,8 @@ void MultithreadedTileVisitor::run(const Profile* mapProfile)
 {                   
     // Start up the task service
     OE_INFO << "Starting " << _numThreads << std::endl;
-    _taskService = new TaskService( "MTTileHandler", _numThreads, 1000 );
+    // Tiles are not prioritized, so spread the queue over one lane per processor.
+    _taskService = new TaskService( "MTTileHandler", _numThreads, 1000, 0u );
 
     // Produce the tiles
     TileVisitor::run( mapProfile );
@@ -363,7 +364,7 @@ void MultiprocessTileVisitor::setBatchSize( unsigned int batchSize )
 void MultiprocessTileVisitor::run(const Profile* mapProfile)
 {                             
     // Start up the task service          
-    _taskService = new TaskService( "MPTileHandler", _numProcesses, 1000 );
+    _taskService = new TaskService( "MPTileHandler", _numProcesses, 1000, 0u );
     
     // Produce the tiles
     TileVisitor::run( mapProfile );
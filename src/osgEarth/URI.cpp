@@ -23,6 +23,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Progress>
 #include <osgEarth/FileUtils>
+#include <osgEarth/ThreadingUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/ReaderWriter>
@@ -345,6 +346,11 @@ namespace
             if ( r.getImage() ) r.getImage()->setFileName( uri );
             return r;
         }
+        ReadResult fromFuture( HTTPFuture* f, const std::string& uri, const osgDB::Options* opt ) {
+            ReadResult r = f->readImage(opt);
+            if ( r.getImage() ) r.getImage()->setFileName( uri );
+            return r;
+        }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { 
             ReadResult r = ReadResult(osgDB::readImageFile(uri, opt));
             if ( r.getImage() ) r.getImage()->setFileName( uri );
@@ -366,9 +372,150 @@ namespace
             }
             return HTTPClient::readString(req, opt, p);
         }
+        ReadResult fromFuture( HTTPFuture* f, const std::string& uri, const osgDB::Options* opt ) { return f->readString(); }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { return readStringFile(uri, opt); }
     };
 
+    //--------------------------------------------------------------------
+    // Remote reads: consult the cache, hit the server if necessary, and
+    // write the result back to the cache.
+
+    template<typename READ_FUNCTOR>
+    ReadResult doRemoteRead(
+        READ_FUNCTOR&         reader,
+        const URI&            uri,
+        const osgDB::Options* localOptions,
+        URIReadCallback*      cb,
+        ProgressCallback*     progress,
+        bool&                 gotResultFromCallback)
+    {
+        ReadResult result;
+
+        bool callbackCachingOK = !cb || reader.callbackRequestsCaching(cb);
+
+        optional<CachePolicy> cp;
+        osg::ref_ptr<CacheBin> bin;
+
+        CacheSettings* cacheSettings = CacheSettings::get(localOptions);
+        if (cacheSettings)
+        {
+            cp = cacheSettings->cachePolicy();
+            if (cp->isCacheEnabled() && callbackCachingOK)
+            {
+                bin = cacheSettings->getCacheBin(); 
+            }
+        }
+
+        bool expired = false;
+        // first try to go to the cache if there is one:
+        if ( bin && cp->isCacheReadable() )
+        {                                                
+            result = reader.fromCache( bin, uri.cacheKey() );                        
+            if ( result.succeeded() )
+            {                                        
+                expired = cp->isExpired(result.lastModifiedTime());
+                result.setIsFromCache(true);
+            }
+        }
+
+        // If it's not cached, or it is cached but is expired then try to hit the server.                    
+        if ( result.empty() || expired )
+        {                        
+            // Need to do this to support nested PLODs and Proxynodes.
+            osg::ref_ptr<osgDB::Options> remoteOptions =
+                Registry::instance()->cloneOrCreateOptions( localOptions );
+            remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
+
+            // Store the existing object from the cache if there is one.
+            osg::ref_ptr< osg::Object > object = result.getObject();
+
+            // try to use the callback if it's set. Callback ignores the caching policy.
+            if ( cb )
+            {                
+                result = reader.fromCallback( cb, uri.full(), remoteOptions.get() );
+
+                if ( result.code() != ReadResult::RESULT_NOT_IMPLEMENTED )
+                {
+                    // "not implemented" is the only excuse for falling back
+                    gotResultFromCallback = true;
+                }
+            }
+
+            if ( !gotResultFromCallback )
+            {                            
+                // still no data, go to the source:
+                if ( (result.empty() || expired) && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
+                {                                
+                    ReadResult remoteResult = reader.fromHTTP( uri.full(), remoteOptions.get(), progress, result.lastModifiedTime() );
+                    if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED)
+                    {                                    
+                        OE_DEBUG << LC << uri.full() << " not modified, using cached result" << std::endl;
+                        // Touch the cached item to update it's last modified timestamp so it doesn't expire again immediately.
+                        if (bin)
+                            bin->touch( uri.cacheKey() );
+                    }
+                    else
+                    {
+                        OE_DEBUG << LC << "Got remote result for " << uri.full() << std::endl;
+                        result = remoteResult;                                    
+                    }
+                }
+
+                // write the result to the cache if possible:
+                if ( result.succeeded() && !result.isFromCache() && bin && cp->isCacheWriteable() && bin )
+                {
+                    OE_DEBUG << LC << "Writing " << uri.cacheKey() << " to cache" << std::endl;
+                    bin->write( uri.cacheKey(), result.getObject(), result.metadata(), remoteOptions );
+                }
+            }
+        }
+
+        OE_TEST << LC 
+            << uri.base() << ": " 
+            << (result.succeeded() ? "OK" : "FAILED") 
+            << "; policy=" << cp->usageString()
+            << (result.isFromCache() && result.succeeded() ? "; (from cache)" : "")
+            << std::endl;
+
+        return result;
+    }
+
+    // Concurrent reads of the same remote URI are coalesced so that only one
+    // thread goes to the cache and the server; one table per result type.
+    // The published result is a private copy that nobody modifies.
+    template<typename READ_FUNCTOR>
+    struct RemoteReads
+    {
+        struct Value
+        {
+            Value() : fromCallback(false) { }
+            ReadResult result;
+            bool       fromCallback;
+        };
+        typedef Threading::SingleFlight<std::string, Value> Flights;
+        static Flights s_flights;
+    };
+
+    template<typename READ_FUNCTOR>
+    typename RemoteReads<READ_FUNCTOR>::Flights RemoteReads<READ_FUNCTOR>::s_flights;
+
+    // Copy of a shared result that the caller is free to modify.
+    ReadResult copyOf(const ReadResult& rhs)
+    {
+        if ( !rhs.getObject() )
+            return rhs;
+
+        ReadResult r(
+            rhs.code(),
+            osg::clone(rhs.getObject(), osg::CopyOp::DEEP_COPY_ALL),
+            rhs.metadata() );
+        r.setIsFromCache( rhs.isFromCache() );
+        r.setLastModifiedTime( rhs.lastModifiedTime() );
+        r.setDuration( rhs.duration() );
+        r.setErrorDetail( rhs.errorDetail() );
+        return r;
+    }
+
     //--------------------------------------------------------------------
     // MASTER read template function. I templatized this so we wouldn't
     // have 4 95%-identical code paths to maintain...
@@ -452,91 +599,49 @@ namespace
                 // remote URI, consider caching:
                 else
                 {
-                    bool callbackCachingOK = !cb || reader.callbackRequestsCaching(cb);
-
-                    optional<CachePolicy> cp;
-                    osg::ref_ptr<CacheBin> bin;
-
-                    CacheSettings* cacheSettings = CacheSettings::get(localOptions.get());
-                    if (cacheSettings)
+                    // Coalesce with an identical read already in flight, if any.
+                    // Reads only match if everything that can change the result
+                    // matches: the options, the cache settings (cache, bin and
+                    // policy), the read callback, and the context.
+                    CacheSettings* cacheSettings = CacheSettings::get( localOptions.get() );
+                    std::string flightKey = Stringify()
+                        << uri.full()
+                        << "|" << uri.context().referrer()
+                        << "|" << (localOptions.valid() ? localOptions->getOptionString() : "")
+                        << "|" << (void*)cacheSettings
+                        << "|" << (cacheSettings ? cacheSettings->cachePolicy()->usageString() : "")
+                        << "|" << (void*)cb;
+
+                    osg::ref_ptr<typename RemoteReads<READ_FUNCTOR>::Flights::Call> call;
+                    typename RemoteReads<READ_FUNCTOR>::Value shared;
+
+                    if ( RemoteReads<READ_FUNCTOR>::s_flights.begin(flightKey, call, shared, progress) )
                     {
-                        cp = cacheSettings->cachePolicy();
-                        if (cp->isCacheEnabled() && callbackCachingOK)
+                        result = doRemoteRead( reader, uri, localOptions.get(), cb, progress, gotResultFromCallback );
+
+                        // A canceled or retryable failure is specific to this caller.
+                        bool shareable =
+                            result.succeeded() ||
+                            progress == 0L ||
+                            (!progress->isCanceled() && !progress->needsRetry());
+
+                        // Publish a copy, since this thread goes on to modify its own result.
+                        // close() stops new callers joining, so if nobody is waiting yet
+                        // there is no one to publish to and the copy can be skipped.
+                        typename RemoteReads<READ_FUNCTOR>::Value value;
+                        if ( shareable && RemoteReads<READ_FUNCTOR>::s_flights.close(call.get()) > 0u )
                         {
-                            bin = cacheSettings->getCacheBin(); 
+                            value.result = copyOf( result );
+                            value.fromCallback = gotResultFromCallback;
                         }
+                        RemoteReads<READ_FUNCTOR>::s_flights.end( call.get(), value, shareable );
                     }
-
-                    bool expired = false;
-                    // first try to go to the cache if there is one:
-                    if ( bin && cp->isCacheReadable() )
-                    {                                                
-                        result = reader.fromCache( bin, uri.cacheKey() );                        
-                        if ( result.succeeded() )
-                        {                                        
-                            expired = cp->isExpired(result.lastModifiedTime());
-                            result.setIsFromCache(true);
-                        }
-                    }
-
-                    // If it's not cached, or it is cached but is expired then try to hit the server.                    
-                    if ( result.empty() || expired )
-                    {                        
-                        // Need to do this to support nested PLODs and Proxynodes.
-                        osg::ref_ptr<osgDB::Options> remoteOptions =
-                            Registry::instance()->cloneOrCreateOptions( localOptions );
-                        remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
-
-                        // Store the existing object from the cache if there is one.
-                        osg::ref_ptr< osg::Object > object = result.getObject();
-
-                        // try to use the callback if it's set. Callback ignores the caching policy.
-                        if ( cb )
-                        {                
-                            result = reader.fromCallback( cb, uri.full(), remoteOptions.get() );
-
-                            if ( result.code() != ReadResult::RESULT_NOT_IMPLEMENTED )
-                            {
-                                // "not implemented" is the only excuse for falling back
-                                gotResultFromCallback = true;
-                            }
-                        }
-
-                        if ( !gotResultFromCallback )
-                        {                            
-                            // still no data, go to the source:
-                            if ( (result.empty() || expired) && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
-                            {                                
-                                ReadResult remoteResult = reader.fromHTTP( uri.full(), remoteOptions.get(), progress, result.lastModifiedTime() );
-                                if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED)
-                                {                                    
-                                    OE_DEBUG << LC << uri.full() << " not modified, using cached result" << std::endl;
-                                    // Touch the cached item to update it's last modified timestamp so it doesn't expire again immediately.
-                                    if (bin)
-                                        bin->touch( uri.cacheKey() );
-                                }
-                                else
-                                {
-                                    OE_DEBUG << LC << "Got remote result for " << uri.full() << std::endl;
-                                    result = remoteResult;                                    
-                                }
-                            }
-
-                            // write the result to the cache if possible:
-                            if ( result.succeeded() && !result.isFromCache() && bin && cp->isCacheWriteable() && bin )
-                            {
-                                OE_DEBUG << LC << "Writing " << uri.cacheKey() << " to cache" << std::endl;
-                                bin->write( uri.cacheKey(), result.getObject(), result.metadata(), remoteOptions );
-                            }
-                        }
+                    else
+                    {
+                        // (empty if this caller was canceled while waiting)
+                        result = copyOf( shared.result );
+                        gotResultFromCallback = shared.fromCallback;
                     }
-
-                    OE_TEST << LC 
-                        << uri.base() << ": " 
-                        << (result.succeeded() ? "OK" : "FAILED") 
-                        << "; policy=" << cp->usageString()
-                        << (result.isFromCache() && result.succeeded() ? "; (from cache)" : "")
-                        << std::endl;
                 }
 
 
@@ -561,6 +666,214 @@ namespace
 
         return result;
     }
+
+    //--------------------------------------------------------------------
+    // Asynchronous reads. Only the network wait is asynchronous; decoding
+    // and the cache write happen in URIFuture::get(), on the caller's thread.
+
+    // Does what doRead() does with a fresh result: names it, puts it in the
+    // memory cache, and runs the post-read callback.
+    void finishRead(ReadResult&           result,
+                    const URI&            uri,
+                    const osgDB::Options* localOptions,
+                    const osgDB::Options* dbOptions)
+    {
+        if ( result.getObject() )
+        {
+            result.getObject()->setName( uri.base() );
+
+            URIResultCache* memCache = URIResultCache::from( localOptions );
+            if ( memCache )
+            {
+                memCache->insert( uri, result );
+            }
+        }
+
+        URIPostReadCallback* post = URIPostReadCallback::from( dbOptions );
+        if ( post )
+        {
+            (*post)(result);
+        }
+    }
+
+    // A read that completed without waiting on the network.
+    class ReadyURIFuture : public URIFuture
+    {
+    public:
+        ReadyURIFuture(const ReadResult& result) : _result(result) { }
+        bool isAvailable() const { return true; }
+        ReadResult get() { return _result; }
+        void cancel() { }
+
+    private:
+        ReadResult _result;
+    };
+
+    // A remote read whose download is in flight on the HTTP I/O thread.
+    template<typename READ_FUNCTOR>
+    class RemoteURIFuture : public URIFuture
+    {
+    public:
+        RemoteURIFuture(HTTPFuture*                  http,
+                        const URI&                   uri,
+                        const ReadResult&            cached,
+                        CacheBin*                    bin,
+                        const optional<CachePolicy>& cp,
+                        const osgDB::Options*        localOptions,
+                        const osgDB::Options*        remoteOptions,
+                        const osgDB::Options*        dbOptions) :
+        _http         ( http ),
+        _uri          ( uri ),
+        _cached       ( cached ),
+        _bin          ( bin ),
+        _cp           ( cp ),
+        _localOptions ( localOptions ),
+        _remoteOptions( remoteOptions ),
+        _dbOptions    ( dbOptions ),
+        _done         ( false ) { }
+
+        bool isAvailable() const { return _http->isAvailable(); }
+
+        void cancel() { _http->cancel(); }
+
+        ReadResult get()
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+
+            if ( !_done )
+            {
+                READ_FUNCTOR reader;
+                ReadResult remoteResult = reader.fromFuture( _http.get(), _uri.full(), _remoteOptions.get() );
+                if ( remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED )
+                {
+                    OE_DEBUG << LC << _uri.full() << " not modified, using cached result" << std::endl;
+                    if ( _bin.valid() )
+                        _bin->touch( _uri.cacheKey() );
+                    _result = _cached;
+                }
+                else
+                {
+                    _result = remoteResult;
+                }
+
+                if ( _result.succeeded() && !_result.isFromCache() && _bin.valid() && _cp->isCacheWriteable() )
+                {
+                    OE_DEBUG << LC << "Writing " << _uri.cacheKey() << " to cache" << std::endl;
+                    _bin->write( _uri.cacheKey(), _result.getObject(), _result.metadata(), _remoteOptions.get() );
+                }
+
+                finishRead( _result, _uri, _localOptions.get(), _dbOptions.get() );
+                _done = true;
+            }
+
+            return _result;
+        }
+
+    private:
+        osg::ref_ptr<HTTPFuture>           _http;
+        URI                                _uri;
+        ReadResult                         _cached;
+        osg::ref_ptr<CacheBin>             _bin;
+        optional<CachePolicy>              _cp;
+        osg::ref_ptr<const osgDB::Options> _localOptions;
+        osg::ref_ptr<const osgDB::Options> _remoteOptions;
+        osg::ref_ptr<const osgDB::Options> _dbOptions;
+        Threading::Mutex                   _mutex;
+        ReadResult                         _result;
+        bool                               _done;
+    };
+
+    template<typename READ_FUNCTOR>
+    URIFuture* doReadAsync(
+        const URI&            inputURI,
+        const osgDB::Options* dbOptions,
+        ProgressCallback*     progress)
+    {
+        if ( inputURI.empty() )
+        {
+            return new ReadyURIFuture( doRead<READ_FUNCTOR>(inputURI, dbOptions, progress) );
+        }
+
+        // establish our IO options, as doRead() does:
+        osg::ref_ptr<const osgDB::Options> localOptions = dbOptions ? dbOptions : Registry::instance()->getDefaultOptions();
+        if ( inputURI.optionString().isSet() )
+        {
+            osgDB::Options* newLocalOptions = Registry::cloneOrCreateOptions(localOptions.get());
+            newLocalOptions->setOptionString(
+                inputURI.optionString().get() + " " + localOptions->getOptionString());
+            localOptions = newLocalOptions;
+        }
+
+        URI uri = inputURI;
+        URIAliasMap* aliasMap = URIAliasMap::from( localOptions.get() );
+        if ( aliasMap )
+        {
+            uri = aliasMap->resolve(inputURI.full(), inputURI.context());
+        }
+
+        // Local files, read callbacks and memory cache hits don't wait on the
+        // network, so take the blocking path for those.
+        URIResultCache* memCache = URIResultCache::from( localOptions.get() );
+        URIResultCache::Record rec;
+        if ( !uri.isRemote() ||
+             Registry::instance()->getURIReadCallback() ||
+             (memCache && memCache->get(uri, rec)) )
+        {
+            return new ReadyURIFuture( doRead<READ_FUNCTOR>(inputURI, dbOptions, progress) );
+        }
+
+        READ_FUNCTOR reader;
+
+        optional<CachePolicy> cp;
+        osg::ref_ptr<CacheBin> bin;
+
+        CacheSettings* cacheSettings = CacheSettings::get( localOptions.get() );
+        if ( cacheSettings )
+        {
+            cp = cacheSettings->cachePolicy();
+            if ( cp->isCacheEnabled() )
+            {
+                bin = cacheSettings->getCacheBin();
+            }
+        }
+
+        ReadResult cached;
+        if ( bin.valid() && cp->isCacheReadable() )
+        {
+            cached = reader.fromCache( bin.get(), uri.cacheKey() );
+            if ( cached.succeeded() )
+            {
+                cached.setIsFromCache( true );
+                if ( !cp->isExpired(cached.lastModifiedTime()) )
+                {
+                    finishRead( cached, uri, localOptions.get(), dbOptions );
+                    return new ReadyURIFuture( cached );
+                }
+            }
+        }
+
+        if ( cp->usage() == CachePolicy::USAGE_CACHE_ONLY )
+        {
+            finishRead( cached, uri, localOptions.get(), dbOptions );
+            return new ReadyURIFuture( cached );
+        }
+
+        HTTPRequest request( uri.full() );
+        if ( cached.lastModifiedTime() > 0 )
+        {
+            request.setLastModified( cached.lastModifiedTime() );
+        }
+
+        // Need to do this to support nested PLODs and Proxynodes.
+        osg::ref_ptr<osgDB::Options> remoteOptions =
+            Registry::instance()->cloneOrCreateOptions( localOptions.get() );
+        remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
+
+        osg::ref_ptr<HTTPFuture> http = HTTPClient::getAsync( request, remoteOptions.get(), progress );
+
+        return new RemoteURIFuture<READ_FUNCTOR>(
+            http.get(), uri, cached, bin.get(), cp, localOptions.get(), remoteOptions.get(), dbOptions );
+    }
 }
 
 ReadResult
@@ -591,6 +904,40 @@ URI::readString(const osgDB::Options* dbOptions,
     return doRead<ReadString>( *this, dbOptions, progress );
 }
 
+osg::ref_ptr<HTTPFuture>
+URI::fetch(const osgDB::Options* dbOptions,
+           ProgressCallback*     progress ) const
+{
+    if ( !isRemote() )
+        return 0L;
+
+    return HTTPClient::getAsync( HTTPRequest(full()), dbOptions, progress );
+}
+
+URIFuture*
+URI::readImageAsync(const osgDB::Options* dbOptions,
+                    ProgressCallback*     progress ) const
+{
+    return doReadAsync<ReadImage>( *this, dbOptions, progress );
+}
+
+URIFuture*
+URI::readStringAsync(const osgDB::Options* dbOptions,
+                     ProgressCallback*     progress ) const
+{
+    return doReadAsync<ReadString>( *this, dbOptions, progress );
+}
+
+unsigned
+URI::getNumCoalescedReads()
+{
+    return
+        RemoteReads<ReadObject>::s_flights.getNumCoalesced() +
+        RemoteReads<ReadNode>::s_flights.getNumCoalesced() +
+        RemoteReads<ReadImage>::s_flights.getNumCoalesced() +
+        RemoteReads<ReadString>::s_flights.getNumCoalesced();
+}
+
 
 //------------------------------------------------------------------------
 
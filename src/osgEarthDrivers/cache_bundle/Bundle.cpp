@@ -0,0 +1,241 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "Bundle"
+#include <osgEarth/Notify>
+
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <errno.h>
+#   include <string.h>
+#endif
+
+#define LC "[BundleCache] "
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::BundleCache;
+
+Bundle::Bundle(unsigned id, const std::string& path) :
+_id           ( id ),
+_path         ( path ),
+_size         ( 0u ),
+_removeOnClose( false ),
+#ifdef _WIN32
+_handle       ( INVALID_HANDLE_VALUE )
+#else
+_fd           ( -1 )
+#endif
+{
+    //nop
+}
+
+Bundle::~Bundle()
+{
+    close();
+
+    if ( _removeOnClose )
+    {
+#ifdef _WIN32
+        ::DeleteFileA( _path.c_str() );
+#else
+        ::unlink( _path.c_str() );
+#endif
+    }
+}
+
+#ifdef _WIN32
+
+bool
+Bundle::open()
+{
+    _handle = ::CreateFileA(
+        _path.c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0L,
+        OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        0L );
+
+    if ( _handle == INVALID_HANDLE_VALUE )
+    {
+        OE_WARN << LC << "Failed to open bundle " << _path << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if ( !::GetFileSizeEx( (HANDLE)_handle, &size ) )
+    {
+        close();
+        return false;
+    }
+
+    _size = (uint64_t)size.QuadPart;
+    return true;
+}
+
+void
+Bundle::close()
+{
+    if ( _handle != INVALID_HANDLE_VALUE )
+    {
+        ::CloseHandle( (HANDLE)_handle );
+        _handle = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool
+Bundle::read(uint64_t offset, uint32_t length, std::vector<char>& out) const
+{
+    if ( _handle == INVALID_HANDLE_VALUE || offset + length > _size )
+        return false;
+
+    out.resize( length );
+    if ( length == 0u )
+        return true;
+
+    OVERLAPPED ov;
+    ::ZeroMemory( &ov, sizeof(ov) );
+    ov.Offset     = (DWORD)(offset & 0xffffffff);
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+
+    DWORD numRead = 0;
+    return
+        ::ReadFile( (HANDLE)_handle, &out[0], length, &numRead, &ov ) &&
+        numRead == length;
+}
+
+bool
+Bundle::append(const char* data, uint32_t length, uint64_t& out_offset)
+{
+    if ( _handle == INVALID_HANDLE_VALUE )
+        return false;
+
+    OVERLAPPED ov;
+    ::ZeroMemory( &ov, sizeof(ov) );
+    ov.Offset     = (DWORD)(_size & 0xffffffff);
+    ov.OffsetHigh = (DWORD)(_size >> 32);
+
+    DWORD numWritten = 0;
+    if ( !::WriteFile( (HANDLE)_handle, data, length, &numWritten, &ov ) || numWritten != length )
+        return false;
+
+    out_offset = _size;
+    _size = _size + length;
+    return true;
+}
+
+void
+Bundle::sync()
+{
+    if ( _handle != INVALID_HANDLE_VALUE )
+        ::FlushFileBuffers( (HANDLE)_handle );
+}
+
+#else // !_WIN32
+
+bool
+Bundle::open()
+{
+    _fd = ::open( _path.c_str(), O_RDWR | O_CREAT, 0644 );
+    if ( _fd < 0 )
+    {
+        OE_WARN << LC << "Failed to open bundle " << _path << ": " << ::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat buf;
+    if ( ::fstat( _fd, &buf ) != 0 )
+    {
+        close();
+        return false;
+    }
+
+    _size = (uint64_t)buf.st_size;
+    return true;
+}
+
+void
+Bundle::close()
+{
+    if ( _fd >= 0 )
+    {
+        ::close( _fd );
+        _fd = -1;
+    }
+}
+
+bool
+Bundle::read(uint64_t offset, uint32_t length, std::vector<char>& out) const
+{
+    if ( _fd < 0 || offset + length > _size )
+        return false;
+
+    out.resize( length );
+
+    size_t total = 0;
+    while( total < length )
+    {
+        ssize_t n = ::pread( _fd, &out[total], length - total, (off_t)(offset + total) );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return false;
+        total += (size_t)n;
+    }
+    return true;
+}
+
+bool
+Bundle::append(const char* data, uint32_t length, uint64_t& out_offset)
+{
+    if ( _fd < 0 )
+        return false;
+
+    uint64_t offset = _size;
+
+    size_t total = 0;
+    while( total < length )
+    {
+        ssize_t n = ::pwrite( _fd, data + total, length - total, (off_t)(offset + total) );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return false;
+        total += (size_t)n;
+    }
+
+    out_offset = offset;
+    _size = offset + length;
+    return true;
+}
+
+void
+Bundle::sync()
+{
+    if ( _fd >= 0 )
+        ::fsync( _fd );
+}
+
+#endif // _WIN32
@@ -0,0 +1,178 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "BundleCache"
+#include <osgEarth/URI>
+#include <osgEarth/FileUtils>
+#include <osgDB/Registry>
+#include <osgDB/FileUtils>
+#include <osgDB/ObjectWrapper>
+
+#define LC "[BundleCache] "
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::BundleCache;
+
+
+BundleCacheImpl::BundleCacheImpl( const CacheOptions& options ) :
+osgEarth::Cache( options ),
+_options       ( options )
+{
+    // Force OSG to initialize the image wrapper. Failure to do this can result
+    // in a race condition within OSG when the cache is accessed from multiple threads.
+    osgDB::ObjectWrapperManager* owm = osgDB::Registry::instance()->getObjectWrapperManager();
+    owm->findWrapper("osg::Image");
+    owm->findWrapper("osg::HeightField");
+
+    if ( _options.rootPath().isSet() )
+    {
+        _rootPath = URI( *_options.rootPath(), options.referrer() ).full();
+    }
+    else
+    {
+        // read the root path from ENV is necessary:
+        const char* cachePath = ::getenv(OSGEARTH_ENV_CACHE_PATH);
+        if ( cachePath )
+        {
+            _rootPath = cachePath;
+            OE_INFO << LC << "Cache location set from environment: \""
+                << cachePath << "\"" << std::endl;
+        }
+    }
+
+    if ( _rootPath.empty() )
+    {
+        _ok = false;
+        OE_WARN << LC << "Illegal: no root path set for cache!" << std::endl;
+    }
+    else if ( !osgDB::fileExists(_rootPath) && !osgEarth::makeDirectory(_rootPath) )
+    {
+        _ok = false;
+        OE_WARN << LC << "Failed to create root cache folder \"" << _rootPath << "\"" << std::endl;
+    }
+    else
+    {
+        OE_INFO << LC << "Opened a bundle cache at \"" << _rootPath << "\"" << std::endl;
+    }
+}
+
+BundleCacheBin*
+BundleCacheImpl::getOrCreateBin( const std::string& name )
+{
+    Threading::ScopedMutexLock lock( _binTableMutex );
+
+    osg::ref_ptr<BundleCacheBin>& bin = _binTable[name];
+    if ( !bin.valid() )
+        bin = new BundleCacheBin( name, _rootPath, _options );
+
+    return bin.get();
+}
+
+CacheBin*
+BundleCacheImpl::addBin( const std::string& name )
+{
+    if ( !_ok )
+        return 0L;
+
+    return _bins.getOrCreate( name, getOrCreateBin(name) );
+}
+
+CacheBin*
+BundleCacheImpl::getOrCreateDefaultBin()
+{
+    if ( !_ok )
+        return 0L;
+
+    static Threading::Mutex s_defaultBinMutex;
+    if ( !_defaultBin.valid() )
+    {
+        Threading::ScopedMutexLock lock( s_defaultBinMutex );
+        if ( !_defaultBin.valid() ) // double-check
+        {
+            _defaultBin = getOrCreateBin( "_default" );
+        }
+    }
+    return _defaultBin.get();
+}
+
+void
+BundleCacheImpl::removeBin( CacheBin* bin )
+{
+    if ( bin )
+    {
+        Threading::ScopedMutexLock lock( _binTableMutex );
+        _binTable.erase( bin->getID() );
+    }
+
+    Cache::removeBin( bin );
+}
+
+void
+BundleCacheImpl::getBins( BinList& out ) const
+{
+    Threading::ScopedMutexLock lock( _binTableMutex );
+
+    out.reserve( _binTable.size() );
+    for(BinTable::const_iterator i = _binTable.begin(); i != _binTable.end(); ++i)
+        out.push_back( i->second.get() );
+}
+
+off_t
+BundleCacheImpl::getApproximateSize() const
+{
+    BinList bins;
+    getBins( bins );
+
+    uint64_t total = 0u;
+    for(BinList::const_iterator i = bins.begin(); i != bins.end(); ++i)
+        total += (*i)->getStorageSize64();
+
+    return (off_t)total;
+}
+
+bool
+BundleCacheImpl::compact()
+{
+    // Work on a copy of the table: compacting or clearing a bin can take a
+    // while, and holding the table lock would stall every getOrCreateBin().
+    BinList bins;
+    getBins( bins );
+
+    bool ok = true;
+    for(BinList::iterator i = bins.begin(); i != bins.end(); ++i)
+    {
+        if ( !(*i)->compact() )
+            ok = false;
+    }
+    return ok;
+}
+
+bool
+BundleCacheImpl::clear()
+{
+    BinList bins;
+    getBins( bins );
+
+    bool ok = true;
+    for(BinList::iterator i = bins.begin(); i != bins.end(); ++i)
+    {
+        if ( !(*i)->clear() )
+            ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,941 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "BundleCacheBin"
+#include <osgEarth/Cache>
+#include <osgEarth/DateTime>
+#include <osgEarth/FileUtils>
+#include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <osgDB/Registry>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/Thread>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace osgEarth;
+using namespace osgEarth::Threading;
+using namespace osgEarth::Drivers::BundleCache;
+
+#undef  LC
+#define LC "[BundleCacheBin] "
+
+#define RECORD_MAGIC    0x5242454fu // "OEBR"
+#define RECORD_DELETED  1u
+
+#define INDEX_FILE      "index"
+#define BUNDLE_EXT      "bundle"
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    /**
+     * Every record in a bundle starts with this header, followed by the
+     * key, the metadata (JSON) and the serialized object. The index only
+     * holds key hashes, so the key is checked on every read. Removals
+     * append a header with the RECORD_DELETED flag so that rebuilding the
+     * index from the bundles doesn't bring removed records back.
+     */
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t flags;
+        uint32_t keyLength;
+        uint32_t metaLength;
+        uint32_t dataLength;
+        uint32_t reserved;
+        int64_t  timestamp;
+    };
+
+    bool encodeRecord(uint32_t           flags,
+                      int64_t            timestamp,
+                      const std::string& key,
+                      const std::string& meta,
+                      const std::string& data,
+                      std::vector<char>& out)
+    {
+        uint64_t length = sizeof(RecordHeader) + key.size() + meta.size() + data.size();
+        if ( length > UINT_MAX )
+            return false;
+
+        RecordHeader h;
+        h.magic      = RECORD_MAGIC;
+        h.flags      = flags;
+        h.keyLength  = (uint32_t)key.size();
+        h.metaLength = (uint32_t)meta.size();
+        h.dataLength = (uint32_t)data.size();
+        h.reserved   = 0u;
+        h.timestamp  = timestamp;
+
+        out.resize( (size_t)length );
+        char* ptr = &out[0];
+        ::memcpy( ptr, &h, sizeof(h) );         ptr += sizeof(h);
+        ::memcpy( ptr, key.data(), key.size() ); ptr += key.size();
+        ::memcpy( ptr, meta.data(), meta.size() ); ptr += meta.size();
+        ::memcpy( ptr, data.data(), data.size() );
+        return true;
+    }
+
+    /** Validates a record read from a bundle and locates its parts. */
+    bool decodeRecord(const std::vector<char>& buf,
+                      const std::string&       key,
+                      RecordHeader&            h,
+                      const char*&             meta,
+                      const char*&             data)
+    {
+        if ( buf.size() < sizeof(RecordHeader) )
+            return false;
+
+        ::memcpy( &h, &buf[0], sizeof(h) );
+
+        if ( h.magic != RECORD_MAGIC ||
+             (h.flags & RECORD_DELETED) != 0u ||
+             sizeof(h) + (uint64_t)h.keyLength + h.metaLength + h.dataLength != buf.size() ||
+             h.keyLength != key.size() ||
+             ::memcmp( &buf[sizeof(h)], key.data(), key.size() ) != 0 )
+        {
+            return false;
+        }
+
+        meta = &buf[0] + sizeof(h) + h.keyLength;
+        data = meta + h.metaLength;
+        return true;
+    }
+
+    bool sortByLocation(const std::pair<uint64_t, BundleRecord>& lhs,
+                        const std::pair<uint64_t, BundleRecord>& rhs)
+    {
+        return
+            lhs.second.bundle < rhs.second.bundle ||
+            (lhs.second.bundle == rhs.second.bundle && lhs.second.offset < rhs.second.offset);
+    }
+
+    /** A record copied to a new location during compaction */
+    struct Move
+    {
+        uint64_t hash;
+        uint32_t fromBundle;
+        uint64_t fromOffset;
+        uint32_t toBundle;
+        uint64_t toOffset;
+    };
+
+    int64_t now()
+    {
+        return (int64_t)DateTime().asTimeStamp();
+    }
+}
+
+//------------------------------------------------------------------------
+
+/**
+ * Runs one compaction on its own thread, so the write that crosses the
+ * compaction threshold doesn't have to wait for it.
+ */
+class BundleCacheBin::Compactor : public OpenThreads::Thread
+{
+public:
+    Compactor(BundleCacheBin* bin) : _bin(bin) { }
+
+    void run()
+    {
+        _bin->compactImpl();
+
+        ScopedMutexLock lock( _bin->_compactorMutex );
+        _bin->_compacting = false;
+    }
+
+private:
+    BundleCacheBin* _bin;
+};
+
+//------------------------------------------------------------------------
+
+BundleCacheBin::BundleCacheBin(const std::string&        binID,
+                               const std::string&        rootPath,
+                               const BundleCacheOptions& options) :
+osgEarth::CacheBin( binID ),
+_options          ( options ),
+_ok               ( false ),
+_opened           ( false ),
+_nextBundleID     ( 1u ),
+_totalBytes       ( 0u ),
+_compactor        ( 0L ),
+_compacting       ( false ),
+_closing          ( false )
+{
+    // Note: the cache may construct bins it never uses, so don't touch
+    // the disk until the first read or write.
+    _binPath  = osgDB::concatPaths( rootPath, binID );
+    _metaPath = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
+
+    _maxBundleBytes = (uint64_t)osg::maximum(_options.maxBundleSizeMB().get(), 1u) * 1048576u;
+
+    _rw = osgDB::Registry::instance()->getReaderWriterForExtension( "osgb" );
+
+#ifdef OSGEARTH_HAVE_ZLIB
+    _zlibOptions = Registry::instance()->cloneOrCreateOptions();
+    _zlibOptions->setPluginStringData("Compressor", "zlib");
+#endif
+
+    _codec = RawRecordCodec::create( _options );
+}
+
+BundleCacheBin::~BundleCacheBin()
+{
+    // stop a compaction in progress; the bundles it hasn't finished
+    // copying from stay where they are.
+    {
+        ScopedMutexLock lock( _compactorMutex );
+        _closing = true;
+    }
+
+    if ( _compactor )
+    {
+        _compactor->join();
+        delete _compactor;
+    }
+
+    if ( _writeBundle.valid() )
+        _writeBundle->sync();
+
+    _index.close();
+}
+
+bool
+BundleCacheBin::binValidForReading(bool silent)
+{
+    if ( !_opened )
+    {
+        ScopedMutexLock lock( _openMutex );
+        if ( !_opened ) // double-check
+        {
+            _ok = _rw.valid() && open();
+            _opened = true;
+
+            if ( !_ok && !silent )
+            {
+                OE_WARN << LC << "Failed to open cache bin at [" << _binPath << "]" << std::endl;
+            }
+        }
+    }
+    return _ok;
+}
+
+bool
+BundleCacheBin::binValidForWriting(bool silent)
+{
+    return binValidForReading( silent );
+}
+
+std::string
+BundleCacheBin::getHashedKey(const std::string& key) const
+{
+    return Stringify() << std::hex << std::setw(16) << std::setfill('0') << BundleIndex::hashKey(key);
+}
+
+const osgDB::Options*
+BundleCacheBin::mergeOptions(const osgDB::Options* dbo)
+{
+    if (!dbo)
+    {
+        return _zlibOptions.get();
+    }
+    else if (!_zlibOptions.valid())
+    {
+        return dbo;
+    }
+    else
+    {
+        osgDB::Options* merged = Registry::cloneOrCreateOptions(dbo);
+        merged->setPluginStringData("Compressor", "zlib");
+        return merged;
+    }
+}
+
+bool
+BundleCacheBin::open()
+{
+    if ( !osgDB::fileExists(_binPath) && !osgEarth::makeDirectory(_binPath) )
+        return false;
+
+    // the index locks the bin against other processes, so open it first.
+    bool created = false;
+    if ( !_index.open( osgDB::concatPaths(_binPath, INDEX_FILE), created ) )
+        return false;
+
+    // find the existing bundles:
+    osgDB::DirectoryContents files = osgDB::getDirectoryContents( _binPath );
+    for(osgDB::DirectoryContents::const_iterator i = files.begin(); i != files.end(); ++i)
+    {
+        if ( osgDB::getLowerCaseFileExtension(*i) != BUNDLE_EXT )
+            continue;
+
+        unsigned id = as<unsigned>( osgDB::getNameLessExtension(*i), 0u );
+        if ( id == 0u )
+            continue;
+
+        osg::ref_ptr<Bundle> bundle = new Bundle( id, osgDB::concatPaths(_binPath, *i) );
+        if ( bundle->open() )
+        {
+            _bundles[id] = bundle.get();
+            _totalBytes += bundle->getSize();
+        }
+    }
+
+    if ( !_bundles.empty() )
+        _nextBundleID = _bundles.rbegin()->first + 1u;
+
+    if ( created && !_bundles.empty() )
+    {
+        rebuildIndex();
+    }
+
+    OE_DEBUG << LC << "Opened bin " << getID() << ": "
+        << _index.getNumRecords() << " records in "
+        << _bundles.size() << " bundles" << std::endl;
+
+    // Note: new writes always go to a new bundle, so a record left half
+    // written by a crash never sits in front of good ones.
+    return true;
+}
+
+bool
+BundleCacheBin::rebuildIndex()
+{
+    unsigned count = 0u;
+    std::vector<char> buf;
+
+    // bundles are in the order they were written, so later records
+    // correctly replace earlier ones.
+    for(BundleTable::const_iterator b = _bundles.begin(); b != _bundles.end(); ++b)
+    {
+        Bundle*  bundle = b->second.get();
+        uint64_t size   = bundle->getSize();
+        uint64_t offset = 0u;
+
+        while( offset + sizeof(RecordHeader) <= size )
+        {
+            RecordHeader h;
+            if ( !bundle->read(offset, sizeof(h), buf) )
+                break;
+            ::memcpy( &h, &buf[0], sizeof(h) );
+
+            uint64_t length = sizeof(h) + (uint64_t)h.keyLength + h.metaLength + h.dataLength;
+            if ( h.magic != RECORD_MAGIC || length > UINT_MAX || offset + length > size )
+            {
+                OE_WARN << LC << "Bundle " << bundle->getPath() << " is truncated at offset " << offset << std::endl;
+                break;
+            }
+
+            if ( !bundle->read(offset + sizeof(h), h.keyLength, buf) )
+                break;
+            std::string key = buf.empty() ? std::string() : std::string( &buf[0], buf.size() );
+            uint64_t hash = BundleIndex::hashKey( key );
+
+            BundleRecord previous;
+            if ( h.flags & RECORD_DELETED )
+            {
+                _index.remove( hash, previous );
+            }
+            else
+            {
+                BundleRecord rec;
+                rec.bundle    = bundle->getID();
+                rec.length    = (uint32_t)length;
+                rec.offset    = offset;
+                rec.timestamp = h.timestamp;
+
+                bool replaced;
+                if ( !_index.insert( hash, rec, replaced, previous ) )
+                    return false;
+            }
+
+            offset += length;
+            ++count;
+        }
+    }
+
+    _index.sync();
+
+    OE_INFO << LC << "Rebuilt the index for bin " << getID() << " from "
+        << count << " records; " << _index.getNumRecords() << " are live" << std::endl;
+
+    return true;
+}
+
+Bundle*
+BundleCacheBin::createBundle()
+{
+    return createBundle( _nextBundleID++ );
+}
+
+Bundle*
+BundleCacheBin::createBundle(unsigned id)
+{
+    // caller holds _writeMutex, the only lock under which the bundle table
+    // grows, so no read lock needed here.
+    std::string path = osgDB::concatPaths( _binPath,
+        Stringify() << std::setw(8) << std::setfill('0') << id << "." << BUNDLE_EXT );
+
+    osg::ref_ptr<Bundle> bundle = new Bundle( id, path );
+    if ( !bundle->open() )
+        return 0L;
+
+    {
+        ScopedWriteLock lock( _indexMutex );
+        _bundles[id] = bundle.get();
+    }
+
+    _totalBytes += bundle->getSize();
+    return bundle.get();
+}
+
+Bundle*
+BundleCacheBin::getWriteBundle(uint32_t length)
+{
+    if ( !_writeBundle.valid() ||
+         (_writeBundle->getSize() > 0u && _writeBundle->getSize() + length > _maxBundleBytes) )
+    {
+        if ( _writeBundle.valid() )
+            _writeBundle->sync();
+
+        _writeBundle = createBundle();
+    }
+    return _writeBundle.get();
+}
+
+ReadResult
+BundleCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
+{
+    osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+    return read(key, ImageReader(_rw.get(), dbo.get()));
+}
+
+ReadResult
+BundleCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
+{
+    osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+    return read(key, ObjectReader(_rw.get(), dbo.get()));
+}
+
+ReadResult
+BundleCacheBin::readNode(const std::string& key, const osgDB::Options* readOptions)
+{
+    osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+    return read(key, NodeReader(_rw.get(), dbo.get()));
+}
+
+ReadResult
+BundleCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
+{
+    ReadResult r = readObject(key, readOptions);
+    if ( r.succeeded() )
+    {
+        if ( r.get<StringObject>() )
+            return r;
+        else
+            return ReadResult();
+    }
+    else
+    {
+        return r;
+    }
+}
+
+ReadResult
+BundleCacheBin::read(const std::string& key, const Reader& reader)
+{
+    if ( !binValidForReading() )
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+    uint64_t hash = BundleIndex::hashKey( key );
+
+    // find the record. The lock only covers the lookup; the bundle
+    // reference keeps the file alive even if compaction retires it
+    // while we are still reading.
+    BundleRecord rec;
+    osg::ref_ptr<Bundle> bundle;
+    {
+        ScopedReadLock lock( _indexMutex );
+        if ( !_index.find(hash, rec) )
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        BundleTable::const_iterator i = _bundles.find( rec.bundle );
+        if ( i == _bundles.end() )
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        bundle = i->second.get();
+    }
+
+    std::vector<char> buf;
+    RecordHeader h;
+    const char* meta = 0L;
+    const char* data = 0L;
+
+    if ( !bundle->read(rec.offset, rec.length, buf) || !decodeRecord(buf, key, h, meta, data) )
+    {
+        // a hash collision or a damaged record.
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+    }
+
+    Config metadata;
+    if ( h.metaLength > 0u )
+        metadata.fromJSON( std::string(meta, h.metaLength) );
+
+    // decode the raw record or the OSGB stream in place.
+    ReadResult decoded = RawRecordCodec::decodeRecord( data, h.dataLength, reader );
+    if ( !decoded.succeeded() )
+    {
+        OE_WARN << LC << "Cache read failure! (" << key << ")"
+            << "\n reader = " << reader.name()
+            << "\n error detail = " << decoded.errorDetail()
+            << "\n";
+
+        return ReadResult(ReadResult::RESULT_READER_ERROR);
+    }
+
+    ReadResult rr(decoded.getObject(), metadata);
+    rr.setLastModifiedTime( (TimeStamp)rec.timestamp );
+    return rr;
+}
+
+bool
+BundleCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+{
+    if ( !binValidForWriting() || !object )
+        return false;
+
+    osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
+
+    // serialize outside of any lock.
+    osgDB::ReaderWriter::WriteResult r;
+    bool objWriteOK = false;
+    std::string data;
+    std::stringstream datastream;
+
+    // images and heightfields go out as raw records if the cache asks for it:
+    bool raw = RawRecordCodec::encodeIfEnabled(_codec.get(), object, data);
+
+    if ( raw )
+    {
+        objWriteOK = true;
+    }
+    else if ( dynamic_cast<const osg::Image*>(object) )
+    {
+        r = _rw->writeImage( *static_cast<const osg::Image*>(object), datastream, dbo.get() );
+        objWriteOK = r.success();
+    }
+    else if ( dynamic_cast<const osg::Node*>(object) )
+    {
+        r = _rw->writeNode( *static_cast<const osg::Node*>(object), datastream, dbo.get() );
+        objWriteOK = r.success();
+    }
+    else
+    {
+        r = _rw->writeObject( *object, datastream, dbo.get() );
+        objWriteOK = r.success();
+    }
+
+    if ( objWriteOK )
+    {
+        if ( !raw )
+            data = datastream.str();
+
+        objWriteOK = append( key, 0u, meta.empty() ? std::string() : meta.toJSON(false), data );
+    }
+
+    if ( objWriteOK )
+    {
+        OE_DEBUG << LC << "Bin " << getID() << ": wrote (" << key << ")" << std::endl;
+    }
+    else
+    {
+        OE_WARN << LC << "Bin " << getID() << ": FAILED to write (" << key << "); msg = \""
+            << r.message() << "\"" << std::endl;
+    }
+
+    return objWriteOK;
+}
+
+bool
+BundleCacheBin::append(const std::string& key, uint32_t flags, const std::string& meta, const std::string& data)
+{
+    int64_t timestamp = now();
+
+    std::vector<char> record;
+    if ( !encodeRecord(flags, timestamp, key, meta, data, record) )
+        return false;
+
+    uint32_t length = (uint32_t)record.size();
+    uint64_t hash   = BundleIndex::hashKey( key );
+
+    ScopedMutexLock writeLock( _writeMutex );
+
+    Bundle* bundle = getWriteBundle( length );
+    if ( !bundle )
+        return false;
+
+    // data goes to disk before the index points at it.
+    uint64_t offset;
+    if ( !bundle->append(&record[0], length, offset) )
+        return false;
+
+    _totalBytes += length;
+
+    bool ok;
+    {
+        ScopedWriteLock lock( _indexMutex );
+
+        BundleRecord previous;
+        if ( flags & RECORD_DELETED )
+        {
+            ok = _index.remove( hash, previous );
+        }
+        else
+        {
+            BundleRecord rec;
+            rec.bundle    = bundle->getID();
+            rec.length    = length;
+            rec.offset    = offset;
+            rec.timestamp = timestamp;
+
+            bool replaced;
+            ok = _index.insert( hash, rec, replaced, previous );
+        }
+    }
+
+    // compact once enough of the bin is taken up by replaced or removed records.
+    // Only the writer changes the live byte count, so no index lock is needed.
+    float ratio = _options.compactionRatio().get();
+    if ( ok && ratio > 0.0f )
+    {
+        uint64_t deadBytes = _totalBytes - osg::minimum(_totalBytes, _index.getLiveBytes());
+        uint64_t minBytes  = (uint64_t)_options.compactionMinMB().get() * 1048576u;
+
+        if ( deadBytes >= minBytes && (double)deadBytes > (double)ratio * (double)_totalBytes )
+        {
+            startCompaction();
+        }
+    }
+
+    return ok;
+}
+
+CacheBin::RecordStatus
+BundleCacheBin::getRecordStatus(const std::string& key)
+{
+    if ( !binValidForReading() )
+        return STATUS_NOT_FOUND;
+
+    BundleRecord rec;
+    ScopedReadLock lock( _indexMutex );
+    return _index.find( BundleIndex::hashKey(key), rec ) ? STATUS_OK : STATUS_NOT_FOUND;
+}
+
+bool
+BundleCacheBin::remove(const std::string& key)
+{
+    if ( !binValidForWriting() )
+        return false;
+
+    {
+        BundleRecord rec;
+        ScopedReadLock lock( _indexMutex );
+        if ( !_index.find(BundleIndex::hashKey(key), rec) )
+            return false;
+    }
+
+    return append( key, RECORD_DELETED, std::string(), std::string() );
+}
+
+bool
+BundleCacheBin::touch(const std::string& key)
+{
+    if ( !binValidForWriting() )
+        return false;
+
+    ScopedWriteLock lock( _indexMutex );
+    return _index.setTimestamp( BundleIndex::hashKey(key), now() );
+}
+
+bool
+BundleCacheBin::clear()
+{
+    if ( !binValidForWriting() )
+        return false;
+
+    ScopedMutexLock compactLock( _compactMutex );
+    ScopedMutexLock writeLock( _writeMutex );
+    ScopedWriteLock lock( _indexMutex );
+
+    // each file goes away once any in-progress reads release it.
+    for(BundleTable::iterator i = _bundles.begin(); i != _bundles.end(); ++i)
+        i->second->setRemoveOnClose( true );
+
+    _bundles.clear();
+    _writeBundle = 0L;
+    _totalBytes = 0u;
+
+    bool ok = _index.clear();
+    _index.sync();
+
+    OE_DEBUG << LC << "Cleared bin " << getID() << std::endl;
+    return ok;
+}
+
+bool
+BundleCacheBin::compact()
+{
+    if ( !binValidForWriting() )
+        return false;
+
+    return compactImpl();
+}
+
+void
+BundleCacheBin::startCompaction()
+{
+    ScopedMutexLock lock( _compactorMutex );
+    if ( _compacting || _closing )
+        return;
+
+    // the last compactor, if any, is done; reap it.
+    if ( _compactor )
+    {
+        _compactor->join();
+        delete _compactor;
+    }
+
+    _compacting = true;
+    _compactor = new Compactor( this );
+    _compactor->start();
+}
+
+bool
+BundleCacheBin::compactImpl()
+{
+    // Copies every live record into fresh bundles and deletes the old ones.
+    // Readers and writers keep going the whole time; writers only wait
+    // while we take the snapshot and when we retire the old bundles.
+    ScopedMutexLock compactLock( _compactMutex );
+
+    BundleIndex::Records live;
+    BundleTable retired;
+    uint64_t sizeBefore;
+    unsigned nextID, lastID;
+    {
+        ScopedMutexLock writeLock( _writeMutex );
+        {
+            ScopedReadLock lock( _indexMutex );
+            _index.getRecords( live );
+            retired = _bundles;
+        }
+        sizeBefore = _totalBytes;
+
+        // The copies go into bundles numbered below any that new writes go
+        // to, so rebuilding the index from the bundles still lets a record
+        // written during compaction replace its old copy. Each pair of
+        // consecutive output bundles holds more than a bundle's worth, which
+        // bounds how many IDs the copies can need.
+        uint64_t reserve = 2u * (_index.getLiveBytes() / _maxBundleBytes) + 2u;
+        nextID = _nextBundleID;
+        lastID = nextID + (unsigned)reserve - 1u;
+        _nextBundleID = lastID + 1u;
+
+        // new writes start a new bundle, so nothing more lands in the old ones.
+        if ( _writeBundle.valid() )
+            _writeBundle->sync();
+        _writeBundle = 0L;
+    }
+
+    // read each old bundle front to back.
+    std::sort( live.begin(), live.end(), sortByLocation );
+
+    osg::ref_ptr<Bundle> out;
+    uint64_t copied = 0u;
+
+    std::vector<Move> moves;
+    moves.reserve( 1024u );
+
+    std::vector<char> buf;
+    bool ok = true;
+
+    for(BundleIndex::Records::const_iterator i = live.begin(); i != live.end(); ++i)
+    {
+        if ( _closing )
+        {
+            ok = false;
+            break;
+        }
+
+        const BundleRecord& rec = i->second;
+
+        BundleTable::const_iterator b = retired.find( rec.bundle );
+        if ( b == retired.end() || !b->second->read(rec.offset, rec.length, buf) )
+            continue;
+
+        if ( !out.valid() || (out->getSize() > 0u && out->getSize() + rec.length > _maxBundleBytes) )
+        {
+            if ( out.valid() )
+                out->sync();
+
+            out = 0L;
+            if ( nextID <= lastID )
+            {
+                ScopedMutexLock writeLock( _writeMutex );
+                out = createBundle( nextID++ );
+            }
+        }
+
+        uint64_t offset;
+        if ( !out.valid() || !out->append(&buf[0], rec.length, offset) )
+        {
+            ok = false;
+            break;
+        }
+        copied += rec.length;
+
+        Move move = { i->first, rec.bundle, rec.offset, out->getID(), offset };
+        moves.push_back( move );
+
+        // repoint the index in batches to keep the write lock short. A record
+        // that was replaced or removed in the meantime stays as it is.
+        if ( moves.size() >= 1024u )
+        {
+            ScopedWriteLock lock( _indexMutex );
+            for(std::vector<Move>::const_iterator m = moves.begin(); m != moves.end(); ++m)
+                _index.relocate( m->hash, m->fromBundle, m->fromOffset, m->toBundle, m->toOffset );
+            moves.clear();
+        }
+    }
+
+    if ( !moves.empty() )
+    {
+        ScopedWriteLock lock( _indexMutex );
+        for(std::vector<Move>::const_iterator m = moves.begin(); m != moves.end(); ++m)
+            _index.relocate( m->hash, m->fromBundle, m->fromOffset, m->toBundle, m->toOffset );
+    }
+
+    if ( out.valid() )
+        out->sync();
+
+    uint64_t sizeAfter;
+    {
+        ScopedMutexLock writeLock( _writeMutex );
+        _totalBytes += copied;
+
+        if ( !ok )
+        {
+            // records that were already moved stay moved; everything else still
+            // points at the old bundles, which we keep.
+            if ( _closing )
+            {
+                OE_DEBUG << LC << "Compaction of bin " << getID() << " stopped at close" << std::endl;
+            }
+            else
+            {
+                OE_WARN << LC << "Compaction of bin " << getID() << " failed" << std::endl;
+            }
+            return false;
+        }
+
+        ScopedWriteLock lock( _indexMutex );
+
+        // the index has to reach the disk before the old bundles leave it.
+        _index.sync();
+
+        for(BundleTable::iterator i = retired.begin(); i != retired.end(); ++i)
+        {
+            i->second->setRemoveOnClose( true );
+            _totalBytes -= osg::minimum( _totalBytes, i->second->getSize() );
+            _bundles.erase( i->first );
+        }
+
+        sizeAfter = _totalBytes;
+    }
+
+    OE_INFO << LC << "Compacted bin " << getID() << " from "
+        << (sizeBefore/1048576) << " MB to " << (sizeAfter/1048576) << " MB" << std::endl;
+
+    return true;
+}
+
+uint64_t
+BundleCacheBin::getStorageSize64()
+{
+    if ( !binValidForReading() )
+        return 0u;
+
+    ScopedReadLock lock( _indexMutex );
+
+    uint64_t total = _index.getFileSize();
+    for(BundleTable::const_iterator i = _bundles.begin(); i != _bundles.end(); ++i)
+        total += i->second->getSize();
+    return total;
+}
+
+unsigned
+BundleCacheBin::getStorageSize()
+{
+    return (unsigned)osg::minimum( getStorageSize64(), (uint64_t)UINT_MAX );
+}
+
+Config
+BundleCacheBin::readMetadata()
+{
+    if ( !binValidForReading() )
+        return Config();
+
+    ScopedMutexLock lock( _writeMutex );
+
+    Config conf;
+    std::ifstream input( _metaPath.c_str() );
+    if ( input.is_open() )
+    {
+        std::stringstream buf;
+        buf << input.rdbuf();
+        conf.fromJSON( buf.str() );
+    }
+    return conf;
+}
+
+bool
+BundleCacheBin::writeMetadata(const Config& conf)
+{
+    if ( !binValidForWriting() )
+        return false;
+
+    ScopedMutexLock lock( _writeMutex );
+
+    std::ofstream output( _metaPath.c_str() );
+    if ( output.is_open() )
+    {
+        output << conf.toJSON(true);
+        output.flush();
+        output.close();
+        return true;
+    }
+    return false;
+}
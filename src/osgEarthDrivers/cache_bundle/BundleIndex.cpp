@@ -0,0 +1,585 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "BundleIndex"
+#include <osgEarth/Notify>
+#include <cstring>
+
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <sys/file.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <errno.h>
+#endif
+
+#define LC "[BundleCache] "
+
+#define INDEX_MAGIC    "OEBNDIDX"
+#define INDEX_VERSION  1u
+
+// initial number of slots in a new index (2MB of table)
+#define INITIAL_CAPACITY 65536u
+
+// reserved hash values marking unused slots
+#define SLOT_EMPTY    0u
+#define SLOT_DELETED  1u
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::BundleCache;
+
+struct BundleIndex::Header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t state;       // non-zero while the table is being rebuilt
+    uint64_t capacity;    // number of slots (a power of two)
+    uint64_t count;       // number of live records
+    uint64_t tombstones;  // number of deleted slots
+    char     reserved[24];
+};
+
+struct BundleIndex::Slot
+{
+    uint64_t hash;
+    uint64_t offset;
+    int64_t  timestamp;
+    uint32_t bundle;
+    uint32_t length;
+};
+
+//------------------------------------------------------------------------
+
+BundleIndex::BundleIndex() :
+_data      ( 0L ),
+_mappedSize( 0u ),
+_liveBytes ( 0u ),
+#ifdef _WIN32
+_file      ( INVALID_HANDLE_VALUE ),
+_mapping   ( 0L )
+#else
+_fd        ( -1 )
+#endif
+{
+    //nop
+}
+
+BundleIndex::~BundleIndex()
+{
+    close();
+}
+
+uint64_t
+BundleIndex::hashKey(const std::string& key)
+{
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for(std::string::const_iterator i = key.begin(); i != key.end(); ++i)
+    {
+        hash ^= (unsigned char)(*i);
+        hash *= 1099511628211ULL;
+    }
+    return hash > SLOT_DELETED ? hash : hash + 2u;
+}
+
+BundleIndex::Header*
+BundleIndex::header() const
+{
+    return (Header*)_data;
+}
+
+BundleIndex::Slot*
+BundleIndex::slots() const
+{
+    return (Slot*)((char*)_data + sizeof(Header));
+}
+
+#ifdef _WIN32
+
+namespace
+{
+    bool resizeFile(void* file, uint64_t size)
+    {
+        LARGE_INTEGER pos;
+        pos.QuadPart = (LONGLONG)size;
+        return
+            ::SetFilePointerEx( (HANDLE)file, pos, 0L, FILE_BEGIN ) &&
+            ::SetEndOfFile( (HANDLE)file );
+    }
+}
+
+bool
+BundleIndex::open(const std::string& path, bool& created)
+{
+    close();
+    _path = path;
+
+    // no sharing, so a second process can't open the bin at the same time.
+    _file = ::CreateFileA(
+        _path.c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        0,
+        0L,
+        OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        0L );
+
+    if ( _file == INVALID_HANDLE_VALUE )
+    {
+        if ( ::GetLastError() == ERROR_SHARING_VIOLATION )
+        {
+            OE_WARN << LC << "Index " << _path << " is in use by another process" << std::endl;
+        }
+        else
+        {
+            OE_WARN << LC << "Failed to open index " << _path << std::endl;
+        }
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    uint64_t fileSize = ::GetFileSizeEx( (HANDLE)_file, &size ) ? (uint64_t)size.QuadPart : 0u;
+
+#else // !_WIN32
+
+namespace
+{
+    bool resizeFile(int fd, uint64_t size)
+    {
+        return ::ftruncate( fd, (off_t)size ) == 0;
+    }
+}
+
+bool
+BundleIndex::open(const std::string& path, bool& created)
+{
+    close();
+    _path = path;
+
+    _fd = ::open( _path.c_str(), O_RDWR | O_CREAT, 0644 );
+    if ( _fd < 0 )
+    {
+        OE_WARN << LC << "Failed to open index " << _path << std::endl;
+        return false;
+    }
+
+    // hold an exclusive lock until close() so a second process can't open
+    // the bin at the same time.
+    if ( ::flock( _fd, LOCK_EX | LOCK_NB ) != 0 )
+    {
+        if ( errno == EWOULDBLOCK )
+        {
+            OE_WARN << LC << "Index " << _path << " is in use by another process" << std::endl;
+        }
+        else
+        {
+            OE_WARN << LC << "Failed to lock index " << _path << std::endl;
+        }
+
+        ::close( _fd );
+        _fd = -1;
+        return false;
+    }
+
+    struct stat buf;
+    uint64_t fileSize = ::fstat( _fd, &buf ) == 0 ? (uint64_t)buf.st_size : 0u;
+
+#endif // _WIN32
+
+    created = false;
+
+    if ( fileSize >= sizeof(Header) && map(fileSize) )
+    {
+        const Header* h = header();
+        bool valid =
+            ::memcmp( h->magic, INDEX_MAGIC, 8 ) == 0 &&
+            h->version == INDEX_VERSION &&
+            h->state == 0u &&
+            h->capacity > 0u &&
+            (h->capacity & (h->capacity-1u)) == 0u &&
+            fileSize == sizeof(Header) + h->capacity * sizeof(Slot);
+
+        if ( valid )
+        {
+            const Slot* s = slots();
+            for(uint64_t i=0; i<h->capacity; ++i)
+            {
+                if ( s[i].hash > SLOT_DELETED )
+                    _liveBytes += s[i].length;
+            }
+            return true;
+        }
+
+        OE_WARN << LC << "Index " << _path << " is damaged and will be rebuilt" << std::endl;
+    }
+
+    created = true;
+    return create( INITIAL_CAPACITY );
+}
+
+void
+BundleIndex::close()
+{
+    if ( _data )
+    {
+        sync();
+        unmap();
+    }
+#ifdef _WIN32
+    if ( _file != INVALID_HANDLE_VALUE )
+    {
+        ::CloseHandle( (HANDLE)_file );
+        _file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if ( _fd >= 0 )
+    {
+        ::close( _fd );
+        _fd = -1;
+    }
+#endif
+    _liveBytes = 0u;
+}
+
+bool
+BundleIndex::map(uint64_t size)
+{
+#ifdef _WIN32
+    _mapping = ::CreateFileMappingA( (HANDLE)_file, 0L, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)(size & 0xffffffff), 0L );
+    if ( !_mapping )
+        return false;
+
+    _data = ::MapViewOfFile( (HANDLE)_mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size );
+    if ( !_data )
+    {
+        ::CloseHandle( (HANDLE)_mapping );
+        _mapping = 0L;
+        return false;
+    }
+#else
+    void* data = ::mmap( 0L, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0 );
+    if ( data == MAP_FAILED )
+        return false;
+    _data = data;
+#endif
+    _mappedSize = size;
+    return true;
+}
+
+void
+BundleIndex::unmap()
+{
+#ifdef _WIN32
+    if ( _data )
+        ::UnmapViewOfFile( _data );
+    if ( _mapping )
+        ::CloseHandle( (HANDLE)_mapping );
+    _mapping = 0L;
+#else
+    if ( _data )
+        ::munmap( _data, (size_t)_mappedSize );
+#endif
+    _data = 0L;
+    _mappedSize = 0u;
+}
+
+void
+BundleIndex::sync()
+{
+    if ( !_data )
+        return;
+#ifdef _WIN32
+    ::FlushViewOfFile( _data, 0 );
+    ::FlushFileBuffers( (HANDLE)_file );
+#else
+    ::msync( _data, (size_t)_mappedSize, MS_SYNC );
+#endif
+}
+
+bool
+BundleIndex::create(uint64_t capacity)
+{
+    unmap();
+
+    uint64_t size = sizeof(Header) + capacity * sizeof(Slot);
+
+#ifdef _WIN32
+    if ( !resizeFile(_file, 0u) || !resizeFile(_file, size) || !map(size) )
+#else
+    if ( !resizeFile(_fd, 0u) || !resizeFile(_fd, size) || !map(size) )
+#endif
+    {
+        OE_WARN << LC << "Failed to create index " << _path << std::endl;
+        return false;
+    }
+
+    ::memset( _data, 0, (size_t)size );
+
+    Header* h = header();
+    ::memcpy( h->magic, INDEX_MAGIC, 8 );
+    h->version  = INDEX_VERSION;
+    h->capacity = capacity;
+
+    _liveBytes = 0u;
+    return true;
+}
+
+bool
+BundleIndex::rehash(uint64_t capacity)
+{
+    // pull the live records out of the table:
+    Records records;
+    getRecords( records );
+
+    // flag the table as in flux so a crash here forces a rebuild on the next open.
+    header()->state = 1u;
+    sync();
+
+    unmap();
+
+    uint64_t size = sizeof(Header) + capacity * sizeof(Slot);
+#ifdef _WIN32
+    if ( !resizeFile(_file, size) || !map(size) )
+#else
+    if ( !resizeFile(_fd, size) || !map(size) )
+#endif
+    {
+        OE_WARN << LC << "Failed to resize index " << _path << std::endl;
+        return false;
+    }
+
+    Header* h = header();
+    h->capacity   = capacity;
+    h->count      = 0u;
+    h->tombstones = 0u;
+    ::memset( slots(), 0, (size_t)(capacity * sizeof(Slot)) );
+
+    _liveBytes = 0u;
+    for(Records::const_iterator i = records.begin(); i != records.end(); ++i)
+    {
+        bool replaced;
+        BundleRecord previous;
+        insert( i->first, i->second, replaced, previous );
+    }
+
+    h->state = 0u;
+    return true;
+}
+
+bool
+BundleIndex::reserve()
+{
+    // keep the table at most 70% occupied, counting deleted slots since
+    // they lengthen probe sequences just like live ones.
+    const Header* h = header();
+    if ( (h->count + h->tombstones + 1u) * 10u <= h->capacity * 7u )
+        return true;
+
+    uint64_t capacity = h->capacity;
+    while( (h->count + 1u) * 2u > capacity )
+        capacity *= 2u;
+
+    return rehash( capacity );
+}
+
+BundleIndex::Slot*
+BundleIndex::findSlot(uint64_t hash) const
+{
+    if ( !_data )
+        return 0L;
+
+    uint64_t mask = header()->capacity - 1u;
+    Slot*    s    = slots();
+
+    for(uint64_t i = hash & mask, n = 0; n <= mask; i = (i+1u) & mask, ++n)
+    {
+        if ( s[i].hash == hash )
+            return &s[i];
+        if ( s[i].hash == SLOT_EMPTY )
+            return 0L;
+    }
+    return 0L;
+}
+
+bool
+BundleIndex::find(uint64_t hash, BundleRecord& out) const
+{
+    const Slot* slot = findSlot( hash );
+    if ( !slot )
+        return false;
+
+    out.bundle    = slot->bundle;
+    out.length    = slot->length;
+    out.offset    = slot->offset;
+    out.timestamp = slot->timestamp;
+    return true;
+}
+
+bool
+BundleIndex::insert(uint64_t hash, const BundleRecord& record, bool& replaced, BundleRecord& previous)
+{
+    replaced = false;
+
+    if ( !_data || !reserve() )
+        return false;
+
+    Header*  h    = header();
+    uint64_t mask = h->capacity - 1u;
+    Slot*    s    = slots();
+    Slot*    free = 0L;
+
+    for(uint64_t i = hash & mask, n = 0; n <= mask; i = (i+1u) & mask, ++n)
+    {
+        if ( s[i].hash == hash )
+        {
+            replaced = true;
+            previous.bundle    = s[i].bundle;
+            previous.length    = s[i].length;
+            previous.offset    = s[i].offset;
+            previous.timestamp = s[i].timestamp;
+            _liveBytes -= s[i].length;
+            free = &s[i];
+            break;
+        }
+        else if ( s[i].hash == SLOT_DELETED )
+        {
+            if ( !free )
+                free = &s[i];
+        }
+        else if ( s[i].hash == SLOT_EMPTY )
+        {
+            if ( !free )
+                free = &s[i];
+            break;
+        }
+    }
+
+    if ( !free )
+        return false;
+
+    if ( !replaced )
+    {
+        if ( free->hash == SLOT_DELETED )
+            --h->tombstones;
+        ++h->count;
+    }
+
+    // write the hash last so a torn update never looks like a valid slot
+    free->bundle    = record.bundle;
+    free->length    = record.length;
+    free->offset    = record.offset;
+    free->timestamp = record.timestamp;
+    free->hash      = hash;
+
+    _liveBytes += record.length;
+    return true;
+}
+
+bool
+BundleIndex::remove(uint64_t hash, BundleRecord& previous)
+{
+    Slot* slot = findSlot( hash );
+    if ( !slot )
+        return false;
+
+    previous.bundle    = slot->bundle;
+    previous.length    = slot->length;
+    previous.offset    = slot->offset;
+    previous.timestamp = slot->timestamp;
+
+    slot->hash = SLOT_DELETED;
+
+    Header* h = header();
+    --h->count;
+    ++h->tombstones;
+    _liveBytes -= previous.length;
+    return true;
+}
+
+bool
+BundleIndex::setTimestamp(uint64_t hash, int64_t timestamp)
+{
+    Slot* slot = findSlot( hash );
+    if ( !slot )
+        return false;
+
+    slot->timestamp = timestamp;
+    return true;
+}
+
+bool
+BundleIndex::relocate(uint64_t hash, uint32_t fromBundle, uint64_t fromOffset, uint32_t toBundle, uint64_t toOffset)
+{
+    Slot* slot = findSlot( hash );
+    if ( !slot || slot->bundle != fromBundle || slot->offset != fromOffset )
+        return false;
+
+    slot->bundle = toBundle;
+    slot->offset = toOffset;
+    return true;
+}
+
+bool
+BundleIndex::clear()
+{
+    if ( !_data )
+        return false;
+
+    Header* h = header();
+    ::memset( slots(), 0, (size_t)(h->capacity * sizeof(Slot)) );
+    h->count      = 0u;
+    h->tombstones = 0u;
+    _liveBytes    = 0u;
+    return true;
+}
+
+void
+BundleIndex::getRecords(Records& out) const
+{
+    if ( !_data )
+        return;
+
+    const Header* h = header();
+    const Slot*   s = slots();
+
+    out.reserve( out.size() + (size_t)h->count );
+
+    for(uint64_t i=0; i<h->capacity; ++i)
+    {
+        if ( s[i].hash > SLOT_DELETED )
+        {
+            BundleRecord r;
+            r.bundle    = s[i].bundle;
+            r.length    = s[i].length;
+            r.offset    = s[i].offset;
+            r.timestamp = s[i].timestamp;
+            out.push_back( std::make_pair(s[i].hash, r) );
+        }
+    }
+}
+
+uint64_t
+BundleIndex::getNumRecords() const
+{
+    return _data ? header()->count : 0u;
+}
@@ -25,9 +25,12 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/RawRecordCodec>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <algorithm>
 #include <fstream>
+#include <vector>
 #include <sys/stat.h>
 
 using namespace osgEarth;
@@ -72,6 +75,7 @@ namespace
         void init();
 
         std::string _rootPath;
+        osg::ref_ptr<RawRecordCodec> _codec;
     };
 
     /** 
@@ -81,7 +85,7 @@ namespace
     class FileSystemCacheBin : public CacheBin
     {
     public:
-        FileSystemCacheBin( const std::string& name, const std::string& rootPath );
+        FileSystemCacheBin( const std::string& name, const std::string& rootPath, RawRecordCodec* codec );
 
     public: // CacheBin interface
 
@@ -118,12 +122,15 @@ namespace
 
         const osgDB::Options* mergeOptions(const osgDB::Options* in);
 
+        osgDB::ReaderWriter::ReadResult readRawRecord(const std::string& path);
+
         bool                              _ok;
         bool                              _binPathExists;
         std::string                       _metaPath;       // full path to the bin's metadata file
         std::string                       _binPath;        // full path to the bin's root folder
         osg::ref_ptr<osgDB::ReaderWriter> _rw;
         osg::ref_ptr<osgDB::Options>      _zlibOptions;
+        osg::ref_ptr<RawRecordCodec>      _codec;          // raw record encoder, or NULL for osgb
         mutable Threading::Mutex          _mutex;
     };
 
@@ -178,6 +185,7 @@ namespace
         }
 
         _rootPath = URI( *fsco.rootPath(), options.referrer() ).full();
+        _codec = RawRecordCodec::create( fsco );
         init();
     }
 
@@ -190,7 +198,7 @@ namespace
     CacheBin*
     FileSystemCache::addBin( const std::string& name )
     {
-        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath ) );
+        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath, _codec.get() ) );
     }
 
     CacheBin*
@@ -202,7 +210,7 @@ namespace
             Threading::ScopedMutexLock lock( s_defaultBinMutex );
             if ( !_defaultBin.valid() ) // double-check
             {
-                _defaultBin = new FileSystemCacheBin( "__default", _rootPath );
+                _defaultBin = new FileSystemCacheBin( "__default", _rootPath, _codec.get() );
             }
         }
         return _defaultBin.get();
@@ -288,10 +296,12 @@ namespace
     }
 
     FileSystemCacheBin::FileSystemCacheBin(const std::string&   binID,
-                                           const std::string&   rootPath) :
+                                           const std::string&   rootPath,
+                                           RawRecordCodec*      codec) :
     CacheBin            ( binID ),
     _binPathExists      ( false ),
-    _ok( true )
+    _ok( true ),
+    _codec              ( codec )
     {
         _binPath = osgDB::concatPaths( rootPath, binID );
         _metaPath = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
@@ -325,6 +335,39 @@ namespace
         }
     }
 
+    osgDB::ReaderWriter::ReadResult
+    FileSystemCacheBin::readRawRecord(const std::string& path)
+    {
+        // Check the magic no matter which format this cache writes: the
+        // bin may hold records written under a different setting. Anything
+        // else is left to the osgb serializer.
+        std::ifstream in( path.c_str(), std::ios::binary );
+        if ( !in.is_open() )
+            return osgDB::ReaderWriter::ReadResult::FILE_NOT_HANDLED;
+
+        in.seekg( 0, std::ios::end );
+        std::streamoff size = in.tellg();
+        in.seekg( 0, std::ios::beg );
+        if ( size <= 0 )
+            return osgDB::ReaderWriter::ReadResult::FILE_NOT_HANDLED;
+
+        // peek at the header first so an osgb file isn't read twice.
+        std::streamoff head = std::min( size, (std::streamoff)128 );
+        std::vector<char> buf( (size_t)head );
+        if ( !in.read( &buf[0], head ) || !RawRecordCodec::isRecord(&buf[0], buf.size()) )
+            return osgDB::ReaderWriter::ReadResult::FILE_NOT_HANDLED;
+
+        buf.resize( (size_t)size );
+        if ( size > head && !in.read( &buf[(size_t)head], size - head ) )
+            return osgDB::ReaderWriter::ReadResult::ERROR_IN_READING_FILE;
+
+        osg::Object* object = RawRecordCodec::decode( &buf[0], buf.size() );
+        if ( !object )
+            return osgDB::ReaderWriter::ReadResult::ERROR_IN_READING_FILE;
+
+        return osgDB::ReaderWriter::ReadResult( object );
+    }
+
     ReadResult
     FileSystemCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
     {
@@ -346,7 +389,9 @@ namespace
         {
             ScopedMutexLock lock(_mutex);
 
-            r = _rw->readImage( path, dbo.get() );
+            r = readRawRecord( path );
+            if ( r.status() == r.FILE_NOT_HANDLED )
+                r = _rw->readImage( path, dbo.get() );
             if ( !r.success() )
                 return ReadResult();
 
@@ -383,7 +428,9 @@ namespace
         {
             ScopedMutexLock lock(_mutex);
 
-            r = _rw->readObject( path, dbo.get() );
+            r = readRawRecord( path );
+            if ( r.status() == r.FILE_NOT_HANDLED )
+                r = _rw->readObject( path, dbo.get() );
             if ( !r.success() )
                 return ReadResult();
 
@@ -438,7 +485,15 @@ namespace
 
             osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
 
-            if ( dynamic_cast<const osg::Image*>(object) )
+            // images and heightfields go out as raw records if the cache asks for it:
+            std::string raw;
+            if ( RawRecordCodec::encodeIfEnabled(_codec.get(), object, raw) )
+            {
+                std::string filename = fileURI.full() + OSG_EXT;
+                std::ofstream out( filename.c_str(), std::ios::binary | std::ios::trunc );
+                objWriteOK = out.is_open() && out.write( raw.data(), raw.size() ).good();
+            }
+            else if ( dynamic_cast<const osg::Image*>(object) )
             {
                 std::string filename = fileURI.full() + OSG_EXT;
                 r = _rw->writeImage( *static_cast<const osg::Image*>(object), filename, dbo.get() );
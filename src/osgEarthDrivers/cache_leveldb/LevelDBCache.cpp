@@ -44,7 +44,10 @@ using namespace osgEarth::Drivers::LevelDBCache;
 LevelDBCacheImpl::LevelDBCacheImpl( const CacheOptions& options ) :
 osgEarth::Cache( options ),
 _options       ( options ),
-_active        ( true )
+_active        ( true ),
+_db            ( 0L ),
+_blockCache    ( 0L ),
+_filterPolicy  ( 0L )
 {
     // Force OSG to initialize the image wrapper. Failure to do this can result
     // in a race condition within OSG when the cache is accessed from multiple threads.
@@ -89,6 +92,7 @@ _active        ( true )
     }
 
     _tracker = new Tracker(_options, _rootPath);
+    _codec = RawRecordCodec::create(_options);
     
     if ( !_rootPath.empty() )
     {
@@ -103,6 +107,12 @@ _active        ( true )
 
 LevelDBCacheImpl::~LevelDBCacheImpl()
 {
+    // commit anything still queued.
+    if ( _queue.valid() )
+    {
+        _queue->stop();
+    }
+
     if ( _db )
     {
         // problem. This destructor causes a lockup sometimes. Perhaps try
@@ -110,6 +120,9 @@ LevelDBCacheImpl::~LevelDBCacheImpl()
         // is commented out
         //delete _db;
         _db = 0L;
+
+        // the block cache and filter policy must outlive the database,
+        // so they leak along with it.
     }
 }
 
@@ -133,6 +146,12 @@ LevelDBCacheImpl::init()
     if ( _db )
     {
         _tracker->calcSize();
+
+        _queue = new WriteQueue(
+            _db,
+            _tracker.get(),
+            _options.writeBatchSize().value(),
+            _options.writeQueueSize().value() );
     }
 
     if ( _active )
@@ -147,6 +166,23 @@ LevelDBCacheImpl::open()
     leveldb::Options options;
     options.create_if_missing = true;
     options.block_size        = _options.blockSize().value();
+    options.write_buffer_size = _options.writeBufferSize().value();
+    options.max_open_files    = _options.maxOpenFiles().value();
+
+    // one block cache for the whole database, so every bin shares it.
+    if ( _options.blockCacheSize().value() > 0u )
+    {
+        _blockCache = leveldb::NewLRUCache( _options.blockCacheSize().value() );
+        options.block_cache = _blockCache;
+    }
+
+    // bloom filters let a miss skip the disk read, which is most
+    // lookups while a new area is being cached.
+    if ( _options.bloomFilterBits().value() > 0u )
+    {
+        _filterPolicy = leveldb::NewBloomFilterPolicy( _options.bloomFilterBits().value() );
+        options.filter_policy = _filterPolicy;
+    }
 
     leveldb::Status status;
         
@@ -179,7 +215,7 @@ CacheBin*
 LevelDBCacheImpl::addBin( const std::string& name )
 {
     return _db ?
-        _bins.getOrCreate(name, new LevelDBCacheBin(name, _db, _tracker.get())) :
+        _bins.getOrCreate(name, new LevelDBCacheBin(name, _db, _tracker.get(), _queue.get(), _codec.get())) :
         0L;
 }
 
@@ -195,7 +231,7 @@ LevelDBCacheImpl::getOrCreateDefaultBin()
         Threading::ScopedMutexLock lock( s_defaultBinMutex );
         if ( !_defaultBin.valid() ) // double-check
         {
-            _defaultBin = new LevelDBCacheBin("_default", _db, _tracker.get());
+            _defaultBin = new LevelDBCacheBin("_default", _db, _tracker.get(), _queue.get(), _codec.get());
         }
     }
     return _defaultBin.get();
@@ -224,14 +260,20 @@ LevelDBCacheImpl::clear()
     if ( !_db )
         return false;
 
+    // get everything queued into the database first so the scan sees it.
+    _queue->flush();
+
     // No WriteBatch because it doesn't seem to allow compaction to occur
     // -- need to figure out why someday.
 
-    leveldb::Iterator* it = _db->NewIterator(leveldb::ReadOptions());
+    leveldb::ReadOptions ro;
+    ro.fill_cache = false;
+    leveldb::Iterator* it = _db->NewIterator(ro);
     for(it->SeekToFirst(); it->Valid(); it->Next())
     {
         _db->Delete(leveldb::WriteOptions(), it->key());
     }
+    delete it;
 
     return true;
 }
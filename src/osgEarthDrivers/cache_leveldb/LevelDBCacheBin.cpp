@@ -21,7 +21,6 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Random>
 #include <osgDB/Registry>
-#include <leveldb/write_batch.h>
 #include <string>
 
 using namespace osgEarth;
@@ -81,10 +80,14 @@ namespace
 
 LevelDBCacheBin::LevelDBCacheBin(const std::string& binID,
                                  leveldb::DB*       db,
-                                 Tracker*           tracker) :
+                                 Tracker*           tracker,
+                                 WriteQueue*        queue,
+                                 RawRecordCodec*    codec) :
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
+_queue            ( queue ),
+_codec            ( codec ),
 _debug            ( false )
 {
     // reader to parse data:
@@ -199,7 +202,13 @@ LevelDBCacheBin::metaEnd() const
 std::string
 LevelDBCacheBin::timeKey(const DateTime& t, const std::string& key) const
 {
-    return "t" + SEP + t.asCompactISO8601() + SEP + getID() + SEP + key;
+    return timeKeyFromTuple(t, binDataKeyTuple(key));
+}
+
+std::string
+LevelDBCacheBin::timeKeyFromTuple(const DateTime& t, const std::string& tuple) const
+{
+    return "t" + SEP + t.asCompactISO8601() + SEP + tuple;
 }
 
 std::string
@@ -254,25 +263,41 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     ++_tracker->reads;
 
     Config metadata;
-    leveldb::Status status;
-    leveldb::ReadOptions ro;
-
-    // first read the metadata record.
     std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
+    std::string datavalue;
+
+    // records not yet committed come straight from the write queue. Look
+    // both up at once so a commit can't land between the two lookups.
+    WriteQueue::Lookup metaLookup, dataLookup;
+    _queue->find( metaKey(key), metavalue, metaLookup, dataKey(key), datavalue, dataLookup );
+    bool metaFound = (metaLookup == WriteQueue::QUEUED);
+    bool dataFound = (dataLookup == WriteQueue::QUEUED);
+
+    if ( metaLookup == WriteQueue::NOT_QUEUED || dataLookup == WriteQueue::NOT_QUEUED )
+    {
+        // read both records from the same snapshot so a concurrent commit
+        // can't pair the metadata of one write with the data of another.
+        leveldb::ReadOptions ro;
+        ro.snapshot = _db->GetSnapshot();
+
+        if ( metaLookup == WriteQueue::NOT_QUEUED )
+            metaFound = _db->Get( ro, metaKey(key), &metavalue ).ok();
+
+        if ( dataLookup == WriteQueue::NOT_QUEUED )
+            dataFound = _db->Get( ro, dataKey(key), &datavalue ).ok();
+
+        _db->ReleaseSnapshot( ro.snapshot );
+    }
+
     TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
+    if ( metaFound )
     {        
         decodeMeta(metavalue, metadata);
         DateTime t( metadata.value(TIME_FIELD));
         lastModified = t.asTimeStamp();
     }
         
-    // next read the data record.
-    std::string datakey = dataKey(key);
-    std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
-    if ( !status.ok() )
+    if ( !dataFound )
     {
         // main record not found for some reason.
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
@@ -282,19 +307,19 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     if ( _tracker->seed().isSet() )
         unblend(datavalue, _tracker->seed().value());
 
-    // finally, decode the OSGB stream into an object.
-    std::istringstream datastream(datavalue);
-    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
-    if ( !r.success() )
+    // finally, decode the record into an object: either a raw image/heightfield
+    // record or an OSGB stream.
+    ReadResult decoded = RawRecordCodec::decodeRecord(datavalue.data(), datavalue.size(), reader);
+    if ( !decoded.succeeded() )
     {
-        OE_WARN << LC << "Cache read failure!"
+        OE_WARN << LC << "Cache read failure! (" << key << ")"
             << "\n reader = " << reader.name()
-            << "\n error detail = " << r.message()
-            << "\n data value = " << datavalue
+            << "\n error detail = " << decoded.errorDetail()
             << "\n";
 
         return ReadResult(ReadResult::RESULT_READER_ERROR);
     }
+    osg::ref_ptr<osg::Object> object = decoded.getObject();
         
     if ( _debug )
     {
@@ -310,7 +335,7 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     }
 
     ++_tracker->hits;
-    ReadResult rr(r.getObject(), metadata);
+    ReadResult rr(object.get(), metadata);
     rr.setLastModifiedTime(lastModified);    
     return rr;
 }
@@ -344,7 +369,14 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     std::string       data;
     std::stringstream datastream;
 
-    if ( dynamic_cast<const osg::Image*>(object) )
+    // images and heightfields go out as raw records if the cache asks for it:
+    bool raw = RawRecordCodec::encodeIfEnabled(_codec.get(), object, data);
+
+    if ( raw )
+    {
+        objWriteOK = true;
+    }
+    else if ( dynamic_cast<const osg::Image*>(object) )
     {
         if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
         {
@@ -378,34 +410,33 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     if (objWriteOK)
     {
         DateTime now;
-        leveldb::WriteBatch batch;
+        WriteQueue::Batch batch;
 
         // write the data:
-        data = datastream.str();
+        if ( !raw )
+            data = datastream.str();
         if ( _tracker->seed().isSet() )
             blend(data, _tracker->seed().value());
-        batch.Put( dataKey(key), data );
+        batch.put( dataKey(key), data );
 
         // write the timestamp index:
-        batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+        batch.put( timeKey(now, key), binDataKeyTuple(key) );
 
         // write the metadata:
         Config metadata(meta);
         metadata.set( TIME_FIELD, now.asCompactISO8601() );
         encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
+        batch.put( metaKey(key), data );
 
-        objWriteOK = _db->Write( leveldb::WriteOptions(), &batch ).ok();
+        // the queue commits it in the background:
+        _queue->submit( batch );
 
-        if ( objWriteOK )
-        {
-            ++_tracker->writes;
-            postWrite();
+        ++_tracker->writes;
+        postWrite();
             
-            if ( _debug )
-            {
-                OE_NOTICE << LC << "Bin " << getID() << ": wrote (" << key << ")\n";
-            }
+        if ( _debug )
+        {
+            OE_NOTICE << LC << "Bin " << getID() << ": queued (" << key << ")\n";
         }
     }
 
@@ -422,35 +453,17 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
 void
 LevelDBCacheBin::postWrite()
 {
-    if ( _tracker->hasSizeLimit() )
+    // The size itself is tracked on the write queue thread (see Tracker::recordCommit),
+    // so all that's left here is a cheap check against the last estimate.
+    if ( _tracker->hasSizeLimit() && _tracker->isOverLimit() && _tracker->isTimeToPurge() )
     {
-        if ( _tracker->isOverLimit() )
-        {
-            if ( _tracker->isTimeToPurge() )
-            {
-                this->purgeOldest(_tracker->numToPurge());
-
-                if (_debug)
-                {
-                    off_t size = _tracker->calcSize();
-                    OE_NOTICE 
-                        << LC << "Cache size = " << (size/1048576) << " MB; " 
-                        << "Hit ratio = " << (float)_tracker->hits/(float)_tracker->reads << std::endl;
-                }
-            }
-        }
-        else
+        this->purgeOldest(_tracker->numToPurge());
+
+        if (_debug)
         {
-            if ( _tracker->isTimeToCheckSize() )
-            {
-                off_t size = _tracker->calcSize();
-                if ( _debug )
-                {
-                    OE_NOTICE 
-                        << LC << "Cache size = " << (size/1048576) << " MB; " 
-                        << "Hit ratio = " << (float)_tracker->hits/(float)_tracker->reads << std::endl;
-                }
-            }
+            OE_NOTICE 
+                << LC << "Cache size = " << (_tracker->getSize()/1048576) << " MB; " 
+                << "Hit ratio = " << (float)_tracker->hits/(float)_tracker->reads << std::endl;
         }
     }
 }
@@ -461,13 +474,9 @@ LevelDBCacheBin::getRecordStatus(const std::string& key)
     if ( !binValidForReading() ) 
         return STATUS_NOT_FOUND;
 
-    leveldb::Status status;
-    leveldb::ReadOptions ro;
-
-    // read the metadata record.
-    std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    if ( status.ok() )
+    // a record needs both its metadata and its data; a purge racing with a
+    // touch can leave the metadata behind on its own.
+    if ( exists(metaKey(key)) && exists(dataKey(key)) )
     {        
         return STATUS_OK;
     }
@@ -485,25 +494,21 @@ LevelDBCacheBin::remove(const std::string& key)
 
     // first read in the time from the metadata record.
     std::string metavalue;
-    if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
+    if ( get(metaKey(key), metavalue) == false )
         return false;
 
     Config metadata;
     decodeMeta(metavalue, metadata);
     DateTime t(metadata.value(TIME_FIELD));
 
-    leveldb::WriteBatch batch;
-    batch.Delete( dataKey(key) );
-    batch.Delete( metaKey(key) );
-    batch.Delete( timeKey(t, key) );
+    WriteQueue::Batch batch;
+    batch.remove( dataKey(key) );
+    batch.remove( metaKey(key) );
+    batch.remove( timeKey(t, key) );
         
-    leveldb::Status status = _db->Write(leveldb::WriteOptions(), &batch);
-    if ( !status.ok() )
-    {
-        OE_WARN << LC << "Failed to remove (" << key << ") from bin " << getID() << std::endl;
-        return false;
-    }
-    else if ( _debug )
+    _queue->submit( batch );
+
+    if ( _debug )
     {
         OE_NOTICE << LC << "Removed (" << key << ") from bin " << getID() << std::endl;
     }
@@ -519,37 +524,80 @@ LevelDBCacheBin::touch(const std::string& key)
 
     // first read in the time from the metadata record.
     std::string metavalue;
-    if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
+    if ( get(metaKey(key), metavalue) == false )
         return false;
 
     Config metadata;
     decodeMeta(metavalue, metadata);
     DateTime oldtime(metadata.value(TIME_FIELD));
         
-    leveldb::WriteBatch batch;
+    WriteQueue::Batch batch;
 
     // In a transaction, update the metadata record with the current time.
     std::string newtime = DateTime().asCompactISO8601();
     metadata.set(TIME_FIELD, newtime);
     encodeMeta(metadata, metavalue);
-    batch.Put(metaKey(key), metavalue);
+    batch.put(metaKey(key), metavalue);
 
     // ...remove the old time index record:
-    batch.Delete( timeKey(oldtime, key) );
+    batch.remove( timeKey(oldtime, key) );
 
     // ...and write a new time index record.
-    batch.Put( timeKey(newtime, key), binDataKeyTuple(key) );
+    batch.put( timeKey(newtime, key), binDataKeyTuple(key) );
 
-    leveldb::Status status = _db->Write(leveldb::WriteOptions(), &batch);
-    if ( !status.ok() )
+    _queue->submit( batch );
+
+    if ( _debug )
     {
-        OE_WARN << LC << "Failed to touch (" << key << ") in bin " << getID() << std::endl;
+        OE_NOTICE << LC << "Bin " << getID() << ": touch (" << key << ")\n";
     }
-    else if ( _debug )
+    return true;
+}
+
+bool
+LevelDBCacheBin::get(const std::string& dbkey, std::string& value)
+{
+    switch( _queue->find(dbkey, value) )
     {
-        OE_NOTICE << LC << "Bin " << getID() << ": touch (" << key << ")\n";
+    case WriteQueue::QUEUED:        return true;
+    case WriteQueue::QUEUED_DELETE: return false;
+    default:                        return _db->Get(leveldb::ReadOptions(), dbkey, &value).ok();
     }
-    return status.ok();
+}
+
+bool
+LevelDBCacheBin::exists(const std::string& dbkey)
+{
+    std::string value;
+    switch( _queue->find(dbkey, value) )
+    {
+    case WriteQueue::QUEUED:        return true;
+    case WriteQueue::QUEUED_DELETE: return false;
+    default: break;
+    }
+
+    // seek instead of Get() so a large data record isn't copied out.
+    leveldb::Iterator* it = _db->NewIterator(leveldb::ReadOptions());
+    it->Seek( dbkey );
+    bool found = it->Valid() && it->key() == leveldb::Slice(dbkey);
+    delete it;
+    return found;
+}
+
+bool
+LevelDBCacheBin::PurgeCheck::test() const
+{
+    // Runs with the queue locked and none of the record's keys queued, so the
+    // database holds the current metadata. A time key with no metadata is an
+    // orphan and goes too.
+    std::string metavalue;
+    if ( !_bin->_db->Get(leveldb::ReadOptions(), _metakey, &metavalue).ok() )
+        return true;
+
+    Config metadata;
+    decodeMeta(metavalue, metadata);
+    DateTime t(metadata.value(TIME_FIELD));
+    return _bin->timeKeyFromTuple(t, _tuple) == _timekey;
 }
 
 bool
@@ -558,10 +606,14 @@ LevelDBCacheBin::clear()
     if ( !binValidForWriting() )
         return false;
     
+    // get everything queued into the database first so the scan sees it.
+    _queue->flush();
+    
     leveldb::WriteOptions wo;
     std::string binphrase = binPhrase();
-    leveldb::WriteBatch batch;
-    leveldb::Iterator* i = _db->NewIterator(leveldb::ReadOptions());
+    leveldb::ReadOptions ro;
+    ro.fill_cache = false;
+    leveldb::Iterator* i = _db->NewIterator(ro);
     for(i->SeekToFirst(); i->Valid(); i->Next())
     {
         std::string key = i->key().ToString();
@@ -659,7 +711,10 @@ LevelDBCacheBin::purgeOldest(unsigned maxnum)
     if ( !binValidForWriting() )
         return false;
 
-    leveldb::Iterator* it = _db->NewIterator(leveldb::ReadOptions());
+    // Keep the scan from evicting hot blocks from the block cache.
+    leveldb::ReadOptions ro;
+    ro.fill_cache = false;
+    leveldb::Iterator* it = _db->NewIterator(ro);
 
     unsigned count = 0;
     std::string limit = timeEndGlobal();
@@ -667,27 +722,36 @@ LevelDBCacheBin::purgeOldest(unsigned maxnum)
     // note: this will delete records NOT OF THIS BIN as well!
     for(it->Seek(timeBeginGlobal());
         count < maxnum && it->Valid() && it->key().ToString() < limit;
-        it->Next(), ++count )
+        it->Next() )
     {
         if ( !it->status().ok() )
             break;
 
-        std::string tuple = it->value().ToString();
-
-        // doing this in a WriteBatch did not work. The size of the
-        // database would never go down.
-        leveldb::WriteOptions wo;
-        _db->Delete( wo, dataKeyFromTuple(tuple) );
-        _db->Delete( wo, metaKeyFromTuple(tuple) );
-        _db->Delete( wo, it->key() );
+        PurgeCheck check;
+        check._bin     = this;
+        check._tuple   = it->value().ToString();
+        check._timekey = it->key().ToString();
+        check._metakey = metaKeyFromTuple(check._tuple);
+
+        // The scan sees a snapshot, so the record may have been rewritten or
+        // touched since. The queue only takes the removal if no write, touch
+        // or removal of the record is still queued (the queued batch would
+        // replace or remove this time key itself) and the live metadata still
+        // dates the record to this time key.
+        WriteQueue::Batch batch;
+        batch.remove( dataKeyFromTuple(check._tuple) );
+        batch.remove( check._metakey );
+        batch.remove( check._timekey );
+        if ( _queue->submitIf(batch, check) )
+            ++count;
     }
 
     delete it;
 
     if ( _debug )
     {
-        OE_NOTICE << LC << "Purged " << count << " record(s) for "
-            << (_tracker->calcSize()/1048576) << " MB" << std::endl;
+        OE_NOTICE << LC << "Purged " << count << " record(s); cache size = "
+            << (_tracker->getSize()/1048576) << " MB" << std::endl;
     }
 
     return true;
@@ -0,0 +1,306 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "WriteQueue"
+#include <osgEarth/Notify>
+#include <leveldb/write_batch.h>
+
+using namespace osgEarth;
+using namespace osgEarth::Threading;
+using namespace osgEarth::Drivers::LevelDBCache;
+
+#undef  LC
+#define LC "[LevelDBCache] "
+
+// Longest a record waits in the queue when the batch doesn't fill up
+#define COMMIT_INTERVAL_MS 250
+
+//------------------------------------------------------------------------
+
+void
+WriteQueue::Batch::put(const std::string& key, const std::string& value)
+{
+    _ops.push_back( Op() );
+    _ops.back().key    = key;
+    _ops.back().value  = value;
+    _ops.back().remove = false;
+}
+
+void
+WriteQueue::Batch::remove(const std::string& key)
+{
+    _ops.push_back( Op() );
+    _ops.back().key    = key;
+    _ops.back().remove = true;
+}
+
+//------------------------------------------------------------------------
+
+WriteQueue::WriteQueue(leveldb::DB* db,
+                       Tracker*     tracker,
+                       unsigned     batchSize,
+                       unsigned     maxQueued) :
+_db           ( db ),
+_tracker      ( tracker ),
+_batchSize    ( osg::maximum(batchSize, 1u) ),
+_maxQueued    ( osg::maximum(maxQueued, batchSize) ),
+_commits      ( 0u ),
+_flushRequests( 0u ),
+_done         ( false ),
+_running      ( true )
+{
+    start();
+}
+
+WriteQueue::~WriteQueue()
+{
+    stop();
+}
+
+void
+WriteQueue::submit(Batch& batch)
+{
+    if ( batch.empty() )
+        return;
+
+    ScopedMutexLock lock( _mutex );
+    submitLocked( batch );
+}
+
+bool
+WriteQueue::submitIf(Batch& batch, const Precondition& pre)
+{
+    if ( batch.empty() )
+        return false;
+
+    ScopedMutexLock lock( _mutex );
+
+    // wait out any back-pressure first; the wait releases the lock, so the
+    // checks below must come after it.
+    while ( _running && _pending.size() >= _maxQueued )
+    {
+        _workCond.signal();
+        _commitCond.wait( &_mutex );
+    }
+
+    std::string value;
+    for(std::vector<Batch::Op>::const_iterator i = batch._ops.begin(); i != batch._ops.end(); ++i)
+    {
+        if ( findLocked(i->key, value) != NOT_QUEUED )
+        {
+            batch._ops.clear();
+            return false;
+        }
+    }
+
+    if ( !pre.test() )
+    {
+        batch._ops.clear();
+        return false;
+    }
+
+    submitLocked( batch );
+    return true;
+}
+
+void
+WriteQueue::submitLocked(Batch& batch)
+{
+    if ( !_running )
+    {
+        // queue is shut down; commit on this thread.
+        Records records;
+        for(std::vector<Batch::Op>::iterator i = batch._ops.begin(); i != batch._ops.end(); ++i)
+        {
+            Value& v = records[i->key];
+            v.value.swap( i->value );
+            v.remove = i->remove;
+        }
+        batch._ops.clear();
+        off_t bytes = 0;
+        if ( commit(records, bytes) )
+            _tracker->recordCommit( bytes );
+        return;
+    }
+
+    // apply back-pressure so a fast producer can't queue without bound.
+    while ( _running && _pending.size() >= _maxQueued )
+    {
+        _workCond.signal();
+        _commitCond.wait( &_mutex );
+    }
+
+    // later writes to the same key replace the queued ones.
+    for(std::vector<Batch::Op>::iterator i = batch._ops.begin(); i != batch._ops.end(); ++i)
+    {
+        Value& v = _pending[i->key];
+        v.value.swap( i->value );
+        v.remove = i->remove;
+    }
+    batch._ops.clear();
+
+    if ( _pending.size() >= _batchSize )
+        _workCond.signal();
+}
+
+WriteQueue::Lookup
+WriteQueue::find(const std::string& key, std::string& value) const
+{
+    ScopedMutexLock lock( _mutex );
+    return findLocked( key, value );
+}
+
+void
+WriteQueue::find(const std::string& key1, std::string& value1, Lookup& lookup1,
+                 const std::string& key2, std::string& value2, Lookup& lookup2) const
+{
+    ScopedMutexLock lock( _mutex );
+    lookup1 = findLocked( key1, value1 );
+    lookup2 = findLocked( key2, value2 );
+}
+
+WriteQueue::Lookup
+WriteQueue::findLocked(const std::string& key, std::string& value) const
+{
+    // newest first.
+    Records::const_iterator i = _pending.find( key );
+    if ( i == _pending.end() )
+    {
+        i = _committing.find( key );
+        if ( i == _committing.end() )
+            return NOT_QUEUED;
+    }
+
+    if ( i->second.remove )
+        return QUEUED_DELETE;
+
+    value = i->second.value;
+    return QUEUED;
+}
+
+void
+WriteQueue::flush()
+{
+    ScopedMutexLock lock( _mutex );
+
+    // each commit takes everything pending at the time, so at most two more
+    // commits cover everything submitted before this call.
+    unsigned target = _commits;
+    if ( !_committing.empty() ) ++target;
+    if ( !_pending.empty() )    ++target;
+
+    ++_flushRequests;
+    _workCond.signal();
+    while ( _running && _commits < target )
+    {
+        _commitCond.wait( &_mutex );
+    }
+    --_flushRequests;
+}
+
+void
+WriteQueue::stop()
+{
+    {
+        ScopedMutexLock lock( _mutex );
+        if ( !_running )
+            return;
+        _done = true;
+        _workCond.signal();
+    }
+
+    // the thread commits whatever is left before it exits.
+    join();
+}
+
+void
+WriteQueue::run()
+{
+    for(;;)
+    {
+        {
+            ScopedMutexLock lock( _mutex );
+
+            // wait for a full batch, a flush request, or the commit interval.
+            if ( !_done && _flushRequests == 0u && _pending.size() < _batchSize )
+            {
+                _workCond.wait( &_mutex, COMMIT_INTERVAL_MS );
+            }
+
+            if ( _pending.empty() )
+            {
+                if ( _done )
+                {
+                    _running = false;
+                    _commitCond.broadcast();
+                    return;
+                }
+                continue;
+            }
+
+            // take the whole queue. It stays visible to find() until committed.
+            _committing.swap( _pending );
+            _commitCond.broadcast();
+        }
+
+        // _committing only changes under the lock, and only on this thread,
+        // so it's safe to read here while other threads call find().
+        off_t bytes = 0;
+        bool ok = commit( _committing, bytes );
+
+        {
+            ScopedMutexLock lock( _mutex );
+            _committing.clear();
+            ++_commits;
+            _commitCond.broadcast();
+        }
+
+        if ( ok )
+            _tracker->recordCommit( bytes );
+    }
+}
+
+bool
+WriteQueue::commit(const Records& records, off_t& bytes)
+{
+    leveldb::WriteBatch batch;
+    bytes = 0;
+
+    for(Records::const_iterator i = records.begin(); i != records.end(); ++i)
+    {
+        if ( i->second.remove )
+        {
+            batch.Delete( i->first );
+        }
+        else
+        {
+            batch.Put( i->first, i->second.value );
+            bytes += i->first.size() + i->second.value.size();
+        }
+    }
+
+    leveldb::Status status = _db->Write( leveldb::WriteOptions(), &batch );
+    if ( !status.ok() )
+    {
+        OE_WARN << LC << "Failed to commit " << records.size() << " record(s): "
+            << status.ToString() << std::endl;
+        return false;
+    }
+
+    return true;
+}
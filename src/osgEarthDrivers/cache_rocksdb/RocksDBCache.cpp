@@ -91,6 +91,7 @@ _active        ( true )
     }
 
     _tracker = new Tracker(_options, _rootPath);
+    _codec = RawRecordCodec::create(_options);
     
     if ( !_rootPath.empty() )
     {
@@ -200,7 +201,7 @@ CacheBin*
 RocksDBCacheImpl::addBin( const std::string& name )
 {
     return _db ?
-        _bins.getOrCreate(name, new RocksDBCacheBin(name, _db, _tracker.get())) :
+        _bins.getOrCreate(name, new RocksDBCacheBin(name, _db, _tracker.get(), _codec.get())) :
         0L;
 }
 
@@ -216,7 +217,7 @@ RocksDBCacheImpl::getOrCreateDefaultBin()
         Threading::ScopedMutexLock lock( s_defaultBinMutex );
         if ( !_defaultBin.valid() ) // double-check
         {
-            _defaultBin = new RocksDBCacheBin("_default", _db, _tracker.get());
+            _defaultBin = new RocksDBCacheBin("_default", _db, _tracker.get(), _codec.get());
         }
     }
     return _defaultBin.get();
@@ -81,10 +81,12 @@ namespace
 
 RocksDBCacheBin::RocksDBCacheBin(const std::string& binID,
                                  rocksdb::DB*       db,
-                                 Tracker*           tracker) :
+                                 Tracker*           tracker,
+                                 RawRecordCodec*    codec) :
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
+_codec            ( codec ),
 _debug            ( false )
 {
     // reader to parse data:
@@ -276,19 +278,19 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
     if ( _tracker->seed().isSet() )
         unblend(datavalue, _tracker->seed().value());
 
-    // finally, decode the OSGB stream into an object.
-    std::istringstream datastream(datavalue);
-    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
-    if ( !r.success() )
+    // finally, decode the record into an object: either a raw image/heightfield
+    // record or an OSGB stream.
+    ReadResult decoded = RawRecordCodec::decodeRecord(datavalue.data(), datavalue.size(), reader);
+    if ( !decoded.succeeded() )
     {
-        OE_WARN << LC << "Cache read failure!"
+        OE_WARN << LC << "Cache read failure! (" << key << ")"
             << "\n reader = " << reader.name()
-            << "\n error detail = " << r.message()
-            << "\n data value = " << datavalue
+            << "\n error detail = " << decoded.errorDetail()
             << "\n";
 
         return ReadResult(ReadResult::RESULT_READER_ERROR);
     }
+    osg::ref_ptr<osg::Object> object = decoded.getObject();
         
     if ( _debug )
     {
@@ -304,7 +306,7 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
     }
 
     ++_tracker->hits;
-    ReadResult rr(r.getObject(), metadata);
+    ReadResult rr(object.get(), metadata);
     rr.setLastModifiedTime(lastModified);    
     return rr;
 }
@@ -338,7 +340,14 @@ RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const
     std::string       data;
     std::stringstream datastream;
 
-    if ( dynamic_cast<const osg::Image*>(object) )
+    // images and heightfields go out as raw records if the cache asks for it:
+    bool raw = RawRecordCodec::encodeIfEnabled(_codec.get(), object, data);
+
+    if ( raw )
+    {
+        objWriteOK = true;
+    }
+    else if ( dynamic_cast<const osg::Image*>(object) )
     {
         if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
         {
@@ -375,7 +384,8 @@ RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const
         rocksdb::WriteBatch batch;
 
         // write the data:
-        data = datastream.str();
+        if ( !raw )
+            data = datastream.str();
         if ( _tracker->seed().isSet() )
             blend(data, _tracker->seed().value());
         batch.Put( dataKey(key), data );
@@ -82,18 +82,23 @@ namespace
 
 // invoke runs in the background pager thread.
 void
-LoadTileData::invoke()
+LoadTileData::invoke(ProgressCallback* progress)
 {
     osg::ref_ptr<TileNode> tilenode;
     if ( _tilenode.lock(tilenode) )
     {
-        osg::ref_ptr<ProgressCallback> progress; // = new ProgressCallback();
-
         // Assemble all the components necessary to display this tile
         _model = _context->getEngine()->createTileModel(
             _context->getMapFrame(),
             tilenode->getTileKey(),
-            progress ); // progress
+            progress );
+
+        // A canceled load may be missing layers; discard it. The tile stays
+        // dirty and will be requested again if it is still needed.
+        if ( progress && progress->isCanceled() )
+        {
+            _model = 0L;
+        }
 
         // Prep the stateset for merging (and for GL pre-compile).
         if ( _model.valid() )
@@ -38,7 +38,6 @@ Loader::Request::Request()
     _state = IDLE;
     _loadCount = 0;
     _priority = 0;
-    _lastFrameSubmitted = 0;
     _lastTick = 0;
 }
 
@@ -80,7 +79,7 @@ SimpleLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& n
         osg::ref_ptr<Request> r = request;
 
         //OE_INFO << LC << "Request invoke : UID = " << request->getUID() << "\n";
-        request->invoke();
+        request->invoke( 0L );
         
         //OE_INFO << LC << "Request apply : UID = " << request->getUID() << "\n";
         request->apply( nv.getFrameStamp() );
@@ -170,6 +169,26 @@ namespace
 
         osg::ref_ptr<Loader::Request> _request;
     };
+
+    /**
+     * Progress callback handed to a request while it runs in a pager thread.
+     * It reports cancelation as soon as the loader decides the request is
+     * stale, so the image and elevation fetches can bail out early.
+     */
+    struct RequestProgressCallback : public ProgressCallback
+    {
+        RequestProgressCallback(const Loader::Request* request, const PagerLoader* loader)
+            : _request(request), _loader(loader) { }
+
+        bool isCanceled() {
+            if ( !_canceled && _loader->isStale(_request) )
+                _canceled = true;
+            return _canceled;
+        }
+
+        const Loader::Request* _request;
+        const PagerLoader*     _loader;
+    };
 }
 
 
@@ -177,7 +196,10 @@ PagerLoader::PagerLoader(TerrainEngine* engine) :
 _engineUID     ( engine->getUID() ),
 _checkpoint    ( (osg::Timer_t)0 ),
 _mergesPerFrame( 0 ),
-_frameNumber   ( 0 )
+_staleLoadFrames( 0u ),
+_frameNumber   ( 0u ),
+_numCompleted  ( 0u ),
+_numCanceled   ( 0u )
 {
     _myNodePath.push_back( this );
 
@@ -192,6 +214,35 @@ PagerLoader::setMergesPerFrame(int value)
     this->setNumChildrenRequiringUpdateTraversal( 1 );
 }
 
+void
+PagerLoader::setStaleLoadFrames(unsigned value)
+{
+    _staleLoadFrames = value;
+}
+
+bool
+PagerLoader::isStale(const Loader::Request* request) const
+{
+    // the thing we're loading for went away:
+    if ( request->isObsolete() )
+        return true;
+
+    // the loader was cleared since the request was last submitted:
+    if ( request->getLastTick() < getCheckpoint() )
+        return true;
+
+    // nobody has asked for the request in a while:
+    if ( _staleLoadFrames > 0u )
+    {
+        unsigned fn   = _frameNumber;
+        unsigned last = request->getLastFrameSubmitted();
+        if ( fn > last && fn - last > _staleLoadFrames )
+            return true;
+    }
+
+    return false;
+}
+
 bool
 PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv)
 {
@@ -206,6 +257,10 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
         {
             fn = nv.getFrameStamp()->getFrameNumber();
             request->setFrameNumber( fn );
+
+            // track the latest frame for stale request detection.
+            if ( fn > _frameNumber )
+                _frameNumber.exchange( fn );
         }
 
         bool addToRequestSet = false;
@@ -263,10 +318,19 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
 void
 PagerLoader::clear()
 {
-    // Set a time checkpoint for invalidating old requests.
+    // Set a time checkpoint for invalidating old requests. Pager threads
+    // read it through isStale(), so write it under the lock.
+    Threading::ScopedMutexLock lock( _requestsMutex );
     _checkpoint = osg::Timer::instance()->tick();
 }
 
+osg::Timer_t
+PagerLoader::getCheckpoint() const
+{
+    Threading::ScopedMutexLock lock( _requestsMutex );
+    return _checkpoint;
+}
+
 void
 PagerLoader::traverse(osg::NodeVisitor& nv)
 {
@@ -276,13 +340,18 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
         if ( nv.getFrameStamp() )
         {
             setFrameStamp(nv.getFrameStamp());
+
+            if ( nv.getFrameStamp()->getFrameNumber() > _frameNumber )
+                _frameNumber.exchange( nv.getFrameStamp()->getFrameNumber() );
         }
 
+        osg::Timer_t checkpoint = getCheckpoint();
+
         int count;
         for(count=0; count < _mergesPerFrame && !_mergeQueue.empty(); ++count)
         {
             Request* req = _mergeQueue.begin()->get();
-            if ( req && req->_lastTick >= _checkpoint )
+            if ( req && req->getLastTick() >= checkpoint )
             {
                 OE_START_TIMER(req_apply);
                 req->apply( getFrameStamp() );
@@ -348,7 +417,7 @@ PagerLoader::addChild(osg::Node* node)
         Request* req = result->getRequest();
         if ( req )
         {
-            if ( req->_lastTick >= _checkpoint )
+            if ( req->getLastTick() >= getCheckpoint() )
             {
                 if ( _mergesPerFrame > 0 )
                 {
@@ -411,7 +480,19 @@ PagerLoader::invokeAndRelease(UID requestUID)
         if ( REPORT_ACTIVITY )
             Registry::instance()->startActivity( request->getName() );
 
-        request->invoke();
+        osg::ref_ptr<ProgressCallback> progress = new RequestProgressCallback( request.get(), this );
+
+        request->invoke( progress.get() );
+
+        if ( progress->isCanceled() )
+        {
+            ++_numCanceled;
+            OE_DEBUG << LC << "Canceled " << request->getName() << std::endl;
+        }
+        else
+        {
+            ++_numCompleted;
+        }
     }
 
     else
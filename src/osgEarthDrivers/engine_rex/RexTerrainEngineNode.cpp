@@ -249,6 +249,7 @@ RexTerrainEngineNode::postInitialize( const Map* map, const TerrainOptions& opti
     // Make a tile loader
     PagerLoader* loader = new PagerLoader( this );
     loader->setMergesPerFrame( _terrainOptions.mergesPerFrame().get() );
+    loader->setStaleLoadFrames( _terrainOptions.staleLoadFrames().get() );
     _loader = loader;
     this->addChild( _loader.get() );
 
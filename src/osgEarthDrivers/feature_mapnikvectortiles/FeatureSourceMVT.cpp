@@ -108,7 +108,7 @@ public:
             int dataLen = sqlite3_column_bytes( select, 0 );
             std::string dataBuffer( data, dataLen );
             std::stringstream in(dataBuffer);
-            MVT::read(in, key, features);
+            MVT::read(in, key, features, _options.parallelDecode() == true);
         }
         else
         {
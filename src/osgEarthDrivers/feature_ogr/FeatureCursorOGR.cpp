@@ -20,8 +20,13 @@
 #include <osgEarthFeatures/OgrUtils>
 #include <osgEarthFeatures/Feature>
 #include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
 #include <osg/Math>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Condition>
 #include <algorithm>
+#include <deque>
+#include <set>
 
 #define LC "[FeatureCursorOGR] "
 
@@ -30,6 +35,7 @@
 using namespace osgEarth;
 using namespace osgEarth::Features;
 using namespace osgEarth::Symbology;
+using namespace osgEarth::Drivers;
 
 namespace
 {
@@ -68,13 +74,97 @@ namespace
     }
 }
 
+/**
+ * Reads features from the result set on a background thread, keeping a
+ * small number of chunks ready so that OGR I/O overlaps the filtering
+ * the cursor does on the previous chunk.
+ */
+class FeatureCursorOGR::Prefetcher : public OpenThreads::Thread
+{
+public:
+    Prefetcher( FeatureCursorOGR* cursor, unsigned maxChunks ) :
+        _cursor   ( cursor ),
+        _maxChunks( osg::maximum(maxChunks, 1u) ),
+        _done     ( false ),
+        _cancelled( false ) { }
+
+    /** Stops reading and waits for the thread to exit. */
+    void cancel()
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+            _cancelled = true;
+            _cond.broadcast();
+        }
+        join();
+    }
+
+    /**
+     * Blocks until the next chunk is available and moves it into "output".
+     * Returns false if no more chunks will follow.
+     */
+    bool pop( FeatureList& output )
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+        while( _chunks.empty() && !_done )
+            _cond.wait( &_mutex );
+
+        if ( !_chunks.empty() )
+        {
+            output.swap( _chunks.front() );
+            _chunks.pop_front();
+            _cond.broadcast();
+        }
+
+        return !(_done && _chunks.empty());
+    }
+
+    void run()
+    {
+        bool more = true;
+        while( more )
+        {
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+                while( !_cancelled && _chunks.size() >= _maxChunks )
+                    _cond.wait( &_mutex );
+                if ( _cancelled )
+                    break;
+            }
+
+            FeatureList chunk;
+            more = _cursor->readFeatures( chunk );
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+            _chunks.push_back( FeatureList() );
+            _chunks.back().swap( chunk );
+            _cond.broadcast();
+        }
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+        _done = true;
+        _cond.broadcast();
+    }
+
+private:
+    FeatureCursorOGR*       _cursor;
+    unsigned                _maxChunks;
+    std::deque<FeatureList> _chunks;
+    bool                    _done;
+    bool                    _cancelled;
+    OpenThreads::Mutex      _mutex;
+    OpenThreads::Condition  _cond;
+};
+
 
 FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH              dsHandle,
                                    OGRLayerH                   layerHandle,
                                    const FeatureSource*        source,
                                    const FeatureProfile*       profile,
                                    const Symbology::Query&     query,
-                                   const FeatureFilterList&    filters) :
+                                   const FeatureFilterList&    filters,
+                                   const OGRFeatureOptions&    options,
+                                   bool                        privateDataSource) :
 _source           ( source ),
 _dsHandle         ( dsHandle ),
 _layerHandle      ( layerHandle ),
@@ -84,6 +174,8 @@ _query            ( query ),
 _chunkSize        ( 500 ),
 _nextHandleToQueue( 0L ),
 _resultSetEndReached(false),
+_privateDataSource( privateDataSource ),
+_prefetcher       ( 0L ),
 _profile          ( profile ),
 _filters          ( filters )
 {
@@ -170,33 +262,73 @@ _filters          ( filters )
         }
 
 
-        OE_DEBUG << LC << "SQL: " << expr << std::endl;
-        _resultSetHandle = OGR_DS_ExecuteSQL( _dsHandle, expr.c_str(), _spatialFilter, 0L );
+        // A plain "SELECT *" is read straight from the layer when projecting
+        // attributes, since the OGR SQL result set would re-enable all the
+        // fields on the source layer. That changes the layer's state, so only
+        // do it when no other cursor shares the data source.
+        if ( _privateDataSource && options.attributes().isSet() && !_query.expression().isSet() && !_query.orderby().isSet() )
+        {
+            OE_DEBUG << LC << "Reading layer " << from << std::endl;
+            OGR_L_SetSpatialFilter( _layerHandle, _spatialFilter );
+            _resultSetHandle = _layerHandle;
+        }
+        else
+        {
+            OE_DEBUG << LC << "SQL: " << expr << std::endl;
+            _resultSetHandle = OGR_DS_ExecuteSQL( _dsHandle, expr.c_str(), _spatialFilter, 0L );
+        }
 
         if ( _resultSetHandle )
         {
+            // an SQL result set passes the ignored fields on to the source layer.
+            if ( _privateDataSource && options.attributes().isSet() )
+            {
+                setIgnoredFields( options.attributes().get() );
+            }
+
             OGR_L_ResetReading( _resultSetHandle );
         }
     }
 
+    if ( _resultSetHandle && options.prefetch() == true )
+    {
+        _prefetcher = new Prefetcher( this, 2u );
+        _prefetcher->start();
+    }
+
     readChunk();
 }
 
 FeatureCursorOGR::~FeatureCursorOGR()
 {
+    // stop the reader before taking the OGR lock, which it may be waiting on.
+    if ( _prefetcher )
+    {
+        _prefetcher->cancel();
+        delete _prefetcher;
+        _prefetcher = 0L;
+    }
+
     OGR_SCOPED_LOCK;
 
     if ( _nextHandleToQueue )
         OGR_F_Destroy( _nextHandleToQueue );
 
-    if ( _resultSetHandle != _layerHandle )
+    // reading straight from the layer needs no cleanup; the private data
+    // source goes away below.
+    if ( _resultSetHandle && _resultSetHandle != _layerHandle )
         OGR_DS_ReleaseResultSet( _dsHandle, _resultSetHandle );
 
     if ( _spatialFilter )
         OGR_G_DestroyGeometry( _spatialFilter );
 
     if ( _dsHandle )
-        OGRReleaseDataSource( _dsHandle );
+    {
+        if ( _privateDataSource )
+            OGR_DS_Destroy( _dsHandle );
+        else
+            OGRReleaseDataSource( _dsHandle );
+    }
 }
 
 bool
@@ -230,35 +362,17 @@ FeatureCursorOGR::readChunk()
 {
     if ( !_resultSetHandle )
         return;
-    
-    OGR_SCOPED_LOCK;
 
     while( _queue.size() < _chunkSize && !_resultSetEndReached )
     {
         FeatureList filterList;
-        while( filterList.size() < _chunkSize && !_resultSetEndReached )
-        {
-            OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
-            if ( handle )
-            {
-                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get() );
-
-                if (feature.valid() &&
-                    !_source->isBlacklisted( feature->getFID() ) &&
-                    validateGeometry( feature->getGeometry() ))
-                {
-                    filterList.push_back( feature.release() );
-                }
-                OGR_F_Destroy( handle );
-            }
-            else
-            {
-                _resultSetEndReached = true;
-            }
-        }
+        if ( _prefetcher )
+            _resultSetEndReached = !_prefetcher->pop( filterList );
+        else
+            _resultSetEndReached = !readFeatures( filterList );
 
         // preprocess the features using the filter list:
-        if ( !_filters.empty() )
+        if ( !_filters.empty() && !filterList.empty() )
         {
             FilterContext cx;
             cx.setProfile( _profile.get() );
@@ -285,3 +399,66 @@ FeatureCursorOGR::readChunk()
     }
 }
 
+bool
+FeatureCursorOGR::readFeatures( FeatureList& output )
+{
+    OGR_SCOPED_LOCK;
+
+    // all the features in the result set share one attribute schema.
+    if ( !_schema.valid() )
+        _schema = OgrUtils::createAttributeSchema( OGR_L_GetLayerDefn(_resultSetHandle) );
+
+    while( output.size() < _chunkSize )
+    {
+        OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
+        if ( !handle )
+            return false;
+
+        osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get(), _schema.get() );
+
+        if (feature.valid() &&
+            !_source->isBlacklisted( feature->getFID() ) &&
+            validateGeometry( feature->getGeometry() ))
+        {
+            output.push_back( feature.release() );
+        }
+        OGR_F_Destroy( handle );
+    }
+
+    return true;
+}
+
+void
+FeatureCursorOGR::setIgnoredFields( const std::string& attributes )
+{
+    StringVector names;
+    StringTokenizer( attributes, names, " ,", "'\"", false, true );
+
+    std::set<std::string> keep;
+    for(StringVector::const_iterator i = names.begin(); i != names.end(); ++i)
+        keep.insert( osgEarth::toLower(*i) );
+
+    OGRFeatureDefnH defn = OGR_L_GetLayerDefn( _resultSetHandle );
+    int numFields = OGR_FD_GetFieldCount( defn );
+
+    std::vector<const char*> ignored;
+    for(int i = 0; i < numFields; ++i)
+    {
+        const char* name = OGR_Fld_GetNameRef( OGR_FD_GetFieldDefn(defn, i) );
+        if ( keep.find(osgEarth::toLower(name)) == keep.end() )
+            ignored.push_back( name );
+    }
+
+    if ( ignored.empty() )
+        return;
+
+    ignored.push_back( 0L );
+    if ( OGR_L_SetIgnoredFields( _resultSetHandle, &ignored[0] ) == OGRERR_NONE )
+    {
+        OE_DEBUG << LC << "Ignoring " << (ignored.size()-1) << " of " << numFields << " fields" << std::endl;
+    }
+    else
+    {
+        OE_DEBUG << LC << "Driver does not support ignoring fields; reading all attributes" << std::endl;
+    }
+}
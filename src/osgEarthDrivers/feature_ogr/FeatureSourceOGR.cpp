@@ -329,14 +329,20 @@ public:
         {
             OGRDataSourceH dsHandle = 0L;
             OGRLayerH layerHandle = 0L;
+            bool privateDataSource = false;
 
             // open the handles safely:
             {
                 OGR_SCOPED_LOCK;
 
                 // Each cursor requires its own DS handle so that multi-threaded access will work.
-                // The cursor impl will dispose of the new DS handle.
-                dsHandle = OGROpenShared( _source.c_str(), 0, &_ogrDriverHandle );
+                // The cursor impl will dispose of the new DS handle. A cursor that projects
+                // attributes or prefetches changes the layer's state or reads it from another
+                // thread, so it gets a private data source instead of the shared one.
+                privateDataSource = _options.attributes().isSet() || _options.prefetch() == true;
+                dsHandle = privateDataSource ?
+                    OGROpen( _source.c_str(), 0, &_ogrDriverHandle ) :
+                    OGROpenShared( _source.c_str(), 0, &_ogrDriverHandle );
                 if ( dsHandle )
                 {
                     layerHandle = openLayer(dsHandle, _options.layer().get());
@@ -352,14 +358,19 @@ public:
                     this,
                     getFeatureProfile(),
                     query,
-                    getFilters() );
+                    getFilters(),
+                    _options,
+                    privateDataSource );
             }
             else
             {
                 if ( dsHandle )
                 {
                     OGR_SCOPED_LOCK;
-                    OGRReleaseDataSource( dsHandle );
+                    if ( privateDataSource )
+                        OGR_DS_Destroy( dsHandle );
+                    else
+                        OGRReleaseDataSource( dsHandle );
                 }
 
                 return 0L;
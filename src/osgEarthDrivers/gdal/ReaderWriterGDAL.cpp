@@ -26,6 +26,7 @@
 #include <osgEarth/ImageUtils>
 #include <osgEarth/URI>
 #include <osgEarth/HeightFieldUtils>
+#include <osgEarth/ThreadingUtils>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -631,7 +632,9 @@ public:
       _srcDS(NULL),
       _warpedDS(NULL),
       _options(options),
-      _maxDataLevel(30)
+      _maxDataLevel(30),
+      _requiresWarp(false),
+      _warpPolar(false)
     {
     }
 
@@ -639,6 +642,13 @@ public:
     {
         GDAL_SCOPED_LOCK;
 
+        // Close the per-thread read handles.
+        for(unsigned i=0; i<_freeHandles.size(); ++i)
+        {
+            closeHandle( _freeHandles[i] );
+        }
+        _freeHandles.clear();
+
         // Close the _warpedDS dataset if :
         // - it exists
         // - and is different from _srcDS
@@ -776,6 +786,7 @@ public:
                         _srcDS = (GDALDataset*)GDALOpen(result.getString().c_str(), GA_ReadOnly );
                         if (_srcDS)
                         {
+                            _srcOpenString = result.getString();
                             OE_INFO << LC << INDENT << "Read VRT from cache!" << std::endl;
                         }
                     }
@@ -792,6 +803,13 @@ public:
 
                     if (_srcDS)
                     {
+                        // Remember the VRT definition so reader threads can open their own handles.
+                        char** vrtXML = _srcDS->GetMetadata( "xml:VRT" );
+                        if ( vrtXML && vrtXML[0] )
+                        {
+                            _srcOpenString = vrtXML[0];
+                        }
+
                         //Cache the VRT so we don't have to build it next time.
                         if (_cacheBin)
                         {
@@ -837,6 +855,7 @@ public:
 
                 if (_srcDS)
                 {
+                    _srcOpenString = files[0];
 
                     char **subDatasets = _srcDS->GetMetadata( "SUBDATASETS");
                     int numSubDatasets = CSLCount( subDatasets );
@@ -851,6 +870,7 @@ public:
                         char *pszSubdatasetName = CPLStrdup( CSLFetchNameValue( subDatasets, buf.str().c_str() ) );
                         GDALClose( _srcDS );
                         _srcDS = (GDALDataset*)GDALOpen( pszSubdatasetName, GA_ReadOnly ) ;
+                        _srcOpenString = pszSubdatasetName;
                         CPLFree( pszSubdatasetName );
                     }
                 }
@@ -980,27 +1000,12 @@ public:
 
         if ( requiresReprojection || (profile && !profile->getSRS()->isEquivalentTo( src_srs.get() )) )
         {
-            if ( profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar()) )
-            {
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    profile->getSRS()->getWKT().c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    NULL);
-            }
-            else
-            {
-                std::string destWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRT(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    destWKT.c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    0);
-            }
+            _requiresWarp = true;
+            _warpPolar    = profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar());
+            _warpSrcWKT   = src_srs->getWKT();
+            _warpDestWKT  = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
+
+            _warpedDS = createWarpedDataset( _srcDS );
 
             if ( _warpedDS )
             {
@@ -1144,12 +1149,140 @@ public:
 
 
     /**
-    * Finds a raster band based on color interpretation
+    * Creates the warping VRT for a source dataset, using the reprojection
+    * parameters established in initialize().
     */
-    static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
+    GDALDataset* createWarpedDataset(GDALDataset* srcDS)
+    {
+        if ( _warpPolar )
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                NULL);
+        }
+        else
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRT(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                0);
+        }
+    }
+
+    /**
+    * A source dataset and the (possibly identical) warped dataset we read from.
+    */
+    struct DatasetHandle
     {
+        DatasetHandle() : _srcDS(NULL), _warpedDS(NULL) { }
+        GDALDataset* _srcDS;
+        GDALDataset* _warpedDS;
+    };
+
+    /**
+    * Checks out a read handle from the pool, opening a new one if none are
+    * free. GDAL datasets may not be shared across threads, but separate
+    * handles to the same source may be read concurrently. Returns false if
+    * the source cannot be reopened (e.g. an external dataset).
+    */
+    bool acquireHandle(DatasetHandle& out)
+    {
+        if ( _srcOpenString.empty() )
+            return false;
+
+        {
+            Threading::ScopedMutexLock lock( _handlesMutex );
+            if ( !_freeHandles.empty() )
+            {
+                out = _freeHandles.back();
+                _freeHandles.pop_back();
+                return true;
+            }
+        }
+
+        // Opening touches the driver manager, which is not thread-safe.
         GDAL_SCOPED_LOCK;
 
+        out._srcDS = (GDALDataset*)GDALOpen( _srcOpenString.c_str(), GA_ReadOnly );
+        if ( !out._srcDS )
+        {
+            OE_DEBUG << LC << "Failed to open a read handle; falling back on the shared dataset" << std::endl;
+            return false;
+        }
+
+        out._warpedDS = _requiresWarp ? createWarpedDataset( out._srcDS ) : out._srcDS;
+        if ( !out._warpedDS )
+        {
+            GDALClose( out._srcDS );
+            out._srcDS = NULL;
+            return false;
+        }
+
+        return true;
+    }
+
+    /** Returns a handle obtained from acquireHandle() to the pool. */
+    void releaseHandle(const DatasetHandle& handle)
+    {
+        Threading::ScopedMutexLock lock( _handlesMutex );
+        _freeHandles.push_back( handle );
+    }
+
+    void closeHandle(DatasetHandle& handle)
+    {
+        if ( handle._warpedDS && handle._warpedDS != handle._srcDS )
+            GDALClose( handle._warpedDS );
+        if ( handle._srcDS )
+            GDALClose( handle._srcDS );
+        handle._srcDS = handle._warpedDS = NULL;
+    }
+
+    /**
+    * Scoped access to a dataset for reading a tile. Uses a pooled handle
+    * private to the calling thread when possible, so reads don't serialize
+    * on the global GDAL mutex; otherwise reads the shared dataset under it.
+    */
+    class ReadHandle
+    {
+    public:
+        ReadHandle(GDALTileSource* source) : _source(source)
+        {
+            _pooled = _source->acquireHandle( _handle );
+            if ( !_pooled )
+            {
+                Registry::instance()->getGDALMutex().lock();
+                _handle._warpedDS = _source->_warpedDS;
+            }
+        }
+
+        ~ReadHandle()
+        {
+            if ( _pooled )
+                _source->releaseHandle( _handle );
+            else
+                Registry::instance()->getGDALMutex().unlock();
+        }
+
+        GDALDataset* dataset() const { return _handle._warpedDS; }
+
+    private:
+        GDALTileSource* _source;
+        DatasetHandle   _handle;
+        bool            _pooled;
+    };
+
+    /**
+    * Finds a raster band based on color interpretation
+    */
+    static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
+    {
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetColorInterpretation() == colorInterp) return ds->GetRasterBand(i);
@@ -1159,8 +1292,6 @@ public:
 
     static GDALRasterBand* findBandByDataType(GDALDataset *ds, GDALDataType dataType)
     {
-        GDAL_SCOPED_LOCK;
-
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetRasterDataType() == dataType) return ds->GetRasterBand(i);
@@ -1276,7 +1407,8 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        ReadHandle handle( this );
+        GDALDataset* ds = handle.dataset();
 
         int tileSize = _options.tileSize().value();
 
@@ -1308,8 +1440,8 @@ public:
             int height = (int)(src_max_y - src_min_y);
 
 
-            int rasterWidth = _warpedDS->GetRasterXSize();
-            int rasterHeight = _warpedDS->GetRasterYSize();
+            int rasterWidth = ds->GetRasterXSize();
+            int rasterHeight = ds->GetRasterYSize();
             if (off_x + width > rasterWidth || off_y + height > rasterHeight)
             {
                 OE_WARN << LC << "Read window outside of bounds of dataset.  Source Dimensions=" << rasterWidth << "x" << rasterHeight << " Read Window=" << off_x << ", " << off_y << " " << width << "x" << height << std::endl;
@@ -1343,44 +1475,44 @@ public:
 
 
 
-            GDALRasterBand* bandRed = findBandByColorInterp(_warpedDS, GCI_RedBand);
-            GDALRasterBand* bandGreen = findBandByColorInterp(_warpedDS, GCI_GreenBand);
-            GDALRasterBand* bandBlue = findBandByColorInterp(_warpedDS, GCI_BlueBand);
-            GDALRasterBand* bandAlpha = findBandByColorInterp(_warpedDS, GCI_AlphaBand);
+            GDALRasterBand* bandRed = findBandByColorInterp(ds, GCI_RedBand);
+            GDALRasterBand* bandGreen = findBandByColorInterp(ds, GCI_GreenBand);
+            GDALRasterBand* bandBlue = findBandByColorInterp(ds, GCI_BlueBand);
+            GDALRasterBand* bandAlpha = findBandByColorInterp(ds, GCI_AlphaBand);
 
-            GDALRasterBand* bandGray = findBandByColorInterp(_warpedDS, GCI_GrayIndex);
+            GDALRasterBand* bandGray = findBandByColorInterp(ds, GCI_GrayIndex);
 
-            GDALRasterBand* bandPalette = findBandByColorInterp(_warpedDS, GCI_PaletteIndex);
+            GDALRasterBand* bandPalette = findBandByColorInterp(ds, GCI_PaletteIndex);
 
             if (!bandRed && !bandGreen && !bandBlue && !bandAlpha && !bandGray && !bandPalette)
             {
                 OE_DEBUG << LC << "Could not determine bands based on color interpretation, using band count" << std::endl;
                 //We couldn't find any valid bands based on the color interp, so just make an educated guess based on the number of bands in the file
                 //RGB = 3 bands
-                if (_warpedDS->GetRasterCount() == 3)
+                if (ds->GetRasterCount() == 3)
                 {
-                    bandRed   = _warpedDS->GetRasterBand( 1 );
-                    bandGreen = _warpedDS->GetRasterBand( 2 );
-                    bandBlue  = _warpedDS->GetRasterBand( 3 );
+                    bandRed   = ds->GetRasterBand( 1 );
+                    bandGreen = ds->GetRasterBand( 2 );
+                    bandBlue  = ds->GetRasterBand( 3 );
                 }
                 //RGBA = 4 bands
-                else if (_warpedDS->GetRasterCount() == 4)
+                else if (ds->GetRasterCount() == 4)
                 {
-                    bandRed   = _warpedDS->GetRasterBand( 1 );
-                    bandGreen = _warpedDS->GetRasterBand( 2 );
-                    bandBlue  = _warpedDS->GetRasterBand( 3 );
-                    bandAlpha = _warpedDS->GetRasterBand( 4 );
+                    bandRed   = ds->GetRasterBand( 1 );
+                    bandGreen = ds->GetRasterBand( 2 );
+                    bandBlue  = ds->GetRasterBand( 3 );
+                    bandAlpha = ds->GetRasterBand( 4 );
                 }
                 //Gray = 1 band
-                else if (_warpedDS->GetRasterCount() == 1)
+                else if (ds->GetRasterCount() == 1)
                 {
-                    bandGray = _warpedDS->GetRasterBand( 1 );
+                    bandGray = ds->GetRasterBand( 1 );
                 }
                 //Gray + alpha = 2 bands
-                else if (_warpedDS->GetRasterCount() == 2)
+                else if (ds->GetRasterCount() == 2)
                 {
-                    bandGray  = _warpedDS->GetRasterBand( 1 );
-                    bandAlpha = _warpedDS->GetRasterBand( 2 );
+                    bandGray  = ds->GetRasterBand( 1 );
+                    bandAlpha = ds->GetRasterBand( 2 );
                 }
             }
 
@@ -1750,7 +1882,6 @@ public:
 
     bool isValidValue(float v, GDALRasterBand* band)
     {
-        GDAL_SCOPED_LOCK;
         return isValidValue_noLock( v, band );
     }
 
@@ -1890,7 +2021,8 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        ReadHandle handle( this );
+        GDALDataset* ds = handle.dataset();
 
         int tileSize = _options.tileSize().value();
 
@@ -1905,11 +2037,11 @@ public:
             key.getExtent().getBounds(xmin, ymin, xmax, ymax);
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(ds, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = ds->GetRasterBand(1);
             }
 
             if (_options.interpolation() == INTERP_NEAREST)
@@ -1928,9 +2060,9 @@ public:
                 int iNumRows = iRowMax - iRowMin + 1;
 
                 int iWinColMin = max(0, iColMin);
-                int iWinColMax = min(_warpedDS->GetRasterXSize()-1, iColMax);
+                int iWinColMax = min(ds->GetRasterXSize()-1, iColMax);
                 int iWinRowMin = max(0, iRowMin);
-                int iWinRowMax = min(_warpedDS->GetRasterYSize()-1, iRowMax);
+                int iWinRowMax = min(ds->GetRasterYSize()-1, iRowMax);
                 int iNumWinCols = iWinColMax - iWinColMin + 1;
                 int iNumWinRows = iWinRowMax - iWinRowMin + 1;
 
@@ -2016,7 +2148,8 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        ReadHandle handle( this );
+        GDALDataset* ds = handle.dataset();
 
         int tileSize = _options.tileSize().value();
 
@@ -2040,8 +2173,8 @@ public:
             geoToPixel( intersection.xMin(), intersection.yMax(), src_min_x, src_min_y);
             geoToPixel( intersection.xMax(), intersection.yMin(), src_max_x, src_max_y);
 
-            int rasterWidth = _warpedDS->GetRasterXSize();
-            int rasterHeight = _warpedDS->GetRasterYSize();
+            int rasterWidth = ds->GetRasterXSize();
+            int rasterHeight = ds->GetRasterYSize();
 
             // Convert the doubles to integers.  We floor the mins and ceil the maximums to give the widest window possible.
             src_min_x = osg::round(src_min_x);
@@ -2204,11 +2337,11 @@ public:
             OE_DEBUG << LC << "Read extents " << read_min_x << ", " << read_min_y << " to " << read_max_x << ", " << read_max_y << std::endl;
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(ds, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = ds->GetRasterBand(1);
             }
 
             float *heights = new float[target_width * target_height];
@@ -2293,6 +2426,16 @@ private:
     osg::ref_ptr< osgDB::Options > _dbOptions;
 
     unsigned int _maxDataLevel;
+
+    // parameters for reopening the dataset on reader threads
+    std::string _srcOpenString;
+    bool        _requiresWarp;
+    bool        _warpPolar;
+    std::string _warpSrcWKT;
+    std::string _warpDestWKT;
+
+    std::vector<DatasetHandle> _freeHandles;
+    OpenThreads::Mutex         _handlesMutex;
 };
 
 
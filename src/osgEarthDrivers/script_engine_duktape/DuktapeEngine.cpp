@@ -31,6 +31,13 @@
 // complete the feature set.
 //#define MAXIMUM_ISOLATION
 
+// maximum number of compiled snippets to cache in each context before
+// the cache is flushed.
+#define MAX_COMPILED_SCRIPTS 1024
+
+// name of the global stash property that holds the compiled snippets.
+#define COMPILED_SCRIPTS "oe_compiled_scripts"
+
 using namespace osgEarth;
 using namespace osgEarth::Features;
 using namespace osgEarth::Drivers::Duktape;
@@ -201,6 +208,7 @@ namespace
 DuktapeEngine::Context::Context()
 {
     _ctx = 0L;
+    _numCompiled = 0u;
 }
 
 void
@@ -240,7 +248,80 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
         }
 
         duk_pop(_ctx); // []
+
+        // cache of compiled code snippets, keyed by source.
+        duk_push_global_stash( _ctx );                  // [stash]
+        duk_push_object( _ctx );                        // [stash, cache]
+        duk_put_prop_string( _ctx, -2, COMPILED_SCRIPTS ); // [stash]
+        duk_pop(_ctx); // []
+        _numCompiled = 0u;
+    }
+}
+
+ScriptResult
+DuktapeEngine::Context::run(const std::string& code)
+{
+    duk_push_global_stash( _ctx );                      // [stash]
+    duk_get_prop_string( _ctx, -1, COMPILED_SCRIPTS );  // [stash, cache]
+
+    // Look up the compiled function; compile and cache it on a miss. This
+    // is the same compilation duk_peval_string performs, but done once per
+    // snippet instead of once per call.
+    if ( !duk_get_prop_string(_ctx, -1, code.c_str()) ) // [stash, cache, undefined]
+    {
+        duk_pop( _ctx );                                // [stash, cache]
+
+        if ( duk_pcompile_string(_ctx, DUK_COMPILE_EVAL, code.c_str()) != 0 ) // [stash, cache, error]
+        {
+            std::string message( duk_safe_to_string(_ctx, -1) );
+            duk_pop_3( _ctx );                          // []
+            OE_WARN << LC << "Error: source =" << std::endl << code << std::endl;
+            return ScriptResult("", false, message);
+        }
+
+        // [stash, cache, function]
+        if ( _numCompiled >= MAX_COMPILED_SCRIPTS )
+        {
+            // flush the cache by replacing it with an empty one.
+            duk_push_object( _ctx );                    // [stash, cache, function, newcache]
+            duk_put_prop_string( _ctx, -4, COMPILED_SCRIPTS );
+            _numCompiled = 0u;
+        }
+        else
+        {
+            duk_dup( _ctx, -1 );                        // [stash, cache, function, function]
+            duk_put_prop_string( _ctx, -3, code.c_str() ); // [stash, cache, function]
+            ++_numCompiled;
+        }
+    }
+
+    // [stash, cache, function]
+    duk_remove( _ctx, -2 );
+    duk_remove( _ctx, -2 );                             // [function]
+
+    // eval code runs with the global object as "this".
+    duk_push_global_object( _ctx );                     // [function, global]
+
+    // run the script. On error, the top of stack will hold the error
+    // message instead of the return value.
+    std::string resultString;
+
+    bool ok = (duk_pcall_method(_ctx, 0) == 0);         // [ "result" ]
+    const char* resultVal = duk_to_string(_ctx, -1);
+    if ( resultVal )
+        resultString = resultVal;
+
+    if ( !ok )
+    {
+        OE_WARN << LC << "Error: source =" << std::endl << code << std::endl;
     }
+
+    // pop the return value:
+    duk_pop(_ctx); // []
+
+    return ok ?
+        ScriptResult(resultString, true) :
+        ScriptResult("", false, resultString);
 }
 
 DuktapeEngine::Context::~Context()
@@ -297,24 +378,47 @@ DuktapeEngine::run(const std::string&   code,
     // remember the feature so we don't re-create it if not necessary
     c._feature = feature;
 
-    // run the script. On error, the top of stack will hold the error
-    // message instead of the return value.
-    std::string resultString;
+    return c.run( code );
+}
 
-    bool ok = (duk_peval_string(ctx, code.c_str()) == 0); // [ "result" ]
-    const char* resultVal = duk_to_string(ctx, -1);
-    if ( resultVal )
-        resultString = resultVal;
+void
+DuktapeEngine::run(const std::string&   code,
+                   const FeatureList&   features,
+                   ScriptResultVector&  results,
+                   FilterContext const* context)
+{
+    results.clear();
 
-    if ( !ok )
+    if (code.empty())
     {
-        OE_WARN << LC << "Error: source =" << std::endl << code << std::endl;
+        results.assign( features.size(), ScriptResult(EMPTY_STRING, false, "Script is empty.") );
+        return;
     }
 
-    // pop the return value:
-    duk_pop(ctx); // []
+    results.reserve( features.size() );
 
-    return ok ?
-        ScriptResult(resultString, true) :
-        ScriptResult("", false, resultString);
+    bool complete = (getProfile() == "full");
+
+#ifdef MAXIMUM_ISOLATION
+    for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        results.push_back( run(code, i->get(), context) );
+    }
+#else
+    // enter the per-thread context once for the entire batch.
+    Context& c = _contexts.get();
+    c.initialize( _options, complete );
+
+    for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        const Feature* feature = i->get();
+        if ( feature && feature != c._feature.get() )
+        {
+            setFeature(c._ctx, feature, complete);
+        }
+        c._feature = feature;
+
+        results.push_back( c.run(code) );
+    }
+#endif
 }
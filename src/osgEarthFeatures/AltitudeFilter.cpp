@@ -182,16 +182,45 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
     bool vertEquiv =
         featureSRS->isVertEquivalentTo( mapSRS );
 
-    for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
+    // run a symbol script if present.
+    if ( _altitude.valid() && _altitude->script().isSet() )
     {
-        Feature* feature = i->get();
-        
-        // run a symbol script if present.
-        if ( _altitude.valid() && _altitude->script().isSet() )
+        StringExpression temp( _altitude->script().get() );
+        for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
         {
-            StringExpression temp( _altitude->script().get() );
-            feature->eval( temp, &cx );
+            i->get()->eval( temp, &cx );
         }
+    }
+
+    // When clamping per vertex, sample the terrain under every point of every
+    // feature in a single query, so that points sharing an elevation tile are
+    // sampled together no matter which feature they belong to. "next" is the
+    // index of the current geometry's first point in the batch.
+    std::vector<osg::Vec3d> points;
+    std::vector<float>      elevations;
+    unsigned                next = 0u;
+
+    if ( perVertex )
+    {
+        for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
+        {
+            GeometryIterator gi( i->get()->getGeometry() );
+            while( gi.hasMore() )
+            {
+                Geometry* geom = gi.next();
+                points.insert( points.end(), geom->begin(), geom->end() );
+            }
+        }
+
+        if ( _altitude->clamping() == AltitudeSymbol::CLAMP_TO_TERRAIN )
+            eq.getElevations( points, featureSRS, true, _maxRes );
+        else
+            eq.getElevations( points, featureSRS, elevations, _maxRes );
+    }
+
+    for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
+    {
+        Feature* feature = i->get();
 
         double maxTerrainZ  = -DBL_MAX;
         double minTerrainZ  =  DBL_MAX;
@@ -226,46 +255,45 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
 
             total += geom->size();
 
+            unsigned first = next;
+            next += geom->size();
+
             // Absolute heights in Z. Only need to collect the HATs; the geometry
             // remains unchanged.
             if ( _altitude->clamping() == AltitudeSymbol::CLAMP_ABSOLUTE )
             {
                 if ( perVertex )
                 {
-                    std::vector<float> elevations;
-
-                    if ( eq.getElevations( geom->asVector(), featureSRS, elevations, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
-                        {
-                            osg::Vec3d& p = (*geom)[i];
+                        osg::Vec3d& p = (*geom)[i];
 
-                            if (p.z() != NO_DATA_VALUE)
-                            {
-                                p.z() *= scaleZ;
-                                p.z() += offsetZ;
+                        if (p.z() != NO_DATA_VALUE)
+                        {
+                            p.z() *= scaleZ;
+                            p.z() += offsetZ;
 
-                                double z = p.z();
+                            double z = p.z();
 
-                                if ( !vertEquiv )
-                                {
-                                    osg::Vec3d tempgeo;
-                                    if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
-                                        z = tempgeo.z();
-                                }
+                            if ( !vertEquiv )
+                            {
+                                osg::Vec3d tempgeo;
+                                if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
+                                    z = tempgeo.z();
+                            }
 
-                                double hat = z - elevations[i];
+                            double elevation = elevations[first+i];
+                            double hat = z - elevation;
 
-                                if ( hat > maxHAT )
-                                    maxHAT = hat;
-                                if ( hat < minHAT )
-                                    minHAT = hat;
+                            if ( hat > maxHAT )
+                                maxHAT = hat;
+                            if ( hat < minHAT )
+                                minHAT = hat;
 
-                                if ( elevations[i] > maxTerrainZ )
-                                    maxTerrainZ = elevations[i];
-                                if ( elevations[i] < minTerrainZ )
-                                    minTerrainZ = elevations[i];
-                            }
+                            if ( elevation > maxTerrainZ )
+                                maxTerrainZ = elevation;
+                            if ( elevation < minTerrainZ )
+                                minTerrainZ = elevation;
                         }
                     }
                 }
@@ -309,40 +337,35 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
 
                 if ( perVertex )
                 {
-                    std::vector<float> elevations;
-                    elevations.reserve( geom->size() );
-                    
-                    if ( eq.getElevations( geom->asVector(), featureSRS, elevations, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
+                        osg::Vec3d& p = (*geom)[i];
+
+                        if (p.z() != NO_DATA_VALUE)
                         {
-                            osg::Vec3d& p = (*geom)[i];
+                            p.z() *= scaleZ;
+                            p.z() += offsetZ;
+
+                            double elevation = elevations[first+i];
+                            double hat = p.z();
+                            p.z() = elevation + p.z();
 
-                            if (p.z() != NO_DATA_VALUE)
+                            // if necessary, convert the Z value (which is now in the map's SRS) back to
+                            // the feature's SRS.
+                            if ( !vertEquiv )
                             {
-                                p.z() *= scaleZ;
-                                p.z() += offsetZ;
-
-                                double hat = p.z();
-                                p.z() = elevations[i] + p.z();
-
-                                // if necessary, convert the Z value (which is now in the map's SRS) back to
-                                // the feature's SRS.
-                                if ( !vertEquiv )
-                                {
-                                    featureSRSwithMapVertDatum->transform(p, featureSRS, p);
-                                }
-
-                                if ( hat > maxHAT )
-                                    maxHAT = hat;
-                                if ( hat < minHAT )
-                                    minHAT = hat;
-
-                                if ( elevations[i] > maxTerrainZ )
-                                    maxTerrainZ = elevations[i];
-                                if ( elevations[i] < minTerrainZ )
-                                    minTerrainZ = elevations[i];
+                                featureSRSwithMapVertDatum->transform(p, featureSRS, p);
                             }
+
+                            if ( hat > maxHAT )
+                                maxHAT = hat;
+                            if ( hat < minHAT )
+                                minHAT = hat;
+
+                            if ( elevation > maxTerrainZ )
+                                maxTerrainZ = elevation;
+                            if ( elevation < minTerrainZ )
+                                minTerrainZ = elevation;
                         }
                     }
                 }
@@ -382,8 +405,11 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             {
                 if ( perVertex )
                 {
-                    eq.getElevations( geom->asVector(), featureSRS, true, _maxRes );
-                    
+                    for( unsigned i=0; i<geom->size(); ++i )
+                    {
+                        (*geom)[i].z() = points[first+i].z();
+                    }
+
                     // if necessary, transform the Z values (which are now in the map SRS) back
                     // into the feature's SRS.
                     if ( !vertEquiv )
@@ -22,6 +22,7 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/JsonUtils>
 #include <algorithm>
+#include <cctype>
 
 using namespace osgEarth;
 using namespace osgEarth::Features;
@@ -144,6 +145,272 @@ AttributeValue::getBool( bool defaultValue ) const
 
 //----------------------------------------------------------------------------
 
+namespace
+{
+    // FNV-1a hash of the lower-cased name
+    unsigned hashName(const std::string& name)
+    {
+        unsigned h = 2166136261u;
+        for(std::string::const_iterator c = name.begin(); c != name.end(); ++c)
+        {
+            h ^= (unsigned)::tolower((unsigned char)*c);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    bool equalsNoCase(const std::string& a, const std::string& b)
+    {
+        if ( a.size() != b.size() )
+            return false;
+        for(unsigned i=0; i<a.size(); ++i)
+        {
+            if ( ::tolower((unsigned char)a[i]) != ::tolower((unsigned char)b[i]) )
+                return false;
+        }
+        return true;
+    }
+}
+
+namespace
+{
+    // Binds the expression's variables to the slots of the table's schema,
+    // once per schema; returns NULL if the table has no schema.
+    template<typename EXPR>
+    const std::vector<int>* bindVariables(EXPR& expr, const AttributeTable& attrs)
+    {
+        const AttributeSchema* schema = attrs.getSchema();
+        if ( !schema )
+            return 0L;
+
+        if ( expr.getBindingSchema() != schema )
+        {
+            std::vector<int> slots( expr.variables().size() );
+            for(unsigned i=0; i<slots.size(); ++i)
+                slots[i] = schema->indexOf( expr.variables()[i].first );
+            expr.bind( schema, slots );
+        }
+
+        return &expr.getBindings();
+    }
+
+    // Value of the i'th variable, through its bound slot when it has one.
+    const AttributeValue* lookup(const AttributeTable& attrs, const std::vector<int>* slots, unsigned i, const std::string& name)
+    {
+        if ( slots && (*slots)[i] >= 0 )
+            return attrs.getSlot( (unsigned)(*slots)[i] );
+        else
+            return attrs.get( name );
+    }
+}
+
+AttributeSchema::AttributeSchema()
+{
+    rehash( 16u );
+}
+
+void
+AttributeSchema::rehash(unsigned numBuckets)
+{
+    _buckets.assign( numBuckets, -1 );
+    unsigned mask = numBuckets - 1u;
+    for(unsigned i=0; i<_names.size(); ++i)
+    {
+        unsigned b = _hashes[i] & mask;
+        while( _buckets[b] >= 0 )
+            b = (b + 1u) & mask;
+        _buckets[b] = (int)i;
+    }
+}
+
+int
+AttributeSchema::indexOf(const std::string& name) const
+{
+    unsigned h = hashName( name );
+    unsigned mask = _buckets.size() - 1u;
+    for(unsigned b = h & mask; _buckets[b] >= 0; b = (b + 1u) & mask)
+    {
+        int i = _buckets[b];
+        if ( _hashes[i] == h && equalsNoCase(_names[i], name) )
+            return i;
+    }
+    return -1;
+}
+
+unsigned
+AttributeSchema::add(const std::string& name)
+{
+    int existing = indexOf( name );
+    if ( existing >= 0 )
+        return (unsigned)existing;
+
+    _names.push_back( name );
+    _hashes.push_back( hashName(name) );
+
+    // keep the load factor at or below one half.
+    if ( _names.size()*2u > _buckets.size() )
+    {
+        rehash( _buckets.size()*2u );
+    }
+    else
+    {
+        unsigned mask = _buckets.size() - 1u;
+        unsigned b = _hashes.back() & mask;
+        while( _buckets[b] >= 0 )
+            b = (b + 1u) & mask;
+        _buckets[b] = (int)(_names.size()-1u);
+    }
+
+    return _names.size()-1u;
+}
+
+//----------------------------------------------------------------------------
+
+AttributeTable::const_iterator::const_iterator(const AttributeTable* table, unsigned slot, Overflow::const_iterator over) :
+_table( table ),
+_slot ( slot ),
+_over ( over )
+{
+    //nop
+}
+
+void
+AttributeTable::const_iterator::skipAbsent()
+{
+    while( _slot < _table->_values.size() && !_table->_present[_slot] )
+        ++_slot;
+}
+
+AttributeTable::Entry
+AttributeTable::const_iterator::operator*() const
+{
+    if ( _slot < _table->_values.size() )
+        return Entry( _table->_schema->getName(_slot), _table->_values[_slot] );
+    else
+        return Entry( _over->first, _over->second );
+}
+
+AttributeTable::const_iterator&
+AttributeTable::const_iterator::operator++()
+{
+    if ( _slot < _table->_values.size() )
+    {
+        ++_slot;
+        skipAbsent();
+    }
+    else
+    {
+        ++_over;
+    }
+    return *this;
+}
+
+AttributeTable::AttributeTable() :
+_numPresent( 0u )
+{
+    //nop
+}
+
+void
+AttributeTable::setSchema(const AttributeSchema* schema)
+{
+    if ( schema == _schema.get() )
+        return;
+
+    // move the existing attributes over to the new layout.
+    std::vector< std::pair<std::string, AttributeValue> > existing;
+    existing.reserve( size() );
+    for(const_iterator i = begin(); i != end(); ++i)
+        existing.push_back( std::make_pair(i->first, i->second) );
+
+    _schema = schema;
+    _values.clear();
+    _present.clear();
+    _numPresent = 0u;
+    _overflow.clear();
+
+    for(unsigned i=0; i<existing.size(); ++i)
+        (*this)[existing[i].first] = existing[i].second;
+}
+
+AttributeValue&
+AttributeTable::at(unsigned slot)
+{
+    if ( _values.empty() )
+    {
+        _values.resize( _schema->size() );
+        _present.resize( _schema->size(), false );
+    }
+
+    if ( !_present[slot] )
+    {
+        _present[slot] = true;
+        ++_numPresent;
+    }
+
+    return _values[slot];
+}
+
+AttributeValue&
+AttributeTable::operator[](const std::string& name)
+{
+    int slot = _schema.valid() ? _schema->indexOf(name) : -1;
+    if ( slot >= 0 )
+        return at( (unsigned)slot );
+    else
+        return _overflow[name];
+}
+
+const AttributeValue*
+AttributeTable::getSlot(unsigned slot) const
+{
+    return slot < _values.size() && _present[slot] ? &_values[slot] : 0L;
+}
+
+const AttributeValue*
+AttributeTable::get(const std::string& name) const
+{
+    if ( _schema.valid() )
+    {
+        int slot = _schema->indexOf( name );
+        if ( slot >= 0 )
+            return (unsigned)slot < _values.size() && _present[slot] ? &_values[slot] : 0L;
+    }
+
+    Overflow::const_iterator i = _overflow.find( name );
+    return i != _overflow.end() ? &i->second : 0L;
+}
+
+AttributeTable::const_iterator
+AttributeTable::find(const std::string& name) const
+{
+    if ( _schema.valid() )
+    {
+        int slot = _schema->indexOf( name );
+        if ( slot >= 0 )
+            return (unsigned)slot < _values.size() && _present[slot] ? const_iterator(this, slot, _overflow.begin()) : end();
+    }
+
+    Overflow::const_iterator i = _overflow.find( name );
+    return i != _overflow.end() ? const_iterator(this, _values.size(), i) : end();
+}
+
+AttributeTable::const_iterator
+AttributeTable::begin() const
+{
+    const_iterator i( this, 0u, _overflow.begin() );
+    i.skipAbsent();
+    return i;
+}
+
+AttributeTable::const_iterator
+AttributeTable::end() const
+{
+    return const_iterator( this, _values.size(), _overflow.end() );
+}
+
+//----------------------------------------------------------------------------
+
 Feature::Feature( FeatureID fid ) :
 _fid( fid ),
 _srs( 0L )
@@ -273,55 +540,56 @@ Feature::setNull( const std::string& name, AttributeType type)
 bool
 Feature::hasAttr( const std::string& name ) const
 {
-    return _attrs.find(toLower(name)) != _attrs.end();
+    return _attrs.get(name) != 0L;
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
+    const AttributeValue* a = _attrs.get(name);
+    return a ? a->getString() : EMPTY_STRING;
 }
 
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
+    const AttributeValue* a = _attrs.get(name);
+    return a ? a->getDouble(defaultValue) : defaultValue;
 }
 
 int
 Feature::getInt( const std::string& name, int defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
+    const AttributeValue* a = _attrs.get(name);
+    return a ? a->getInt(defaultValue) : defaultValue;
 }
 
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
+    const AttributeValue* a = _attrs.get(name);
+    return a ? a->getBool(defaultValue) : defaultValue;
 }
 
 bool
 Feature::isSet( const std::string& name) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
-    return i != _attrs.end()? i->second.second.set : false;
+    const AttributeValue* a = _attrs.get(name);
+    return a ? a->second.set : false;
 }
 
 double
 Feature::eval( NumericExpression& expr, FilterContext const* context ) const
 {
+    const std::vector<int>* slots = bindVariables(expr, _attrs);
     const NumericExpression::Variables& vars = expr.variables();
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       double val = 0.0;
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      const AttributeValue* a = lookup(_attrs, slots, i - vars.begin(), i->first);
+      if (a)
       {
-        val = ai->second.getDouble(0.0);
+        val = a->getDouble(0.0);
       }
       else if (context && context->getSession())
       {
@@ -347,14 +615,15 @@ Feature::eval( NumericExpression& expr, FilterContext const* context ) const
 double
 Feature::eval(NumericExpression& expr, Session* session) const
 {
+    const std::vector<int>* slots = bindVariables(expr, _attrs);
     const NumericExpression::Variables& vars = expr.variables();
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         double val = 0.0;
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        const AttributeValue* a = lookup(_attrs, slots, i - vars.begin(), i->first);
+        if (a)
         {
-            val = ai->second.getDouble(0.0);
+            val = a->getDouble(0.0);
         }
         else if (session)
         {
@@ -383,14 +652,15 @@ Feature::eval(NumericExpression& expr, Session* session) const
 const std::string&
 Feature::eval( StringExpression& expr, FilterContext const* context ) const
 {
+    const std::vector<int>* slots = bindVariables(expr, _attrs);
     const StringExpression::Variables& vars = expr.variables();
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       std::string val = "";
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      const AttributeValue* a = lookup(_attrs, slots, i - vars.begin(), i->first);
+      if (a)
       {
-        val = ai->second.getString();
+        val = a->getString();
       }
       else if (context && context->getSession())
       {
@@ -415,14 +685,15 @@ Feature::eval( StringExpression& expr, FilterContext const* context ) const
 const std::string&
 Feature::eval(StringExpression& expr, Session* session) const
 {
+    const std::vector<int>* slots = bindVariables(expr, _attrs);
     const StringExpression::Variables& vars = expr.variables();
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         std::string val = "";
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        const AttributeValue* a = lookup(_attrs, slots, i - vars.begin(), i->first);
+        if (a)
         {
-            val = ai->second.getString();
+            val = a->getString();
         }
         else if (session)
         {
@@ -444,6 +715,17 @@ Feature::eval(StringExpression& expr, Session* session) const
     return expr.eval();
 }
 
+void
+Feature::eval(NumericExpression& expr, const FeatureList& features, std::vector<double>& out_values, FilterContext const* context)
+{
+    out_values.resize( features.size() );
+
+    unsigned n = 0u;
+    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++n )
+    {
+        out_values[n] = f->valid() ? f->get()->eval( expr, context ) : 0.0;
+    }
+}
 
 bool
 Feature::getWorldBound(const SpatialReference* srs,
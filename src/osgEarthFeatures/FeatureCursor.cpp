@@ -42,6 +42,13 @@ _clone   ( false )
     _iter = _features.begin();
 }
 
+FeatureListCursor::FeatureListCursor(const FeatureList& features, bool clone) :
+_features( features ),
+_clone   ( clone )
+{
+    _iter = _features.begin();
+}
+
 bool
 FeatureListCursor::hasMore() const
 {
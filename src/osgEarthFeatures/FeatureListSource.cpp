@@ -17,18 +17,42 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/FeatureListSource>
+#include <osg/Math>
+#include <algorithm>
+#include <cmath>
 
+using namespace osgEarth;
 using namespace osgEarth::Features;
 
+namespace
+{
+    // index of the grid cell containing "v" along one axis
+    unsigned cellOf(double v, double min, double max, unsigned n)
+    {
+        if ( max <= min )
+            return 0u;
+        double c = floor( (v - min) / (max - min) * (double)n );
+        return c <= 0.0 ? 0u : c >= (double)(n-1) ? n-1 : (unsigned)c;
+    }
+}
+
 FeatureListSource::FeatureListSource():
-FeatureSource()
+FeatureSource(),
+_gridCols    ( 0u ),
+_gridRows    ( 0u ),
+_stamp       ( 0u ),
+_indexDirty  ( true )
 {
     //nop
 }
 
 FeatureListSource::FeatureListSource(const GeoExtent& defaultExtent ) :
 FeatureSource (),
-_defaultExtent( defaultExtent )
+_defaultExtent( defaultExtent ),
+_gridCols     ( 0u ),
+_gridRows     ( 0u ),
+_stamp        ( 0u ),
+_indexDirty   ( true )
 {
     //nop
 }
@@ -39,15 +63,151 @@ FeatureListSource::createFeatureCursor( const Symbology::Query& query )
     if (getFeatureProfile() == 0L)
         setFeatureProfile(createFeatureProfile());
 
-    //Create a copy of all of the features before returning the cursor.
-    //The processing filters in osgEarth can modify the features as they are operating and we don't want our original data destroyed.
     FeatureList cursorFeatures;
+    if ( query.bounds().isSet() && query.bounds()->isValid() )
+    {
+        queryIndex( query.bounds().get(), cursorFeatures );
+    }
+    else
+    {
+        Threading::ScopedMutexLock lock( _indexMutex );
+        cursorFeatures = _features;
+    }
+
+    //The processing filters in osgEarth can modify the features as they are operating and we don't want our original data destroyed,
+    //so the cursor copies each feature as it's read.
+    return new FeatureListCursor( cursorFeatures, true );
+}
+
+void
+FeatureListSource::dirty()
+{
+    // a feature may have been edited in place, so its indexed bounds can no
+    // longer be trusted.
+    {
+        Threading::ScopedMutexLock lock( _indexMutex );
+        _indexDirty = true;
+    }
+    Revisioned::dirty();
+}
+
+FeatureList&
+FeatureListSource::getFeatures()
+{
+    // the caller may modify the list, so the index can no longer be trusted.
+    Threading::ScopedMutexLock lock( _indexMutex );
+    _indexDirty = true;
+    return _features;
+}
+
+void
+FeatureListSource::buildIndex()
+{
+    _entries.clear();
+    _cells.clear();
+    _gridBounds = Bounds();
+    _gridCols = _gridRows = 0u;
+    _indexDirty = false;
+
     for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
     {
-        Feature* feature = new osgEarth::Features::Feature(*(itr->get()), osg::CopyOp::DEEP_COPY_ALL);        
-        cursorFeatures.push_back( feature );
-    }    
-    return new FeatureListCursor( cursorFeatures );
+        Feature* feature = itr->get();
+        if ( feature && feature->getGeometry() )
+        {
+            IndexEntry entry;
+            entry._feature = feature;
+            entry._bounds  = feature->getGeometry()->getBounds();
+            entry._stamp   = 0u;
+            if ( entry._bounds.isValid() )
+            {
+                _entries.push_back( entry );
+                _gridBounds.expandBy( entry._bounds );
+            }
+        }
+    }
+
+    if ( _entries.empty() )
+        return;
+
+    // aim for a handful of features per cell.
+    unsigned n = (unsigned)ceil( sqrt( (double)_entries.size() / 4.0 ) );
+    _gridCols = _gridRows = osg::clampBetween( n, 1u, 256u );
+    _cells.resize( _gridCols * _gridRows );
+
+    for(unsigned i=0; i<_entries.size(); ++i)
+        addToIndex( i );
+}
+
+void
+FeatureListSource::getCellRange(const Bounds& b, unsigned& c0, unsigned& r0, unsigned& c1, unsigned& r1) const
+{
+    c0 = cellOf( b.xMin(), _gridBounds.xMin(), _gridBounds.xMax(), _gridCols );
+    c1 = cellOf( b.xMax(), _gridBounds.xMin(), _gridBounds.xMax(), _gridCols );
+    r0 = cellOf( b.yMin(), _gridBounds.yMin(), _gridBounds.yMax(), _gridRows );
+    r1 = cellOf( b.yMax(), _gridBounds.yMin(), _gridBounds.yMax(), _gridRows );
+}
+
+void
+FeatureListSource::addToIndex(unsigned i)
+{
+    // Bounds outside the grid clamp to the edge cells, which queries clamp
+    // the same way, so the result is still correct.
+    unsigned c0, r0, c1, r1;
+    getCellRange( _entries[i]._bounds, c0, r0, c1, r1 );
+    for(unsigned r=r0; r<=r1; ++r)
+        for(unsigned c=c0; c<=c1; ++c)
+            _cells[r*_gridCols + c].push_back( i );
+}
+
+void
+FeatureListSource::queryIndex(const Bounds& bounds, FeatureList& output)
+{
+    Threading::ScopedMutexLock lock( _indexMutex );
+
+    if ( _indexDirty )
+        buildIndex();
+
+    if ( _cells.empty() )
+        return;
+
+    // the stamp marks entries already visited, since large features span many cells.
+    if ( ++_stamp == 0u )
+    {
+        for(unsigned i=0; i<_entries.size(); ++i)
+            _entries[i]._stamp = 0u;
+        _stamp = 1u;
+    }
+
+    std::vector<unsigned> hits;
+
+    unsigned c0, r0, c1, r1;
+    getCellRange( bounds, c0, r0, c1, r1 );
+    for(unsigned r=r0; r<=r1; ++r)
+    {
+        for(unsigned c=c0; c<=c1; ++c)
+        {
+            const std::vector<unsigned>& cell = _cells[r*_gridCols + c];
+            for(unsigned k=0; k<cell.size(); ++k)
+            {
+                IndexEntry& entry = _entries[cell[k]];
+                if ( entry._stamp != _stamp )
+                {
+                    entry._stamp = _stamp;
+                    const Bounds& eb = entry._bounds;
+                    if (eb.xMin() <= bounds.xMax() && eb.xMax() >= bounds.xMin() &&
+                        eb.yMin() <= bounds.yMax() && eb.yMax() >= bounds.yMin())
+                    {
+                        hits.push_back( cell[k] );
+                    }
+                }
+            }
+        }
+    }
+
+    // return the features in list order.
+    std::sort( hits.begin(), hits.end() );
+    for(unsigned i=0; i<hits.size(); ++i)
+        output.push_back( _entries[hits[i]]._feature );
 }
 
 const FeatureProfile*
@@ -83,12 +243,14 @@ bool
 FeatureListSource::deleteFeature(FeatureID fid)
 {
     dirtyFeatureProfile();
+    Threading::ScopedMutexLock lock( _indexMutex );
     for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr) 
     {
         if (itr->get()->getFID() == fid)
         {
             _features.erase( itr );
-            dirty();
+            _indexDirty = true;
+            Revisioned::dirty();
             return true;
         }
     }
@@ -111,7 +273,32 @@ FeatureListSource::getFeature( FeatureID fid )
 bool FeatureListSource::insertFeature(Feature* feature)
 {
     dirtyFeatureProfile();
+    Threading::ScopedMutexLock lock( _indexMutex );
     _features.push_back( feature );
-    dirty();
+
+    // add to the index in place, unless it has outgrown its grid.
+    if ( !_indexDirty && feature && feature->getGeometry() )
+    {
+        IndexEntry entry;
+        entry._feature = feature;
+        entry._bounds  = feature->getGeometry()->getBounds();
+        entry._stamp   = 0u;
+
+        if ( !entry._bounds.isValid() )
+        {
+            // not indexable; queries with bounds skip it
+        }
+        else if ( _cells.empty() || _entries.size() >= 16u * _cells.size() || !_gridBounds.contains(entry._bounds) )
+        {
+            _indexDirty = true;
+        }
+        else
+        {
+            _entries.push_back( entry );
+            addToIndex( _entries.size()-1 );
+        }
+    }
+
+    Revisioned::dirty();
     return true;
 }
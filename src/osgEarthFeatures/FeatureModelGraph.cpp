@@ -32,6 +32,7 @@
 #include <osgEarth/FadeEffect>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/TaskService>
 #include <osgEarth/ThreadingUtils>
 
 #include <osg/CullFace>
@@ -1293,6 +1294,24 @@ FeatureModelGraph::buildStyleGroups(const StyleSelector*  selector,
 }
 
 
+/**
+ * Compiles one style bin; run through a ParallelTask.
+ */
+struct FeatureModelGraph::CompileStyleGroup
+{
+    void execute() {
+        _ok = _graph->compileStyleGroup( _style, *_workingSet, *_context, _readOptions, _node );
+    }
+
+    FeatureModelGraph*      _graph;
+    Style                   _style;
+    FeatureList*            _workingSet;
+    const FilterContext*    _context;
+    const osgDB::Options*   _readOptions;
+    osg::ref_ptr<osg::Node> _node;
+    bool                    _ok;
+};
+
 /**
  * Querys the feature source;
  * Visits each feature and uses the Style Expression to resolve its style class;
@@ -1338,7 +1357,10 @@ FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
         }
     }
 
-    // next create a style group per bin.
+    // next resolve the style for each bin.
+    std::vector<Style>        binStyles;
+    std::vector<FeatureList*> binFeatures;
+
     for( std::map<std::string,FeatureList>::iterator i = styleBins.begin(); i != styleBins.end(); ++i )
     {
         const std::string& styleString = i->first;
@@ -1367,11 +1389,65 @@ FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
                 combinedStyle = *selectedStyle;
         }
 
-        // if there is a valid style, create the node and add it. (Otherwise we will skip
+        // if there is a valid style, queue the bin for compilation. (Otherwise we will skip
         // the feature.)
         if ( !combinedStyle.empty() )
         {
-            osg::Group* styleGroup = createStyleGroup(combinedStyle, workingSet, context, readOptions);
+            binStyles.push_back( combinedStyle );
+            binFeatures.push_back( &workingSet );
+        }
+    }
+
+    // finally create a style group per bin, concurrently if so configured.
+    TaskService* service =
+        _options.parallelStyleGroups() == true && binStyles.size() > 1 ?
+        Registry::instance()->getTaskServiceManager()->getOrAdd("FeatureModelGraph style groups") : 0L;
+
+    if ( service )
+    {
+        typedef ParallelTask<CompileStyleGroup> CompileStyleGroupTask;
+
+        // Compile the first bin on this thread and farm the rest out to the pool.
+        // Each bin gets its own copy of the filter context in compileStyleGroup.
+        Threading::MultiEvent done( binStyles.size()-1 );
+        std::vector< osg::ref_ptr<CompileStyleGroupTask> > tasks( binStyles.size() );
+
+        for(unsigned i=0; i<binStyles.size(); ++i)
+        {
+            tasks[i] = new CompileStyleGroupTask( &done );
+            tasks[i]->_graph       = this;
+            tasks[i]->_style       = binStyles[i];
+            tasks[i]->_workingSet  = binFeatures[i];
+            tasks[i]->_context     = &context;
+            tasks[i]->_readOptions = readOptions;
+            tasks[i]->_ok          = false;
+            if ( i > 0 )
+                service->add( tasks[i].get() );
+        }
+
+        tasks[0]->execute();
+        done.wait();
+
+        // Merge the results in bin order so the output matches a sequential build.
+        for(unsigned i=0; i<tasks.size(); ++i)
+        {
+            if ( tasks[i]->_ok )
+            {
+                osg::Group* styleGroup = getOrCreateStyleGroupFromFactory( binStyles[i] );
+
+                // if it returned a node, add it. (it doesn't necessarily have to)
+                if ( tasks[i]->_node.valid() )
+                    styleGroup->addChild( tasks[i]->_node.get() );
+
+                parent->addChild( styleGroup );
+            }
+        }
+    }
+    else
+    {
+        for(unsigned i=0; i<binStyles.size(); ++i)
+        {
+            osg::Group* styleGroup = createStyleGroup(binStyles[i], *binFeatures[i], context, readOptions);
             if ( styleGroup )
                 parent->addChild( styleGroup );
         }
@@ -1387,6 +1463,27 @@ FeatureModelGraph::createStyleGroup(const Style&          style,
 {
     osg::Group* styleGroup = 0L;
 
+    osg::ref_ptr<osg::Node> node;
+    if ( compileStyleGroup( style, workingSet, contextPrototype, readOptions, node ) )
+    {
+        styleGroup = getOrCreateStyleGroupFromFactory( style );
+
+        // if it returned a node, add it. (it doesn't necessarily have to)
+        if ( node.valid() )
+            styleGroup->addChild( node.get() );
+    }
+
+    return styleGroup;
+}
+
+
+bool
+FeatureModelGraph::compileStyleGroup(const Style&             style,
+                                     FeatureList&             workingSet,
+                                     const FilterContext&     contextPrototype,
+                                     const osgDB::Options*    readOptions,
+                                     osg::ref_ptr<osg::Node>& output)
+{
     OE_DEBUG << LC << "Created style group \"" << style.getName() << "\"\n";
 
     FilterContext context(contextPrototype);
@@ -1422,21 +1519,11 @@ FeatureModelGraph::createStyleGroup(const Style&          style,
     // finally, compile the features into a node.
     if ( workingSet.size() > 0 )
     {
-        osg::ref_ptr<osg::Node> node;
         osg::ref_ptr<FeatureCursor> newCursor = new FeatureListCursor(workingSet);
-
-        if ( createOrUpdateNode( newCursor.get(), style, context, readOptions, node ) )
-        {
-            if ( !styleGroup )
-                styleGroup = getOrCreateStyleGroupFromFactory( style );
-
-            // if it returned a node, add it. (it doesn't necessarily have to)
-            if ( node.valid() )
-                styleGroup->addChild( node.get() );
-        }
+        return createOrUpdateNode( newCursor.get(), style, context, readOptions, output );
     }
 
-    return styleGroup;
+    return false;
 }
 
 
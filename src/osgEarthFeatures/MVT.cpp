@@ -21,6 +21,8 @@
 #include <osgEarth/Registry>
 #include <osgEarth/FileUtils>
 #include <osgEarth/GeoData>
+#include <osgEarth/TaskService>
+#include <osgEarth/StringUtils>
 #include <osgEarthFeatures/FeatureSource>
 #include <list>
 #include <stdio.h>
@@ -60,215 +62,398 @@ int zig_zag_decode(int n)
 
 #ifdef OSGEARTH_HAVE_MVT
 
-Geometry* decodeLine(const mapnik::vector::tile_feature& feature, const TileKey& key, unsigned int tileres)
+namespace
 {
-    unsigned int length = 0;
-    int cmd = -1;
-    const int cmd_bits = 3;
+    /**
+     * Maps tile coordinates (0..extent) to the map coordinates of a TileKey.
+     */
+    struct TileTransform
+    {
+        TileTransform(const TileKey& key, unsigned int tileres)
+        {
+            const GeoExtent& ex = key.getExtent();
+            _x0 = ex.xMin();
+            _y0 = ex.yMax();
+            _sx = ex.width() / (double)tileres;
+            _sy = ex.height() / (double)tileres;
+        }
 
-    int x = 0;
-    int y = 0;
+        double x(int tx) const { return _x0 + _sx * (double)tx; }
+        double y(int ty) const { return _y0 - _sy * (double)ty; }
 
-    osgEarth::Symbology::LineString *geometry = new osgEarth::Symbology::LineString();
+        double _x0, _y0, _sx, _sy;
+    };
 
-    for (int k = 0; k < feature.geometry_size();)
+    /**
+     * Counts the vertices in a feature's command stream so the geometry
+     * can be allocated once.
+     */
+    unsigned countVertices(const mapnik::vector::tile_feature& feature)
     {
-        if (!length)
+        unsigned count = 0;
+        for (int k = 0; k < feature.geometry_size();)
         {
             unsigned int cmd_length = feature.geometry(k++);
-            cmd = cmd_length & ((1 << cmd_bits) - 1);
-            length = cmd_length >> cmd_bits;
-        }
-        if (length > 0)
-        {
-            length--;
+            int cmd = cmd_length & ((1 << CMD_BITS) - 1);
+            unsigned int length = cmd_length >> CMD_BITS;
             if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
             {
-                int px = feature.geometry(k++);
-                int py = feature.geometry(k++);
-                px = zig_zag_decode(px);
-                py = zig_zag_decode(py);
+                count += length;
+                k += 2 * length;
+            }
+        }
+        return count;
+    }
 
-                x += px;
-                y += py;
+    /**
+     * Decodes a point or line command stream into a pre-sized geometry.
+     */
+    Geometry* decodeVertices(const mapnik::vector::tile_feature& feature, const TileTransform& xform, Geometry* geometry)
+    {
+        unsigned int length = 0;
+        int cmd = -1;
+
+        int x = 0;
+        int y = 0;
 
-                double width = key.getExtent().width();
-                double height = key.getExtent().height();
+        geometry->reserve( countVertices(feature) );
 
-                double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                geometry->push_back(geoX, geoY, 0);
+        for (int k = 0; k < feature.geometry_size();)
+        {
+            if (!length)
+            {
+                unsigned int cmd_length = feature.geometry(k++);
+                cmd = cmd_length & ((1 << CMD_BITS) - 1);
+                length = cmd_length >> CMD_BITS;
+            }
+            if (length > 0)
+            {
+                length--;
+                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+                {
+                    x += zig_zag_decode(feature.geometry(k++));
+                    y += zig_zag_decode(feature.geometry(k++));
+                    geometry->push_back(xform.x(x), xform.y(y), 0);
+                }
             }
         }
+
+        return geometry;
     }
 
-    return geometry;
-}
+    Geometry* decodeLine(const mapnik::vector::tile_feature& feature, const TileTransform& xform)
+    {
+        return decodeVertices(feature, xform, new osgEarth::Symbology::LineString());
+    }
 
-Geometry* decodePoint(const mapnik::vector::tile_feature& feature, const TileKey& key, unsigned int tileres)
-{
-    unsigned int length = 0;
-    int cmd = -1;
-    const int cmd_bits = 3;
+    Geometry* decodePoint(const mapnik::vector::tile_feature& feature, const TileTransform& xform)
+    {
+        return decodeVertices(feature, xform, new osgEarth::Symbology::PointSet());
+    }
 
-    int x = 0;
-    int y = 0;
+    Geometry* decodePolygon(const mapnik::vector::tile_feature& feature, const TileTransform& xform)
+    {
+        /*
+         https://github.com/mapbox/vector-tile-spec/tree/master/2.1
+         Decoding polygons is a bit more difficult than lines or points.
+         A Polygon geometry is either a single polygon or a multipolygon.  Each polygon has one exterior ring and zero or more interior rings.
+         The rings are in sequence and you must check the orientation of the ring to know if it's an exterior ring (new polygon) or an 
+         interior ring (inner polygon of the current polygon).
+         */
 
-    osgEarth::Symbology::PointSet *geometry = new osgEarth::Symbology::PointSet();
+        unsigned int length = 0;
+        int cmd = -1;
 
-    for (int k = 0; k < feature.geometry_size();)
-    {
-        if (!length)
-        {
-            unsigned int cmd_length = feature.geometry(k++);
-            cmd = cmd_length & ((1 << cmd_bits) - 1);
-            length = cmd_length >> cmd_bits;
-        }
-        if (length > 0)
-        {
-            length--;
-            if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
-            {
-                int px = feature.geometry(k++);
-                int py = feature.geometry(k++);
-                px = zig_zag_decode(px);
-                py = zig_zag_decode(py);
+        int x = 0;
+        int y = 0;
 
-                x += px;
-                y += py;
+        // The list of polygons we've collected
+        std::vector< osg::ref_ptr< osgEarth::Symbology::Polygon > > polygons;
 
-                double width = key.getExtent().width();
-                double height = key.getExtent().height();
+        osg::ref_ptr< osgEarth::Symbology::Polygon > currentPolygon;    
 
-                double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                geometry->push_back(geoX, geoY, 0);
+        osg::ref_ptr< osgEarth::Symbology::Ring > currentRing;
+
+        for (int k = 0; k < feature.geometry_size();)
+        {
+            if (!length)
+            {
+                unsigned int cmd_length = feature.geometry(k++);
+                cmd = cmd_length & ((1 << CMD_BITS) - 1);
+                length = cmd_length >> CMD_BITS;
             }
-        }
-    }
+            if (length > 0)
+            {
+                length--;
+                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+                {
+                    x += zig_zag_decode(feature.geometry(k++));
+                    y += zig_zag_decode(feature.geometry(k++));
 
-    return geometry;
-}
+                    if (!currentRing)
+                    {
+                        // A ring is a MoveTo followed by a LineTo; size it for
+                        // both plus the closing point.
+                        unsigned capacity = 2;
+                        if (k < feature.geometry_size() && (feature.geometry(k) & ((1 << CMD_BITS) - 1)) == SEG_LINETO)
+                            capacity += feature.geometry(k) >> CMD_BITS;
+                        currentRing = new osgEarth::Symbology::Ring(capacity);
+                    }
 
-Geometry* decodePolygon(const mapnik::vector::tile_feature& feature, const  TileKey& key, unsigned int tileres)
-{
-    /*
-     https://github.com/mapbox/vector-tile-spec/tree/master/2.1
-     Decoding polygons is a bit more difficult than lines or points.
-     A Polygon geometry is either a single polygon or a multipolygon.  Each polygon has one exterior ring and zero or more interior rings.
-     The rings are in sequence and you must check the orientation of the ring to know if it's an exterior ring (new polygon) or an 
-     interior ring (inner polygon of the current polygon).
-     */
-    
+                    currentRing->push_back(xform.x(x), xform.y(y), 0);
+                }
+                else if (cmd == (SEG_CLOSE & ((1 << CMD_BITS) - 1)) && currentRing.valid())
+                {
+                    // The orientation is the opposite of what we want for features.  clockwise means exterior ring, counter clockwise means interior                
 
-    unsigned int length = 0;
-    int cmd = -1;
-    const int cmd_bits = 3;
+                    // Figure out what to do with the ring based on the orientation of the ring
+                    Geometry::Orientation orientation = currentRing->getOrientation();
+                    // Close the ring.
+                    currentRing->close();
 
-    int x = 0;
-    int y = 0;
+                    // Clockwise means exterior ring.  Start a new polygon and add the ring.
+                    if (orientation == Geometry::ORIENTATION_CW)
+                    {
+                        // osgearth orientations are reversed from mvt
+                        currentRing->rewind(Geometry::ORIENTATION_CCW);
+
+                        // take over the ring's points instead of copying them.
+                        currentPolygon = new osgEarth::Symbology::Polygon();
+                        currentPolygon->asVector().swap( currentRing->asVector() );
+                        polygons.push_back(currentPolygon.get());
+                    }                
+                    else if (orientation == Geometry::ORIENTATION_CCW && currentPolygon.valid())
+                    // Counter clockwise means a hole, add it to the existing polygon.
+                    {
+                        // osgearth orientations are reversed from mvt
+                        currentRing->rewind(Geometry::ORIENTATION_CW);                                       
+                        currentPolygon->getHoles().push_back( currentRing );
+                    }
 
-    // The list of polygons we've collected
-    std::vector< osg::ref_ptr< osgEarth::Symbology::Polygon > > polygons;
+                    // Start a new ring
+                    currentRing = 0;
+                }
+            }
+        }
 
-    osg::ref_ptr< osgEarth::Symbology::Polygon > currentPolygon;    
+        currentRing = 0;
+        currentPolygon = 0;
 
-    osg::ref_ptr< osgEarth::Symbology::Ring > currentRing;
-    
-    for (int k = 0; k < feature.geometry_size();)
-    {
-        if (!length)
+        if (polygons.size() == 0)
+        {        
+            return 0;
+        }
+        else if (polygons.size() == 1)
         {
-            unsigned int cmd_length = feature.geometry(k++);
-            cmd = cmd_length & ((1 << cmd_bits) - 1);
-            length = cmd_length >> cmd_bits;
+            // Just return a simple polygon
+            return polygons[0].release();
         }
-        if (length > 0)
+        else
         {
-            length--;
-            if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+            // Return a multipolygon
+            MultiGeometry* multi = new MultiGeometry;
+            for (unsigned int i = 0; i < polygons.size(); i++)
             {
-                if (!currentRing)
-                {
-                    currentRing = new osgEarth::Symbology::Ring();
-                }
+                multi->add(polygons[i].get());
+            }
+            return multi;
+        }
+    }
 
-                int px = feature.geometry(k++);
-                int py = feature.geometry(k++);
-                px = zig_zag_decode(px);
-                py = zig_zag_decode(py);
+    /**
+     * Per-layer decoding state. A layer's keys and values are dictionaries
+     * shared by all its features, so they are resolved once here: keys into
+     * slots of an attribute schema, and values into ready-made attribute
+     * values that each feature simply copies.
+     */
+    struct LayerDecoder
+    {
+        LayerDecoder(const mapnik::vector::tile_layer& layer, const TileKey& key) :
+            _layer    ( layer ),
+            _xform    ( key, layer.extent() ),
+            _srs      ( key.getProfile()->getSRS() ),
+            _schema   ( new AttributeSchema() ),
+            _otherTagsSlot( -1 )
+        {
+            // Set the layer name as "mvt_layer" so we can filter it later
+            _layerSlot = _schema->add("mvt_layer");
+            _layerName.first = ATTRTYPE_STRING;
+            _layerName.second.stringValue = layer.name();
+            _layerName.second.set = true;
+
+            _keySlots.reserve(layer.keys_size());
+            for (int i = 0; i < layer.keys_size(); ++i)
+            {
+                _keySlots.push_back(_schema->add(layer.keys(i)));
+                if (layer.keys(i) == "other_tags")
+                    _otherTagsSlot = _keySlots.back();
+            }
 
-                x += px;
-                y += py;
+            _heightSlot = _schema->add("height");
 
-                double width = key.getExtent().width();
-                double height = key.getExtent().height();
+            _values.resize(layer.values_size());
+            for (int i = 0; i < layer.values_size(); ++i)
+            {
+                const mapnik::vector::tile_value& value = layer.values(i);
+                AttributeValue& a = _values[i];
+                a.first = ATTRTYPE_UNSPECIFIED;
+                a.second.set = true;
 
-                double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                currentRing->push_back(geoX, geoY, 0);
+                if (value.has_bool_value())
+                {
+                    a.first = ATTRTYPE_BOOL;
+                    a.second.boolValue = value.bool_value();
+                }
+                else if (value.has_double_value())
+                {
+                    a.first = ATTRTYPE_DOUBLE;
+                    a.second.doubleValue = value.double_value();
+                }
+                else if (value.has_float_value())
+                {
+                    a.first = ATTRTYPE_DOUBLE;
+                    a.second.doubleValue = value.float_value();
+                }
+                else if (value.has_int_value())
+                {
+                    a.first = ATTRTYPE_INT;
+                    a.second.intValue = (int)value.int_value();
+                }
+                else if (value.has_sint_value())
+                {
+                    a.first = ATTRTYPE_INT;
+                    a.second.intValue = (int)value.sint_value();
+                }
+                else if (value.has_string_value())
+                {
+                    a.first = ATTRTYPE_STRING;
+                    a.second.stringValue = value.string_value();
+                }
+                else if (value.has_uint_value())
+                {
+                    a.first = ATTRTYPE_INT;
+                    a.second.intValue = (int)value.uint_value();
+                }
             }
-            else if (cmd == (SEG_CLOSE & ((1 << cmd_bits) - 1)))
+        }
+
+        /** Decodes features [begin, end) of the layer into "output". */
+        void decode(int begin, int end, FeatureList& output) const
+        {
+            for (int j = begin; j < end; ++j)
             {
-                // The orientation is the opposite of what we want for features.  clockwise means exterior ring, counter clockwise means interior                
-
-                // Figure out what to do with the ring based on the orientation of the ring
-                Geometry::Orientation orientation = currentRing->getOrientation();
-                // Close the ring.
-                currentRing->close();
-                
-                // Clockwise means exterior ring.  Start a new polygon and add the ring.
-                if (orientation == Geometry::ORIENTATION_CW)
+                const mapnik::vector::tile_feature &feature = _layer.features(j);
+
+                osg::ref_ptr< osgEarth::Symbology::Geometry > geometry;
+
+                eGeomType geomType = static_cast<eGeomType>(feature.type());
+                if (geomType == ::Polygon)
+                {
+                    geometry = decodePolygon(feature, _xform);
+                }
+                else if (geomType == ::LineString)
                 {
-                    // osgearth orientations are reversed from mvt
-                    currentRing->rewind(Geometry::ORIENTATION_CCW);
-                    
-                    currentPolygon = new osgEarth::Symbology::Polygon(&currentRing->asVector());                                            
-                    polygons.push_back(currentPolygon.get());
-                }                
-                else if (orientation == Geometry::ORIENTATION_CCW)
-                // Counter clockwise means a hole, add it to the existing polygon.
+                    geometry = decodeLine(feature, _xform);
+                }
+                else if (geomType == ::Point)
                 {
-                    // osgearth orientations are reversed from mvt
-                    currentRing->rewind(Geometry::ORIENTATION_CW);                                       
-                    currentPolygon->getHoles().push_back( currentRing );
+                    geometry = decodePoint(feature, _xform);
                 }
+                else
+                {
+                    geometry = decodeLine(feature, _xform);
+                }
+
+                // features without geometry are dropped, so don't bother with their attributes.
+                if (!geometry.valid())
+                    continue;
 
-                // Start a new ring
-                currentRing = 0;
+                osg::ref_ptr< Feature > oeFeature = new Feature(geometry.get(), _srs.get());
+
+                AttributeTable& attrs = oeFeature->getAttrs();
+                attrs.setSchema(_schema.get());
+                attrs.at(_layerSlot) = _layerName;
+
+                // Read attributes
+                for (int k = 0; k + 1 < feature.tags_size(); k += 2)
+                {
+                    unsigned keyIndex = feature.tags(k);
+                    unsigned valueIndex = feature.tags(k+1);
+                    if (keyIndex >= _keySlots.size() || valueIndex >= _values.size())
+                        continue;
+
+                    const AttributeValue& value = _values[valueIndex];
+                    if (value.first != ATTRTYPE_UNSPECIFIED)
+                    {
+                        attrs.at(_keySlots[keyIndex]) = value;
+                    }
+
+                    // Special path for getting heights from our test dataset.
+                    if ((int)_keySlots[keyIndex] == _otherTagsSlot)
+                    {
+                        const std::string& other_tags = _layer.values(valueIndex).string_value();
+
+                        StringTokenizer tok("=>");
+                        StringVector tized;
+                        tok.tokenize(other_tags, tized);
+                        if (tized.size() == 3)
+                        {
+                            if (tized[0] == "height")
+                            {
+                                // Remove quotes from the height
+                                float height = as<float>(tized[2], FLT_MAX);
+                                if (height != FLT_MAX)
+                                {
+                                    AttributeValue& a = attrs.at(_heightSlot);
+                                    a.first = ATTRTYPE_DOUBLE;
+                                    a.second.doubleValue = height;
+                                    a.second.set = true;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                output.push_back(oeFeature.get());
             }
         }
-    }
-
-    currentRing = 0;
-    currentPolygon = 0;
 
-    if (polygons.size() == 0)
-    {        
-        return 0;
-    }
-    else if (polygons.size() == 1)
-    {
-        // Just return a simple polygon
-        return polygons[0].release();
-    }
-    else
+        const mapnik::vector::tile_layer&      _layer;
+        TileTransform                          _xform;
+        osg::ref_ptr<const SpatialReference>   _srs;
+        osg::ref_ptr<AttributeSchema>          _schema;
+        std::vector<unsigned>                  _keySlots;
+        std::vector<AttributeValue>            _values;
+        AttributeValue                         _layerName;
+        unsigned                               _layerSlot;
+        unsigned                               _heightSlot;
+        int                                    _otherTagsSlot;
+    };
+
+    /**
+     * Decodes a range of features in one layer; run through a ParallelTask.
+     */
+    struct DecodeRange
     {
-        // Return a multipolygon
-        MultiGeometry* multi = new MultiGeometry;
-        for (unsigned int i = 0; i < polygons.size(); i++)
-        {
-            multi->add(polygons[i].get());
+        void execute() {
+            _decoder->decode(_begin, _end, _output);
         }
-        return multi;
-    }
+
+        const LayerDecoder* _decoder;
+        int                 _begin;
+        int                 _end;
+        FeatureList         _output;
+    };
+
+    // Number of features each decoding task handles.
+    const int s_featuresPerTask = 1024;
 }
 
 #endif
 
 
 bool
-    MVT::read(std::istream& in, const TileKey& key, FeatureList& features)
+    MVT::read(std::istream& in, const TileKey& key, FeatureList& features, bool parallel)
 {
     features.clear();
 
@@ -294,108 +479,62 @@ bool
 
     if (tile.ParseFromString(value))
     {
-        for (unsigned int i = 0; i < tile.layers().size(); i++)
+        // resolve each layer's dictionaries up front.
+        std::vector< LayerDecoder* > decoders;
+        decoders.reserve(tile.layers_size());
+        for (int i = 0; i < tile.layers_size(); i++)
         {
-            const mapnik::vector::tile_layer &layer = tile.layers().Get(i);
-
+            decoders.push_back(new LayerDecoder(tile.layers(i), key));
+        }
 
-            for (unsigned int j = 0; j < layer.features().size(); j++)
+        // split the layers into ranges of features, in tile order.
+        typedef ParallelTask<DecodeRange> DecodeRangeTask;
+        std::vector< osg::ref_ptr<DecodeRangeTask> > tasks;
+        for (unsigned i = 0; i < decoders.size(); i++)
+        {
+            int numFeatures = decoders[i]->_layer.features_size();
+            for (int begin = 0; begin < numFeatures; begin += s_featuresPerTask)
             {
-                const mapnik::vector::tile_feature &feature = layer.features().Get(j);
-
-                
-                osg::ref_ptr< Feature > oeFeature = new Feature(0, key.getProfile()->getSRS());
-
-                // Set the layer name as "mvt_layer" so we can filter it later
-                oeFeature->set("mvt_layer", layer.name());
-
-                // Read attributes
-                for (unsigned int k = 0; k < feature.tags().size(); k+=2)
-                {
-                    std::string key = layer.keys().Get(feature.tags().Get(k));
-                    mapnik::vector::tile_value value = layer.values().Get(feature.tags().Get(k+1));
-
-                    if (value.has_bool_value())
-                    {
-                        oeFeature->set(key, value.bool_value());
-                    }
-                    else if (value.has_double_value())
-                    {
-                        oeFeature->set(key, value.double_value());
-                    }
-                    else if (value.has_float_value())
-                    {
-                        oeFeature->set(key, value.float_value());
-                    }
-                    else if (value.has_int_value())
-                    {
-                        oeFeature->set(key, (int)value.int_value());
-                    }
-                    else if (value.has_sint_value())
-                    {
-                        oeFeature->set(key, (int)value.sint_value());
-                    }
-                    else if (value.has_string_value())
-                    {
-                        oeFeature->set(key, value.string_value());
-                    }
-                    else if (value.has_uint_value())
-                    {
-                        oeFeature->set(key, (int)value.uint_value());
-                    }
-
-                    // Special path for getting heights from our test dataset.
-                    if (key == "other_tags")
-                    {
-                        std::string other_tags = value.string_value();
-
-                        StringTokenizer tok("=>");
-                        StringVector tized;
-                        tok.tokenize(other_tags, tized);
-                        if (tized.size() == 3)
-                        {
-                            if (tized[0] == "height")
-                            {
-                                std::string value = tized[2];
-                                // Remove quotes from the height
-                                float height = as<float>(value, FLT_MAX);
-                                if (height != FLT_MAX)
-                                {
-                                    oeFeature->set("height", height);
-                                }
-                            }
-                        }
-                    }
-                }
+                DecodeRangeTask* task = new DecodeRangeTask();
+                task->_decoder = decoders[i];
+                task->_begin   = begin;
+                task->_end     = osg::minimum(begin + s_featuresPerTask, numFeatures);
+                tasks.push_back(task);
+            }
+        }
 
-                
+        TaskService* service = parallel && tasks.size() > 1 ?
+            Registry::instance()->getTaskServiceManager()->getOrAdd("MVT decoding") : 0L;
 
-                osg::ref_ptr< osgEarth::Symbology::Geometry > geometry;
+        if (service)
+        {
+            // Decode the first range on this thread and farm the rest out to the pool.
+            Threading::MultiEvent done( tasks.size()-1 );
+            for (unsigned i = 1; i < tasks.size(); i++)
+            {
+                tasks[i]->_mev = &done;
+                service->add(tasks[i].get());
+            }
+            tasks[0]->execute();
+            done.wait();
+        }
+        else
+        {
+            for (unsigned i = 0; i < tasks.size(); i++)
+            {
+                tasks[i]->execute();
+            }
+        }
 
-                eGeomType geomType = static_cast<eGeomType>(feature.type());
-                if (geomType == ::Polygon)
-                {
-                    geometry = decodePolygon(feature, key, layer.extent());
-                }
-                else if (geomType == ::LineString)
-                {
-                    geometry = decodeLine(feature, key, layer.extent());
-                }
-                else if (geomType == ::Point)
-                {
-                    geometry = decodePoint(feature, key, layer.extent());
-                }
-                else
-                {
-                    geometry = decodeLine(feature, key, layer.extent());
-                }
+        // Merge the results in order so the output matches a sequential read.
+        for (unsigned i = 0; i < tasks.size(); i++)
+        {
+            features.insert(features.end(), tasks[i]->_output.begin(), tasks[i]->_output.end());
+        }
 
-                if (geometry)
-                {
-                    oeFeature->setGeometry( geometry );
-                    features.push_back(oeFeature.get());
-                }
-            }
+        for (unsigned i = 0; i < decoders.size(); i++)
+        {
+            delete decoders[i];
         }
     }
     else
@@ -409,4 +548,4 @@ bool
     OE_NOTICE << "Mapnik Vector Tiles NOT SUPPORTED - please compile osgEarth with protobuf to enable." << std::endl;
     return false;
 #endif
-}
+}
\ No newline at end of file
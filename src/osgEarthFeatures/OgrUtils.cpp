@@ -268,23 +268,44 @@ OgrUtils::createOgrGeometry(const osgEarth::Symbology::Geometry* geometry, OGRwk
 
 Feature*
 OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile)
+{
+    return createFeature( handle, profile, 0L );
+}
+
+Feature*
+OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile, const AttributeSchema* schema)
 {
     Feature* f = 0L;
     if ( profile )
     {
-        f = createFeature( handle, profile->getSRS() );
+        f = createFeature( handle, profile->getSRS(), schema );
         if ( f && profile->geoInterp().isSet() )
             f->geoInterp() = profile->geoInterp().get();
     }
     else
     {
-        f = createFeature( handle, (const SpatialReference*)0L );
+        f = createFeature( handle, (const SpatialReference*)0L, schema );
     }
     return f;
 }            
 
+AttributeSchema*
+OgrUtils::createAttributeSchema( OGRFeatureDefnH defnHandle )
+{
+    AttributeSchema* schema = new AttributeSchema();
+
+    int numFields = OGR_FD_GetFieldCount( defnHandle );
+    for (int i = 0; i < numFields; ++i)
+    {
+        OGRFieldDefnH field_handle_ref = OGR_FD_GetFieldDefn( defnHandle, i );
+        schema->add( osgEarth::toLower( std::string(OGR_Fld_GetNameRef(field_handle_ref)) ) );
+    }
+
+    return schema;
+}
+
 Feature*
-OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
+OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs, const AttributeSchema* schema )
 {
     long fid = OGR_F_GetFID( handle );
 
@@ -300,13 +321,31 @@ OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
     Feature* feature = new Feature( geom, srs, Style(), fid );
 
     int numAttrs = OGR_F_GetFieldCount(handle); 
+
+    // With a schema that matches the fields one-to-one, write the values
+    // straight into their slots without building the name strings.
+    AttributeTable& attrs = feature->getAttrs();
+    bool bySlot = schema && schema->size() == (unsigned)numAttrs;
+    if ( schema )
+        attrs.setSchema( schema );
+
     for (int i = 0; i < numAttrs; ++i) 
     { 
         OGRFieldDefnH field_handle_ref = OGR_F_GetFieldDefnRef( handle, i ); 
 
+        // skip fields the layer was told not to read:
+        if ( OGR_Fld_IsIgnored(field_handle_ref) )
+            continue;
+
         // get the field name and convert to lower case:
-        const char* field_name = OGR_Fld_GetNameRef( field_handle_ref ); 
-        std::string name = osgEarth::toLower( std::string(field_name) );
+        std::string name;
+        if ( !bySlot )
+        {
+            const char* field_name = OGR_Fld_GetNameRef( field_handle_ref ); 
+            name = osgEarth::toLower( std::string(field_name) );
+        }
+
+        AttributeValue& a = bySlot ? attrs.at(i) : attrs[name];
 
         // get the field type and set the value appropriately
         OGRFieldType field_type = OGR_Fld_GetType( field_handle_ref );        
@@ -314,40 +353,31 @@ OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
         {
         case OFTInteger:
             {     
-                if (OGR_F_IsFieldSet( handle, i ))
+                a.first = ATTRTYPE_INT;
+                a.second.set = OGR_F_IsFieldSet( handle, i ) != 0;
+                if ( a.second.set )
                 {
-                    int value = OGR_F_GetFieldAsInteger( handle, i );
-                    feature->set( name, value );                    
-                }
-                else
-                {
-                    feature->setNull( name, ATTRTYPE_INT );
+                    a.second.intValue = OGR_F_GetFieldAsInteger( handle, i );
                 }
             }
             break;
         case OFTReal:
             {
-                if (OGR_F_IsFieldSet( handle, i ))
-                {
-                    double value = OGR_F_GetFieldAsDouble( handle, i );
-                    feature->set( name, value );
-                }
-                else
+                a.first = ATTRTYPE_DOUBLE;
+                a.second.set = OGR_F_IsFieldSet( handle, i ) != 0;
+                if ( a.second.set )
                 {
-                    feature->setNull( name, ATTRTYPE_DOUBLE );
+                    a.second.doubleValue = OGR_F_GetFieldAsDouble( handle, i );
                 }
             }
             break;
         default:
             {
-                if (OGR_F_IsFieldSet( handle, i ))
-                {
-                    const char* value = OGR_F_GetFieldAsString(handle, i);
-                    feature->set( name, std::string(value) );
-                }
-                else
+                a.first = ATTRTYPE_STRING;
+                a.second.set = OGR_F_IsFieldSet( handle, i ) != 0;
+                if ( a.second.set )
                 {
-                    feature->setNull( name, ATTRTYPE_STRING );
+                    a.second.stringValue = OGR_F_GetFieldAsString( handle, i );
                 }
             }
         }
@@ -48,7 +48,9 @@ _src  ( rhs._src ),
 _rpn  ( rhs._rpn ),
 _vars ( rhs._vars ),
 _value( rhs._value ),
-_dirty( rhs._dirty )
+_dirty( rhs._dirty ),
+_bindingSchema( rhs._bindingSchema ),
+_bindings     ( rhs._bindings )
 {
     //nop
 }
@@ -99,6 +101,8 @@ NumericExpression::init()
 {
     _vars.clear();
     _rpn.clear();
+    _bindingSchema = 0L;
+    _bindings.clear();
 
     StringTokenizer variablesTokenizer( "", "" );
     variablesTokenizer.addDelims( "[]", true );
@@ -277,12 +281,49 @@ NumericExpression::set( const Variable& var, double value )
     }
 }
 
+void
+NumericExpression::bind( const osg::Referenced* schema, const std::vector<int>& slots )
+{
+    _bindingSchema = schema;
+    _bindings = slots;
+}
+
+// evaluation stack that lives on the call stack for typical expressions
+namespace
+{
+    struct EvalStack
+    {
+        EvalStack(unsigned capacity) : _top(0u)
+        {
+            if ( capacity > 32u )
+            {
+                _heap.resize( capacity );
+                _data = &_heap[0];
+            }
+            else
+            {
+                _data = _local;
+            }
+        }
+        unsigned size() const { return _top; }
+        bool empty() const { return _top == 0u; }
+        double top() const { return _data[_top-1]; }
+        void pop() { --_top; }
+        void push(double v) { _data[_top++] = v; }
+
+        double              _local[32];
+        std::vector<double> _heap;
+        double*             _data;
+        unsigned            _top;
+    };
+}
+
 double
 NumericExpression::eval() const
 {
     if ( _dirty )
     {
-        std::stack<double> s;
+        EvalStack s( _rpn.size() );
 
         for( unsigned i=0; i<_rpn.size(); ++i )
         {
@@ -394,7 +435,9 @@ _vars( rhs._vars ),
 _value( rhs._value ),
 _infix( rhs._infix ),
 _dirty( rhs._dirty ),
-_uriContext( rhs._uriContext )
+_uriContext( rhs._uriContext ),
+_bindingSchema( rhs._bindingSchema ),
+_bindings( rhs._bindings )
 {
     //nop
 }
@@ -440,6 +483,9 @@ StringExpression::getConfig() const
 void
 StringExpression::init()
 {
+    _bindingSchema = 0L;
+    _bindings.clear();
+
     bool inQuotes = false;
     int inVar = 0;
     int startPos = 0;
@@ -533,6 +579,13 @@ StringExpression::set( const Variable& var, const std::string& value )
     }
 }
 
+void
+StringExpression::bind( const osg::Referenced* schema, const std::vector<int>& slots )
+{
+    _bindingSchema = schema;
+    _bindings = slots;
+}
+
 void
 StringExpression::set( const std::string& varName, const std::string& value )
 {
@@ -550,11 +603,11 @@ StringExpression::eval() const
 {
     if ( _dirty )
     {
-        std::stringstream buf;
+        std::string& value = const_cast<StringExpression*>(this)->_value;
+        value.clear();
         for( AtomVector::const_iterator i = _infix.begin(); i != _infix.end(); ++i )
-            buf << i->second;
+            value.append( i->second );
 
-        const_cast<StringExpression*>(this)->_value = buf.str();
         const_cast<StringExpression*>(this)->_dirty = false;
     }
 